@@ -0,0 +1,584 @@
+/*
+===========================================================================
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company.
+
+This file is part of Spearmint Source Code.
+
+Spearmint Source Code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Spearmint Source Code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Spearmint Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, Spearmint Source Code is also subject to certain additional terms.
+You should have received a copy of these additional terms immediately following
+the terms and conditions of the GNU General Public License.  If not, please
+request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional
+terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc.,
+Suite 120, Rockville, Maryland 20850 USA.
+===========================================================================
+*/
+
+// bb_qcommon.c -- the parts of qcommon the collision model and the bot library
+// need, the files are read from the base directory without search paths or paks
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "botbench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+char		bb_basedir[MAX_OSPATH] = ".";
+
+cvar_t		*com_speeds;
+
+static cvar_t	*bb_cvars;
+
+#define	MAX_BB_FILES	64
+static FILE		*bb_files[MAX_BB_FILES];
+
+/*
+===============================================================================
+
+COMMON
+
+===============================================================================
+*/
+
+/*
+=============
+Com_Printf
+=============
+*/
+void QDECL Com_Printf( const char *fmt, ... ) {
+	va_list		argptr;
+
+	va_start( argptr, fmt );
+	vprintf( fmt, argptr );
+	va_end( argptr );
+}
+
+/*
+=============
+Com_DPrintf
+=============
+*/
+void QDECL Com_DPrintf( const char *fmt, ... ) {
+	va_list		argptr;
+
+	if ( !atoi( Cvar_VariableString( "developer" ) ) ) {
+		return;
+	}
+
+	va_start( argptr, fmt );
+	vprintf( fmt, argptr );
+	va_end( argptr );
+}
+
+/*
+=============
+Com_Error
+=============
+*/
+void QDECL Com_Error( int code, const char *fmt, ... ) {
+	va_list		argptr;
+
+	va_start( argptr, fmt );
+	printf( "ERROR: " );
+	vprintf( fmt, argptr );
+	printf( "\n" );
+	va_end( argptr );
+
+	exit( 1 );
+}
+
+/*
+=============
+Com_LoadStage
+=============
+*/
+void Com_LoadStage( const char *stage ) {
+}
+
+/*
+=============
+Com_RunJobs
+
+There are no worker threads, all the jobs are run in order
+=============
+*/
+void Com_RunJobs( jobFunc_t func, void *data, int numJobs, int numWorkers ) {
+	int		i;
+
+	for ( i = 0; i < numJobs; i++ ) {
+		func( data, i );
+	}
+}
+
+/*
+=============
+CopyString
+=============
+*/
+char *CopyString( const char *in ) {
+	char	*out;
+
+	out = Z_Malloc( strlen( in ) + 1 );
+	strcpy( out, in );
+	return out;
+}
+
+/*
+=============
+Cmd_Argc
+=============
+*/
+int Cmd_Argc( void ) {
+	return 0;
+}
+
+/*
+=============
+Cmd_Argv
+=============
+*/
+char *Cmd_Argv( int arg ) {
+	return "";
+}
+
+/*
+===============================================================================
+
+CVARS
+
+===============================================================================
+*/
+
+/*
+=============
+BB_FindCvar
+=============
+*/
+static cvar_t *BB_FindCvar( const char *name ) {
+	cvar_t	*var;
+
+	for ( var = bb_cvars; var; var = var->next ) {
+		if ( !Q_stricmp( var->name, name ) ) {
+			return var;
+		}
+	}
+	return NULL;
+}
+
+/*
+=============
+BB_SetCvar
+=============
+*/
+void BB_SetCvar( const char *name, const char *value ) {
+	cvar_t	*var;
+
+	var = BB_FindCvar( name );
+	if ( !var ) {
+		var = Z_Malloc( sizeof( *var ) );
+		var->name = CopyString( name );
+		var->next = bb_cvars;
+		bb_cvars = var;
+	} else {
+		Z_Free( var->string );
+	}
+
+	var->string = CopyString( value );
+	var->value = atof( value );
+	var->integer = atoi( value );
+	var->modified = qtrue;
+	var->modificationCount++;
+}
+
+/*
+=============
+Cvar_Get
+
+Cvars set on the command line keep their value
+=============
+*/
+cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
+	cvar_t	*var;
+
+	var = BB_FindCvar( var_name );
+	if ( !var ) {
+		BB_SetCvar( var_name, var_value );
+		var = BB_FindCvar( var_name );
+	}
+	var->flags |= flags;
+	return var;
+}
+
+/*
+=============
+Cvar_VariableString
+=============
+*/
+char *Cvar_VariableString( const char *var_name ) {
+	cvar_t	*var;
+
+	var = BB_FindCvar( var_name );
+	return var ? var->string : "";
+}
+
+/*
+===============================================================================
+
+MEMORY
+
+===============================================================================
+*/
+
+/*
+=============
+Z_MallocDebug
+=============
+*/
+void *Z_MallocDebug( int size, char *label, char *file, int line ) {
+	void	*buf;
+
+	buf = calloc( 1, size );
+	if ( !buf ) {
+		Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from %s:%d", size, file, line );
+	}
+	return buf;
+}
+
+/*
+=============
+Z_FreeDebug
+=============
+*/
+void Z_FreeDebug( void *ptr, char *label, char *file, int line ) {
+	free( ptr );
+}
+
+/*
+=============
+Z_AvailableMemory
+=============
+*/
+int Z_AvailableMemory( void ) {
+	return 0x7fffffff;
+}
+
+/*
+=============
+Hunk_AllocDebug
+
+Hunk memory is never freed
+=============
+*/
+void *Hunk_AllocDebug( int size, ha_pref preference, char *label, char *file, int line ) {
+	return Z_MallocDebug( size, label, file, line );
+}
+
+/*
+=============
+Hunk_CheckMark
+=============
+*/
+qboolean Hunk_CheckMark( void ) {
+	return qfalse;
+}
+
+/*
+===============================================================================
+
+SYSTEM
+
+===============================================================================
+*/
+
+#ifdef _WIN32
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds( void ) {
+	static LARGE_INTEGER	frequency, base;
+	LARGE_INTEGER			count;
+
+	if ( !frequency.QuadPart ) {
+		QueryPerformanceFrequency( &frequency );
+		QueryPerformanceCounter( &base );
+	}
+	QueryPerformanceCounter( &count );
+
+	return ( count.QuadPart - base.QuadPart ) * 1000000 / frequency.QuadPart;
+}
+#else
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds( void ) {
+	static time_t	base;
+	struct timeval	tp;
+
+	gettimeofday( &tp, NULL );
+	if ( !base ) {
+		base = tp.tv_sec;
+	}
+
+	return (int64_t)( tp.tv_sec - base ) * 1000000 + tp.tv_usec;
+}
+#endif
+
+/*
+================
+Sys_Milliseconds
+================
+*/
+int Sys_Milliseconds( void ) {
+	return (int)( Sys_Microseconds() / 1000 );
+}
+
+/*
+===============================================================================
+
+FILE SYSTEM
+
+===============================================================================
+*/
+
+/*
+=============
+FS_BuildOSPath
+=============
+*/
+char *FS_BuildOSPath( const char *base, const char *game, const char *qpath ) {
+	static char	ospath[2][MAX_OSPATH];
+	static int	toggle;
+
+	toggle ^= 1;
+	if ( game && *game ) {
+		Com_sprintf( ospath[toggle], sizeof( ospath[0] ), "%s/%s/%s", base, game, qpath );
+	} else {
+		Com_sprintf( ospath[toggle], sizeof( ospath[0] ), "%s/%s", base, qpath );
+	}
+	return ospath[toggle];
+}
+
+/*
+=============
+BB_OpenFile
+=============
+*/
+static fileHandle_t BB_OpenFile( const char *qpath, const char *mode ) {
+	int		i;
+
+	for ( i = 1; i < MAX_BB_FILES; i++ ) {
+		if ( !bb_files[i] ) {
+			break;
+		}
+	}
+	if ( i == MAX_BB_FILES ) {
+		Com_Error( ERR_FATAL, "BB_OpenFile: no free file handles" );
+	}
+
+	bb_files[i] = fopen( FS_BuildOSPath( bb_basedir, NULL, qpath ), mode );
+	return bb_files[i] ? i : 0;
+}
+
+/*
+=============
+BB_FileForHandle
+=============
+*/
+static FILE *BB_FileForHandle( fileHandle_t f ) {
+	if ( f <= 0 || f >= MAX_BB_FILES || !bb_files[f] ) {
+		Com_Error( ERR_FATAL, "BB_FileForHandle: bad file handle %d", f );
+	}
+	return bb_files[f];
+}
+
+/*
+=============
+FS_FOpenFileRead
+=============
+*/
+long FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFILE ) {
+	fileHandle_t	f;
+	long			length;
+
+	f = BB_OpenFile( qpath, "rb" );
+	if ( !f ) {
+		if ( file ) {
+			*file = 0;
+		}
+		return -1;
+	}
+
+	fseek( bb_files[f], 0, SEEK_END );
+	length = ftell( bb_files[f] );
+	fseek( bb_files[f], 0, SEEK_SET );
+
+	if ( file ) {
+		*file = f;
+	} else {
+		FS_FCloseFile( f );
+	}
+	return length;
+}
+
+/*
+=============
+FS_FOpenFileWrite
+=============
+*/
+fileHandle_t FS_FOpenFileWrite( const char *qpath ) {
+	return BB_OpenFile( qpath, "wb" );
+}
+
+/*
+=============
+FS_FOpenFileByMode
+=============
+*/
+int FS_FOpenFileByMode( const char *qpath, fileHandle_t *f, fsMode_t mode ) {
+	switch ( mode ) {
+	case FS_READ:
+		return FS_FOpenFileRead( qpath, f, qtrue );
+	case FS_WRITE:
+		*f = FS_FOpenFileWrite( qpath );
+		return *f ? 0 : -1;
+	case FS_APPEND:
+	case FS_APPEND_SYNC:
+		*f = BB_OpenFile( qpath, "ab" );
+		return *f ? 0 : -1;
+	default:
+		Com_Error( ERR_FATAL, "FS_FOpenFileByMode: bad mode" );
+	}
+	return -1;
+}
+
+/*
+=============
+FS_Read
+=============
+*/
+int FS_Read( void *buffer, int len, fileHandle_t f ) {
+	return (int)fread( buffer, 1, len, BB_FileForHandle( f ) );
+}
+
+/*
+=============
+FS_Write
+=============
+*/
+int FS_Write( const void *buffer, int len, fileHandle_t f ) {
+	return (int)fwrite( buffer, 1, len, BB_FileForHandle( f ) );
+}
+
+/*
+=============
+FS_Seek
+=============
+*/
+int FS_Seek( fileHandle_t f, long offset, int origin ) {
+	switch ( origin ) {
+	case FS_SEEK_CUR:
+		return fseek( BB_FileForHandle( f ), offset, SEEK_CUR );
+	case FS_SEEK_END:
+		return fseek( BB_FileForHandle( f ), offset, SEEK_END );
+	case FS_SEEK_SET:
+		return fseek( BB_FileForHandle( f ), offset, SEEK_SET );
+	default:
+		Com_Error( ERR_FATAL, "FS_Seek: bad origin" );
+	}
+	return -1;
+}
+
+/*
+=============
+FS_FCloseFile
+=============
+*/
+void FS_FCloseFile( fileHandle_t f ) {
+	fclose( BB_FileForHandle( f ) );
+	bb_files[f] = NULL;
+}
+
+/*
+=============
+FS_ReadFile
+
+Returns the length of the file and -1 if it doesn't exist,
+a NULL buffer only checks the file
+=============
+*/
+long FS_ReadFile( const char *qpath, void **buffer ) {
+	fileHandle_t	f;
+	long			length;
+	byte			*buf;
+
+	length = FS_FOpenFileRead( qpath, buffer ? &f : NULL, qtrue );
+	if ( !buffer ) {
+		return length;
+	}
+	*buffer = NULL;
+	if ( length < 0 ) {
+		return -1;
+	}
+
+	buf = Z_Malloc( length + 1 );
+	FS_Read( buf, length, f );
+	FS_FCloseFile( f );
+
+	*buffer = buf;
+	return length;
+}
+
+/*
+=============
+FS_FreeFile
+=============
+*/
+void FS_FreeFile( void *buffer ) {
+	Z_Free( buffer );
+}
+
+/*
+=============
+FS_MapFile
+
+Files are never mapped, the callers read them instead
+=============
+*/
+long FS_MapFile( const char *qpath, void **buffer, void **mapping ) {
+	*buffer = NULL;
+	*mapping = NULL;
+	return -1;
+}
+
+/*
+=============
+FS_UnmapFile
+=============
+*/
+void FS_UnmapFile( void *mapping ) {
+}
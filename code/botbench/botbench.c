@@ -0,0 +1,560 @@
+/*
+===========================================================================
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company.
+
+This file is part of Spearmint Source Code.
+
+Spearmint Source Code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Spearmint Source Code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Spearmint Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, Spearmint Source Code is also subject to certain additional terms.
+You should have received a copy of these additional terms immediately following
+the terms and conditions of the GNU General Public License.  If not, please
+request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional
+terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc.,
+Suite 120, Rockville, Maryland 20850 USA.
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		botbench.c
+ *
+ * desc:		replays a bot library query capture against the map it was
+ *				captured on and reports the query throughput, the routing
+ *				cache memory and the routing cache hit rate
+ *
+ *****************************************************************************/
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "../botlib/l_libvar.h"
+#include "../botlib/aasfile.h"
+#include "../botlib/botlib.h"
+#include "../botlib/be_aas.h"
+#include "../botlib/be_aas_funcs.h"
+#include "../botlib/be_aas_def.h"
+#include "../botlib/be_interface.h"
+#include "botbench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+botlib_export_t *GetBotLibAPI(int apiVersion, botlib_import_t *import);
+
+//maximum number of areas a replayed trace stores
+#define MAX_REPLAYAREAS		1024
+
+typedef struct bb_querystats_s
+{
+	char *name;
+	int count;
+	int64_t usec;
+	int mismatches;
+} bb_querystats_t;
+
+static bb_querystats_t querystats[MAX_QUERYTYPES] =
+{
+	{""},
+	{"StartFrame"},
+	{"EnableRoutingArea"},
+	{"AreaTravelTimeToGoalArea"},
+	{"PredictRoute"},
+	{"TraceAreas"},
+	{"NearestHideArea"}
+};
+
+//===========================================================================
+//
+// bot library imports
+//
+//===========================================================================
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void QDECL BB_Print(int type, char *fmt, ...)
+{
+	char str[2048];
+	va_list ap;
+
+	va_start(ap, fmt);
+	Q_vsnprintf(str, sizeof(str), fmt, ap);
+	va_end(ap);
+
+	switch(type)
+	{
+		case PRT_DEVELOPER: Com_DPrintf("%s", str); break;
+		case PRT_MESSAGE: Com_Printf("%s", str); break;
+		case PRT_WARNING: Com_Printf("Warning: %s", str); break;
+		case PRT_ERROR: Com_Printf("Error: %s", str); break;
+		case PRT_FATAL: Com_Printf("Fatal: %s", str); break;
+		case PRT_EXIT: Com_Error(ERR_DROP, "Exit: %s", str); break;
+		default: Com_Printf("unknown print type\n"); break;
+	} //end switch
+} //end of the function BB_Print
+//===========================================================================
+// there are no entities, only the world is traced
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_Trace(bsp_trace_t *trace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int passent, int contentmask)
+{
+	CM_BoxTrace(trace, start, end, mins, maxs, 0, contentmask, TT_AABB);
+	trace->entityNum = trace->fraction < 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+} //end of the function BB_Trace
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_EntityTrace(bsp_trace_t *trace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int entnum, int contentmask)
+{
+	Com_Memset(trace, 0, sizeof(bsp_trace_t));
+	trace->fraction = 1.0;
+	VectorCopy(end, trace->endpos);
+	trace->entityNum = ENTITYNUM_NONE;
+} //end of the function BB_EntityTrace
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int BB_PointContents(vec3_t point)
+{
+	return CM_PointContents(point, 0);
+} //end of the function BB_PointContents
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int BB_inPVS(vec3_t p1, vec3_t p2)
+{
+	int leafnum1, leafnum2, cluster;
+	byte *mask;
+
+	leafnum1 = CM_PointLeafnum(p1);
+	leafnum2 = CM_PointLeafnum(p2);
+	mask = CM_ClusterPVS(CM_LeafCluster(leafnum1));
+	cluster = CM_LeafCluster(leafnum2);
+	if (mask && !(mask[cluster >> 3] & (1 << (cluster & 7)))) return qfalse;
+	//a door blocks sight
+	if (!CM_AreasConnected(CM_LeafArea(leafnum1), CM_LeafArea(leafnum2))) return qfalse;
+	return qtrue;
+} //end of the function BB_inPVS
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_BSPModelMinsMaxsOrigin(int modelnum, vec3_t angles, vec3_t outmins, vec3_t outmaxs, vec3_t origin)
+{
+	clipHandle_t h;
+	vec3_t mins, maxs;
+	float max;
+	int i;
+
+	h = CM_InlineModel(modelnum);
+	CM_ModelBounds(h, mins, maxs);
+	//if the model is rotated
+	if (angles[0] || angles[1] || angles[2])
+	{
+		//expand for rotation
+		max = RadiusFromBounds(mins, maxs);
+		for (i = 0; i < 3; i++)
+		{
+			mins[i] = -max;
+			maxs[i] = max;
+		} //end for
+	} //end if
+	if (outmins) VectorCopy(mins, outmins);
+	if (outmaxs) VectorCopy(maxs, outmaxs);
+	if (origin) VectorClear(origin);
+} //end of the function BB_BSPModelMinsMaxsOrigin
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_BotClientCommand(int playerNum, const char *command)
+{
+} //end of the function BB_BotClientCommand
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void *BB_GetMemory(int size)
+{
+	return Z_Malloc(size);
+} //end of the function BB_GetMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_FreeMemory(void *ptr)
+{
+	Z_Free(ptr);
+} //end of the function BB_FreeMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void *BB_HunkAlloc(int size)
+{
+	return Hunk_Alloc(size, h_high);
+} //end of the function BB_HunkAlloc
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int BB_DebugLineCreate(void)
+{
+	return 0;
+} //end of the function BB_DebugLineCreate
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_DebugLineDelete(int line)
+{
+} //end of the function BB_DebugLineDelete
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_DebugLineShow(int line, vec3_t start, vec3_t end, int color)
+{
+} //end of the function BB_DebugLineShow
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int BB_DebugPolygonCreate(int color, int numPoints, vec3_t *points)
+{
+	return 0;
+} //end of the function BB_DebugPolygonCreate
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_DebugPolygonDelete(int id)
+{
+} //end of the function BB_DebugPolygonDelete
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static botlib_export_t *BB_InitBotLib(void)
+{
+	botlib_import_t botlib_import;
+
+	Com_Memset(&botlib_import, 0, sizeof(botlib_import));
+	botlib_import.MilliSeconds = Sys_Milliseconds;
+	botlib_import.Print = BB_Print;
+	botlib_import.Trace = BB_Trace;
+	botlib_import.EntityTrace = BB_EntityTrace;
+	botlib_import.PointContents = BB_PointContents;
+	botlib_import.inPVS = BB_inPVS;
+	botlib_import.GetEntityToken = CM_GetEntityToken;
+	botlib_import.BSPModelMinsMaxsOrigin = BB_BSPModelMinsMaxsOrigin;
+	botlib_import.BotClientCommand = BB_BotClientCommand;
+	botlib_import.GetMemory = BB_GetMemory;
+	botlib_import.FreeMemory = BB_FreeMemory;
+	botlib_import.AvailableMemory = Z_AvailableMemory;
+	botlib_import.HunkAlloc = BB_HunkAlloc;
+	botlib_import.FS_FOpenFile = FS_FOpenFileByMode;
+	botlib_import.FS_Read = FS_Read;
+	botlib_import.FS_Write = FS_Write;
+	botlib_import.FS_FCloseFile = FS_FCloseFile;
+	botlib_import.FS_Seek = FS_Seek;
+	botlib_import.DebugLineCreate = BB_DebugLineCreate;
+	botlib_import.DebugLineDelete = BB_DebugLineDelete;
+	botlib_import.DebugLineShow = BB_DebugLineShow;
+	botlib_import.DebugPolygonCreate = BB_DebugPolygonCreate;
+	botlib_import.DebugPolygonDelete = BB_DebugPolygonDelete;
+	//the routing jobs run on the calling thread
+
+	return GetBotLibAPI(BOTLIB_API_VERSION, &botlib_import);
+} //end of the function BB_InitBotLib
+
+//===========================================================================
+//
+// replay
+//
+//===========================================================================
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_ReplayVector(int *record, vec3_t v)
+{
+	floatint_t fi;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		fi.i = record[i];
+		v[i] = fi.f;
+	} //end for
+} //end of the function BB_ReplayVector
+//===========================================================================
+// replays the query, returns qtrue when the results are the same as the
+// captured results
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static qboolean BB_ReplayQuery(botlib_export_t *botlib, int *record)
+{
+	static int areas[MAX_REPLAYAREAS];
+	static vec3_t points[MAX_REPLAYAREAS];
+	aas_predictroute_t route;
+	vec3_t origin, end;
+	floatint_t fi;
+	unsigned int checksum;
+	int i, result, maxareas;
+
+	switch(record[0])
+	{
+		case QUERY_STARTFRAME:
+		{
+			fi.i = record[1];
+			botlib->BotLibStartFrame(fi.f);
+			return qtrue;
+		} //end case
+		case QUERY_ENABLEROUTINGAREA:
+		{
+			result = botlib->aas.AAS_EnableRoutingArea(record[1], record[2]);
+			return result == record[3];
+		} //end case
+		case QUERY_TRAVELTIMETOGOALAREA:
+		{
+			BB_ReplayVector(&record[3], origin);
+			result = botlib->aas.AAS_AreaTravelTimeToGoalArea(record[1], record[2] ? origin : NULL, record[6], record[7]);
+			return result == record[8];
+		} //end case
+		case QUERY_PREDICTROUTE:
+		{
+			BB_ReplayVector(&record[2], origin);
+			result = botlib->aas.AAS_PredictRoute(&route, record[1], origin, record[5], record[6], record[7],
+							record[8], record[9], record[10], record[11], record[12]);
+			BB_ReplayVector(&record[14], end);
+			return result == record[13] && VectorCompare(route.endpos, end) &&
+					route.endarea == record[17] && route.stopevent == record[18] &&
+					route.endcontents == record[19] && route.endtravelflags == record[20] &&
+					route.numareas == record[21] && route.time == record[22];
+		} //end case
+		case QUERY_TRACEAREAS:
+		{
+			BB_ReplayVector(&record[1], origin);
+			BB_ReplayVector(&record[4], end);
+			maxareas = record[7] < MAX_REPLAYAREAS ? record[7] : MAX_REPLAYAREAS;
+			result = botlib->aas.AAS_TraceAreas(origin, end, areas, record[8] ? points : NULL, maxareas);
+			for (checksum = 0, i = 0; i < result; i++) checksum = checksum * 31 + areas[i];
+			return result == record[9] && checksum == (unsigned int) record[10];
+		} //end case
+		case QUERY_NEARESTHIDEAREA:
+		{
+			BB_ReplayVector(&record[2], origin);
+			BB_ReplayVector(&record[7], end);
+			result = botlib->aas.AAS_NearestHideArea(record[1], origin, record[5], record[6], end, record[10], record[11]);
+			return result == record[12];
+		} //end case
+		default:
+		{
+			Com_Error(ERR_FATAL, "unknown query type %d", record[0]);
+		} //end default
+	} //end switch
+	return qfalse;
+} //end of the function BB_ReplayQuery
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_PrintStats(int64_t usec)
+{
+	bb_querystats_t *stats;
+	int i, lookups;
+
+	Com_Printf("%-26s %10s %10s %12s %10s\n", "query", "count", "usec", "queries/sec", "mismatches");
+	for (i = 1; i < MAX_QUERYTYPES; i++)
+	{
+		stats = &querystats[i];
+		if (!stats->count) continue;
+		Com_Printf("%-26s %10d %10d %12.0f %10d\n", stats->name, stats->count, (int) stats->usec,
+						stats->usec ? stats->count * 1000000.0 / stats->usec : 0, stats->mismatches);
+	} //end for
+	Com_Printf("replayed in %d msec\n", (int) (usec / 1000));
+	Com_Printf("%d bytes routing cache\n", routingcachesize);
+	lookups = routingcachehits + routingcachemisses;
+	Com_Printf("%d routing cache lookups, %d hits, %d misses, %.1f%% hit rate\n", lookups,
+					routingcachehits, routingcachemisses, lookups ? routingcachehits * 100.0 / lookups : 0);
+} //end of the function BB_PrintStats
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BB_Usage(void)
+{
+	Com_Printf("usage: botbench [-basedir <dir>] [+set <var> <value>] <capture file>\n"
+				"replays a bot query capture written with the querycapture libvar,\n"
+				"the map and aas file are loaded from maps/ in the base directory and\n"
+				"the variables are set both as cvars and as bot library variables\n");
+	exit(1);
+} //end of the function BB_Usage
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int main(int argc, char **argv)
+{
+	botlib_export_t *botlib;
+	char *filename, mapname[MAX_QPATH];
+	int i, j, length, numqueries, checksum, header[3], *records, *record;
+	int64_t start, querystart, usec;
+	FILE *fp;
+
+	filename = NULL;
+	for (i = 1; i < argc; i++)
+	{
+		if (!Q_stricmp(argv[i], "-basedir") && i + 1 < argc)
+		{
+			Q_strncpyz(bb_basedir, argv[++i], sizeof(bb_basedir));
+		} //end if
+		else if (!Q_stricmp(argv[i], "+set") && i + 2 < argc)
+		{
+			BB_SetCvar(argv[i+1], argv[i+2]);
+			i += 2;
+		} //end else if
+		else if (argv[i][0] != '-' && argv[i][0] != '+' && !filename)
+		{
+			filename = argv[i];
+		} //end else if
+		else
+		{
+			BB_Usage();
+		} //end else
+	} //end for
+	if (!filename) BB_Usage();
+	//
+	fp = fopen(filename, "rb");
+	if (!fp) Com_Error(ERR_FATAL, "couldn't open %s", filename);
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (length < QUERYCAPTURE_HEADER || fread(header, sizeof(header), 1, fp) != 1 ||
+			fread(mapname, sizeof(mapname), 1, fp) != 1 ||
+			LittleLong(header[0]) != QUERYCAPTURE_IDENT ||
+			LittleLong(header[1]) != QUERYCAPTURE_VERSION)
+	{
+		Com_Error(ERR_FATAL, "%s is not a bot query capture", filename);
+	} //end if
+	mapname[sizeof(mapname) - 1] = '\0';
+	numqueries = (length - QUERYCAPTURE_HEADER) / QUERYCAPTURE_RECORD;
+	records = Z_Malloc(numqueries * QUERYCAPTURE_RECORD + 1);
+	if (fread(records, QUERYCAPTURE_RECORD, numqueries, fp) != (size_t) numqueries)
+	{
+		Com_Error(ERR_FATAL, "couldn't read %s", filename);
+	} //end if
+	fclose(fp);
+	for (i = 0; i < numqueries * QUERYCAPTURE_RECORD / 4; i++)
+	{
+		records[i] = LittleLong(records[i]);
+	} //end for
+	for (i = 0, record = records; i < numqueries; i++, record += QUERYCAPTURE_RECORD / 4)
+	{
+		if (record[0] <= 0 || record[0] >= MAX_QUERYTYPES)
+		{
+			Com_Error(ERR_FATAL, "%s has an unknown query type %d", filename, record[0]);
+		} //end if
+	} //end for
+	//
+	com_speeds = Cvar_Get("com_speeds", "0", 0);
+	CM_LoadMap(va("maps/%s.bsp", mapname), qfalse, &checksum);
+	if (checksum != LittleLong(header[2]))
+	{
+		Com_Printf("WARNING: %s was captured on a different version of %s\n", filename, mapname);
+	} //end if
+	//
+	botlib = BB_InitBotLib();
+	if (!botlib) Com_Error(ERR_FATAL, "couldn't initialize the bot library");
+	for (i = 1; i + 2 < argc; i++)
+	{
+		if (!Q_stricmp(argv[i], "+set"))
+		{
+			botlib->BotLibVarSet(argv[i+1], argv[i+2]);
+			i += 2;
+		} //end if
+	} //end for
+	botlib->BotLibVarSet("sv_mapChecksum", va("%d", checksum));
+	if (botlib->BotLibSetup() != BLERR_NOERROR) Com_Error(ERR_FATAL, "couldn't setup the bot library");
+	if (botlib->BotLibLoadMap(mapname) != BLERR_NOERROR) Com_Error(ERR_FATAL, "couldn't load the aas file for %s", mapname);
+	//
+	Com_Printf("replaying %d queries on %s\n", numqueries, mapname);
+	start = Sys_Microseconds();
+	for (i = 0, record = records; i < numqueries; i++, record += QUERYCAPTURE_RECORD / 4)
+	{
+		j = record[0];
+		querystart = Sys_Microseconds();
+		if (!BB_ReplayQuery(botlib, record)) querystats[j].mismatches++;
+		querystats[j].usec += Sys_Microseconds() - querystart;
+		querystats[j].count++;
+	} //end for
+	usec = Sys_Microseconds() - start;
+	//
+	BB_PrintStats(usec);
+	//
+	botlib->BotLibShutdown();
+	Z_Free(records);
+	return 0;
+} //end of the function main
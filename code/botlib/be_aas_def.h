@@ -131,10 +131,21 @@ typedef struct aas_settings_s
 #define CACHETYPE_PORTAL		0
 #define CACHETYPE_AREA			1
 
+//node with its plane copied in so walking the tree only touches one array
+//32 bytes, the array is cache line aligned
+typedef struct aas_packednode_s
+{
+	aas_plane_t plane;
+	int children[2];					//packed child nodes, or areas as leaves when negative
+	int planenum;						//number of the plane in aasworld.planes
+} aas_packednode_t;
+
 //routing cache
 typedef struct aas_routingcache_s
 {
 	byte type;									//portal or area cache
+	byte fileview;								//arrays point into the route cache file
+	byte pending;								//travel times are still being calculated
 	float time;									//last time accessed or updated
 	int size;									//size of the routing cache
 	int cluster;								//cluster the cache is for
@@ -144,8 +155,8 @@ typedef struct aas_routingcache_s
 	int travelflags;							//combinations of the travel flags
 	struct aas_routingcache_s *prev, *next;
 	struct aas_routingcache_s *time_prev, *time_next;
+	unsigned short int *traveltimes;			//travel time for every area
 	unsigned char *reachabilities;				//reachabilities used for routing
-	unsigned short int traveltimes[1];			//travel time for every area (variable sized)
 } aas_routingcache_t;
 
 //fields for the routing algorithm
@@ -161,6 +172,17 @@ typedef struct aas_routingupdate_s
 	struct aas_routingupdate_s *prev;
 } aas_routingupdate_t;
 
+//routing cache flood that can be continued over several frames
+typedef struct aas_routingflood_s
+{
+	aas_routingcache_t *cache;					//cache being flooded
+	aas_routingupdate_t *updates;				//routing update fields used by the flood
+	aas_routingupdate_t *updateliststart;		//first update in the list
+	aas_routingupdate_t *updatelistend;			//last update in the list
+	qboolean prebuilt;							//only use existing area caches
+	unsigned short int startareatraveltimes[128];	//NOTE: not more than 128 reachabilities per area allowed
+} aas_routingflood_t;
+
 //reversed reachability link
 typedef struct aas_reversedlink_s
 {
@@ -227,6 +249,9 @@ typedef struct aas_s
 	//nodes of the bsp tree
 	int numnodes;
 	aas_node_t *nodes;
+	//nodes of the bsp tree with their planes, in depth first order
+	aas_packednode_t *packednodes;
+	void *packednodememory;
 	//cluster portals
 	int numportals;
 	aas_portal_t *portals;
@@ -257,6 +282,12 @@ typedef struct aas_s
 	aas_routingupdate_t *portalupdate;
 	//number of routing updates during a frame (reset every frame)
 	int frameroutingupdates;
+	//routing caches waiting to be flooded, linked through the time links
+	aas_routingcache_t *firstroutingrequest;
+	aas_routingcache_t *lastroutingrequest;
+	//flood of the first routing request
+	aas_routingflood_t requestflood;
+	aas_routingupdate_t *requestupdate;
 	//reversed reachability links
 	aas_reversedreachability_t *reversedreachability;
 	//travel times within the areas
@@ -267,6 +298,11 @@ typedef struct aas_s
 	//cache list sorted on time
 	aas_routingcache_t *oldestcache;		// start of cache list sorted on time
 	aas_routingcache_t *newestcache;		// end of cache list sorted on time
+	//route cache file the file view caches point into
+	byte *routecachefile;
+	int routecachefilesize;
+	void *routecachemapping;				// NULL if the file was read instead of mapped
+	aas_routingcache_t *routecacheviews;
 	//maximum travel time through portal areas
 	int *portalmaxtraveltimes;
 	//areas the reachabilities go through
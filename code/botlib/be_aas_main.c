@@ -157,8 +157,8 @@ int AAS_StartFrame(float time)
 	AAS_InvalidateEntities();
 	//initialize AAS
 	AAS_ContinueInit(time);
-	//
-	aasworld.frameroutingupdates = 0;
+	//count the routing updates of the last frame and continue routing requests
+	AAS_RoutingStartFrame();
 	//
 	if (botDeveloper)
 	{
@@ -177,6 +177,11 @@ int AAS_StartFrame(float time)
 			PrintMemoryLabels();
 			LibVarSet("memorydump", "0");
 		} //end if
+		if (LibVarGetValue("aasbenchmark"))
+		{
+			AAS_SampleBenchmark((int) LibVarGetValue("aasbenchmark"));
+			LibVarSet("aasbenchmark", "0");
+		} //end if
 	} //end if
 	//
 	if (saveroutingcache->value)
@@ -274,6 +279,8 @@ int AAS_LoadMap(const char *mapname)
 	} //end if
 	//
 	AAS_InitSettings();
+	//pack the nodes of the new map for walking the tree
+	AAS_InitPackedNodes();
 	//initialize the AAS link heap for the new map
 	AAS_InitAASLinkHeap();
 	//initialize the AAS linked entities for the new map
@@ -87,6 +87,16 @@ int numportalcacheupdates;
 
 int routingcachesize;
 int max_routingcachesize;
+//maximum number of routing update steps each frame for routing requests, 0 = no requests
+int routingupdatebudget;
+//routing update steps taken on the main thread
+static int routingupdatesteps;
+//number of frames with 0, 1, 2-3, 4-7, ... routing updates
+#define MAX_ROUTINGHISTOGRAM		12
+static int frameroutinghistogram[MAX_ROUTINGHISTOGRAM];
+//routing cache lookups answered by an existing cache and lookups that had to wait for a flood
+int routingcachehits;
+int routingcachemisses;
 
 //===========================================================================
 //
@@ -97,9 +107,26 @@ int max_routingcachesize;
 #ifdef ROUTING_DEBUG
 void AAS_RoutingInfo(void)
 {
+	int i;
+	aas_routingcache_t *cache;
+
 	botimport.Print(PRT_MESSAGE, "%d area cache updates\n", numareacacheupdates);
 	botimport.Print(PRT_MESSAGE, "%d portal cache updates\n", numportalcacheupdates);
 	botimport.Print(PRT_MESSAGE, "%d bytes routing cache\n", routingcachesize);
+	botimport.Print(PRT_MESSAGE, "%d routing cache hits, %d misses\n", routingcachehits, routingcachemisses);
+	if (routingupdatebudget)
+	{
+		for (i = 0, cache = aasworld.firstroutingrequest; cache; cache = cache->time_next) i++;
+		botimport.Print(PRT_MESSAGE, "%d routing requests pending\n", i);
+	} //end if
+	botimport.Print(PRT_MESSAGE, "frames with routing updates:\n");
+	for (i = 0; i < MAX_ROUTINGHISTOGRAM; i++)
+	{
+		if (!frameroutinghistogram[i]) continue;
+		if (i <= 1) botimport.Print(PRT_MESSAGE, "%10d: %d\n", i, frameroutinghistogram[i]);
+		else if (i == MAX_ROUTINGHISTOGRAM - 1) botimport.Print(PRT_MESSAGE, "%9d+: %d\n", 1 << (i - 1), frameroutinghistogram[i]);
+		else botimport.Print(PRT_MESSAGE, "%5d-%-4d: %d\n", 1 << (i - 1), (1 << i) - 1, frameroutinghistogram[i]);
+	} //end for
 } //end of the function AAS_RoutingInfo
 #endif //ROUTING_DEBUG
 //===========================================================================
@@ -231,6 +258,79 @@ void AAS_LinkCache(aas_routingcache_t *cache)
 	aasworld.newestcache = cache;
 } //end of the function AAS_LinkCache
 //===========================================================================
+// adds the cache to the portal cache or cluster area cache it belongs to
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AddRoutingCache(aas_routingcache_t *cache)
+{
+	aas_routingcache_t **list;
+
+	if (cache->type == CACHETYPE_PORTAL)
+	{
+		list = &aasworld.portalcache[cache->areanum];
+	} //end if
+	else
+	{
+		list = &aasworld.clusterareacache[cache->cluster][AAS_ClusterAreaNum(cache->cluster, cache->areanum)];
+	} //end else
+	cache->prev = NULL;
+	cache->next = *list;
+	if (*list) (*list)->prev = cache;
+	*list = cache;
+} //end of the function AAS_AddRoutingCache
+//===========================================================================
+// queues the cache to be flooded during the next frames, the requests are
+// linked through the time links because a cache isn't put in the time
+// sorted cache list before it has been flooded
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_QueueRoutingRequest(aas_routingcache_t *cache)
+{
+	cache->pending = qtrue;
+	cache->time_next = NULL;
+	cache->time_prev = aasworld.lastroutingrequest;
+	if (aasworld.lastroutingrequest) aasworld.lastroutingrequest->time_next = cache;
+	else aasworld.firstroutingrequest = cache;
+	aasworld.lastroutingrequest = cache;
+} //end of the function AAS_QueueRoutingRequest
+//===========================================================================
+// removes the cache from the routing requests and stops its flood
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RemoveRoutingRequest(aas_routingcache_t *cache)
+{
+	aas_routingupdate_t *update;
+
+	if (cache->time_next) cache->time_next->time_prev = cache->time_prev;
+	else aasworld.lastroutingrequest = cache->time_prev;
+	if (cache->time_prev) cache->time_prev->time_next = cache->time_next;
+	else aasworld.firstroutingrequest = cache->time_next;
+	cache->time_next = NULL;
+	cache->time_prev = NULL;
+	cache->pending = qfalse;
+	//
+	if (aasworld.requestflood.cache == cache)
+	{
+		//updates left in the list would be skipped by the next flood
+		for (update = aasworld.requestflood.updateliststart; update; update = update->next)
+		{
+			update->inlist = qfalse;
+		} //end for
+		aasworld.requestflood.cache = NULL;
+		aasworld.requestflood.updateliststart = NULL;
+		aasworld.requestflood.updatelistend = NULL;
+	} //end if
+} //end of the function AAS_RemoveRoutingRequest
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -238,7 +338,10 @@ void AAS_LinkCache(aas_routingcache_t *cache)
 //===========================================================================
 void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 {
-	AAS_UnlinkCache(cache);
+	//caches in the route cache file are only freed with the file
+	if (cache->fileview) return;
+	if (cache->pending) AAS_RemoveRoutingRequest(cache);
+	else AAS_UnlinkCache(cache);
 	routingcachesize -= cache->size;
 	FreeMemory(cache);
 } //end of the function AAS_FreeRoutingCache
@@ -750,6 +853,7 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 	routingcachesize += size;
 	//
 	cache = (aas_routingcache_t *) GetClearedMemory(size);
+	cache->traveltimes = (unsigned short int *) ((unsigned char *) cache + sizeof(aas_routingcache_t));
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
 								+ numtraveltimes * sizeof(unsigned short int);
 	cache->size = size;
@@ -883,6 +987,12 @@ void AAS_InitRoutingUpdate(void)
 	//allocate memory for the portal update fields
 	aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMemory(
 									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+	//
+	if (aasworld.requestupdate) FreeMemory(aasworld.requestupdate);
+	//allocate memory for the update fields of routing requests which flood area or portal caches
+	if (maxreachabilityareas < aasworld.numportals+1) maxreachabilityareas = aasworld.numportals+1;
+	aasworld.requestupdate = (aas_routingupdate_t *) GetClearedMemory(
+									maxreachabilityareas * sizeof(aas_routingupdate_t));
 } //end of the function AAS_InitRoutingUpdate
 //===========================================================================
 //
@@ -911,16 +1021,13 @@ void AAS_CreateAllRoutingCache(void)
 	} //end for
 	aasworld.initialized = qfalse;
 } //end of the function AAS_CreateAllRoutingCache
-//===========================================================================
-//
-// Parameter:			-
-// Returns:				-
-// Changes Globals:		-
-//===========================================================================
 
 //the route cache header
-//this header is followed by numportalcache + numareacache aas_routingcache_t
-//structures that store routing cache
+//this header is followed by numportalcache + numareacache routecacheindex_t
+//structures, one for every routing cache, after which come the travel times
+//of all the caches followed by the reachabilities of all the caches
+//the file is mapped when possible and the caches read from it point
+//directly at their travel times and reachabilities in the file
 typedef struct routecacheheader_s
 {
 	int ident;
@@ -933,30 +1040,113 @@ typedef struct routecacheheader_s
 	int numareacache;
 } routecacheheader_t;
 
+//route cache index
+typedef struct routecacheindex_s
+{
+	int type;									//portal or area cache
+	int cluster;								//cluster the cache is for
+	int areanum;								//area the cache is created for
+	int travelflags;							//combinations of the travel flags
+	int numtraveltimes;							//number of travel times and reachabilities
+	int traveltimes;							//file offset of the travel times
+	int reachabilities;							//file offset of the reachabilities
+} routecacheindex_t;
+
 #define RCID						(('C'<<24)+('R'<<16)+('E'<<8)+'M')
-#define RCVERSION					2
+#define RCVERSION					3
 
 //void AAS_DecompressVis(byte *in, int numareas, byte *decompressed);
 //int AAS_CompressVis(byte *vis, int numareas, byte *dest);
 
-void AAS_WriteRouteCache(void)
+//===========================================================================
+// returns the number of travel times stored in the given routing cache
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RoutingCacheNumTravelTimes(int type, int cluster)
+{
+	if (type == CACHETYPE_PORTAL) return aasworld.numportals;
+	return aasworld.clusters[cluster].numreachabilityareas;
+} //end of the function AAS_RoutingCacheNumTravelTimes
+//===========================================================================
+// frees the route cache file, the file view caches must already be
+// removed from the portal and cluster area cache
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FreeRouteCacheFile(void)
+{
+	if (aasworld.routecacheviews) FreeMemory(aasworld.routecacheviews);
+	aasworld.routecacheviews = NULL;
+	if (aasworld.routecachemapping) botimport.FS_UnmapFile(aasworld.routecachemapping);
+	else if (aasworld.routecachefile) FreeMemory(aasworld.routecachefile);
+	aasworld.routecachemapping = NULL;
+	aasworld.routecachefile = NULL;
+	aasworld.routecachefilesize = 0;
+} //end of the function AAS_FreeRouteCacheFile
+//===========================================================================
+// replaces a mapped route cache file with a copy in memory so the file
+// itself can be overwritten
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_CopyRouteCacheFile(void)
 {
-	int i, j, numportalcache, numareacache, totalsize;
+	int i, numcache;
+	byte *buffer;
+	routecacheheader_t *routecacheheader;
 	aas_routingcache_t *cache;
+
+	if (!aasworld.routecachemapping) return;
+	buffer = (byte *) GetMemory(aasworld.routecachefilesize);
+	Com_Memcpy(buffer, aasworld.routecachefile, aasworld.routecachefilesize);
+	routecacheheader = (routecacheheader_t *) buffer;
+	numcache = routecacheheader->numportalcache + routecacheheader->numareacache;
+	for (i = 0; i < numcache; i++)
+	{
+		cache = &aasworld.routecacheviews[i];
+		cache->traveltimes = (unsigned short int *) (buffer + ((byte *) cache->traveltimes - aasworld.routecachefile));
+		cache->reachabilities = buffer + (cache->reachabilities - aasworld.routecachefile);
+	} //end for
+	botimport.FS_UnmapFile(aasworld.routecachemapping);
+	aasworld.routecachemapping = NULL;
+	aasworld.routecachefile = buffer;
+} //end of the function AAS_CopyRouteCacheFile
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+qboolean AAS_WriteRouteCache(void)
+{
+	int i, j, numportalcache, numareacache, numcache, numtraveltimes, offset, reachoffset;
+	aas_routingcache_t *cache, **caches;
 	aas_cluster_t *cluster;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
 	routecacheheader_t routecacheheader;
+	routecacheindex_t index;
 
 	numportalcache = 0;
+	numareacache = 0;
+	numtraveltimes = 0;
 	for (i = 0; i < aasworld.numareas; i++)
 	{
 		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
 		{
+			//routing requests aren't written before they're flooded
+			if (cache->pending) continue;
 			numportalcache++;
+			numtraveltimes += AAS_RoutingCacheNumTravelTimes(CACHETYPE_PORTAL, cache->cluster);
 		} //end for
 	} //end for
-	numareacache = 0;
 	for (i = 0; i < aasworld.numclusters; i++)
 	{
 		cluster = &aasworld.clusters[i];
@@ -964,17 +1154,45 @@ void AAS_WriteRouteCache(void)
 		{
 			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
 			{
+				if (cache->pending) continue;
 				numareacache++;
+				numtraveltimes += AAS_RoutingCacheNumTravelTimes(CACHETYPE_AREA, cache->cluster);
+			} //end for
+		} //end for
+	} //end for
+	//gather the caches in the order they are written
+	caches = (aas_routingcache_t **) GetMemory((numportalcache + numareacache + 1) * sizeof(aas_routingcache_t *));
+	numcache = 0;
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
+		{
+			if (cache->pending) continue;
+			caches[numcache++] = cache;
+		} //end for
+	} //end for
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		cluster = &aasworld.clusters[i];
+		for (j = 0; j < cluster->numareas; j++)
+		{
+			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
+			{
+				if (cache->pending) continue;
+				caches[numcache++] = cache;
 			} //end for
 		} //end for
 	} //end for
+	//the file might be the one the file view caches point into
+	AAS_CopyRouteCacheFile();
 	// open the file for writing
 	Com_sprintf(filename, MAX_QPATH, "maps/%s.rcd", aasworld.mapname);
 	botimport.FS_FOpenFile( filename, &fp, FS_WRITE );
 	if (!fp)
 	{
+		FreeMemory(caches);
 		AAS_Error("Unable to open file: %s\n", filename);
-		return;
+		return qfalse;
 	} //end if
 	//create the header
 	routecacheheader.ident = RCID;
@@ -987,28 +1205,36 @@ void AAS_WriteRouteCache(void)
 	routecacheheader.numareacache = numareacache;
 	//write the header
 	botimport.FS_Write(&routecacheheader, sizeof(routecacheheader_t), fp);
-	//
-	totalsize = 0;
-	//write all the cache
-	for (i = 0; i < aasworld.numareas; i++)
+	//write the index, the travel times directly follow it and the reachabilities follow the travel times
+	offset = sizeof(routecacheheader_t) + numcache * sizeof(routecacheindex_t);
+	reachoffset = offset + numtraveltimes * sizeof(unsigned short int);
+	for (i = 0; i < numcache; i++)
+	{
+		cache = caches[i];
+		index.type = cache->type;
+		index.cluster = cache->cluster;
+		index.areanum = cache->areanum;
+		index.travelflags = cache->travelflags;
+		index.numtraveltimes = AAS_RoutingCacheNumTravelTimes(cache->type, cache->cluster);
+		index.traveltimes = offset;
+		index.reachabilities = reachoffset;
+		botimport.FS_Write(&index, sizeof(routecacheindex_t), fp);
+		offset += index.numtraveltimes * sizeof(unsigned short int);
+		reachoffset += index.numtraveltimes * sizeof(unsigned char);
+	} //end for
+	//write the travel times of all the caches
+	for (i = 0; i < numcache; i++)
 	{
-		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
-		{
-			botimport.FS_Write(cache, cache->size, fp);
-			totalsize += cache->size;
-		} //end for
+		cache = caches[i];
+		botimport.FS_Write(cache->traveltimes, AAS_RoutingCacheNumTravelTimes(cache->type, cache->cluster)
+												* sizeof(unsigned short int), fp);
 	} //end for
-	for (i = 0; i < aasworld.numclusters; i++)
+	//write the reachabilities of all the caches
+	for (i = 0; i < numcache; i++)
 	{
-		cluster = &aasworld.clusters[i];
-		for (j = 0; j < cluster->numareas; j++)
-		{
-			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
-			{
-				botimport.FS_Write(cache, cache->size, fp);
-				totalsize += cache->size;
-			} //end for
-		} //end for
+		cache = caches[i];
+		botimport.FS_Write(cache->reachabilities, AAS_RoutingCacheNumTravelTimes(cache->type, cache->cluster)
+												* sizeof(unsigned char), fp);
 	} //end for
 	// write the visareas
 	/*
@@ -1027,28 +1253,45 @@ void AAS_WriteRouteCache(void)
 	*/
 	//
 	botimport.FS_FCloseFile(fp);
+	FreeMemory(caches);
 	botimport.Print(PRT_MESSAGE, "\nroute cache written to %s\n", filename);
-	botimport.Print(PRT_MESSAGE, "written %d bytes of routing cache\n", totalsize);
+	botimport.Print(PRT_MESSAGE, "written %d bytes of routing cache\n", reachoffset);
+	return qtrue;
 } //end of the function AAS_WriteRouteCache
 //===========================================================================
+// returns qtrue if the route cache index describes a valid cache for
+// the loaded AAS data that fits in the file
 //
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
+static qboolean AAS_ValidRouteCacheIndex(routecacheindex_t *index, int length)
 {
-	int size;
-	aas_routingcache_t *cache;
+	int areacluster;
+	aas_portal_t *portal;
 
-	botimport.FS_Read(&size, sizeof(size), fp);
-	cache = (aas_routingcache_t *) GetMemory(size);
-	cache->size = size;
-	botimport.FS_Read((unsigned char *)cache + sizeof(size), size - sizeof(size), fp);
-	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) +
-		(size - sizeof(aas_routingcache_t) + sizeof(unsigned short)) / 3 * 2;
-	return cache;
-} //end of the function AAS_ReadCache
+	if (index->areanum <= 0 || index->areanum >= aasworld.numareas) return qfalse;
+	if (index->cluster <= 0 || index->cluster >= aasworld.numclusters) return qfalse;
+	if (index->type != CACHETYPE_PORTAL && index->type != CACHETYPE_AREA) return qfalse;
+	//the area of an area cache must be inside the cluster or a portal of the cluster
+	if (index->type == CACHETYPE_AREA)
+	{
+		areacluster = aasworld.areasettings[index->areanum].cluster;
+		if (areacluster < 0)
+		{
+			portal = &aasworld.portals[-areacluster];
+			if (portal->frontcluster != index->cluster && portal->backcluster != index->cluster) return qfalse;
+		} //end if
+		else if (areacluster != index->cluster) return qfalse;
+	} //end if
+	if (index->numtraveltimes != AAS_RoutingCacheNumTravelTimes(index->type, index->cluster)) return qfalse;
+	if (index->traveltimes < (int) sizeof(routecacheheader_t) || (index->traveltimes & 1)) return qfalse;
+	if (index->traveltimes + index->numtraveltimes * (int) sizeof(unsigned short int) > length) return qfalse;
+	if (index->reachabilities < (int) sizeof(routecacheheader_t)) return qfalse;
+	if (index->reachabilities + index->numtraveltimes * (int) sizeof(unsigned char) > length) return qfalse;
+	return qtrue;
+} //end of the function AAS_ValidRouteCacheIndex
 //===========================================================================
 //
 // Parameter:			-
@@ -1057,71 +1300,109 @@ aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 //===========================================================================
 int AAS_ReadRouteCache(void)
 {
-	int i, clusterareanum;//, size;
+	int i, length, numcache;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
+	byte *buffer;
+	void *mapping;
 	routecacheheader_t routecacheheader;
+	routecacheindex_t *index;
 	aas_routingcache_t *cache;
 
 	Com_sprintf(filename, MAX_QPATH, "maps/%s.rcd", aasworld.mapname);
-	botimport.FS_FOpenFile( filename, &fp, FS_READ );
+	length = botimport.FS_FOpenFile( filename, &fp, FS_READ );
 	if (!fp)
 	{
 		return qfalse;
 	} //end if
+	if (length < (int) sizeof(routecacheheader_t))
+	{
+		botimport.FS_FCloseFile(fp);
+		AAS_Error("%s is not a route cache dump\n", filename);
+		return qfalse;
+	} //end if
 	botimport.FS_Read(&routecacheheader, sizeof(routecacheheader_t), fp );
 	if (routecacheheader.ident != RCID)
 	{
+		botimport.FS_FCloseFile(fp);
 		AAS_Error("%s is not a route cache dump\n", filename);
 		return qfalse;
 	} //end if
 	if (routecacheheader.version != RCVERSION)
 	{
-		AAS_Error("route cache dump has wrong version %d, should be %d\n", routecacheheader.version, RCVERSION);
+		//an out of date route cache is simply rebuilt
+		botimport.FS_FCloseFile(fp);
+		botimport.Print(PRT_MESSAGE, "route cache dump has wrong version %d, should be %d\n", routecacheheader.version, RCVERSION);
 		return qfalse;
 	} //end if
-	if (routecacheheader.numareas != aasworld.numareas)
-	{
-		//AAS_Error("route cache dump has wrong number of areas\n");
+	if (routecacheheader.numareas != aasworld.numareas ||
+		routecacheheader.numclusters != aasworld.numclusters ||
+		routecacheheader.areacrc !=
+			CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas ) ||
+		routecacheheader.clustercrc !=
+			CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters ))
+	{
+		//the route cache dump was made for different AAS data
+		botimport.FS_FCloseFile(fp);
 		return qfalse;
 	} //end if
-	if (routecacheheader.numclusters != aasworld.numclusters)
+	numcache = routecacheheader.numportalcache + routecacheheader.numareacache;
+	if (numcache < 0 || numcache > (length - (int) sizeof(routecacheheader_t)) / (int) sizeof(routecacheindex_t))
 	{
-		//AAS_Error("route cache dump has wrong number of clusters\n");
+		botimport.FS_FCloseFile(fp);
+		AAS_Error("route cache dump %s is corrupt\n", filename);
 		return qfalse;
 	} //end if
-	if (routecacheheader.areacrc !=
-		CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas ))
+	//map the file so the caches can point straight into it
+	buffer = NULL;
+	mapping = NULL;
+	if (botimport.FS_MapFile)
 	{
-		//AAS_Error("route cache dump area CRC incorrect\n");
-		return qfalse;
+		if (botimport.FS_MapFile(filename, (void **) &buffer, &mapping) != length || ((intptr_t) buffer & 3))
+		{
+			if (mapping) botimport.FS_UnmapFile(mapping);
+			buffer = NULL;
+			mapping = NULL;
+		} //end if
 	} //end if
-	if (routecacheheader.clustercrc !=
-		CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters ))
+	//otherwise read the whole file into a single block
+	if (!buffer)
 	{
-		//AAS_Error("route cache dump cluster CRC incorrect\n");
-		return qfalse;
+		buffer = (byte *) GetMemory(length);
+		Com_Memcpy(buffer, &routecacheheader, sizeof(routecacheheader_t));
+		botimport.FS_Read(buffer + sizeof(routecacheheader_t), length - sizeof(routecacheheader_t), fp);
 	} //end if
-	//read all the portal cache
-	for (i = 0; i < routecacheheader.numportalcache; i++)
-	{
-		cache = AAS_ReadCache(fp);
-		cache->next = aasworld.portalcache[cache->areanum];
-		cache->prev = NULL;
-		if (aasworld.portalcache[cache->areanum])
-			aasworld.portalcache[cache->areanum]->prev = cache;
-		aasworld.portalcache[cache->areanum] = cache;
+	botimport.FS_FCloseFile(fp);
+	//
+	index = (routecacheindex_t *) (buffer + sizeof(routecacheheader_t));
+	for (i = 0; i < numcache; i++)
+	{
+		if (!AAS_ValidRouteCacheIndex(&index[i], length))
+		{
+			if (mapping) botimport.FS_UnmapFile(mapping);
+			else FreeMemory(buffer);
+			AAS_Error("route cache dump %s is corrupt\n", filename);
+			return qfalse;
+		} //end if
 	} //end for
-	//read all the cluster area cache
-	for (i = 0; i < routecacheheader.numareacache; i++)
-	{
-		cache = AAS_ReadCache(fp);
-		clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
-		cache->next = aasworld.clusterareacache[cache->cluster][clusterareanum];
-		cache->prev = NULL;
-		if (aasworld.clusterareacache[cache->cluster][clusterareanum])
-			aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
-		aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
+	aasworld.routecachefile = buffer;
+	aasworld.routecachefilesize = length;
+	aasworld.routecachemapping = mapping;
+	//create a cache for every record that points into the file
+	aasworld.routecacheviews = (aas_routingcache_t *) GetClearedMemory(numcache * sizeof(aas_routingcache_t));
+	for (i = 0; i < numcache; i++)
+	{
+		cache = &aasworld.routecacheviews[i];
+		cache->type = index[i].type;
+		cache->fileview = qtrue;
+		cache->cluster = index[i].cluster;
+		cache->areanum = index[i].areanum;
+		VectorCopy(aasworld.areas[cache->areanum].center, cache->origin);
+		cache->starttraveltime = 1;
+		cache->travelflags = index[i].travelflags;
+		cache->traveltimes = (unsigned short int *) (buffer + index[i].traveltimes);
+		cache->reachabilities = buffer + index[i].reachabilities;
+		AAS_AddRoutingCache(cache);
 	} //end for
 	// read the visareas
 	/*
@@ -1137,7 +1418,6 @@ int AAS_ReadRouteCache(void)
 	}
 	*/
 	//
-	botimport.FS_FCloseFile(fp);
 	return qtrue;
 } //end of the function AAS_ReadRouteCache
 //===========================================================================
@@ -1247,8 +1527,25 @@ void AAS_InitRouting(void)
 	//
 	routingcachesize = 0;
 	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
-	// read any routing cache if available
-	AAS_ReadRouteCache();
+	routingupdatebudget = (int) LibVarValue("routingupdatebudget", "0");
+	Com_Memset(frameroutinghistogram, 0, sizeof(frameroutinghistogram));
+	// read any routing cache if available, otherwise build and save it when requested
+	if (!AAS_ReadRouteCache() && (int) LibVarValue("precomputeroutingcache", "0"))
+	{
+		AAS_PrecomputeRoutingCache();
+		if (AAS_WriteRouteCache())
+		{
+			//use the written file instead of the allocated cache
+			AAS_FreeAllClusterAreaCache();
+			AAS_FreeAllPortalCache();
+			AAS_InitClusterAreaCache();
+			AAS_InitPortalCache();
+			AAS_ReadRouteCache();
+		} //end if
+	} //end if
+	//only count the cache lookups of routing queries
+	routingcachehits = 0;
+	routingcachemisses = 0;
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1262,6 +1559,8 @@ void AAS_FreeRoutingCaches(void)
 	AAS_FreeAllClusterAreaCache();
 	// free all the existing portal cache
 	AAS_FreeAllPortalCache();
+	// free the route cache file the remaining cache pointed into
+	AAS_FreeRouteCacheFile();
 	// free cached travel times within areas
 	if (aasworld.areatraveltimes) FreeMemory(aasworld.areatraveltimes);
 	aasworld.areatraveltimes = NULL;
@@ -1276,6 +1575,8 @@ void AAS_FreeRoutingCaches(void)
 	aasworld.areaupdate = NULL;
 	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
 	aasworld.portalupdate = NULL;
+	if (aasworld.requestupdate) FreeMemory(aasworld.requestupdate);
+	aasworld.requestupdate = NULL;
 	// free lists with areas the reachabilities go through
 	if (aasworld.reachabilityareas) FreeMemory(aasworld.reachabilityareas);
 	aasworld.reachabilityareas = NULL;
@@ -1287,53 +1588,75 @@ void AAS_FreeRoutingCaches(void)
 	aasworld.areacontentstravelflags = NULL;
 } //end of the function AAS_FreeRoutingCaches
 //===========================================================================
-// update the given routing cache
+// start flooding the given routing cache using the given routing update fields
+// the update fields are only touched by this flood so different caches
+// can be flooded at the same time with different update fields
 //
-// Parameter:			areacache		: routing cache to update
+// Parameter:			flood			: flood state
+//						areaupdate		: routing update fields for every reachability area in the cluster
+//						areacache		: routing cache to update
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
+static void AAS_StartAreaFlood(aas_routingflood_t *flood, aas_routingupdate_t *areaupdate, aas_routingcache_t *areacache)
 {
-	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
-	int numreachabilityareas;
-	unsigned short int t, startareatraveltimes[128]; //NOTE: not more than 128 reachabilities per area allowed
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
-	aas_reachability_t *reach;
-	aas_reversedreachability_t *revreach;
-	aas_reversedlink_t *revlink;
+	int clusterareanum;
+	aas_routingupdate_t *curupdate;
 
-#ifdef ROUTING_DEBUG
-	numareacacheupdates++;
-#endif //ROUTING_DEBUG
-	//number of reachability areas within this cluster
-	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
-	//
-	aasworld.frameroutingupdates++;
-	//clear the routing update fields
-//	Com_Memset(aasworld.areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
-	//
-	badtravelflags = ~areacache->travelflags;
+	flood->cache = areacache;
+	flood->updates = areaupdate;
+	flood->updateliststart = NULL;
+	flood->updatelistend = NULL;
+	flood->prebuilt = qfalse;
 	//
 	clusterareanum = AAS_ClusterAreaNum(areacache->cluster, areacache->areanum);
-	if (clusterareanum >= numreachabilityareas) return;
+	if (clusterareanum >= aasworld.clusters[areacache->cluster].numreachabilityareas) return;
 	//
-	Com_Memset(startareatraveltimes, 0, sizeof(startareatraveltimes));
+	Com_Memset(flood->startareatraveltimes, 0, sizeof(flood->startareatraveltimes));
 	//
-	curupdate = &aasworld.areaupdate[clusterareanum];
+	curupdate = &areaupdate[clusterareanum];
 	curupdate->areanum = areacache->areanum;
 	//VectorCopy(areacache->origin, curupdate->start);
-	curupdate->areatraveltimes = startareatraveltimes;
+	curupdate->areatraveltimes = flood->startareatraveltimes;
 	curupdate->tmptraveltime = areacache->starttraveltime;
 	//
 	areacache->traveltimes[clusterareanum] = areacache->starttraveltime;
 	//put the area to start with in the current read list
 	curupdate->next = NULL;
 	curupdate->prev = NULL;
-	updateliststart = curupdate;
-	updatelistend = curupdate;
+	flood->updateliststart = curupdate;
+	flood->updatelistend = curupdate;
+} //end of the function AAS_StartAreaFlood
+//===========================================================================
+// continue an area cache flood, the flood is finished when the update
+// list is empty
+//
+// Parameter:			flood			: flood state
+//						maxsteps		: maximum number of updates to process, -1 for no limit
+// Returns:				number of processed updates
+// Changes Globals:		-
+//===========================================================================
+static int AAS_ContinueAreaFlood(aas_routingflood_t *flood, int maxsteps)
+{
+	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
+	int numreachabilityareas, steps;
+	unsigned short int t;
+	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	aas_routingcache_t *areacache;
+	aas_reachability_t *reach;
+	aas_reversedreachability_t *revreach;
+	aas_reversedlink_t *revlink;
+
+	areacache = flood->cache;
+	//number of reachability areas within this cluster
+	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
+	//
+	badtravelflags = ~areacache->travelflags;
+	//
+	updateliststart = flood->updateliststart;
+	updatelistend = flood->updatelistend;
 	//while there are updates in the current list
-	while (updateliststart)
+	for (steps = 0; updateliststart && steps != maxsteps; steps++)
 	{
 		curupdate = updateliststart;
 		//
@@ -1376,7 +1699,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 			{
 				areacache->traveltimes[clusterareanum] = t;
 				areacache->reachabilities[clusterareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
-				nextupdate = &aasworld.areaupdate[clusterareanum];
+				nextupdate = &flood->updates[clusterareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//VectorCopy(reach->start, nextupdate->start);
@@ -1396,46 +1719,129 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 				} //end if
 			} //end if
 		} //end for
-	} //end while
+	} //end for
+	flood->updateliststart = updateliststart;
+	flood->updatelistend = updatelistend;
+	return steps;
+} //end of the function AAS_ContinueAreaFlood
+//===========================================================================
+// flood the given routing cache using the given routing update fields
+//
+// Parameter:			areaupdate		: routing update fields for every reachability area in the cluster
+//						areacache		: routing cache to update
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FloodAreaRoutingCache(aas_routingupdate_t *areaupdate, aas_routingcache_t *areacache)
+{
+	aas_routingflood_t flood;
+
+	AAS_StartAreaFlood(&flood, areaupdate, areacache);
+	AAS_ContinueAreaFlood(&flood, -1);
+} //end of the function AAS_FloodAreaRoutingCache
+//===========================================================================
+// update the given routing cache
+//
+// Parameter:			areacache		: routing cache to update
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
+{
+	aas_routingflood_t flood;
+
+#ifdef ROUTING_DEBUG
+	numareacacheupdates++;
+#endif //ROUTING_DEBUG
+	//
+	aasworld.frameroutingupdates++;
+	//
+	AAS_StartAreaFlood(&flood, aasworld.areaupdate, areacache);
+	routingupdatesteps += AAS_ContinueAreaFlood(&flood, -1);
 } //end of the function AAS_UpdateAreaRoutingCache
 //===========================================================================
+// returns the cached area routing without updating the cache time
 //
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
+static aas_routingcache_t *AAS_FindAreaRoutingCache(int clusternum, int areanum, int travelflags)
 {
-	int clusterareanum;
-	aas_routingcache_t *cache, *clustercache;
+	aas_routingcache_t *cache;
 
-	//number of the area in the cluster
-	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
-	//pointer to the cache for the area in the cluster
-	clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
 	//find the cache without undesired travel flags
-	for (cache = clustercache; cache; cache = cache->next)
+	for (cache = aasworld.clusterareacache[clusternum][AAS_ClusterAreaNum(clusternum, areanum)];
+			cache; cache = cache->next)
 	{
 		//if there aren't used any undesired travel types for the cache
 		if (cache->travelflags == travelflags) break;
 	} //end for
+	return cache;
+} //end of the function AAS_FindAreaRoutingCache
+//===========================================================================
+// allocates a new area routing cache and adds it to the cluster area cache
+// the travel times still have to be calculated
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_NewAreaRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
+	cache->type = CACHETYPE_AREA;
+	cache->cluster = clusternum;
+	cache->areanum = areanum;
+	VectorCopy(aasworld.areas[areanum].center, cache->origin);
+	cache->starttraveltime = 1;
+	cache->travelflags = travelflags;
+	AAS_AddRoutingCache(cache);
+	return cache;
+} //end of the function AAS_NewAreaRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	cache = AAS_FindAreaRoutingCache(clusternum, areanum, travelflags);
 	//if there was no cache
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		cache->prev = NULL;
-		cache->next = clustercache;
-		if (clustercache) clustercache->prev = cache;
-		aasworld.clusterareacache[clusternum][clusterareanum] = cache;
+		routingcachemisses++;
+		cache = AAS_NewAreaRoutingCache(clusternum, areanum, travelflags);
 		AAS_UpdateAreaRoutingCache(cache);
 	} //end if
+	//caches in the route cache file are never freed so they don't need a time
+	else if (cache->fileview)
+	{
+		routingcachehits++;
+		return cache;
+	} //end else if
+	//the routing request can't wait any longer
+	else if (cache->pending)
+	{
+		routingcachemisses++;
+		if (aasworld.requestflood.cache == cache)
+		{
+			routingupdatesteps += AAS_ContinueAreaFlood(&aasworld.requestflood, -1);
+		} //end if
+		else
+		{
+			AAS_UpdateAreaRoutingCache(cache);
+		} //end else
+		AAS_RemoveRoutingRequest(cache);
+	} //end else if
 	else
 	{
+		routingcachehits++;
 		AAS_UnlinkCache(cache);
 	} //end else
 	//the cache has been accessed
@@ -1445,27 +1851,27 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 	return cache;
 } //end of the function AAS_GetAreaRoutingCache
 //===========================================================================
+// start flooding the given portal routing cache using the given routing
+// update fields, when prebuilt is set all the area caches the flood needs
+// must already exist, they are only looked up and never created or relinked
 //
-// Parameter:			-
+// Parameter:			flood			: flood state
+//						portalupdate	: routing update fields for every portal + 1
+//						portalcache		: routing cache to update
+//						prebuilt		: only use existing area caches
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
+static void AAS_StartPortalFlood(aas_routingflood_t *flood, aas_routingupdate_t *portalupdate, aas_routingcache_t *portalcache, qboolean prebuilt)
 {
-	int i, portalnum, clusterareanum, clusternum;
-	unsigned short int t;
-	aas_portal_t *portal;
-	aas_cluster_t *cluster;
-	aas_routingcache_t *cache;
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	int clusternum;
+	aas_routingupdate_t *curupdate;
 
-#ifdef ROUTING_DEBUG
-	numportalcacheupdates++;
-#endif //ROUTING_DEBUG
-	//clear the routing update fields
-//	Com_Memset(aasworld.portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+	flood->cache = portalcache;
+	flood->updates = portalupdate;
+	flood->prebuilt = prebuilt;
 	//
-	curupdate = &aasworld.portalupdate[aasworld.numportals];
+	curupdate = &portalupdate[aasworld.numportals];
 	curupdate->cluster = portalcache->cluster;
 	curupdate->areanum = portalcache->areanum;
 	curupdate->tmptraveltime = portalcache->starttraveltime;
@@ -1478,23 +1884,52 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 	//put the area to start with in the current read list
 	curupdate->next = NULL;
 	curupdate->prev = NULL;
-	updateliststart = curupdate;
-	updatelistend = curupdate;
-	//while there are updates in the current list
-	while (updateliststart)
+	flood->updateliststart = curupdate;
+	flood->updatelistend = curupdate;
+} //end of the function AAS_StartPortalFlood
+//===========================================================================
+// continue a portal cache flood, the flood is finished when the update
+// list is empty
+//
+// Parameter:			flood			: flood state
+//						maxsteps		: maximum number of updates to process, -1 for no limit
+// Returns:				number of processed updates
+// Changes Globals:		-
+//===========================================================================
+static int AAS_ContinuePortalFlood(aas_routingflood_t *flood, int maxsteps)
+{
+	int i, portalnum, clusterareanum, steps;
+	unsigned short int t;
+	aas_portal_t *portal;
+	aas_cluster_t *cluster;
+	aas_routingcache_t *cache, *portalcache;
+	aas_routingupdate_t *curupdate, *nextupdate;
+
+	portalcache = flood->cache;
+	//while there are updates in the current list
+	for (steps = 0; flood->updateliststart && steps != maxsteps; steps++)
 	{
-		curupdate = updateliststart;
+		curupdate = flood->updateliststart;
 		//remove the current update from the list
 		if (curupdate->next) curupdate->next->prev = NULL;
-		else updatelistend = NULL;
-		updateliststart = curupdate->next;
+		else flood->updatelistend = NULL;
+		flood->updateliststart = curupdate->next;
 		//current update is removed from the list
 		curupdate->inlist = qfalse;
 		//
 		cluster = &aasworld.clusters[curupdate->cluster];
 		//
-		cache = AAS_GetAreaRoutingCache(curupdate->cluster,
+		if (flood->prebuilt)
+		{
+			cache = AAS_FindAreaRoutingCache(curupdate->cluster,
 								curupdate->areanum, portalcache->travelflags);
+			if (!cache) continue;
+		} //end if
+		else
+		{
+			cache = AAS_GetAreaRoutingCache(curupdate->cluster,
+								curupdate->areanum, portalcache->travelflags);
+		} //end else
 		//take all portals of the cluster
 		for (i = 0; i < cluster->numportals; i++)
 		{
@@ -1514,7 +1949,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 					portalcache->traveltimes[portalnum] > t)
 			{
 				portalcache->traveltimes[portalnum] = t;
-				nextupdate = &aasworld.portalupdate[portalnum];
+				nextupdate = &flood->updates[portalnum];
 				if (portal->frontcluster == curupdate->cluster)
 				{
 					nextupdate->cluster = portal->backcluster;
@@ -1532,50 +1967,129 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 					// we could also use a B+ tree to have a real sorted list
 					// on travel time which makes for faster routing updates
 					nextupdate->next = NULL;
-					nextupdate->prev = updatelistend;
-					if (updatelistend) updatelistend->next = nextupdate;
-					else updateliststart = nextupdate;
-					updatelistend = nextupdate;
+					nextupdate->prev = flood->updatelistend;
+					if (flood->updatelistend) flood->updatelistend->next = nextupdate;
+					else flood->updateliststart = nextupdate;
+					flood->updatelistend = nextupdate;
 					nextupdate->inlist = qtrue;
 				} //end if
 			} //end if
 		} //end for
-	} //end while
+	} //end for
+	return steps;
+} //end of the function AAS_ContinuePortalFlood
+//===========================================================================
+// flood the given portal routing cache using the given routing update fields
+//
+// Parameter:			portalupdate	: routing update fields for every portal + 1
+//						portalcache		: routing cache to update
+//						prebuilt		: only use existing area caches
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FloodPortalRoutingCache(aas_routingupdate_t *portalupdate, aas_routingcache_t *portalcache, qboolean prebuilt)
+{
+	aas_routingflood_t flood;
+
+	AAS_StartPortalFlood(&flood, portalupdate, portalcache, prebuilt);
+	AAS_ContinuePortalFlood(&flood, -1);
+} //end of the function AAS_FloodPortalRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
+{
+#ifdef ROUTING_DEBUG
+	numportalcacheupdates++;
+#endif //ROUTING_DEBUG
+	AAS_FloodPortalRoutingCache(aasworld.portalupdate, portalcache, qfalse);
 } //end of the function AAS_UpdatePortalRoutingCache
 //===========================================================================
+// returns the cached portal routing without updating the cache time
 //
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
+static aas_routingcache_t *AAS_FindPortalRoutingCache(int areanum, int travelflags)
 {
 	aas_routingcache_t *cache;
 
-	//find the cached portal routing if existing
 	for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
 	{
 		if (cache->travelflags == travelflags) break;
 	} //end for
+	return cache;
+} //end of the function AAS_FindPortalRoutingCache
+//===========================================================================
+// allocates a new portal routing cache and adds it to the portal cache
+// the travel times still have to be calculated
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_NewPortalRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	cache = AAS_AllocRoutingCache(aasworld.numportals);
+	cache->type = CACHETYPE_PORTAL;
+	cache->cluster = clusternum;
+	cache->areanum = areanum;
+	VectorCopy(aasworld.areas[areanum].center, cache->origin);
+	cache->starttraveltime = 1;
+	cache->travelflags = travelflags;
+	//add the cache to the cache list
+	AAS_AddRoutingCache(cache);
+	return cache;
+} //end of the function AAS_NewPortalRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	//find the cached portal routing if existing
+	cache = AAS_FindPortalRoutingCache(areanum, travelflags);
 	//if the portal routing isn't cached
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.numportals);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		//add the cache to the cache list
-		cache->prev = NULL;
-		cache->next = aasworld.portalcache[areanum];
-		if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
-		aasworld.portalcache[areanum] = cache;
+		routingcachemisses++;
+		cache = AAS_NewPortalRoutingCache(clusternum, areanum, travelflags);
 		//update the cache
 		AAS_UpdatePortalRoutingCache(cache);
 	} //end if
+	//caches in the route cache file are never freed so they don't need a time
+	else if (cache->fileview)
+	{
+		routingcachehits++;
+		return cache;
+	} //end else if
+	//the routing request can't wait any longer
+	else if (cache->pending)
+	{
+		routingcachemisses++;
+		if (aasworld.requestflood.cache == cache)
+		{
+			routingupdatesteps += AAS_ContinuePortalFlood(&aasworld.requestflood, -1);
+		} //end if
+		else
+		{
+			AAS_UpdatePortalRoutingCache(cache);
+		} //end else
+		AAS_RemoveRoutingRequest(cache);
+	} //end else if
 	else
 	{
+		routingcachehits++;
 		AAS_UnlinkCache(cache);
 	} //end else
 	//the cache has been accessed
@@ -1585,6 +2099,365 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 	return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// returns the area routing cache when it's available, otherwise the cache
+// is requested and returned with the pending flag set
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_RequestAreaRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	if (routingupdatebudget <= 0) return AAS_GetAreaRoutingCache(clusternum, areanum, travelflags);
+	//
+	cache = AAS_FindAreaRoutingCache(clusternum, areanum, travelflags);
+	if (!cache)
+	{
+		cache = AAS_NewAreaRoutingCache(clusternum, areanum, travelflags);
+		routingcachemisses++;
+		AAS_QueueRoutingRequest(cache);
+		return cache;
+	} //end if
+	if (cache->pending)
+	{
+		routingcachemisses++;
+		return cache;
+	} //end if
+	return AAS_GetAreaRoutingCache(clusternum, areanum, travelflags);
+} //end of the function AAS_RequestAreaRoutingCache
+//===========================================================================
+// returns the portal routing cache when it's available, otherwise the cache
+// is requested and returned with the pending flag set
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_RequestPortalRoutingCache(int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	if (routingupdatebudget <= 0) return AAS_GetPortalRoutingCache(clusternum, areanum, travelflags);
+	//
+	cache = AAS_FindPortalRoutingCache(areanum, travelflags);
+	if (!cache)
+	{
+		cache = AAS_NewPortalRoutingCache(clusternum, areanum, travelflags);
+		routingcachemisses++;
+		AAS_QueueRoutingRequest(cache);
+		return cache;
+	} //end if
+	if (cache->pending)
+	{
+		routingcachemisses++;
+		return cache;
+	} //end if
+	return AAS_GetPortalRoutingCache(clusternum, areanum, travelflags);
+} //end of the function AAS_RequestPortalRoutingCache
+//===========================================================================
+// floods the requested routing caches in order until the routing update
+// budget for this frame is used, the flood of the first request is
+// continued next frame when it didn't finish
+//
+// Parameter:			budget		: maximum number of routing update steps
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ContinueRoutingRequests(int budget)
+{
+	int startsteps;
+	aas_routingcache_t *cache;
+	aas_routingflood_t *flood;
+
+	flood = &aasworld.requestflood;
+	startsteps = routingupdatesteps;
+	while (aasworld.firstroutingrequest && routingupdatesteps - startsteps < budget)
+	{
+		cache = aasworld.firstroutingrequest;
+		if (flood->cache != cache)
+		{
+			aasworld.frameroutingupdates++;
+			if (cache->type == CACHETYPE_AREA)
+			{
+#ifdef ROUTING_DEBUG
+				numareacacheupdates++;
+#endif //ROUTING_DEBUG
+				AAS_StartAreaFlood(flood, aasworld.requestupdate, cache);
+			} //end if
+			else
+			{
+#ifdef ROUTING_DEBUG
+				numportalcacheupdates++;
+#endif //ROUTING_DEBUG
+				AAS_StartPortalFlood(flood, aasworld.requestupdate, cache, qfalse);
+			} //end else
+		} //end if
+		//one step at a time because a portal update step can flood area caches
+		if (cache->type == CACHETYPE_AREA) routingupdatesteps += AAS_ContinueAreaFlood(flood, 1);
+		else routingupdatesteps += AAS_ContinuePortalFlood(flood, 1);
+		//if the flood finished the cache can be used
+		if (!flood->updateliststart)
+		{
+			AAS_RemoveRoutingRequest(cache);
+			cache->time = AAS_RoutingTime();
+			AAS_LinkCache(cache);
+		} //end if
+	} //end while
+} //end of the function AAS_ContinueRoutingRequests
+//===========================================================================
+// keeps track of the number of routing updates per frame and spends the
+// routing update budget on the routing requests
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RoutingStartFrame(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_ROUTINGHISTOGRAM - 1; i++)
+	{
+		if (aasworld.frameroutingupdates < (1 << i)) break;
+	} //end for
+	frameroutinghistogram[i]++;
+	aasworld.frameroutingupdates = 0;
+	//
+	if (routingupdatebudget > 0 && aasworld.initialized)
+	{
+		AAS_ContinueRoutingRequests(routingupdatebudget);
+	} //end if
+} //end of the function AAS_RoutingStartFrame
+//===========================================================================
+// routing cache precomputation
+//
+// all the area and portal routing caches for the default travel flags are
+// allocated and linked on the calling thread, after which jobs flood them,
+// every job with its own routing update fields
+//===========================================================================
+
+typedef struct aas_routingjobs_s
+{
+	int numjobs;								//number of jobs the caches are divided over
+	int numcaches;								//number of caches to flood
+	aas_routingcache_t **caches;				//caches to flood
+	aas_routingupdate_t **updates;				//routing update fields for every job
+} aas_routingjobs_t;
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AreaRoutingCacheJob(void *data, int jobnum)
+{
+	aas_routingjobs_t *jobs = (aas_routingjobs_t *) data;
+	int i;
+
+	for (i = jobnum; i < jobs->numcaches; i += jobs->numjobs)
+	{
+		AAS_FloodAreaRoutingCache(jobs->updates[jobnum], jobs->caches[i]);
+	} //end for
+} //end of the function AAS_AreaRoutingCacheJob
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_PortalRoutingCacheJob(void *data, int jobnum)
+{
+	aas_routingjobs_t *jobs = (aas_routingjobs_t *) data;
+	int i;
+
+	for (i = jobnum; i < jobs->numcaches; i += jobs->numjobs)
+	{
+		AAS_FloodPortalRoutingCache(jobs->updates[jobnum], jobs->caches[i], qtrue);
+	} //end for
+} //end of the function AAS_PortalRoutingCacheJob
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RunRoutingCacheJobs(void (*func)(void *data, int jobnum), aas_routingjobs_t *jobs)
+{
+	int i;
+
+	if (botimport.RunJobs)
+	{
+		botimport.RunJobs(func, jobs, jobs->numjobs, jobs->numjobs - 1);
+		return;
+	} //end if
+	for (i = 0; i < jobs->numjobs; i++)
+	{
+		func(jobs, i);
+	} //end for
+} //end of the function AAS_RunRoutingCacheJobs
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AddPrecomputedAreaCache(aas_routingjobs_t *jobs, int clusternum, int areanum, int travelflags)
+{
+	aas_routingcache_t *cache;
+
+	if (AAS_FindAreaRoutingCache(clusternum, areanum, travelflags)) return;
+	cache = AAS_NewAreaRoutingCache(clusternum, areanum, travelflags);
+	cache->time = AAS_RoutingTime();
+	AAS_LinkCache(cache);
+	jobs->caches[jobs->numcaches++] = cache;
+} //end of the function AAS_AddPrecomputedAreaCache
+//===========================================================================
+// creates the area and portal routing cache for all the areas with
+// reachabilities using the default travel flags
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_PrecomputeRoutingCache(void)
+{
+	int i, side, clusternum, numareacache, numportalcache;
+	int maxreachabilityareas, travelflags, starttime;
+	aas_routingjobs_t jobs;
+	aas_routingcache_t *cache;
+	aas_portal_t *portal;
+
+	starttime = botimport.MilliSeconds();
+	travelflags = TFL_DEFAULT;
+	//
+	jobs.numjobs = (int) LibVarValue("routingcachethreads", "0") + 1;
+	if (jobs.numjobs < 1) jobs.numjobs = 1;
+	//every job gets its own routing update fields
+	maxreachabilityareas = 0;
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		if (aasworld.clusters[i].numreachabilityareas > maxreachabilityareas)
+		{
+			maxreachabilityareas = aasworld.clusters[i].numreachabilityareas;
+		} //end if
+	} //end for
+	jobs.updates = (aas_routingupdate_t **) GetClearedMemory(jobs.numjobs * sizeof(aas_routingupdate_t *));
+	for (i = 0; i < jobs.numjobs; i++)
+	{
+		jobs.updates[i] = (aas_routingupdate_t *) GetClearedMemory(
+					(maxreachabilityareas + aasworld.numportals + 1) * sizeof(aas_routingupdate_t));
+	} //end for
+	//every area and every portal on both sides can get an area cache
+	jobs.caches = (aas_routingcache_t **) GetMemory(
+					(aasworld.numareas + aasworld.numportals * 2) * sizeof(aas_routingcache_t *));
+	//create the area cache towards every reachability area within its cluster
+	jobs.numcaches = 0;
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		clusternum = aasworld.areasettings[i].cluster;
+		if (clusternum <= 0) continue;
+		if (aasworld.areasettings[i].clusterareanum >= aasworld.clusters[clusternum].numreachabilityareas) continue;
+		AAS_AddPrecomputedAreaCache(&jobs, clusternum, i, travelflags);
+	} //end for
+	//create the area cache towards every portal from both the clusters it separates
+	for (i = 1; i < aasworld.numportals; i++)
+	{
+		portal = &aasworld.portals[i];
+		for (side = 0; side < 2; side++)
+		{
+			clusternum = side ? portal->backcluster : portal->frontcluster;
+			if (portal->clusterareanum[side] >= aasworld.clusters[clusternum].numreachabilityareas) continue;
+			AAS_AddPrecomputedAreaCache(&jobs, clusternum, portal->areanum, travelflags);
+		} //end for
+	} //end for
+	numareacache = jobs.numcaches;
+	AAS_RunRoutingCacheJobs(AAS_AreaRoutingCacheJob, &jobs);
+	//create the portal cache towards every area with reachabilities, the
+	//portal floods only read the area cache created above
+	jobs.numcaches = 0;
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		if (!aasworld.areasettings[i].numreachableareas) continue;
+		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
+		{
+			if (cache->travelflags == travelflags) break;
+		} //end for
+		if (cache) continue;
+		clusternum = aasworld.areasettings[i].cluster;
+		//just assume a portal area is part of the front cluster
+		if (clusternum < 0) clusternum = aasworld.portals[-clusternum].frontcluster;
+		cache = AAS_NewPortalRoutingCache(clusternum, i, travelflags);
+		cache->time = AAS_RoutingTime();
+		AAS_LinkCache(cache);
+		jobs.caches[jobs.numcaches++] = cache;
+	} //end for
+	numportalcache = jobs.numcaches;
+	AAS_RunRoutingCacheJobs(AAS_PortalRoutingCacheJob, &jobs);
+	//
+#ifdef ROUTING_DEBUG
+	numareacacheupdates += numareacache;
+	numportalcacheupdates += numportalcache;
+#endif //ROUTING_DEBUG
+	for (i = 0; i < jobs.numjobs; i++)
+	{
+		FreeMemory(jobs.updates[i]);
+	} //end for
+	FreeMemory(jobs.updates);
+	FreeMemory(jobs.caches);
+	//
+	botimport.Print(PRT_MESSAGE, "precomputed %d area and %d portal routing caches in %d msec using %d jobs\n",
+						numareacache, numportalcache, botimport.MilliSeconds() - starttime, jobs.numjobs);
+} //end of the function AAS_PrecomputeRoutingCache
+//===========================================================================
+// estimates the route to the goal area while the routing cache is still
+// being calculated, the reachability ending closest to the goal area is
+// used and the travel time is based on the straight line distance
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_AreaRouteEstimate(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
+{
+	int i, bestreachnum, badtravelflags;
+	float dist, bestdist;
+	vec_t *goal;
+	aas_areasettings_t *settings;
+	aas_reachability_t *reach;
+
+	goal = aasworld.areas[goalareanum].center;
+	badtravelflags = ~travelflags;
+	settings = &aasworld.areasettings[areanum];
+	bestreachnum = -1;
+	bestdist = 0;
+	for (i = 0; i < settings->numreachableareas; i++)
+	{
+		reach = &aasworld.reachability[settings->firstreachablearea + i];
+		//if there is used an undesired travel type
+		if (AAS_TravelFlagForType_inline(reach->traveltype) & badtravelflags) continue;
+		//if not allowed to enter the next area
+		if (aasworld.areasettings[reach->areanum].areaflags & AREA_DISABLED) continue;
+		//if the next area has a not allowed travel flag
+		if (AAS_AreaContentsTravelFlags_inline(reach->areanum) & badtravelflags) continue;
+		//
+		dist = DistanceSquared(reach->end, goal);
+		if (bestreachnum < 0 || dist < bestdist)
+		{
+			bestreachnum = settings->firstreachablearea + i;
+			bestdist = dist;
+		} //end if
+	} //end for
+	if (bestreachnum < 0) return qfalse;
+	//
+	if (!origin) origin = aasworld.areas[areanum].center;
+	*traveltime = 1 + (int) (Distance(origin, goal) * DISTANCEFACTOR_WALK);
+	*reachnum = bestreachnum;
+	return qtrue;
+} //end of the function AAS_AreaRouteEstimate
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1592,7 +2465,7 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 //===========================================================================
 int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
 {
-	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum;
+	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum, pending;
 	unsigned short int t, besttime;
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
@@ -1675,7 +2548,12 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	if (clusternum > 0 && goalclusternum > 0 && clusternum == goalclusternum)
 	{
 		//
-		areacache = AAS_GetAreaRoutingCache(clusternum, goalareanum, travelflags);
+		areacache = AAS_RequestAreaRoutingCache(clusternum, goalareanum, travelflags);
+		//estimate the route while the routing request is pending
+		if (areacache->pending)
+		{
+			return AAS_AreaRouteEstimate(areanum, origin, goalareanum, travelflags, traveltime, reachnum);
+		} //end if
 		//the number of the area in the cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//the cluster the area is in
@@ -1709,7 +2587,12 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		goalclusternum = portal->frontcluster;
 	} //end if
 	//get the portal routing cache
-	portalcache = AAS_GetPortalRoutingCache(goalclusternum, goalareanum, travelflags);
+	portalcache = AAS_RequestPortalRoutingCache(goalclusternum, goalareanum, travelflags);
+	//estimate the route while the routing request is pending
+	if (portalcache->pending)
+	{
+		return AAS_AreaRouteEstimate(areanum, origin, goalareanum, travelflags, traveltime, reachnum);
+	} //end if
 	//if the area is a cluster portal, read directly from the portal cache
 	if (clusternum < 0)
 	{
@@ -1721,6 +2604,7 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	//
 	besttime = 0;
 	bestreachnum = -1;
+	pending = qfalse;
 	//the cluster the area is in
 	cluster = &aasworld.clusters[clusternum];
 	//find the portal of the area cluster leading towards the goal area
@@ -1732,7 +2616,13 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		//
 		portal = &aasworld.portals[portalnum];
 		//get the cache of the portal area
-		areacache = AAS_GetAreaRoutingCache(clusternum, portal->areanum, travelflags);
+		areacache = AAS_RequestAreaRoutingCache(clusternum, portal->areanum, travelflags);
+		//skip the portal while the routing request is pending
+		if (areacache->pending)
+		{
+			pending = qtrue;
+			continue;
+		} //end if
 		//current area inside the current cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//if the area is NOT a reachability area
@@ -1764,6 +2654,9 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		} //end if
 	} //end for
 	if (bestreachnum < 0) {
+		if (pending) {
+			return AAS_AreaRouteEstimate(areanum, origin, goalareanum, travelflags, traveltime, reachnum);
+		}
 		return qfalse;
 	}
 	*reachnum = bestreachnum;
@@ -1824,6 +2717,7 @@ int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origi
 	route->endcontents = 0;
 	route->endtravelflags = 0;
 	VectorCopy(origin, route->endpos);
+	route->numareas = 0;
 	route->time = 0;
 
 	curareanum = areanum;
@@ -1904,6 +2798,7 @@ int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origi
 		//
 		curareanum = reach->areanum;
 		VectorCopy(reach->end, curorigin);
+		route->numareas++;
 		//
 		if (maxtime && route->time > maxtime)
 			break;
@@ -2094,16 +2989,25 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
 	int i, j, nextareanum, badtravelflags, numreach, bestarea;
 	unsigned short int t, besttraveltime;
 	static unsigned short int *hidetraveltimes;
+	static aas_routingupdate_t *hideupdate;
+	static int hidenumareas;
 	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
 	aas_reachability_t *reach;
 	float dist1, dist2;
 	vec3_t v1, v2, p;
 	qboolean startVisible;
 
-	//
-	if (!hidetraveltimes)
+	if (!aasworld.initialized) return 0;
+	if (areanum <= 0 || areanum >= aasworld.numareas) return 0;
+	//the routing update fields of the world are only allocated for the
+	//reachability areas of a cluster and may be in use by a routing request
+	if (hidenumareas != aasworld.numareas)
 	{
+		if (hidetraveltimes) FreeMemory(hidetraveltimes);
+		if (hideupdate) FreeMemory(hideupdate);
 		hidetraveltimes = (unsigned short int *) GetClearedMemory(aasworld.numareas * sizeof(unsigned short int));
+		hideupdate = (aas_routingupdate_t *) GetClearedMemory(aasworld.numareas * sizeof(aas_routingupdate_t));
+		hidenumareas = aasworld.numareas;
 	} //end if
 	else
 	{
@@ -2116,7 +3020,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
 	//
 	badtravelflags = ~travelflags;
 	//
-	curupdate = &aasworld.areaupdate[areanum];
+	curupdate = &hideupdate[areanum];
 	curupdate->areanum = areanum;
 	VectorCopy(origin, curupdate->start);
 	curupdate->areatraveltimes = aasworld.areatraveltimes[areanum][0];
@@ -2198,7 +3102,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
 					bestarea = nextareanum;
 				} //end if
 				hidetraveltimes[nextareanum] = t;
-				nextupdate = &aasworld.areaupdate[nextareanum];
+				nextupdate = &hideupdate[nextareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//remember where we entered this area
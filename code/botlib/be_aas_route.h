@@ -46,9 +46,17 @@ void AAS_FreeRoutingCaches(void);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
-void AAS_WriteRouteCache(void);
+//create the routing cache for all areas using the default travel flags on worker jobs
+void AAS_PrecomputeRoutingCache(void);
+qboolean AAS_WriteRouteCache(void);
+//continue the routing requests within the routing update budget of the frame
+void AAS_RoutingStartFrame(void);
 //
 void AAS_RoutingInfo(void);
+//size of the routing cache in bytes and the routing cache lookup statistics
+extern int routingcachesize;
+extern int routingcachehits;
+extern int routingcachemisses;
 #endif //AASINTERN
 
 //returns the travel flag for the given travel type
@@ -71,5 +79,7 @@ int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, in
 int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+//returns the nearest area the enemy can't see that can be reached without going near the enemy
+int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, vec3_t enemyorigin, int enemyareanum, int travelflags);
 
 
@@ -208,6 +208,109 @@ void AAS_FreeAASLinkedEntities(void)
 	aasworld.arealinkedentities = NULL;
 } //end of the function AAS_InitAASLinkedEntities
 //===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreePackedNodes(void)
+{
+	if (aasworld.packednodememory) FreeMemory(aasworld.packednodememory);
+	aasworld.packednodememory = NULL;
+	aasworld.packednodes = NULL;
+} //end of the function AAS_FreePackedNodes
+//===========================================================================
+// copies the nodes with their planes into one cache line aligned array
+// the nodes are numbered depth first from the root with the front child
+// first, so a node's front child is usually in the same cache line
+// node zero stays the dummy used for solid leafs and node 1 the root
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitPackedNodes(void)
+{
+	int i, j, child, numordered, numstack;
+	int *order, *stack;
+	aas_node_t *node;
+	aas_packednode_t *packed;
+
+	AAS_FreePackedNodes();
+	if (aasworld.numnodes < 2) return;
+	//
+	order = (int *) GetMemory(aasworld.numnodes * sizeof(int));
+	stack = (int *) GetMemory((aasworld.numnodes * 2 + 1) * sizeof(int));
+	for (i = 0; i < aasworld.numnodes; i++) order[i] = -1;
+	//
+	order[0] = 0;
+	numordered = 1;
+	numstack = 0;
+	stack[numstack++] = 1;
+	//a node can be pushed once for each parent
+	while (numstack)
+	{
+		i = stack[--numstack];
+		if (order[i] != -1) continue;
+		order[i] = numordered++;
+		for (j = 1; j >= 0; j--)
+		{
+			child = aasworld.nodes[i].children[j];
+			if (child > 0 && child < aasworld.numnodes && order[child] == -1)
+			{
+				stack[numstack++] = child;
+			} //end if
+		} //end for
+	} //end while
+	//nodes that can't be reached from the root go at the end
+	for (i = 0; i < aasworld.numnodes; i++)
+	{
+		if (order[i] == -1) order[i] = numordered++;
+	} //end for
+	//
+	aasworld.packednodememory = GetClearedMemory(aasworld.numnodes * sizeof(aas_packednode_t) + 64);
+	aasworld.packednodes = (aas_packednode_t *) PADP(aasworld.packednodememory, 64);
+	for (i = 0; i < aasworld.numnodes; i++)
+	{
+		node = &aasworld.nodes[i];
+		packed = &aasworld.packednodes[order[i]];
+		if (node->planenum >= 0 && node->planenum < aasworld.numplanes)
+		{
+			packed->plane = aasworld.planes[node->planenum];
+			packed->planenum = node->planenum;
+		} //end if
+		for (j = 0; j < 2; j++)
+		{
+			child = node->children[j];
+			//children outside the tree are treated as solid leafs
+			if (child >= aasworld.numnodes) packed->children[j] = 0;
+			else if (child > 0) packed->children[j] = order[child];
+			else packed->children[j] = child;
+		} //end for
+	} //end for
+	FreeMemory(stack);
+	FreeMemory(order);
+} //end of the function AAS_InitPackedNodes
+//===========================================================================
+// returns the AAS area the point is in starting at the given packed node
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE int AAS_PointAreaNumFromNode(vec3_t point, int nodenum)
+{
+	aas_packednode_t *node;
+
+	while (nodenum > 0)
+	{
+		node = &aasworld.packednodes[nodenum];
+		if (DotProduct(point, node->plane.normal) - node->plane.dist > 0) nodenum = node->children[0];
+		else nodenum = node->children[1];
+	} //end while
+	return -nodenum;
+} //end of the function AAS_PointAreaNumFromNode
+//===========================================================================
 // returns the AAS area the point is in
 //
 // Parameter:				-
@@ -216,10 +319,7 @@ void AAS_FreeAASLinkedEntities(void)
 //===========================================================================
 int AAS_PointAreaNum(vec3_t point)
 {
-	int nodenum;
-	vec_t	dist;
-	aas_node_t *node;
-	aas_plane_t *plane;
+	int areanum;
 
 	if (!aasworld.loaded)
 	{
@@ -228,39 +328,173 @@ int AAS_PointAreaNum(vec3_t point)
 	} //end if
 
 	//start with node 1 because node zero is a dummy used for solid leafs
-	nodenum = 1;
-	while (nodenum > 0)
-	{
-//		botimport.Print(PRT_MESSAGE, "[%d]", nodenum);
+	areanum = AAS_PointAreaNumFromNode(point, 1);
 #ifdef AAS_SAMPLE_DEBUG
-		if (nodenum >= aasworld.numnodes)
-		{
-			botimport.Print(PRT_ERROR, "nodenum = %d >= aasworld.numnodes = %d\n", nodenum, aasworld.numnodes);
-			return 0;
-		} //end if
-#endif //AAS_SAMPLE_DEBUG
-		node = &aasworld.nodes[nodenum];
-#ifdef AAS_SAMPLE_DEBUG
-		if (node->planenum < 0 || node->planenum >= aasworld.numplanes)
-		{
-			botimport.Print(PRT_ERROR, "node->planenum = %d >= aasworld.numplanes = %d\n", node->planenum, aasworld.numplanes);
-			return 0;
-		} //end if
-#endif //AAS_SAMPLE_DEBUG
-		plane = &aasworld.planes[node->planenum];
-		dist = DotProduct(point, plane->normal) - plane->dist;
-		if (dist > 0) nodenum = node->children[0];
-		else nodenum = node->children[1];
-	} //end while
-	if (!nodenum)
+	if (!areanum)
 	{
-#ifdef AAS_SAMPLE_DEBUG
 		botimport.Print(PRT_MESSAGE, "in solid\n");
+	} //end if
 #endif //AAS_SAMPLE_DEBUG
+	return areanum;
+} //end of the function AAS_PointAreaNum
+//===========================================================================
+// stores the AAS area every point is in, zero for points in solid
+// four points at a time are walked down the tree in lockstep, so the node
+// loads of the different points overlap, until one of them ends up in a
+// leaf after which the others are finished one by one
+//
+// Parameter:				points		: points to find the areas for
+//							numpoints	: number of points
+//							areanums	: area number for every point
+// Returns:					number of points in an area
+// Changes Globals:		-
+//===========================================================================
+int AAS_PointAreaNums(vec3_t *points, int numpoints, int *areanums)
+{
+	int i, n0, n1, n2, n3, numinareas;
+	aas_packednode_t *node0, *node1, *node2, *node3;
+
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_PointAreaNums: aas not loaded\n");
+		for (i = 0; i < numpoints; i++) areanums[i] = 0;
 		return 0;
 	} //end if
-	return -nodenum;
-} //end of the function AAS_PointAreaNum
+
+	for (i = 0; i + 4 <= numpoints; i += 4)
+	{
+		//start with node 1 because node zero is a dummy used for solid leafs
+		n0 = n1 = n2 = n3 = 1;
+		while (n0 > 0 && n1 > 0 && n2 > 0 && n3 > 0)
+		{
+			node0 = &aasworld.packednodes[n0];
+			node1 = &aasworld.packednodes[n1];
+			node2 = &aasworld.packednodes[n2];
+			node3 = &aasworld.packednodes[n3];
+			n0 = node0->children[!(DotProduct(points[i], node0->plane.normal) - node0->plane.dist > 0)];
+			n1 = node1->children[!(DotProduct(points[i+1], node1->plane.normal) - node1->plane.dist > 0)];
+			n2 = node2->children[!(DotProduct(points[i+2], node2->plane.normal) - node2->plane.dist > 0)];
+			n3 = node3->children[!(DotProduct(points[i+3], node3->plane.normal) - node3->plane.dist > 0)];
+		} //end while
+		areanums[i] = AAS_PointAreaNumFromNode(points[i], n0);
+		areanums[i+1] = AAS_PointAreaNumFromNode(points[i+1], n1);
+		areanums[i+2] = AAS_PointAreaNumFromNode(points[i+2], n2);
+		areanums[i+3] = AAS_PointAreaNumFromNode(points[i+3], n3);
+	} //end for
+	for (; i < numpoints; i++)
+	{
+		areanums[i] = AAS_PointAreaNumFromNode(points[i], 1);
+	} //end for
+	//
+	numinareas = 0;
+	for (i = 0; i < numpoints; i++)
+	{
+		if (areanums[i]) numinareas++;
+	} //end for
+	return numinareas;
+} //end of the function AAS_PointAreaNums
+//===========================================================================
+// returns a pseudo random point within the AAS world bounds, the same
+// seed always gives the same points so results can be compared
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_BenchmarkPoint(unsigned int *seed, vec3_t mins, vec3_t maxs, vec3_t point)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		*seed = *seed * 1664525 + 1013904223;
+		point[i] = mins[i] + (maxs[i] - mins[i]) * ((*seed >> 8) & 0xffff) / 65535.0f;
+	} //end for
+} //end of the function AAS_BenchmarkPoint
+//===========================================================================
+// times the tree walking queries at pseudo random points within the AAS
+// world and prints the queries per second with a checksum of the results
+//
+// Parameter:				numqueries		: number of queries of every kind
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+#define BENCHMARK_BATCH		64
+
+void AAS_SampleBenchmark(int numqueries)
+{
+	int i, j, n, start, time, numareas;
+	int areas[BENCHMARK_BATCH];
+	unsigned int seed, checksum;
+	vec3_t mins, maxs, end;
+	vec3_t points[BENCHMARK_BATCH];
+	aas_trace_t trace;
+
+	if (!aasworld.loaded || aasworld.numareas < 2) return;
+	if (numqueries < 1) return;
+	//
+	ClearBounds(mins, maxs);
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		AddPointToBounds(aasworld.areas[i].mins, mins, maxs);
+		AddPointToBounds(aasworld.areas[i].maxs, mins, maxs);
+	} //end for
+	//
+	seed = 1;
+	checksum = 0;
+	start = botimport.MilliSeconds();
+	for (i = 0; i < numqueries; i++)
+	{
+		AAS_BenchmarkPoint(&seed, mins, maxs, points[0]);
+		checksum = checksum * 31 + AAS_PointAreaNum(points[0]);
+	} //end for
+	time = botimport.MilliSeconds() - start;
+	botimport.Print(PRT_MESSAGE, "AAS_PointAreaNum     %6d msec %10.0f/s checksum %08x\n",
+						time, numqueries * 1000.0f / (time > 0 ? time : 1), checksum);
+	//
+	seed = 1;
+	checksum = 0;
+	start = botimport.MilliSeconds();
+	for (i = 0; i < numqueries; i += n)
+	{
+		n = numqueries - i;
+		if (n > BENCHMARK_BATCH) n = BENCHMARK_BATCH;
+		for (j = 0; j < n; j++) AAS_BenchmarkPoint(&seed, mins, maxs, points[j]);
+		AAS_PointAreaNums(points, n, areas);
+		for (j = 0; j < n; j++) checksum = checksum * 31 + areas[j];
+	} //end for
+	time = botimport.MilliSeconds() - start;
+	botimport.Print(PRT_MESSAGE, "AAS_PointAreaNums    %6d msec %10.0f/s checksum %08x\n",
+						time, numqueries * 1000.0f / (time > 0 ? time : 1), checksum);
+	//
+	seed = 1;
+	checksum = 0;
+	start = botimport.MilliSeconds();
+	for (i = 0; i < numqueries; i++)
+	{
+		AAS_BenchmarkPoint(&seed, mins, maxs, points[0]);
+		AAS_BenchmarkPoint(&seed, mins, maxs, end);
+		numareas = AAS_TraceAreas(points[0], end, areas, NULL, BENCHMARK_BATCH);
+		for (j = 0; j < numareas; j++) checksum = checksum * 31 + areas[j];
+	} //end for
+	time = botimport.MilliSeconds() - start;
+	botimport.Print(PRT_MESSAGE, "AAS_TraceAreas       %6d msec %10.0f/s checksum %08x\n",
+						time, numqueries * 1000.0f / (time > 0 ? time : 1), checksum);
+	//
+	seed = 1;
+	checksum = 0;
+	start = botimport.MilliSeconds();
+	for (i = 0; i < numqueries; i++)
+	{
+		AAS_BenchmarkPoint(&seed, mins, maxs, points[0]);
+		AAS_BenchmarkPoint(&seed, mins, maxs, end);
+		trace = AAS_TracePlayerBBox(points[0], end, PRESENCE_NORMAL, -1, 0);
+		checksum = checksum * 31 + trace.area + trace.planenum + (int) (trace.fraction * 1024);
+	} //end for
+	time = botimport.MilliSeconds() - start;
+	botimport.Print(PRT_MESSAGE, "AAS_TracePlayerBBox  %6d msec %10.0f/s checksum %08x\n",
+						time, numqueries * 1000.0f / (time > 0 ? time : 1), checksum);
+} //end of the function AAS_SampleBenchmark
 //===========================================================================
 //
 // Parameter:			-
@@ -461,7 +695,7 @@ aas_trace_t AAS_TracePlayerBBox(vec3_t start, vec3_t end, int presencetype, int
 	vec3_t cur_start, cur_end, cur_mid, v1, v2;
 	aas_tracestack_t tracestack[127];
 	aas_tracestack_t *tstack_p;
-	aas_node_t *aasnode;
+	aas_packednode_t *aasnode;
 	aas_plane_t *plane;
 	aas_trace_t trace;
 
@@ -608,13 +842,13 @@ aas_trace_t AAS_TracePlayerBBox(vec3_t start, vec3_t end, int presencetype, int
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
 		//the node to test against
-		aasnode = &aasworld.nodes[nodenum];
+		aasnode = &aasworld.packednodes[nodenum];
 		//start point of current line to test against node
 		VectorCopy(tstack_p->start, cur_start);
 		//end point of the current line to test against node
 		VectorCopy(tstack_p->end, cur_end);
 		//the current node plane
-		plane = &aasworld.planes[aasnode->planenum];
+		plane = &aasnode->plane;
 
 		switch(plane->type)
 		{/*FIXME: wtf doesn't this work? obviously the axial node planes aren't always facing positive!!!
@@ -742,7 +976,7 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 	vec3_t cur_start, cur_end, cur_mid;
 	aas_tracestack_t tracestack[127];
 	aas_tracestack_t *tstack_p;
-	aas_node_t *aasnode;
+	aas_packednode_t *aasnode;
 	aas_plane_t *plane;
 
 	numareas = 0;
@@ -800,13 +1034,13 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
 		//the node to test against
-		aasnode = &aasworld.nodes[nodenum];
+		aasnode = &aasworld.packednodes[nodenum];
 		//start point of current line to test against node
 		VectorCopy(tstack_p->start, cur_start);
 		//end point of the current line to test against node
 		VectorCopy(tstack_p->end, cur_end);
 		//the current node plane
-		plane = &aasworld.planes[aasnode->planenum];
+		plane = &aasnode->plane;
 
 		switch(plane->type)
 		{/*FIXME: wtf doesn't this work? obviously the node planes aren't always facing positive!!!
@@ -1237,8 +1471,7 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 	int side, nodenum;
 	aas_linkstack_t linkstack[128];
 	aas_linkstack_t *lstack_p;
-	aas_node_t *aasnode;
-	aas_plane_t *plane;
+	aas_packednode_t *aasnode;
 	aas_link_t *link, *areas;
 
 	if (!aasworld.loaded)
@@ -1296,11 +1529,9 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		//if solid leaf
 		if (!nodenum) continue;
 		//the node to test against
-		aasnode = &aasworld.nodes[nodenum];
-		//the current node plane
-		plane = &aasworld.planes[aasnode->planenum];
+		aasnode = &aasworld.packednodes[nodenum];
 		//get the side(s) the box is situated relative to the plane
-		side = AAS_BoxOnPlaneSide2(absmins, absmaxs, plane);
+		side = AAS_BoxOnPlaneSide2(absmins, absmaxs, &aasnode->plane);
 		//if on the front side of the node
 		if (side & 1)
 		{
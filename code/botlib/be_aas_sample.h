@@ -42,6 +42,9 @@ void AAS_InitAASLinkHeap(void);
 void AAS_InitAASLinkedEntities(void);
 void AAS_FreeAASLinkHeap(void);
 void AAS_FreeAASLinkedEntities(void);
+void AAS_InitPackedNodes(void);
+void AAS_FreePackedNodes(void);
+void AAS_SampleBenchmark(int numqueries);
 aas_face_t *AAS_AreaGroundFace(int areanum, vec3_t point);
 aas_face_t *AAS_TraceEndFace(aas_trace_t *trace);
 aas_plane_t *AAS_PlaneFromNum(int planenum);
@@ -72,6 +75,8 @@ int AAS_BBoxAreas(vec3_t absmins, vec3_t absmaxs, int *areas, int maxareas);
 int AAS_AreaInfo( int areanum, aas_areainfo_t *info );
 //returns the area the point is in
 int AAS_PointAreaNum(vec3_t point);
+//stores the area every point is in and returns the number of points in an area
+int AAS_PointAreaNums(vec3_t *points, int numpoints, int *areanums);
 //
 int AAS_PointReachabilityAreaIndex( vec3_t point );
 //returns the plane the given face is in
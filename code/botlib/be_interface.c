@@ -57,6 +57,9 @@ botlib_import_t botimport;
 int botDeveloper;
 //qtrue if the library is setup
 int botlibsetup = qfalse;
+//query capture file and the number of captured queries
+static fileHandle_t querycapturefile;
+static int numcapturedqueries;
 
 //===========================================================================
 //
@@ -112,6 +115,88 @@ qboolean BotLibSetup(char *str)
 	} //end if
 	return qtrue;
 } //end of the function BotLibSetup
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotLib_StopQueryCapture(void)
+{
+	if (!querycapturefile) return;
+	botimport.FS_FCloseFile(querycapturefile);
+	querycapturefile = 0;
+	botimport.Print(PRT_MESSAGE, "captured %d bot queries\n", numcapturedqueries);
+} //end of the function BotLib_StopQueryCapture
+//===========================================================================
+// start capturing the routing and area queries to the file named by the
+// querycapture libvar, loading a map restarts the capture
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotLib_StartQueryCapture(void)
+{
+	char *filename, mapname[MAX_QPATH];
+	int header[3];
+
+	BotLib_StopQueryCapture();
+	LibVarSetNotModified("querycapture");
+	filename = LibVarString("querycapture", "");
+	if (!*filename || !Q_stricmp(filename, "0")) return;
+	if (!aasworld.loaded) return;
+	//
+	botimport.FS_FOpenFile(filename, &querycapturefile, FS_WRITE);
+	if (!querycapturefile)
+	{
+		botimport.Print(PRT_ERROR, "couldn't open %s for writing\n", filename);
+		return;
+	} //end if
+	header[0] = LittleLong(QUERYCAPTURE_IDENT);
+	header[1] = LittleLong(QUERYCAPTURE_VERSION);
+	header[2] = LittleLong(aasworld.bspchecksum);
+	Com_Memset(mapname, 0, sizeof(mapname));
+	Q_strncpyz(mapname, aasworld.mapname, sizeof(mapname));
+	botimport.FS_Write(header, sizeof(header), querycapturefile);
+	botimport.FS_Write(mapname, sizeof(mapname), querycapturefile);
+	numcapturedqueries = 0;
+	botimport.Print(PRT_MESSAGE, "capturing bot queries to %s\n", filename);
+} //end of the function BotLib_StartQueryCapture
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotLib_CaptureVector(int *record, vec3_t v)
+{
+	floatint_t fi;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		fi.f = v[i];
+		record[i] = fi.i;
+	} //end for
+} //end of the function BotLib_CaptureVector
+//===========================================================================
+//
+// Parameter:				record		: query type followed by the arguments and results
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotLib_CaptureQuery(int *record)
+{
+	int i, out[QUERYCAPTURE_RECORD / 4];
+
+	for (i = 0; i < QUERYCAPTURE_RECORD / 4; i++)
+	{
+		out[i] = LittleLong(record[i]);
+	} //end for
+	botimport.FS_Write(out, sizeof(out), querycapturefile);
+	numcapturedqueries++;
+} //end of the function BotLib_CaptureQuery
 
 //===========================================================================
 //
@@ -158,6 +243,7 @@ int Export_BotLibShutdown(void)
 #ifndef DEMO
 	//DumpFileCRCs();
 #endif //DEMO
+	BotLib_StopQueryCapture();
 	//shud down aas
 	AAS_Shutdown();
 	//free all libvars
@@ -213,7 +299,19 @@ int Export_BotLibVarGet(const char *var_name, char *value, int size)
 //===========================================================================
 int Export_BotLibStartFrame(float time)
 {
+	int record[QUERYCAPTURE_RECORD / 4];
+	floatint_t fi;
+
 	if (!BotLibSetup("BotStartFrame")) return BLERR_LIBRARYNOTSETUP;
+	if (LibVarChanged("querycapture")) BotLib_StartQueryCapture();
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_STARTFRAME;
+		fi.f = time;
+		record[1] = fi.i;
+		BotLib_CaptureQuery(record);
+	} //end if
 	return AAS_StartFrame(time);
 } //end of the function Export_BotLibStartFrame
 //===========================================================================
@@ -232,9 +330,11 @@ int Export_BotLibLoadMap(const char *mapname)
 	if (!BotLibSetup("BotLoadMap")) return BLERR_LIBRARYNOTSETUP;
 	//
 	botimport.Print(PRT_DEVELOPER, "------------ Map Loading ------------\n");
+	BotLib_StopQueryCapture();
 	//startup AAS for the current map, model and sound index
 	errnum = AAS_LoadMap(mapname);
 	if (errnum != BLERR_NOERROR) return errnum;
+	BotLib_StartQueryCapture();
 	//
 	botimport.Print(PRT_DEVELOPER, "-------------------------------------\n");
 #ifdef DEBUG
@@ -269,6 +369,147 @@ void Export_AAS_TracePlayerBBox(struct aas_trace_s *trace, vec3_t start, vec3_t
 	tr = AAS_TracePlayerBBox(start, end, presencetype, passent, contentmask);
 	Com_Memcpy(trace, &tr, sizeof (aas_trace_t));
 } //end of the function Export_AAS_TracePlayerBBox
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int maxareas)
+{
+	int i, numareas, record[QUERYCAPTURE_RECORD / 4];
+	unsigned int checksum;
+
+	numareas = AAS_TraceAreas(start, end, areas, points, maxareas);
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_TRACEAREAS;
+		BotLib_CaptureVector(&record[1], start);
+		BotLib_CaptureVector(&record[4], end);
+		record[7] = maxareas;
+		record[8] = points != NULL;
+		record[9] = numareas;
+		for (checksum = 0, i = 0; i < numareas; i++) checksum = checksum * 31 + areas[i];
+		record[10] = checksum;
+		BotLib_CaptureQuery(record);
+	} //end if
+	return numareas;
+} //end of the function Export_AAS_TraceAreas
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_AAS_EnableRoutingArea(int areanum, int enable)
+{
+	int result, record[QUERYCAPTURE_RECORD / 4];
+
+	result = AAS_EnableRoutingArea(areanum, enable);
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_ENABLEROUTINGAREA;
+		record[1] = areanum;
+		record[2] = enable;
+		record[3] = result;
+		BotLib_CaptureQuery(record);
+	} //end if
+	return result;
+} //end of the function Export_AAS_EnableRoutingArea
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags)
+{
+	int result, record[QUERYCAPTURE_RECORD / 4];
+
+	result = AAS_AreaTravelTimeToGoalArea(areanum, origin, goalareanum, travelflags);
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_TRAVELTIMETOGOALAREA;
+		record[1] = areanum;
+		record[2] = origin != NULL;
+		if (origin) BotLib_CaptureVector(&record[3], origin);
+		record[6] = goalareanum;
+		record[7] = travelflags;
+		record[8] = result;
+		BotLib_CaptureQuery(record);
+	} //end if
+	return result;
+} //end of the function Export_AAS_AreaTravelTimeToGoalArea
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
+							int goalareanum, int travelflags, int maxareas, int maxtime,
+							int stopevent, int stopcontents, int stoptfl, int stopareanum)
+{
+	int result, record[QUERYCAPTURE_RECORD / 4];
+
+	result = AAS_PredictRoute(route, areanum, origin, goalareanum, travelflags, maxareas, maxtime,
+							stopevent, stopcontents, stoptfl, stopareanum);
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_PREDICTROUTE;
+		record[1] = areanum;
+		BotLib_CaptureVector(&record[2], origin);
+		record[5] = goalareanum;
+		record[6] = travelflags;
+		record[7] = maxareas;
+		record[8] = maxtime;
+		record[9] = stopevent;
+		record[10] = stopcontents;
+		record[11] = stoptfl;
+		record[12] = stopareanum;
+		record[13] = result;
+		BotLib_CaptureVector(&record[14], route->endpos);
+		record[17] = route->endarea;
+		record[18] = route->stopevent;
+		record[19] = route->endcontents;
+		record[20] = route->endtravelflags;
+		record[21] = route->numareas;
+		record[22] = route->time;
+		BotLib_CaptureQuery(record);
+	} //end if
+	return result;
+} //end of the function Export_AAS_PredictRoute
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, vec3_t enemyorigin, int enemyareanum, int travelflags)
+{
+	int result, record[QUERYCAPTURE_RECORD / 4];
+
+	result = AAS_NearestHideArea(srcnum, origin, areanum, enemynum, enemyorigin, enemyareanum, travelflags);
+	if (querycapturefile)
+	{
+		Com_Memset(record, 0, sizeof(record));
+		record[0] = QUERY_NEARESTHIDEAREA;
+		record[1] = srcnum;
+		BotLib_CaptureVector(&record[2], origin);
+		record[5] = areanum;
+		record[6] = enemynum;
+		BotLib_CaptureVector(&record[7], enemyorigin);
+		record[10] = enemyareanum;
+		record[11] = travelflags;
+		record[12] = result;
+		BotLib_CaptureQuery(record);
+	} //end if
+	return result;
+} //end of the function Export_AAS_NearestHideArea
 
 
 /*
@@ -307,9 +548,10 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	// be_aas_sample.c
 	//--------------------------------------------
 	aas->AAS_PointAreaNum = AAS_PointAreaNum;
+	aas->AAS_PointAreaNums = AAS_PointAreaNums;
 	aas->AAS_PointReachabilityAreaIndex = AAS_PointReachabilityAreaIndex;
 	aas->AAS_TracePlayerBBox = Export_AAS_TracePlayerBBox;
-	aas->AAS_TraceAreas = AAS_TraceAreas;
+	aas->AAS_TraceAreas = Export_AAS_TraceAreas;
 	aas->AAS_BBoxAreas = AAS_BBoxAreas;
 	aas->AAS_AreaInfo = AAS_AreaInfo;
 	//--------------------------------------------
@@ -346,10 +588,11 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	aas->AAS_NextAreaReachability = AAS_NextAreaReachability;
 	aas->AAS_ReachabilityFromNum = AAS_ReachabilityFromNum;
 	aas->AAS_RandomGoalArea = AAS_RandomGoalArea;
-	aas->AAS_EnableRoutingArea = AAS_EnableRoutingArea;
+	aas->AAS_EnableRoutingArea = Export_AAS_EnableRoutingArea;
 	aas->AAS_AreaTravelTime = AAS_AreaTravelTime;
-	aas->AAS_AreaTravelTimeToGoalArea = AAS_AreaTravelTimeToGoalArea;
-	aas->AAS_PredictRoute = AAS_PredictRoute;
+	aas->AAS_AreaTravelTimeToGoalArea = Export_AAS_AreaTravelTimeToGoalArea;
+	aas->AAS_PredictRoute = Export_AAS_PredictRoute;
+	aas->AAS_NearestHideArea = Export_AAS_NearestHideArea;
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
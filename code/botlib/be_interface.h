@@ -50,6 +50,30 @@ typedef struct botlib_globals_s
 } botlib_globals_t;
 
 
+//query capture written while the "querycapture" libvar is set to a file name
+#define QUERYCAPTURE_IDENT			(('P'<<24)+('A'<<16)+('C'<<8)+'Q')
+#define QUERYCAPTURE_VERSION		1
+//ident, version, map checksum and map name
+#define QUERYCAPTURE_HEADER			(3 * 4 + MAX_QPATH)
+//query type followed by the query arguments and results, floats are stored as their bits
+#define QUERYCAPTURE_RECORD			(24 * 4)
+
+//captured queries and their records:
+//frame time
+#define QUERY_STARTFRAME			1
+//areanum, enable, result
+#define QUERY_ENABLEROUTINGAREA		2
+//areanum, has origin, origin[3], goalareanum, travelflags, result
+#define QUERY_TRAVELTIMETOGOALAREA	3
+//areanum, origin[3], goalareanum, travelflags, maxareas, maxtime, stopevent, stopcontents,
+//stoptfl, stopareanum, result, endpos[3], endarea, stopevent, endcontents, endtravelflags, numareas, time
+#define QUERY_PREDICTROUTE			4
+//start[3], end[3], maxareas, points requested, result, checksum of the areas
+#define QUERY_TRACEAREAS			5
+//srcnum, origin[3], areanum, enemynum, enemyorigin[3], enemyareanum, travelflags, result
+#define QUERY_NEARESTHIDEAREA		6
+#define MAX_QUERYTYPES				7
+
 extern botlib_globals_t botlibglobals;
 extern botlib_import_t botimport;
 extern int botDeveloper;					//true if developer is on
@@ -37,7 +37,7 @@ Suite 120, Rockville, Maryland 20850 USA.
  *
  *****************************************************************************/
 
-#define	BOTLIB_API_VERSION		3
+#define	BOTLIB_API_VERSION		7
 
 struct aas_clientmove_s;
 struct aas_areainfo_s;
@@ -126,6 +126,9 @@ typedef struct botlib_import_s
 	int			(*FS_Write)( const void *buffer, int len, fileHandle_t f );
 	void		(*FS_FCloseFile)( fileHandle_t f );
 	int			(*FS_Seek)( fileHandle_t f, long offset, int origin );
+	//map a file read-only instead of reading it, may be NULL, returns -1 if the file can't be mapped
+	long		(*FS_MapFile)( const char *qpath, void **buffer, void **mapping );
+	void		(*FS_UnmapFile)( void *mapping );
 	//debug visualisation stuff
 	int			(*DebugLineCreate)(void);
 	void		(*DebugLineDelete)(int line);
@@ -133,6 +136,9 @@ typedef struct botlib_import_s
 	//
 	int			(*DebugPolygonCreate)(int color, int numPoints, vec3_t *points);
 	void		(*DebugPolygonDelete)(int id);
+	//run numJobs jobs on up to numWorkers worker threads and wait for them to finish,
+	//may be NULL in which case the jobs are run on the calling thread
+	void		(*RunJobs)(void (*func)(void *data, int jobNum), void *data, int numJobs, int numWorkers);
 } botlib_import_t;
 
 typedef struct aas_export_s
@@ -167,6 +173,7 @@ typedef struct aas_export_s
 	// be_aas_sample.c
 	//--------------------------------------------
 	int			(*AAS_PointAreaNum)(vec3_t point);
+	int			(*AAS_PointAreaNums)(vec3_t *points, int numpoints, int *areanums);
 	int			(*AAS_PointReachabilityAreaIndex)( vec3_t point );
 	void		(*AAS_TracePlayerBBox)(struct aas_trace_s *trace, vec3_t start, vec3_t end, int presencetype, int passent, int contentmask);
 	int			(*AAS_TraceAreas)(vec3_t start, vec3_t end, int *areas, vec3_t *points, int maxareas);
@@ -212,6 +219,7 @@ typedef struct aas_export_s
 	int			(*AAS_PredictRoute)(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+	int			(*AAS_NearestHideArea)(int srcnum, vec3_t origin, int areanum, int enemynum, vec3_t enemyorigin, int enemyareanum, int travelflags);
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -319,6 +327,7 @@ name:						default:			module(s):			description:
 "aasoptimize"				"0"					be_aas_main.c		enable aas optimization
 "sv_mapChecksum"			"0"					be_aas_main.c		BSP file checksum
 "bot_visualizejumppads"		"0"					be_aas_reach.c		visualize jump pads
+"querycapture"				""					be_interface.c		file to capture the routing and area queries to
 
 */
 
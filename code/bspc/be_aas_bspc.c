@@ -225,11 +225,14 @@ void AAS_InitBotImport(void)
 	botimport.FS_Write = NULL;
 	botimport.FS_FCloseFile = NULL;
 	botimport.FS_Seek = NULL;
+	botimport.FS_MapFile = NULL;
+	botimport.FS_UnmapFile = NULL;
 	botimport.DebugLineCreate = NULL;
 	botimport.DebugLineDelete = NULL;
 	botimport.DebugLineShow = NULL;
 	botimport.DebugPolygonCreate = NULL;
 	botimport.DebugPolygonDelete = NULL;
+	botimport.RunJobs = NULL;
 } //end of the function AAS_InitBotImport
 //===========================================================================
 //
@@ -254,6 +257,8 @@ void AAS_CalcReachAndClusters(struct quakefile_s *qf)
 	AAS_LoadBSPFile();
 	//init physics settings
 	AAS_InitSettings();
+	//pack the nodes for walking the tree
+	AAS_InitPackedNodes();
 	//initialize AAS link heap
 	AAS_InitAASLinkHeap();
 	//initialize the AAS linked entities for the new map
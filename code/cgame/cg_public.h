@@ -38,7 +38,7 @@ Suite 120, Rockville, Maryland 20850 USA.
 // ZTM: FIXME: There is no way for the VM to know what the engine support API is
 //             so there is no way to add more system calls.
 #define CG_API_MAJOR_VERSION	1
-#define CG_API_MINOR_VERSION	0
+#define CG_API_MINOR_VERSION	1
 
 
 #define	CMD_BACKUP			64	
@@ -293,6 +293,7 @@ typedef enum {
 	CG_CM_TRANSFORMEDCAPSULETRACE,
 	CG_CM_BISPHERETRACE,
 	CG_CM_TRANSFORMEDBISPHERETRACE,
+	CG_CM_BOXTRACEBATCH, // ( trace_t *results, const traceRequest_t *requests, int numRequests, clipHandle_t model );
 
 
 	CG_R_REGISTERMODEL = 300,
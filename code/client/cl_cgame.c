@@ -1119,13 +1119,28 @@ CL_LoadWorldMap
 =======================
 */
 void CL_LoadWorldMap( const char *name ) {
+	int		startMsec;
+
+	Com_LoadStage( "cgame init" );
+
+	// on a listen server this shares the bsp the server's clip map was
+	// loaded from instead of parsing it again
 	if ( !cls.cgameBsp ) {
 		cls.cgameBsp = BSP_Load( name );
 		if ( !cls.cgameBsp ) {
 			Com_Error( ERR_DROP, "Couldn't load %s", name );
 		}
 	}
+
+	Com_LoadStage( "bsp" );
+
+	startMsec = Sys_Milliseconds();
 	re.LoadWorld( cls.cgameBsp );
+	Com_LoadStage( "renderer world" );
+
+	if ( com_speeds->integer ) {
+		Com_Printf( "CL_LoadWorldMap: %s, renderer world in %i msec\n", name, Sys_Milliseconds() - startMsec );
+	}
 }
 
 
@@ -1312,6 +1327,11 @@ intptr_t CL_CgameSystemCalls( intptr_t *args ) {
 		CM_TransformedBiSphereTrace( VMA(1), VMA(2), VMA(3), VMF(4), VMF(5),
 				args[6], args[7], VMA(8) );
 		return 0;
+	case CG_CM_BOXTRACEBATCH:
+		if ( args[3] > 0 ) {
+			CM_BoxTraceBatch( VMA(1), VMA(2), args[3], args[4] );
+		}
+		return 0;
 	case CG_CM_MARKFRAGMENTS:
 		return re.MarkFragments( args[1], VMA(2), VMA(3), args[4], VMA(5), args[6], VMA(7) );
 	case CG_S_STARTSOUND:
@@ -1834,6 +1854,8 @@ void CL_InitCGame( void ) {
 		Com_Printf("Loading level %s...\n", mapname);
 	}
 
+	Com_BeginLoadStages( va( "cgame %s", mapname ) );
+
 	// init for this gamestate
 	// use the lastExecutedServerCommand instead of the serverCommandSequence
 	// otherwise server commands sent just before a gamestate are dropped
@@ -1865,6 +1887,9 @@ void CL_InitCGame( void ) {
 	// will cause the server to send us the first snapshot
 	clc.state = CA_PRIMED;
 
+	Com_LoadStage( "cgame media" );
+	Com_EndLoadStages();
+
 	t2 = Sys_Milliseconds();
 
 	Com_DPrintf( "CL_InitCGame: %5.2f seconds\n", (t2-t1)/1000.0 );
@@ -38,7 +38,7 @@ Suite 120, Rockville, Maryland 20850 USA.
 // ZTM: FIXME: There is no way for the VM to know what the engine support API is
 //             so there is no way to add more system calls.
 #define	GAME_API_MAJOR_VERSION	1
-#define	GAME_API_MINOR_VERSION	0
+#define	GAME_API_MINOR_VERSION	2
 
 
 // entity->svFlags
@@ -288,6 +288,12 @@ typedef enum {
 	G_CLIPTOENTITIES, // ( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
 	G_CLIPTOENTITIESCAPSULE, // ( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
 
+	G_TRACEBATCH, // ( trace_t *results, const traceRequest_t *requests, int numRequests );
+	// G_TRACE or G_TRACECAPSULE for each request, cheaper than calling them one at a time
+
+	G_IN_PVS_LIST, // int ( const vec3_t p, const vec3_t *points, int numPoints, qboolean ignorePortals, byte *visible );
+	// G_IN_PVS or G_IN_PVS_IGNORE_PORTALS from p to each point, returns the number visible
+
 } gameImport_t;
 
 
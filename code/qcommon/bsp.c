@@ -54,9 +54,43 @@ bspFormat_t *bspFormats[] = {
 
 const int numBspFormats = ARRAY_LEN( bspFormats );
 
-#define MAX_BSP_FILES 1
+// the server, client and renderer share a bsp, a second slot lets the
+// previous map stay referenced while the next one is loaded
+#define MAX_BSP_FILES 2
 bspFile_t *bsp_loadedFiles[MAX_BSP_FILES] = {0};
 
+// file being loaded if it stays mapped while the bsp is in use
+static const byte	*bsp_mappedData;
+static qboolean		bsp_usedMappedData;
+
+static void BSP_FreeInternal( bspFile_t *bsp );
+
+#ifndef BSPC
+/*
+   BSP_FileHash()
+   quick hash to notice that a cached bsp's file has changed, the md4
+   checksum would cost about as much as parsing the file
+ */
+static int BSP_FileHash( const byte *data, int length ) {
+	unsigned	hash[4] = { 2166136261u, 2166136261u, 2166136261u, 2166136261u };
+	unsigned	words[4];
+	int			i, j;
+
+	for ( i = 0; i + 16 <= length; i += 16 ) {
+		Com_Memcpy( words, data + i, 16 );
+		for ( j = 0; j < 4; j++ ) {
+			hash[j] = ( hash[j] ^ words[j] ) * 16777619u;
+		}
+	}
+
+	for ( ; i < length; i++ ) {
+		hash[0] = ( hash[0] ^ data[i] ) * 16777619u;
+	}
+
+	return (int)( hash[0] ^ ( hash[1] * 3 ) ^ ( hash[2] * 5 ) ^ ( hash[3] * 7 ) );
+}
+#endif
+
 
 bspFile_t *BSP_Load( const char *name ) {
 	union {
@@ -67,6 +101,12 @@ bspFile_t *BSP_Load( const char *name ) {
 	int				length;
 	bspFile_t		*bspFile = NULL;
 	int				freeSlot = -1;
+	int				cachedSlot = -1;
+	void			*mapping = NULL;
+#ifndef BSPC
+	int				startMsec;
+	int				fileHash;
+#endif
 
 #ifndef BSPC
 	if ( !name || !name[0] ) {
@@ -84,12 +124,37 @@ bspFile_t *BSP_Load( const char *name ) {
 		}
 
 		if ( !Q_stricmp( bsp_loadedFiles[i]->name, name ) ) {
+			// an unreferenced bsp has to be checked against the file
+			if ( bsp_loadedFiles[i]->references <= 0 ) {
+				cachedSlot = i;
+				continue;
+			}
+
 			bsp_loadedFiles[i]->references++;
+#ifndef BSPC
+			if ( com_speeds->integer ) {
+				Com_Printf( "BSP_Load: %s shared, %i references\n", name, bsp_loadedFiles[i]->references );
+			}
+#endif
 			return bsp_loadedFiles[i];
 		}
 	}
 
-	if ( freeSlot == -1 ) {
+	// free unreferenced bsps for other maps
+	for ( i = 0; i < MAX_BSP_FILES; i++ ) {
+		if ( i == cachedSlot || !bsp_loadedFiles[i] || bsp_loadedFiles[i]->references > 0 ) {
+			continue;
+		}
+
+		BSP_FreeInternal( bsp_loadedFiles[i] );
+		bsp_loadedFiles[i] = NULL;
+
+		if ( freeSlot == -1 ) {
+			freeSlot = i;
+		}
+	}
+
+	if ( freeSlot == -1 && cachedSlot == -1 ) {
 		Com_Error( ERR_DROP, "No free slot to load BSP '%s'", name );
 	}
 
@@ -97,7 +162,14 @@ bspFile_t *BSP_Load( const char *name ) {
 	// load the file
 	//
 #ifndef BSPC
-	length = FS_ReadFile( name, &buf.v );
+	startMsec = Sys_Milliseconds();
+
+	// lumps with the same layout on disk and in memory are used in place
+	// when the file can be mapped, instead of being copied
+	length = FS_MapFile( name, &buf.v, &mapping );
+	if ( !buf.v ) {
+		length = FS_ReadFile( name, &buf.v );
+	}
 #else
 	length = LoadQuakeFile((quakefile_t *) name, &buf.v);
 #endif
@@ -107,9 +179,44 @@ bspFile_t *BSP_Load( const char *name ) {
 		return NULL;
 	}
 
+#ifndef BSPC
+	fileHash = BSP_FileHash( buf.v, length );
+
+	if ( cachedSlot != -1 ) {
+		bspFile = bsp_loadedFiles[cachedSlot];
+
+		if ( bspFile->fileLength == length && bspFile->fileHash == fileHash ) {
+			if ( mapping ) {
+				FS_UnmapFile( mapping );
+			} else {
+				FS_FreeFile( buf.v );
+			}
+
+			bspFile->references++;
+
+			if ( com_speeds->integer ) {
+				Com_Printf( "BSP_Load: %s unchanged, reused in %i msec\n", name, Sys_Milliseconds() - startMsec );
+			}
+			return bspFile;
+		}
+
+		// the file changed since it was parsed
+		BSP_FreeInternal( bspFile );
+		bsp_loadedFiles[cachedSlot] = NULL;
+		bspFile = NULL;
+
+		if ( freeSlot == -1 ) {
+			freeSlot = cachedSlot;
+		}
+	}
+#endif
+
 	//
 	// check formats
 	//
+	bsp_mappedData = mapping ? buf.v : NULL;
+	bsp_usedMappedData = qfalse;
+
 	for ( i = 0; i < numBspFormats; i++ ) {
 		bspFile = bspFormats[i]->loadFunction( bspFormats[i], name, buf.v, length );
 		if ( bspFile ) {
@@ -117,10 +224,18 @@ bspFile_t *BSP_Load( const char *name ) {
 		}
 	}
 
+	bsp_mappedData = NULL;
+
 	if ( i == numBspFormats ) {
 		int ident = LittleLong( buf.i[0] );
 		int version = LittleLong( buf.i[1] );
 
+#ifndef BSPC
+		if ( mapping ) {
+			FS_UnmapFile( mapping );
+		}
+#endif
+
 		Com_Error( ERR_DROP, "Unsupported BSP %s: ident %c%c%c%c, version %d",
 				name, ident & 0xff, ( ident >> 8 ) & 0xff, ( ident >> 16 ) & 0xff,
 				( ident >> 24 ) & 0xff, version );
@@ -129,37 +244,76 @@ bspFile_t *BSP_Load( const char *name ) {
 	if ( bspFile ) {
 		Q_strncpyz( bspFile->name, name, sizeof ( bspFile->name ) );
 		bspFile->references++;
+		bspFile->fileLength = length;
+#ifndef BSPC
+		bspFile->fileHash = fileHash;
+#endif
 		bsp_loadedFiles[freeSlot] = bspFile;
 	}
 
-	FS_FreeFile (buf.v);
+#ifndef BSPC
+	if ( com_speeds->integer ) {
+		Com_Printf( "BSP_Load: %s parsed in %i msec\n", name, Sys_Milliseconds() - startMsec );
+	}
+
+	if ( mapping ) {
+		if ( bspFile && bsp_usedMappedData ) {
+			bspFile->fileMapping = mapping;
+			bspFile->fileData = buf.v;
+		} else {
+			FS_UnmapFile( mapping );
+		}
+	} else
+#endif
+	{
+		FS_FreeFile (buf.v);
+	}
 
 	return bspFile;
 }
 
+/*
+   BSP_FreeLump()
+   lumps used in place in the mapped file aren't allocated
+ */
+static void BSP_FreeLump( bspFile_t *bsp, void *lump ) {
+	if ( bsp->fileData && (byte *)lump >= bsp->fileData && (byte *)lump < bsp->fileData + bsp->fileLength ) {
+		return;
+	}
+
+	free( lump );
+}
+
 static void BSP_FreeInternal( bspFile_t *bsp ) {
-	free( bsp->entityString );
-	free( bsp->shaders );
-	free( bsp->planes );
-	free( bsp->nodes );
-	free( bsp->leafs );
-	free( bsp->leafSurfaces );
-	free( bsp->leafBrushes );
-	free( bsp->submodels );
-	free( bsp->brushes );
-	free( bsp->brushSides );
-	free( bsp->drawVerts );
-	free( bsp->drawIndexes );
-	free( bsp->fogs );
-	free( bsp->surfaces );
-	free( bsp->lightmapData );
-	free( bsp->lightGridData );
-	free( bsp->visibility );
+	BSP_FreeLump( bsp, bsp->entityString );
+	BSP_FreeLump( bsp, bsp->shaders );
+	BSP_FreeLump( bsp, bsp->planes );
+	BSP_FreeLump( bsp, bsp->nodes );
+	BSP_FreeLump( bsp, bsp->leafs );
+	BSP_FreeLump( bsp, bsp->leafSurfaces );
+	BSP_FreeLump( bsp, bsp->leafBrushes );
+	BSP_FreeLump( bsp, bsp->submodels );
+	BSP_FreeLump( bsp, bsp->brushes );
+	BSP_FreeLump( bsp, bsp->brushSides );
+	BSP_FreeLump( bsp, bsp->drawVerts );
+	BSP_FreeLump( bsp, bsp->drawIndexes );
+	BSP_FreeLump( bsp, bsp->fogs );
+	BSP_FreeLump( bsp, bsp->surfaces );
+	BSP_FreeLump( bsp, bsp->lightmapData );
+	BSP_FreeLump( bsp, bsp->lightGridData );
+	BSP_FreeLump( bsp, bsp->visibility );
+#ifndef BSPC
+	if ( bsp->fileMapping ) {
+		FS_UnmapFile( bsp->fileMapping );
+	}
+#endif
 	free( bsp );
 }
 
 void BSP_Free( bspFile_t *bspFile ) {
+#ifdef BSPC
 	int i;
+#endif
 
 	if ( !bspFile )
 		return;
@@ -168,6 +322,7 @@ void BSP_Free( bspFile_t *bspFile ) {
 	if ( bspFile->references > 0 )
 		return;
 
+#ifdef BSPC
 	for ( i = 0; i < MAX_BSP_FILES; i++ ) {
 		if ( bspFile == bsp_loadedFiles[i] ) {
 			bsp_loadedFiles[i] = NULL;
@@ -176,6 +331,10 @@ void BSP_Free( bspFile_t *bspFile ) {
 	}
 
 	BSP_FreeInternal( bspFile );
+#endif
+
+	// otherwise it's kept until another map is loaded in case the same map
+	// is loaded again
 }
 
 void BSP_Shutdown( void ) {
@@ -213,3 +372,30 @@ void BSP_SwapBlock( int *dest, const int *src, int size ) {
 		dest[ i ] = LittleLong( src[ i ] );
 }
 
+/*
+   BSP_MappedLump()
+   returns the lump in the file if the file stays mapped while the bsp is in
+   use and the lump can be used in place, otherwise NULL and the lump should
+   be copied.  the lump must have the same layout in memory as on disk.
+ */
+
+void *BSP_MappedLump( const void *data, int fileofs, int filelen ) {
+#ifdef Q3_LITTLE_ENDIAN
+	const byte *lump;
+
+	if ( !bsp_mappedData || data != bsp_mappedData || filelen <= 0 ) {
+		return NULL;
+	}
+
+	// pk3 entries aren't necessarily aligned
+	lump = bsp_mappedData + fileofs;
+	if ( (intptr_t)lump & 3 ) {
+		return NULL;
+	}
+
+	bsp_usedMappedData = qtrue;
+	return (void *)lump;
+#else
+	return NULL;
+#endif
+}
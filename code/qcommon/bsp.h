@@ -202,6 +202,15 @@ typedef struct {
 	byte			*visibility;
 	int				visibilityLength;
 
+	// lumps used in place point into the mapped file
+	void			*fileMapping;
+	const byte		*fileData;
+
+	// unreferenced bsps are kept until another map is loaded, loading the
+	// same name again only parses the file if it doesn't match these
+	int				fileLength;
+	int				fileHash;
+
 } bspFile_t;
 
 //
@@ -209,6 +218,7 @@ bspFile_t *BSP_Load( const char *name );
 void BSP_Free( bspFile_t *bspFile );
 void BSP_Shutdown( void );
 void BSP_SwapBlock( int *dest, const int *src, int size );
+void *BSP_MappedLump( const void *data, int fileofs, int filelen );
 
 
 /*
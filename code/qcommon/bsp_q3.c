@@ -245,6 +245,19 @@ static void *GetLump( dheader_t *header, const void *src, int lump ) {
 	return (void*)( (byte*) src + header->lumps[ lump ].fileofs );
 }
 
+// Use the lump in the mapped file if it has the same layout in memory, otherwise NULL
+static void *GetLumpInPlace( dheader_t *header, const void *src, int lump, int diskSize, int memSize ) {
+	if ( diskSize != memSize || header->lumps[ lump ].filelen % diskSize ) {
+		return NULL;
+	}
+
+	return BSP_MappedLump( src, header->lumps[ lump ].fileofs, header->lumps[ lump ].filelen );
+}
+
+static qboolean LumpInPlace( dheader_t *header, const void *src, int lump, const void *dest ) {
+	return ( dest == GetLump( header, src, lump ) );
+}
+
 /****************************************************
 */
 
@@ -279,25 +292,39 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 	bsp->shaders = malloc( bsp->numShaders * sizeof ( *bsp->shaders ) );
 
 	bsp->numPlanes = GetLumpElements( &header, LUMP_PLANES, sizeof ( realDplane_t ) );
-	bsp->planes = malloc( bsp->numPlanes * sizeof ( *bsp->planes ) );
+	bsp->planes = GetLumpInPlace( &header, data, LUMP_PLANES, sizeof ( realDplane_t ), sizeof ( *bsp->planes ) );
+	if ( !bsp->planes )
+		bsp->planes = malloc( bsp->numPlanes * sizeof ( *bsp->planes ) );
 
 	bsp->numNodes = GetLumpElements( &header, LUMP_NODES, sizeof ( realDnode_t ) );
-	bsp->nodes = malloc( bsp->numNodes * sizeof ( *bsp->nodes ) );
+	bsp->nodes = GetLumpInPlace( &header, data, LUMP_NODES, sizeof ( realDnode_t ), sizeof ( *bsp->nodes ) );
+	if ( !bsp->nodes )
+		bsp->nodes = malloc( bsp->numNodes * sizeof ( *bsp->nodes ) );
 
 	bsp->numLeafs = GetLumpElements( &header, LUMP_LEAFS, sizeof ( realDleaf_t ) );
-	bsp->leafs = malloc( bsp->numLeafs * sizeof ( *bsp->leafs ) );
+	bsp->leafs = GetLumpInPlace( &header, data, LUMP_LEAFS, sizeof ( realDleaf_t ), sizeof ( *bsp->leafs ) );
+	if ( !bsp->leafs )
+		bsp->leafs = malloc( bsp->numLeafs * sizeof ( *bsp->leafs ) );
 
 	bsp->numLeafSurfaces = GetLumpElements( &header, LUMP_LEAFSURFACES, sizeof ( int ) );
-	bsp->leafSurfaces = malloc( bsp->numLeafSurfaces * sizeof ( *bsp->leafSurfaces ) );
+	bsp->leafSurfaces = GetLumpInPlace( &header, data, LUMP_LEAFSURFACES, sizeof ( int ), sizeof ( *bsp->leafSurfaces ) );
+	if ( !bsp->leafSurfaces )
+		bsp->leafSurfaces = malloc( bsp->numLeafSurfaces * sizeof ( *bsp->leafSurfaces ) );
 
 	bsp->numLeafBrushes = GetLumpElements( &header, LUMP_LEAFBRUSHES, sizeof ( int ) );
-	bsp->leafBrushes = malloc( bsp->numLeafBrushes * sizeof ( *bsp->leafBrushes ) );
+	bsp->leafBrushes = GetLumpInPlace( &header, data, LUMP_LEAFBRUSHES, sizeof ( int ), sizeof ( *bsp->leafBrushes ) );
+	if ( !bsp->leafBrushes )
+		bsp->leafBrushes = malloc( bsp->numLeafBrushes * sizeof ( *bsp->leafBrushes ) );
 
 	bsp->numSubmodels = GetLumpElements( &header, LUMP_MODELS, sizeof ( realDmodel_t ) );
-	bsp->submodels = malloc( bsp->numSubmodels * sizeof ( *bsp->submodels ) );
+	bsp->submodels = GetLumpInPlace( &header, data, LUMP_MODELS, sizeof ( realDmodel_t ), sizeof ( *bsp->submodels ) );
+	if ( !bsp->submodels )
+		bsp->submodels = malloc( bsp->numSubmodels * sizeof ( *bsp->submodels ) );
 
 	bsp->numBrushes = GetLumpElements( &header, LUMP_BRUSHES, sizeof ( realDbrush_t ) );
-	bsp->brushes = malloc( bsp->numBrushes * sizeof ( *bsp->brushes ) );
+	bsp->brushes = GetLumpInPlace( &header, data, LUMP_BRUSHES, sizeof ( realDbrush_t ), sizeof ( *bsp->brushes ) );
+	if ( !bsp->brushes )
+		bsp->brushes = malloc( bsp->numBrushes * sizeof ( *bsp->brushes ) );
 
 	if ( format->version == WARLORD_BSP_VERSION ) {
 		bsp->numBrushSides = GetLumpElements( &header, LUMP_BRUSHSIDES, sizeof ( realDbrushside_warlord_t ) );
@@ -307,10 +334,14 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 	bsp->brushSides = malloc( bsp->numBrushSides * sizeof ( *bsp->brushSides ) );
 
 	bsp->numDrawVerts = GetLumpElements( &header, LUMP_DRAWVERTS, sizeof ( realDrawVert_t ) );
-	bsp->drawVerts = malloc( bsp->numDrawVerts * sizeof ( *bsp->drawVerts ) );
+	bsp->drawVerts = GetLumpInPlace( &header, data, LUMP_DRAWVERTS, sizeof ( realDrawVert_t ), sizeof ( *bsp->drawVerts ) );
+	if ( !bsp->drawVerts )
+		bsp->drawVerts = malloc( bsp->numDrawVerts * sizeof ( *bsp->drawVerts ) );
 
 	bsp->numDrawIndexes = GetLumpElements( &header, LUMP_DRAWINDEXES, sizeof ( int ) );
-	bsp->drawIndexes = malloc( bsp->numDrawIndexes * sizeof ( *bsp->drawIndexes ) );
+	bsp->drawIndexes = GetLumpInPlace( &header, data, LUMP_DRAWINDEXES, sizeof ( int ), sizeof ( *bsp->drawIndexes ) );
+	if ( !bsp->drawIndexes )
+		bsp->drawIndexes = malloc( bsp->numDrawIndexes * sizeof ( *bsp->drawIndexes ) );
 
 	bsp->numFogs = GetLumpElements( &header, LUMP_FOGS, sizeof ( realDfog_t ) );
 	bsp->fogs = malloc( bsp->numFogs * sizeof ( *bsp->fogs ) );
@@ -319,15 +350,21 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 	bsp->surfaces = malloc( bsp->numSurfaces * sizeof ( *bsp->surfaces ) );
 
 	bsp->numLightmaps = GetLumpElements( &header, LUMP_LIGHTMAPS, 128 * 128 * 3 );
-	bsp->lightmapData = malloc( bsp->numLightmaps * 128 * 128 * 3 );
+	bsp->lightmapData = GetLumpInPlace( &header, data, LUMP_LIGHTMAPS, 128 * 128 * 3, 128 * 128 * 3 );
+	if ( !bsp->lightmapData )
+		bsp->lightmapData = malloc( bsp->numLightmaps * 128 * 128 * 3 );
 
 	bsp->numGridPoints = GetLumpElements( &header, LUMP_LIGHTGRID, 8 );
-	bsp->lightGridData = malloc( bsp->numGridPoints * 8 );
+	bsp->lightGridData = GetLumpInPlace( &header, data, LUMP_LIGHTGRID, 8, 8 );
+	if ( !bsp->lightGridData )
+		bsp->lightGridData = malloc( bsp->numGridPoints * 8 );
 
 	bsp->visibilityLength = GetLumpElements( &header, LUMP_VISIBILITY, 1 ) - VIS_HEADER;
-	if ( bsp->visibilityLength > 0 )
-		bsp->visibility = malloc( bsp->visibilityLength );
-	else
+	if ( bsp->visibilityLength > 0 ) {
+		bsp->visibility = BSP_MappedLump( data, header.lumps[LUMP_VISIBILITY].fileofs + VIS_HEADER, bsp->visibilityLength );
+		if ( !bsp->visibility )
+			bsp->visibility = malloc( bsp->visibilityLength );
+	} else
 		bsp->visibilityLength = 0;
 
 	//
@@ -346,7 +383,7 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_PLANES, bsp->planes ) ) {
 		realDplane_t *in = GetLump( &header, data, LUMP_PLANES );
 		dplane_t *out = bsp->planes;
 
@@ -359,7 +396,7 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_NODES, bsp->nodes ) ) {
 		realDnode_t *in = GetLump( &header, data, LUMP_NODES );
 		dnode_t *out = bsp->nodes;
 
@@ -377,7 +414,7 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_LEAFS, bsp->leafs ) ) {
 		realDleaf_t *in = GetLump( &header, data, LUMP_LEAFS );
 		dleaf_t *out = bsp->leafs;
 
@@ -397,10 +434,14 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	CopyLump( &header, LUMP_LEAFSURFACES, data, (void *) bsp->leafSurfaces, sizeof ( *bsp->leafSurfaces ), qtrue );
-	CopyLump( &header, LUMP_LEAFBRUSHES, data, (void *) bsp->leafBrushes, sizeof ( *bsp->leafBrushes ), qtrue );
+	if ( !LumpInPlace( &header, data, LUMP_LEAFSURFACES, bsp->leafSurfaces ) ) {
+		CopyLump( &header, LUMP_LEAFSURFACES, data, (void *) bsp->leafSurfaces, sizeof ( *bsp->leafSurfaces ), qtrue );
+	}
+	if ( !LumpInPlace( &header, data, LUMP_LEAFBRUSHES, bsp->leafBrushes ) ) {
+		CopyLump( &header, LUMP_LEAFBRUSHES, data, (void *) bsp->leafBrushes, sizeof ( *bsp->leafBrushes ), qtrue );
+	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_MODELS, bsp->submodels ) ) {
 		realDmodel_t *in = GetLump( &header, data, LUMP_MODELS );
 		dmodel_t *out = bsp->submodels;
 
@@ -417,7 +458,7 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_BRUSHES, bsp->brushes ) ) {
 		realDbrush_t *in = GetLump( &header, data, LUMP_BRUSHES );
 		dbrush_t *out = bsp->brushes;
 
@@ -449,7 +490,7 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	{
+	if ( !LumpInPlace( &header, data, LUMP_DRAWVERTS, bsp->drawVerts ) ) {
 		realDrawVert_t *in = GetLump( &header, data, LUMP_DRAWVERTS );
 		drawVert_t *out = bsp->drawVerts;
 
@@ -470,7 +511,9 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	CopyLump( &header, LUMP_DRAWINDEXES, data, (void *) bsp->drawIndexes, sizeof ( *bsp->drawIndexes ), qtrue );
+	if ( !LumpInPlace( &header, data, LUMP_DRAWINDEXES, bsp->drawIndexes ) ) {
+		CopyLump( &header, LUMP_DRAWINDEXES, data, (void *) bsp->drawIndexes, sizeof ( *bsp->drawIndexes ), qtrue );
+	}
 
 	{
 		realDfog_t *in = GetLump( &header, data, LUMP_FOGS );
@@ -515,8 +558,12 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		}
 	}
 
-	CopyLump( &header, LUMP_LIGHTMAPS, data, (void *) bsp->lightmapData, sizeof ( *bsp->lightmapData ), qfalse ); /* NO SWAP */
-	CopyLump( &header, LUMP_LIGHTGRID, data, (void *) bsp->lightGridData, sizeof ( *bsp->lightGridData ), qfalse ); /* NO SWAP */
+	if ( !LumpInPlace( &header, data, LUMP_LIGHTMAPS, bsp->lightmapData ) ) {
+		CopyLump( &header, LUMP_LIGHTMAPS, data, (void *) bsp->lightmapData, sizeof ( *bsp->lightmapData ), qfalse ); /* NO SWAP */
+	}
+	if ( !LumpInPlace( &header, data, LUMP_LIGHTGRID, bsp->lightGridData ) ) {
+		CopyLump( &header, LUMP_LIGHTGRID, data, (void *) bsp->lightGridData, sizeof ( *bsp->lightGridData ), qfalse ); /* NO SWAP */
+	}
 
 	if ( bsp->visibilityLength )
 	{
@@ -525,7 +572,8 @@ bspFile_t *BSP_LoadQ3( const bspFormat_t *format, const char *name, const void *
 		bsp->numClusters = LittleLong( ((int *)in)[0] );
 		bsp->clusterBytes = LittleLong( ((int *)in)[1] );
 
-		Com_Memcpy( bsp->visibility, in + VIS_HEADER, bsp->visibilityLength ); /* NO SWAP */
+		if ( bsp->visibility != in + VIS_HEADER )
+			Com_Memcpy( bsp->visibility, in + VIS_HEADER, bsp->visibilityLength ); /* NO SWAP */
 	}
 
 	return bsp;
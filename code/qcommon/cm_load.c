@@ -31,6 +31,7 @@ Suite 120, Rockville, Maryland 20850 USA.
 
 #include "cm_local.h"
 #include "bsp.h"
+#include "cm_patch.h"
 
 // to allow boxes to be treated as brush models, we allocate
 // some extra indexes along with those needed by the map
@@ -63,6 +64,10 @@ cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
 cvar_t		*cm_betterSurfaceNums;
+cvar_t		*cm_traceThreads;
+cvar_t		*cm_brushSIMD;
+cvar_t		*cm_patchCache;
+cvar_t		*cm_loadThreads;
 #endif
 
 cmodel_t	box_model;
@@ -76,6 +81,90 @@ void	CM_InitBoxHull (void);
 void	CM_FloodAreaConnections (void);
 
 
+/*
+===============================================================================
+
+					CLIP MAP MEMORY
+
+The clip map isn't allocated on the hunk so it can outlive Hunk_Clear and
+be kept when the server loads the same map again.
+
+===============================================================================
+*/
+
+#define CM_MEMORY_BLOCK_SIZE	( 1024 * 1024 )
+
+typedef struct cmMemoryBlock_s {
+	struct cmMemoryBlock_s	*next;
+	int						size;
+	int						used;
+} cmMemoryBlock_t;
+
+static cmMemoryBlock_t	*cm_memoryBlocks;
+static int				cm_memoryUsed;
+
+/*
+=================
+CM_Alloc
+
+Cleared memory that lasts until CM_ClearMap
+=================
+*/
+void *CM_Alloc( int size ) {
+	cmMemoryBlock_t	*block;
+	int				blockSize;
+	byte			*data;
+
+	size = PAD( size, 16 );
+	block = cm_memoryBlocks;
+
+	if ( !block || block->used + size > block->size ) {
+		blockSize = MAX( size, CM_MEMORY_BLOCK_SIZE );
+
+		block = malloc( PAD( sizeof( *block ), 16 ) + blockSize );
+		if ( !block ) {
+			Com_Error( ERR_DROP, "CM_Alloc: failed on allocation of %i bytes", size );
+		}
+
+		block->size = blockSize;
+		block->used = 0;
+
+		// keep filling the current block if this one will be full
+		if ( cm_memoryBlocks && size >= CM_MEMORY_BLOCK_SIZE / 4 ) {
+			block->next = cm_memoryBlocks->next;
+			cm_memoryBlocks->next = block;
+		} else {
+			block->next = cm_memoryBlocks;
+			cm_memoryBlocks = block;
+		}
+	}
+
+	data = (byte *)block + PAD( sizeof( *block ), 16 ) + block->used;
+	block->used += size;
+	cm_memoryUsed += size;
+
+	Com_Memset( data, 0, size );
+	return data;
+}
+
+/*
+=================
+CM_FreeMemory
+=================
+*/
+static void CM_FreeMemory( void ) {
+	cmMemoryBlock_t	*block, *next;
+
+	for ( block = cm_memoryBlocks; block; block = next ) {
+		next = block->next;
+		free( block );
+	}
+
+	cm_memoryBlocks = NULL;
+	cm_memoryUsed = 0;
+}
+
+
 /*
 ===============================================================================
 
@@ -114,7 +203,7 @@ void CMod_LoadSubmodels( void ) {
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no models");
-	cm.cmodels = Hunk_Alloc( count * sizeof( *cm.cmodels ), h_high );
+	cm.cmodels = CM_Alloc( count * sizeof( *cm.cmodels ) );
 	cm.numSubModels = count;
 
 	for ( i=0 ; i<count ; i++, in++)
@@ -133,14 +222,14 @@ void CMod_LoadSubmodels( void ) {
 
 		// make a "leaf" just to hold the model's brushes and surfaces
 		out->leaf.numLeafBrushes = LittleLong( in->numBrushes );
-		indexes = Hunk_Alloc( out->leaf.numLeafBrushes * 4, h_high );
+		indexes = CM_Alloc( out->leaf.numLeafBrushes * 4 );
 		out->leaf.firstLeafBrush = indexes - cm.leafbrushes;
 		for ( j = 0 ; j < out->leaf.numLeafBrushes ; j++ ) {
 			indexes[j] = LittleLong( in->firstBrush ) + j;
 		}
 
 		out->leaf.numLeafSurfaces = LittleLong( in->numSurfaces );
-		indexes = Hunk_Alloc( out->leaf.numLeafSurfaces * 4, h_high );
+		indexes = CM_Alloc( out->leaf.numLeafSurfaces * 4 );
 		out->leaf.firstLeafSurface = indexes - cm.leafsurfaces;
 		for ( j = 0 ; j < out->leaf.numLeafSurfaces ; j++ ) {
 			indexes[j] = LittleLong( in->firstSurface ) + j;
@@ -158,7 +247,9 @@ CMod_LoadNodes
 void CMod_LoadNodes( void ) {
 	dnode_t		*in;
 	int			child;
-	cNode_t		*out;
+	cPackedNode_t	*out;
+	int			*order, *stack;
+	int			numOrdered, numStack;
 	int			i, j, count;
 	
 	in = cm_bsp->nodes;
@@ -166,21 +257,69 @@ void CMod_LoadNodes( void ) {
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map has no nodes");
-	cm.nodes = Hunk_Alloc( count * sizeof( *cm.nodes ), h_high );
+	cm.packedNodes = PADP( CM_Alloc( count * sizeof( *cm.packedNodes ) + 64 ), 64 );
 	cm.numNodes = count;
 
-	out = cm.nodes;
+	for (i=0 ; i<count ; i++)
+	{
+		for (j=0 ; j<2 ; j++)
+		{
+			child = LittleLong (in[i].children[j]);
+			if ( child >= count ) {
+				Com_Error( ERR_DROP, "CMod_LoadNodes: bad child %i", child );
+			}
+		}
+	}
+
+	// number the nodes depth first from the root, front child first, so
+	// the root stays node 0.  a node can be pushed once for each parent.
+	order = Z_Malloc( count * sizeof( *order ) );
+	stack = Z_Malloc( ( count * 2 + 1 ) * sizeof( *stack ) );
+	for (i=0 ; i<count ; i++)
+		order[i] = -1;
+
+	numOrdered = 0;
+	numStack = 0;
+	stack[numStack++] = 0;
+	while ( numStack )
+	{
+		i = stack[--numStack];
+		if ( order[i] != -1 ) {
+			continue;
+		}
+		order[i] = numOrdered++;
+
+		for (j=1 ; j>=0 ; j--)
+		{
+			child = LittleLong (in[i].children[j]);
+			if ( child >= 0 && order[child] == -1 ) {
+				stack[numStack++] = child;
+			}
+		}
+	}
+
+	// nodes that can't be reached from the root go at the end
+	for (i=0 ; i<count ; i++)
+	{
+		if ( order[i] == -1 ) {
+			order[i] = numOrdered++;
+		}
+	}
 
-	for (i=0 ; i<count ; i++, out++, in++)
+	for (i=0 ; i<count ; i++, in++)
 	{
-		out->plane = cm.planes + LittleLong( in->planeNum );
+		out = &cm.packedNodes[ order[i] ];
+		out->planeNum = LittleLong( in->planeNum );
+		out->plane = cm.planes[ out->planeNum ];
 		for (j=0 ; j<2 ; j++)
 		{
 			child = LittleLong (in->children[j]);
-			out->children[j] = child;
+			out->children[j] = ( child >= 0 ) ? order[child] : child;
 		}
 	}
 
+	Z_Free( stack );
+	Z_Free( order );
 }
 
 /*
@@ -215,7 +354,7 @@ void CMod_LoadBrushes( void ) {
 	in = cm_bsp->brushes;
 	count = cm_bsp->numBrushes;
 
-	cm.brushes = Hunk_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ), h_high );
+	cm.brushes = CM_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ) );
 	cm.numBrushes = count;
 
 	out = cm.brushes;
@@ -235,6 +374,58 @@ void CMod_LoadBrushes( void ) {
 
 }
 
+/*
+=================
+CMod_CreateBrushPlanes
+
+Copy the brush side planes into groups of four so the trace code can
+test several sides at once without chasing side and plane pointers
+=================
+*/
+static void CMod_CreateBrushPlanes( void ) {
+	cbrush_t		*brush;
+	cbrushplanes_t	*out;
+	cplane_t		*plane;
+	byte			*buf;
+	int				i, j, numGroups;
+
+	numGroups = 0;
+	for ( i = 0, brush = cm.brushes; i < cm.numBrushes; i++, brush++ ) {
+		numGroups += ( brush->numsides + 3 ) / 4;
+	}
+
+	buf = CM_Alloc( numGroups * sizeof( *out ) + 15 );
+	out = (cbrushplanes_t *)( ( (intptr_t)buf + 15 ) & ~15 );
+
+	cm.maxPlaneDist = 0;
+
+	for ( i = 0, brush = cm.brushes; i < cm.numBrushes; i++, brush++ ) {
+		brush->planes = out;
+
+		for ( j = 0; j < ( brush->numsides + 3 ) / 4 * 4; j++ ) {
+			// unused sides have no normal and are far away
+			// so everything is behind them
+			if ( j >= brush->numsides ) {
+				out[j >> 2].dist[j & 3] = 1e30f;
+				continue;
+			}
+
+			plane = brush->sides[j].plane;
+
+			out[j >> 2].normal[0][j & 3] = plane->normal[0];
+			out[j >> 2].normal[1][j & 3] = plane->normal[1];
+			out[j >> 2].normal[2][j & 3] = plane->normal[2];
+			out[j >> 2].dist[j & 3] = plane->dist;
+
+			if ( fabs( plane->dist ) > cm.maxPlaneDist ) {
+				cm.maxPlaneDist = fabs( plane->dist );
+			}
+		}
+
+		out += ( brush->numsides + 3 ) / 4;
+	}
+}
+
 /*
 =================
 CMod_LoadLeafs
@@ -253,7 +444,7 @@ void CMod_LoadLeafs( void )
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no leafs");
 
-	cm.leafs = Hunk_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ), h_high );
+	cm.leafs = CM_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ) );
 	cm.numLeafs = count;
 
 	out = cm.leafs;	
@@ -272,8 +463,8 @@ void CMod_LoadLeafs( void )
 			cm.numAreas = out->area + 1;
 	}
 
-	cm.areas = Hunk_Alloc( cm.numAreas * sizeof( *cm.areas ), h_high );
-	cm.areaPortals = Hunk_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ), h_high );
+	cm.areas = CM_Alloc( cm.numAreas * sizeof( *cm.areas ) );
+	cm.areaPortals = CM_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ) );
 }
 
 /*
@@ -294,7 +485,7 @@ void CMod_LoadPlanes( void )
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no planes");
-	cm.planes = Hunk_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ), h_high );
+	cm.planes = CM_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ) );
 	cm.numPlanes = count;
 
 	out = cm.planes;	
@@ -330,7 +521,7 @@ void CMod_LoadLeafBrushes( void )
 	in = cm_bsp->leafBrushes;
 	count = cm_bsp->numLeafBrushes;
 
-	cm.leafbrushes = Hunk_Alloc( (BOX_LEAF_BRUSHES + count) * sizeof( *cm.leafbrushes ), h_high );
+	cm.leafbrushes = CM_Alloc( (BOX_LEAF_BRUSHES + count) * sizeof( *cm.leafbrushes ) );
 	cm.numLeafBrushes = count;
 
 	out = cm.leafbrushes;
@@ -355,7 +546,7 @@ void CMod_LoadLeafSurfaces( void )
 	in = cm_bsp->leafSurfaces;
 	count = cm_bsp->numLeafSurfaces;
 
-	cm.leafsurfaces = Hunk_Alloc( count * sizeof( *cm.leafsurfaces ), h_high );
+	cm.leafsurfaces = CM_Alloc( count * sizeof( *cm.leafsurfaces ) );
 	cm.numLeafSurfaces = count;
 
 	out = cm.leafsurfaces;
@@ -381,7 +572,7 @@ void CMod_LoadBrushSides ( void )
 	in = cm_bsp->brushSides;
 	count = cm_bsp->numBrushSides;
 
-	cm.brushsides = Hunk_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ), h_high );
+	cm.brushsides = CM_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ) );
 	cm.numBrushSides = count;
 
 	out = cm.brushsides;	
@@ -586,255 +777,1007 @@ static qboolean CMod_AddEdgeToBrush( const vec3_t p0, const vec3_t p1,
 
 /*
 =================
-CMod_CreateBrushSideWindings
+CMod_FreeBrushSideWindings
+
+Frees the side windings a failed CMod_CreateBrushEdges left behind
 =================
 */
-static void CMod_CreateBrushSideWindings( void )
+static void CMod_FreeBrushSideWindings( cbrush_t *brush )
+{
+	int		j;
+
+	for( j = 0; j < brush->numsides; j++ )
+	{
+		if( brush->sides[ j ].winding )
+		{
+			FreeWinding( brush->sides[ j ].winding );
+			brush->sides[ j ].winding = NULL;
+		}
+	}
+}
+
+/*
+=================
+CMod_CreateBrushEdges
+
+Chops the sides of a brush against each other and returns the unique
+edges in a malloc buffer to be passed to CMod_StoreBrushEdges.  Doesn't
+touch anything but the brush, so it can run on a job thread.  On a job
+thread failures return NULL instead of dropping, and the main thread
+builds the brush again to raise the error.
+=================
+*/
+static cbrushedge_t *CMod_CreateBrushEdges( cbrush_t *brush, qboolean onWorker )
 {
-	int						i, j, k;
+	int						j, k;
 	winding_t			*w;
 	cbrushside_t	*side, *chopSide;
 	cplane_t			*plane;
-	cbrush_t			*brush;
 	cbrushedge_t	*tempEdges;
 	int						numEdges;
-	int						edgesAlloc;
-	int						totalEdgesAlloc = 0;
-	int						totalEdges = 0;
 
-	for( i = 0; i < cm.numBrushes; i++ )
+	numEdges = 0;
+
+	// walk the list of brush sides
+	for( j = 0; j < brush->numsides; j++ )
 	{
-		brush = &cm.brushes[ i ];
-		numEdges = 0;
+		// get side and plane
+		side = &brush->sides[ j ];
+		plane = side->plane;
+
+		w = BaseWindingForPlane( plane->normal, plane->dist );
 
 		// walk the list of brush sides
-		for( j = 0; j < brush->numsides; j++ )
+		for( k = 0; k < brush->numsides && w != NULL; k++ )
 		{
-			// get side and plane
-			side = &brush->sides[ j ];
-			plane = side->plane;
-
-			w = BaseWindingForPlane( plane->normal, plane->dist );
+			chopSide = &brush->sides[ k ];
 
-			// walk the list of brush sides
-			for( k = 0; k < brush->numsides && w != NULL; k++ )
-			{
-				chopSide = &brush->sides[ k ];
+			if( chopSide == side )
+				continue;
 
-				if( chopSide == side )
-					continue;
+			if( chopSide->planeNum == ( side->planeNum ^ 1 ) )
+				continue;		// back side clipaway
 
-				if( chopSide->planeNum == ( side->planeNum ^ 1 ) )
-					continue;		// back side clipaway
+			plane = &cm.planes[ chopSide->planeNum ^ 1 ];
+			ChopWindingInPlace( &w, plane->normal, plane->dist, 0 );
+		}
 
-				plane = &cm.planes[ chopSide->planeNum ^ 1 ];
-				ChopWindingInPlace( &w, plane->normal, plane->dist, 0 );
-			}
+		if( w )
+			numEdges += w->numpoints;
 
-			if( w )
-				numEdges += w->numpoints;
+		// set side winding
+		side->winding = w;
 
-			// set side winding
-			side->winding = w;
+		// look for surface numbers
+		if ( side->winding ) {
+			side->surfaceNum = CMod_GetBestSurfaceNumForBrushSide( side );
+		}
+	}
 
-			// look for surface numbers
-			if ( side->winding ) {
-				side->surfaceNum = CMod_GetBestSurfaceNumForBrushSide( side );
-			}
+	// Allocate a temporary buffer of the maximal size
+	tempEdges = (cbrushedge_t *)malloc( sizeof( cbrushedge_t ) * ( numEdges + 1 ) );
+	if( !tempEdges )
+	{
+		if( onWorker )
+		{
+			CMod_FreeBrushSideWindings( brush );
+			return NULL;
 		}
 
-		// Allocate a temporary buffer of the maximal size
-		tempEdges = (cbrushedge_t *)Z_Malloc( sizeof( cbrushedge_t ) * numEdges );
-		brush->numEdges = 0;
+		Com_Error( ERR_FATAL, "CMod_CreateBrushEdges: failed on allocation of %i edges", numEdges );
+	}
+	brush->numEdges = 0;
 
-		// compose the points into edges
-		for( j = 0; j < brush->numsides; j++ )
-		{
-			side = &brush->sides[ j ];
+	// compose the points into edges
+	for( j = 0; j < brush->numsides; j++ )
+	{
+		side = &brush->sides[ j ];
 
-			if( side->winding )
+		if( side->winding )
+		{
+			for( k = 0; k < side->winding->numpoints - 1; k++ )
 			{
-				for( k = 0; k < side->winding->numpoints - 1; k++ )
+				if( brush->numEdges == numEdges )
 				{
-					if( brush->numEdges == numEdges )
-						Com_Error( ERR_FATAL,
-								"Insufficient memory allocated for collision map edges" );
-
-					CMod_AddEdgeToBrush( side->winding->p[ k ],
-							side->winding->p[ k + 1 ], tempEdges, &brush->numEdges );
+					if( onWorker )
+					{
+						CMod_FreeBrushSideWindings( brush );
+						free( tempEdges );
+						return NULL;
+					}
+
+					Com_Error( ERR_FATAL,
+							"Insufficient memory allocated for collision map edges" );
 				}
 
-				FreeWinding( side->winding );
-				side->winding = NULL;
+				CMod_AddEdgeToBrush( side->winding->p[ k ],
+						side->winding->p[ k + 1 ], tempEdges, &brush->numEdges );
 			}
-		}
 
-		// Allocate a buffer of the actual size
-		edgesAlloc = sizeof( cbrushedge_t ) * brush->numEdges;
-		totalEdgesAlloc += edgesAlloc;
-		brush->edges = (cbrushedge_t *)Hunk_Alloc( edgesAlloc, h_low );
-
-		// Copy temporary buffer to permanent buffer
-		Com_Memcpy( brush->edges, tempEdges, edgesAlloc );
-
-		// Free temporary buffer
-		Z_Free( tempEdges );
-
-		totalEdges += brush->numEdges;
+			FreeWinding( side->winding );
+			side->winding = NULL;
+		}
 	}
 
-	Com_DPrintf( "Allocated %d bytes for %d collision map edges...\n",
-			totalEdgesAlloc, totalEdges );
+	return tempEdges;
 }
 
 /*
 =================
-CMod_LoadEntityString
-=================
-*/
-void CMod_LoadEntityString( void ) {
-	cm.entityString = cm_bsp->entityString;
-	cm.numEntityChars = cm_bsp->entityStringLength;
-}
+CMod_StoreBrushEdges
 
-/*
-=================
-CMod_LoadVisibility
+Moves the edges from CMod_CreateBrushEdges into clip map memory,
+returns the number of bytes allocated
 =================
 */
-void CMod_LoadVisibility( void ) {
-	if ( !cm_bsp->visibilityLength ) {
-		cm.clusterBytes = ( cm.numClusters + 31 ) & ~31;
-		cm.visibility = Hunk_Alloc( cm.clusterBytes, h_high );
-		Com_Memset( cm.visibility, 255, cm.clusterBytes );
-		return;
-	}
+static int CMod_StoreBrushEdges( cbrush_t *brush, cbrushedge_t *tempEdges )
+{
+	int						edgesAlloc;
 
-	cm.vised = qtrue;
-	cm.visibility = cm_bsp->visibility;
-	cm.numClusters = cm_bsp->numClusters;
-	cm.clusterBytes = cm_bsp->clusterBytes;
-}
+	// Allocate a buffer of the actual size
+	edgesAlloc = sizeof( cbrushedge_t ) * brush->numEdges;
+	brush->edges = (cbrushedge_t *)CM_Alloc( edgesAlloc );
 
-//==================================================================
+	// Copy temporary buffer to permanent buffer
+	Com_Memcpy( brush->edges, tempEdges, edgesAlloc );
 
+	// Free temporary buffer
+	free( tempEdges );
 
-/*
-=================
-CMod_LoadPatches
-=================
-*/
-#define	MAX_PATCH_VERTS		1024
-void CMod_LoadPatches( void ) {
-	drawVert_t	*dv, *dv_p;
-	dsurface_t	*in;
-	int			count;
-	int			i, j;
-	int			c;
-	cPatch_t	*patch;
-	vec3_t		points[MAX_PATCH_VERTS];
-	int			width, height;
-	int			shaderNum;
-	int			numVertexes;
-	vec3_t		vertexes[SHADER_MAX_VERTEXES];
-	int			numIndexes, *drawIndexes, *index_p;
-	int			indexes[SHADER_MAX_INDEXES];
+	return edgesAlloc;
+}
 
-	in = cm_bsp->surfaces;
-	cm.numSurfaces = count = cm_bsp->numSurfaces;
-	cm.surfaces = Hunk_Alloc( cm.numSurfaces * sizeof( cm.surfaces[0] ), h_high );
+#define	MAX_PATCH_VERTS		1024
 
-	dv = cm_bsp->drawVerts;
-	drawIndexes = cm_bsp->drawIndexes;
+#ifndef BSPC
+/*
+===============================================================================
 
-	// scan through all the surfaces, but only load patches,
-	// not planar faces
-	for ( i = 0 ; i < count ; i++, in++ ) {
+PARALLEL LOADING
 
-		if ( LittleLong( in->surfaceType ) == MST_TERRAIN ) {
-			cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
+Brush edges and patch collision only read the planes, brushes and the
+bsp, so with cm_loadThreads set they are built together on job threads
+and moved into clip map memory by the usual load functions afterwards.
 
-			// load the full drawverts onto the stack
-			numVertexes = LittleLong( in->numVerts );
-			if ( numVertexes > SHADER_MAX_VERTEXES ) {
-				Com_Error(ERR_DROP, "CMod_LoadPatches: SHADER_MAX_VERTEXES");
-			}
+===============================================================================
+*/
 
-			dv_p = dv + LittleLong( in->firstVert );
-			for ( j = 0; j < numVertexes ; j++, dv_p++ ) {
-				vertexes[j][0] = LittleFloat( dv_p->xyz[0] );
-				vertexes[j][1] = LittleFloat( dv_p->xyz[1] );
-				vertexes[j][2] = LittleFloat( dv_p->xyz[2] );
-			}
+#define	BRUSHES_PER_LOAD_JOB	64
 
-			numIndexes = LittleLong( in->numIndexes );
-			if ( numIndexes > SHADER_MAX_INDEXES ) {
-				Com_Error(ERR_DROP, "CMod_LoadPatches: SHADER_MAX_INDEXES");
-			}
+typedef struct {
+	int				numPatchJobs;
+	int				numBrushJobs;
 
-			index_p = drawIndexes + LittleLong( in->firstIndex );
-			for ( j = 0; j < numIndexes ; j++, index_p++ ) {
-				indexes[j] = LittleLong( *index_p );
+	int				numPatchSurfaces;
+	int				*patchSurfaces;		// MST_PATCH surface numbers
+	patchCollide_t	**builtPatches;		// [numSurfaces], NULL if it must be generated on the main thread
 
-				if ( indexes[j] < 0 || indexes[j] >= numVertexes ) {
-					Com_Error(ERR_DROP, "CMod_LoadPatches: Bad index in trisoup surface");
-				}
-			}
+	int				numBrushes;
+	cbrushedge_t	**builtEdges;		// [numBrushes]
+} cmLoadJobs_t;
 
-			shaderNum = LittleLong( in->shaderNum );
-			patch->contents = cm.shaders[shaderNum].contentFlags;
-			patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+static cmLoadJobs_t	cm_loadJobs;
 
-			// create the internal facet structure
-			patch->pc = CM_GenerateTriangleSoupCollide( numVertexes, vertexes, numIndexes, indexes );
-			continue;
-		}
+/*
+=================
+CMod_LoadPatchJob
 
-		if ( LittleLong( in->surfaceType ) != MST_PATCH ) {
-			continue;		// ignore other surfaces
-		}
-		// FIXME: check for non-colliding patches
+Builds every numPatchJobs'th patch with a patchWork_t of its own
+=================
+*/
+static void CMod_LoadPatchJob( int jobNum ) {
+	cmLoadJobs_t	*jobs = &cm_loadJobs;
+	patchWork_t		*pw;
+	dsurface_t		*in;
+	drawVert_t		*dv_p;
+	vec3_t			points[MAX_PATCH_VERTS];
+	int				width, height;
+	int				i, j, c;
+
+	pw = malloc( sizeof( *pw ) );
+	if ( !pw ) {
+		return;
+	}
 
-		cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
+	for ( i = jobNum ; i < jobs->numPatchSurfaces ; i += jobs->numPatchJobs ) {
+		in = &cm_bsp->surfaces[ jobs->patchSurfaces[i] ];
 
-		// load the full drawverts onto the stack
 		width = LittleLong( in->patchWidth );
 		height = LittleLong( in->patchHeight );
 		c = width * height;
 		if ( c > MAX_PATCH_VERTS ) {
-			Com_Error( ERR_DROP, "ParseMesh: MAX_PATCH_VERTS" );
+			continue;
 		}
 
-		dv_p = dv + LittleLong( in->firstVert );
+		dv_p = cm_bsp->drawVerts + LittleLong( in->firstVert );
 		for ( j = 0 ; j < c ; j++, dv_p++ ) {
 			points[j][0] = LittleFloat( dv_p->xyz[0] );
 			points[j][1] = LittleFloat( dv_p->xyz[1] );
 			points[j][2] = LittleFloat( dv_p->xyz[2] );
 		}
 
-		shaderNum = LittleLong( in->shaderNum );
-		patch->contents = cm.shaders[shaderNum].contentFlags;
-		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
-
-		// create the internal facet structure
-		patch->pc = CM_GeneratePatchCollide( width, height, points, LittleFloat( in->subdivisions ) );
+		jobs->builtPatches[ jobs->patchSurfaces[i] ] = CM_BuildPatchCollide( pw, width, height, points, LittleFloat( in->subdivisions ) );
 	}
+
+	free( pw );
 }
 
-//==================================================================
+/*
+=================
+CMod_LoadBrushJob
+=================
+*/
+static void CMod_LoadBrushJob( int jobNum ) {
+	int		i, end;
+
+	i = jobNum * BRUSHES_PER_LOAD_JOB;
+	end = i + BRUSHES_PER_LOAD_JOB;
+	if ( end > cm.numBrushes ) {
+		end = cm.numBrushes;
+	}
+
+	for ( ; i < end ; i++ ) {
+		cm_loadJobs.builtEdges[i] = CMod_CreateBrushEdges( &cm.brushes[i], qtrue );
+	}
+}
 
 /*
-==================
-CM_LoadMap
+=================
+CMod_LoadJob
 
-Loads in the map and all submodels
-==================
+Patch jobs go first as they take the longest
+=================
 */
-void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
-	static unsigned	last_checksum;
+static void CMod_LoadJob( void *data, int jobNum ) {
+	cmLoadJobs_t	*jobs = data;
 
-	if ( !name || !name[0] ) {
-		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
+	if ( jobNum < jobs->numPatchJobs ) {
+		CMod_LoadPatchJob( jobNum );
+	} else {
+		CMod_LoadBrushJob( jobNum - jobs->numPatchJobs );
+	}
+}
+
+/*
+=================
+CMod_BrushEdgesSafeOnJobs
+
+Brushes that would make the winding code drop are left to the main thread
+=================
+*/
+static qboolean CMod_BrushEdgesSafeOnJobs( void ) {
+	cbrush_t	*brush;
+	float		*normal;
+	int			i, j;
+
+	for ( i = 0, brush = cm.brushes ; i < cm.numBrushes ; i++, brush++ ) {
+		// each chop adds at most one point to the base winding's four
+		if ( brush->numsides > MAX_POINTS_ON_WINDING - 4 ) {
+			return qfalse;
+		}
+
+		for ( j = 0 ; j < brush->numsides ; j++ ) {
+			normal = brush->sides[j].plane->normal;
+			if ( Q_isnan( normal[0] ) || Q_isnan( normal[1] ) || Q_isnan( normal[2] ) ) {
+				return qfalse;
+			}
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+CMod_RunLoadJobs
+
+Builds the brush edges, and the patches if they weren't read from the
+cache, on cm_loadThreads worker threads
+=================
+*/
+static void CMod_RunLoadJobs( qboolean patches ) {
+	cmLoadJobs_t	*jobs = &cm_loadJobs;
+	int				numWorkers;
+	int				i;
+
+	numWorkers = cm_loadThreads->integer;
+	if ( numWorkers <= 0 ) {
+		return;
+	}
+
+	Com_Memset( jobs, 0, sizeof( *jobs ) );
+
+	if ( patches ) {
+		jobs->patchSurfaces = Z_Malloc( cm.numSurfaces * sizeof( *jobs->patchSurfaces ) );
+		for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+			if ( LittleLong( cm_bsp->surfaces[i].surfaceType ) == MST_PATCH ) {
+				jobs->patchSurfaces[ jobs->numPatchSurfaces++ ] = i;
+			}
+		}
+
+		if ( jobs->numPatchSurfaces ) {
+			jobs->builtPatches = Z_Malloc( cm.numSurfaces * sizeof( *jobs->builtPatches ) );
+			jobs->numPatchJobs = MIN( numWorkers + 1, jobs->numPatchSurfaces );
+		}
+	}
+
+	if ( cm.numBrushes && CMod_BrushEdgesSafeOnJobs() ) {
+		jobs->numBrushes = cm.numBrushes;
+		jobs->builtEdges = Z_Malloc( cm.numBrushes * sizeof( *jobs->builtEdges ) );
+		jobs->numBrushJobs = ( cm.numBrushes + BRUSHES_PER_LOAD_JOB - 1 ) / BRUSHES_PER_LOAD_JOB;
+	}
+
+	if ( jobs->numPatchJobs + jobs->numBrushJobs > 0 ) {
+		Com_RunJobs( CMod_LoadJob, jobs, jobs->numPatchJobs + jobs->numBrushJobs, numWorkers );
+	}
+}
+
+/*
+=================
+CMod_TakeBuiltPatch
+
+Returns the patch a load job built for the surface, or NULL
+=================
+*/
+static patchCollide_t *CMod_TakeBuiltPatch( int surfaceNum ) {
+	patchCollide_t	*built;
+
+	if ( !cm_loadJobs.builtPatches ) {
+		return NULL;
+	}
+
+	built = cm_loadJobs.builtPatches[ surfaceNum ];
+	cm_loadJobs.builtPatches[ surfaceNum ] = NULL;
+	return built;
+}
+
+/*
+=================
+CMod_TakeBuiltBrushEdges
+
+Returns the edges a load job built for the brush, or NULL
+=================
+*/
+static cbrushedge_t *CMod_TakeBuiltBrushEdges( int brushNum ) {
+	cbrushedge_t	*built;
+
+	if ( !cm_loadJobs.builtEdges ) {
+		return NULL;
+	}
+
+	built = cm_loadJobs.builtEdges[ brushNum ];
+	cm_loadJobs.builtEdges[ brushNum ] = NULL;
+	return built;
+}
+
+/*
+=================
+CMod_FreeLoadJobs
+
+Also frees whatever wasn't taken if the load dropped part way
+=================
+*/
+static void CMod_FreeLoadJobs( void ) {
+	cmLoadJobs_t	*jobs = &cm_loadJobs;
+	int				i;
+
+	if ( jobs->builtPatches ) {
+		for ( i = 0 ; i < jobs->numPatchSurfaces ; i++ ) {
+			free( jobs->builtPatches[ jobs->patchSurfaces[i] ] );
+		}
+		Z_Free( jobs->builtPatches );
+	}
+
+	if ( jobs->patchSurfaces ) {
+		Z_Free( jobs->patchSurfaces );
+	}
+
+	if ( jobs->builtEdges ) {
+		for ( i = 0 ; i < jobs->numBrushes ; i++ ) {
+			free( jobs->builtEdges[i] );
+		}
+		Z_Free( jobs->builtEdges );
+	}
+
+	Com_Memset( jobs, 0, sizeof( *jobs ) );
+}
+#endif
+
+/*
+=================
+CMod_CreateBrushSideWindings
+=================
+*/
+static void CMod_CreateBrushSideWindings( void )
+{
+	int						i;
+	cbrush_t			*brush;
+	cbrushedge_t	*tempEdges;
+	int						totalEdgesAlloc = 0;
+	int						totalEdges = 0;
+
+	for( i = 0; i < cm.numBrushes; i++ )
+	{
+		brush = &cm.brushes[ i ];
+
+#ifndef BSPC
+		// may have been made by a load job, if it failed the brush is
+		// built again here to report the error
+		tempEdges = CMod_TakeBuiltBrushEdges( i );
+		if( !tempEdges )
+#endif
+			tempEdges = CMod_CreateBrushEdges( brush, qfalse );
+
+		totalEdgesAlloc += CMod_StoreBrushEdges( brush, tempEdges );
+		totalEdges += brush->numEdges;
+	}
+
+	Com_DPrintf( "Allocated %d bytes for %d collision map edges...\n",
+			totalEdgesAlloc, totalEdges );
+}
+
+/*
+=================
+CMod_LoadEntityString
+=================
+*/
+void CMod_LoadEntityString( void ) {
+	cm.entityString = cm_bsp->entityString;
+	cm.numEntityChars = cm_bsp->entityStringLength;
+}
+
+/*
+=================
+CMod_LoadVisibility
+=================
+*/
+void CMod_LoadVisibility( void ) {
+	if ( !cm_bsp->visibilityLength ) {
+		cm.clusterBytes = ( cm.numClusters + 31 ) & ~31;
+		cm.visibility = CM_Alloc( cm.clusterBytes );
+		Com_Memset( cm.visibility, 255, cm.clusterBytes );
+		return;
+	}
+
+	cm.vised = qtrue;
+	cm.visibility = cm_bsp->visibility;
+	cm.numClusters = cm_bsp->numClusters;
+	cm.clusterBytes = cm_bsp->clusterBytes;
+}
+
+//==================================================================
+
+
+#ifndef BSPC
+/*
+===============================================================================
+
+PATCH COLLISION CACHE
+
+Generating the facets and planes for curves and terrain is a large part of
+loading curve heavy maps, so they are saved to maps/<map>.pcc keyed by the
+bsp checksum.  The cached structures are all 32 bit words, so the file is read
+in one block and the patches use it in place.
+
+===============================================================================
+*/
+
+#define	PATCH_CACHE_IDENT		(('H'<<24)+('C'<<16)+('C'<<8)+'P')		// little endian "PCCH"
+#define	PATCH_CACHE_VERSION		1
+
+typedef struct {
+	int			ident;
+	int			version;
+	int			checksum;		// of the bsp
+	int			numSurfaces;
+	int			numPatches;
+	int			dataWords;		// everything after the header
+} patchCacheHeader_t;
+
+// one per patch in surface order, followed by its planes and facets
+typedef struct {
+	int			surfaceNum;
+	float		bounds[2][3];
+	int			numPlanes;
+	int			numFacets;
+} patchCacheSurface_t;
+
+/*
+=================
+CMod_PatchCacheName
+=================
+*/
+static void CMod_PatchCacheName( const char *mapName, char *cacheName, int size ) {
+	COM_StripExtension( mapName, cacheName, size );
+	Q_strcat( cacheName, size, ".pcc" );
+}
+
+/*
+=================
+CMod_SwapPatchCache
+
+Everything in the cache is 32 bit words, so it can be swapped in place
+=================
+*/
+static void CMod_SwapPatchCache( void *data, int numWords ) {
+#ifdef Q3_BIG_ENDIAN
+	int		*words = data;
+	int		i;
+
+	for ( i = 0 ; i < numWords ; i++ ) {
+		words[i] = LongSwap( words[i] );
+	}
+#endif
+}
+
+/*
+=================
+CMod_IsPatchSurface
+=================
+*/
+static qboolean CMod_IsPatchSurface( const dsurface_t *surface ) {
+	return ( surface->surfaceType == MST_PATCH || surface->surfaceType == MST_TERRAIN );
+}
+
+/*
+=================
+CMod_ValidCachedFacet
+=================
+*/
+static qboolean CMod_ValidCachedFacet( const facet_t *facet, int numPlanes ) {
+	int		i;
+
+	if ( facet->surfacePlane < 0 || facet->surfacePlane >= numPlanes ) {
+		return qfalse;
+	}
+	if ( facet->numBorders < 0 || facet->numBorders > ARRAY_LEN( facet->borderPlanes ) ) {
+		return qfalse;
+	}
+	for ( i = 0 ; i < facet->numBorders ; i++ ) {
+		if ( facet->borderPlanes[i] < 0 || facet->borderPlanes[i] >= numPlanes ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+=================
+CMod_ParsePatchCache
+
+Walks the swapped cache data, only creating the patches if store is set.
+Returns qfalse if the data is corrupt.
+=================
+*/
+static qboolean CMod_ParsePatchCache( byte *data, byte *end, int numPatches, qboolean store ) {
+	patchCacheSurface_t	*surface;
+	patchCollide_t		*pc;
+	dsurface_t			*in;
+	cPatch_t			*patch;
+	patchPlane_t		*planes;
+	facet_t				*facets;
+	int					lastSurface;
+	int					i, j;
+
+	lastSurface = -1;
+	for ( i = 0 ; i < numPatches ; i++ ) {
+		surface = (patchCacheSurface_t *)data;
+		if ( end - data < sizeof( *surface ) ) {
+			return qfalse;
+		}
+		data += sizeof( *surface );
+
+		if ( surface->surfaceNum <= lastSurface || surface->surfaceNum >= cm.numSurfaces
+			|| !CMod_IsPatchSurface( &cm_bsp->surfaces[surface->surfaceNum] )
+			|| surface->numPlanes < 0 || surface->numPlanes > MAX_PATCH_PLANES
+			|| surface->numFacets < 0 || surface->numFacets > MAX_FACETS
+			|| end - data < surface->numPlanes * sizeof( patchPlane_t ) + surface->numFacets * sizeof( facet_t ) ) {
+			return qfalse;
+		}
+		lastSurface = surface->surfaceNum;
+
+		planes = (patchPlane_t *)data;
+		data += surface->numPlanes * sizeof( patchPlane_t );
+		facets = (facet_t *)data;
+		data += surface->numFacets * sizeof( facet_t );
+
+		if ( !store ) {
+			// the collision code trusts the plane numbers and signbits
+			for ( j = 0 ; j < surface->numPlanes ; j++ ) {
+				if ( planes[j].signbits < 0 || planes[j].signbits > 7 ) {
+					return qfalse;
+				}
+			}
+			for ( j = 0 ; j < surface->numFacets ; j++ ) {
+				if ( !CMod_ValidCachedFacet( &facets[j], surface->numPlanes ) ) {
+					return qfalse;
+				}
+			}
+			continue;
+		}
+
+		pc = CM_Alloc( sizeof( *pc ) );
+		VectorCopy( surface->bounds[0], pc->bounds[0] );
+		VectorCopy( surface->bounds[1], pc->bounds[1] );
+		pc->numPlanes = surface->numPlanes;
+		pc->planes = planes;
+		pc->numFacets = surface->numFacets;
+		pc->facets = facets;
+
+		in = &cm_bsp->surfaces[surface->surfaceNum];
+		cm.surfaces[surface->surfaceNum] = patch = CM_Alloc( sizeof( *patch ) );
+		patch->contents = cm.shaders[in->shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[in->shaderNum].surfaceFlags;
+		patch->pc = pc;
+	}
+
+	return data == end;
+}
+
+/*
+=================
+CMod_LoadPatchCache
+
+Returns qfalse if the cache is missing or doesn't match the map,
+the patches are generated instead.  The cache is read into a temporary
+buffer and only moved into clip map memory once it has been checked.
+=================
+*/
+static qboolean CMod_LoadPatchCache( const char *cacheName ) {
+	patchCacheHeader_t	header;
+	fileHandle_t		f;
+	byte				*buffer, *data;
+	long				len;
+	int					dataSize, numPatches;
+	int					i;
+
+	len = FS_FOpenFileRead( cacheName, &f, qtrue );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	if ( len < sizeof( header ) || FS_Read( &header, sizeof( header ), f ) != sizeof( header ) ) {
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+	CMod_SwapPatchCache( &header, sizeof( header ) / 4 );
+
+	for ( numPatches = 0, i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( CMod_IsPatchSurface( &cm_bsp->surfaces[i] ) ) {
+			numPatches++;
+		}
+	}
+
+	if ( header.ident != PATCH_CACHE_IDENT || header.version != PATCH_CACHE_VERSION
+		|| header.checksum != cm.checksum || header.numSurfaces != cm.numSurfaces
+		|| header.numPatches != numPatches || header.dataWords < 0
+		|| len != sizeof( header ) + header.dataWords * 4 ) {
+		Com_Printf( "%s doesn't match the map, regenerating patch collision\n", cacheName );
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+
+	dataSize = header.dataWords * 4;
+	buffer = malloc( dataSize + 1 );
+	if ( !buffer ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: couldn't allocate %i bytes for %s\n", dataSize, cacheName );
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+
+	if ( FS_Read( buffer, dataSize, f ) != dataSize ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: couldn't read %s\n", cacheName );
+		FS_FCloseFile( f );
+		free( buffer );
+		return qfalse;
+	}
+	FS_FCloseFile( f );
+
+	CMod_SwapPatchCache( buffer, header.dataWords );
+
+	if ( !CMod_ParsePatchCache( buffer, buffer + dataSize, numPatches, qfalse ) ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: %s is corrupt, regenerating patch collision\n", cacheName );
+		free( buffer );
+		return qfalse;
+	}
+
+	data = CM_Alloc( dataSize );
+	Com_Memcpy( data, buffer, dataSize );
+	free( buffer );
+
+	CMod_ParsePatchCache( data, data + dataSize, numPatches, qtrue );
+	return qtrue;
+}
+
+/*
+=================
+CMod_WritePatchCacheWords
+=================
+*/
+static void CMod_WritePatchCacheWords( fileHandle_t f, const void *data, int numWords ) {
+#ifdef Q3_BIG_ENDIAN
+	const int	*words = data;
+	int			swapped[256];
+	int			i, n;
+
+	while ( numWords > 0 ) {
+		n = MIN( numWords, ARRAY_LEN( swapped ) );
+		for ( i = 0 ; i < n ; i++ ) {
+			swapped[i] = LongSwap( words[i] );
+		}
+		FS_Write( swapped, n * 4, f );
+		words += n;
+		numWords -= n;
+	}
+#else
+	FS_Write( data, numWords * 4, f );
+#endif
+}
+
+/*
+=================
+CMod_WritePatchCache
+=================
+*/
+static void CMod_WritePatchCache( const char *cacheName ) {
+	patchCacheHeader_t	header;
+	patchCacheSurface_t	surface;
+	patchCollide_t		*pc;
+	fileHandle_t		f;
+	int					i;
+
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.ident = PATCH_CACHE_IDENT;
+	header.version = PATCH_CACHE_VERSION;
+	header.checksum = cm.checksum;
+	header.numSurfaces = cm.numSurfaces;
+
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+		header.numPatches++;
+		header.dataWords += ( sizeof( surface ) + pc->numPlanes * sizeof( patchPlane_t ) + pc->numFacets * sizeof( facet_t ) ) / 4;
+	}
+
+	f = FS_FOpenFileWrite( cacheName );
+	if ( !f ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: couldn't write %s\n", cacheName );
+		return;
+	}
+
+	CMod_WritePatchCacheWords( f, &header, sizeof( header ) / 4 );
+
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+
+		surface.surfaceNum = i;
+		VectorCopy( pc->bounds[0], surface.bounds[0] );
+		VectorCopy( pc->bounds[1], surface.bounds[1] );
+		surface.numPlanes = pc->numPlanes;
+		surface.numFacets = pc->numFacets;
+
+		CMod_WritePatchCacheWords( f, &surface, sizeof( surface ) / 4 );
+		CMod_WritePatchCacheWords( f, pc->planes, pc->numPlanes * sizeof( patchPlane_t ) / 4 );
+		CMod_WritePatchCacheWords( f, pc->facets, pc->numFacets * sizeof( facet_t ) / 4 );
+	}
+
+	FS_FCloseFile( f );
+}
+#endif
+
+/*
+=================
+CMod_GeneratePatches
+=================
+*/
+static void CMod_GeneratePatches( void ) {
+	drawVert_t	*dv, *dv_p;
+	dsurface_t	*in;
+	int			count;
+	int			i, j;
+	int			c;
+	cPatch_t	*patch;
+	vec3_t		points[MAX_PATCH_VERTS];
+	int			width, height;
+	int			shaderNum;
+	int			numVertexes;
+	vec3_t		vertexes[SHADER_MAX_VERTEXES];
+	int			numIndexes, *drawIndexes, *index_p;
+	int			indexes[SHADER_MAX_INDEXES];
+
+	in = cm_bsp->surfaces;
+	count = cm.numSurfaces;
+
+	dv = cm_bsp->drawVerts;
+	drawIndexes = cm_bsp->drawIndexes;
+
+	// scan through all the surfaces, but only load patches,
+	// not planar faces
+	for ( i = 0 ; i < count ; i++, in++ ) {
+
+		if ( LittleLong( in->surfaceType ) == MST_TERRAIN ) {
+			cm.surfaces[ i ] = patch = CM_Alloc( sizeof( *patch ) );
+
+			// load the full drawverts onto the stack
+			numVertexes = LittleLong( in->numVerts );
+			if ( numVertexes > SHADER_MAX_VERTEXES ) {
+				Com_Error(ERR_DROP, "CMod_LoadPatches: SHADER_MAX_VERTEXES");
+			}
+
+			dv_p = dv + LittleLong( in->firstVert );
+			for ( j = 0; j < numVertexes ; j++, dv_p++ ) {
+				vertexes[j][0] = LittleFloat( dv_p->xyz[0] );
+				vertexes[j][1] = LittleFloat( dv_p->xyz[1] );
+				vertexes[j][2] = LittleFloat( dv_p->xyz[2] );
+			}
+
+			numIndexes = LittleLong( in->numIndexes );
+			if ( numIndexes > SHADER_MAX_INDEXES ) {
+				Com_Error(ERR_DROP, "CMod_LoadPatches: SHADER_MAX_INDEXES");
+			}
+
+			index_p = drawIndexes + LittleLong( in->firstIndex );
+			for ( j = 0; j < numIndexes ; j++, index_p++ ) {
+				indexes[j] = LittleLong( *index_p );
+
+				if ( indexes[j] < 0 || indexes[j] >= numVertexes ) {
+					Com_Error(ERR_DROP, "CMod_LoadPatches: Bad index in trisoup surface");
+				}
+			}
+
+			shaderNum = LittleLong( in->shaderNum );
+			patch->contents = cm.shaders[shaderNum].contentFlags;
+			patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+
+			// create the internal facet structure
+			patch->pc = CM_GenerateTriangleSoupCollide( numVertexes, vertexes, numIndexes, indexes );
+			continue;
+		}
+
+		if ( LittleLong( in->surfaceType ) != MST_PATCH ) {
+			continue;		// ignore other surfaces
+		}
+		// FIXME: check for non-colliding patches
+
+		cm.surfaces[ i ] = patch = CM_Alloc( sizeof( *patch ) );
+
+		// load the full drawverts onto the stack
+		width = LittleLong( in->patchWidth );
+		height = LittleLong( in->patchHeight );
+		c = width * height;
+		if ( c > MAX_PATCH_VERTS ) {
+			Com_Error( ERR_DROP, "ParseMesh: MAX_PATCH_VERTS" );
+		}
+
+		dv_p = dv + LittleLong( in->firstVert );
+		for ( j = 0 ; j < c ; j++, dv_p++ ) {
+			points[j][0] = LittleFloat( dv_p->xyz[0] );
+			points[j][1] = LittleFloat( dv_p->xyz[1] );
+			points[j][2] = LittleFloat( dv_p->xyz[2] );
+		}
+
+		shaderNum = LittleLong( in->shaderNum );
+		patch->contents = cm.shaders[shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+
+		// create the internal facet structure
+#ifndef BSPC
+		// may have been built by a load job
+		patch->pc = CMod_TakeBuiltPatch( i );
+		if ( patch->pc ) {
+			patch->pc = CM_StorePatchCollide( patch->pc );
+			continue;
+		}
+#endif
+		patch->pc = CM_GeneratePatchCollide( width, height, points, LittleFloat( in->subdivisions ) );
+	}
+}
+
+/*
+=================
+CMod_LoadPatches
+
+Returns qtrue if the patches were read from the cache
+=================
+*/
+qboolean CMod_LoadPatches( const char *name ) {
+#ifndef BSPC
+	char		cacheName[MAX_QPATH];
+#endif
+
+	cm.numSurfaces = cm_bsp->numSurfaces;
+	cm.surfaces = CM_Alloc( cm.numSurfaces * sizeof( cm.surfaces[0] ) );
+
+#ifndef BSPC
+	CMod_PatchCacheName( name, cacheName, sizeof( cacheName ) );
+
+	if ( cm_patchCache->integer && CMod_LoadPatchCache( cacheName ) ) {
+		// still run the brush edges on the workers
+		CMod_RunLoadJobs( qfalse );
+		return qtrue;
+	}
+
+	CMod_RunLoadJobs( qtrue );
+	CMod_GeneratePatches();
+
+	if ( cm_patchCache->integer ) {
+		CMod_WritePatchCache( cacheName );
+	}
+#else
+	CMod_GeneratePatches();
+#endif
+
+	return qfalse;
+}
+
+//==================================================================
+
+#ifndef BSPC
+/*
+==================
+CM_ReuseMap
+
+Keeps the clip map when the server loads the same map again and the bsp
+hasn't changed, only the area portal state is reset.  Otherwise the bsp
+that was loaded for the check is returned in loaded for the full load.
+==================
+*/
+static qboolean CM_ReuseMap( const char *name, bspFile_t **loaded ) {
+	bspFile_t	*bsp;
+	int			fileLength, fileHash;
+
+	bsp = cm_bsp;
+	if ( !bsp ) {
+		*loaded = NULL;
+		return qfalse;
+	}
+
+	// a changed file is freed and parsed again, possibly at the same
+	// address, so reuse is decided by the file the bsp was parsed from
+	fileLength = bsp->fileLength;
+	fileHash = bsp->fileHash;
+
+	// drop the clip map's reference so the bsp is checked against the file
+	cm_bsp = NULL;
+	BSP_Free( bsp );
+
+	*loaded = BSP_Load( name );
+	if ( !*loaded || ( *loaded )->fileLength != fileLength || ( *loaded )->fileHash != fileHash ) {
+		return qfalse;
+	}
+
+	cm_bsp = *loaded;
+	*loaded = NULL;
+
+	Com_Memset( cm.areaPortals, 0, cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ) );
+	CM_FloodAreaConnections();
+	CM_ClearLevelPatches();
+	return qtrue;
+}
+#endif
+
+/*
+==================
+CM_LoadMap
+
+Loads in the map and all submodels
+==================
+*/
+void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
+	static unsigned	last_checksum;
+	bspFile_t		*bsp = NULL;
+#ifndef BSPC
+	int				startMsec, patchMsec;
+	qboolean		patchesCached;
+#endif
+
+	if ( !name || !name[0] ) {
+		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
 	}
 
 #ifndef BSPC
@@ -842,6 +1785,12 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
 	cm_betterSurfaceNums = Cvar_Get ("cm_betterSurfaceNums", "0", CVAR_LATCH );
+	cm_traceThreads = Cvar_Get ("cm_traceThreads", "0", CVAR_ARCHIVE );
+	Cvar_CheckRange( cm_traceThreads, 0, MAX_WORKER_THREADS, qtrue );
+	cm_brushSIMD = Cvar_Get ("cm_brushSIMD", "1", 0 );
+	cm_patchCache = Cvar_Get ("cm_patchCache", "1", CVAR_ARCHIVE );
+	cm_loadThreads = Cvar_Get ("cm_loadThreads", "0", CVAR_ARCHIVE );
+	Cvar_CheckRange( cm_loadThreads, 0, MAX_WORKER_THREADS, qtrue );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -850,6 +1799,18 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 		return;
 	}
 
+#ifndef BSPC
+	if ( !strcmp( cm.name, name ) ) {
+		startMsec = Sys_Milliseconds();
+
+		if ( CM_ReuseMap( name, &bsp ) ) {
+			*checksum = last_checksum;
+			Com_Printf( "CM_LoadMap: %s unchanged, reused clip map in %i msec\n", name, Sys_Milliseconds() - startMsec );
+			return;
+		}
+	}
+#endif
+
 	// free old stuff
 	CM_ClearMap();
 
@@ -857,12 +1818,20 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 		cm.numLeafs = 1;
 		cm.numClusters = 1;
 		cm.numAreas = 1;
-		cm.cmodels = Hunk_Alloc( sizeof( *cm.cmodels ), h_high );
+		cm.cmodels = CM_Alloc( sizeof( *cm.cmodels ) );
 		*checksum = 0;
 		return;
 	}
 
-	cm_bsp = BSP_Load( name );
+#ifndef BSPC
+	startMsec = Sys_Milliseconds();
+#endif
+
+	// CM_ReuseMap may have loaded it already
+	if ( !bsp ) {
+		bsp = BSP_Load( name );
+	}
+	cm_bsp = bsp;
 
 	if ( !cm_bsp ) {
 		Com_Error (ERR_DROP, "Couldn't load %s", name);
@@ -870,6 +1839,10 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 
 	last_checksum = cm_bsp->checksum;
 	*checksum = last_checksum;
+	cm.checksum = last_checksum;
+#ifndef BSPC
+	Com_LoadStage( "bsp" );
+#endif
 
 	// load into heap
 	CMod_LoadShaders();
@@ -879,22 +1852,49 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	CMod_LoadPlanes();
 	CMod_LoadBrushSides();
 	CMod_LoadBrushes();
+	CMod_CreateBrushPlanes();
 	CMod_LoadSubmodels();
 	CMod_LoadNodes();
 	CMod_LoadEntityString();
 	CMod_LoadVisibility();
-	CMod_LoadPatches();
+#ifndef BSPC
+	Com_LoadStage( "clip map" );
+	patchMsec = Sys_Milliseconds();
+	patchesCached = CMod_LoadPatches( name );
+	patchMsec = Sys_Milliseconds() - patchMsec;
+#else
+	CMod_LoadPatches( name );
+#endif
 
 	CMod_CreateBrushSideWindings();
+#ifndef BSPC
+	CMod_FreeLoadJobs();
+	Com_LoadStage( "patches and brush edges" );
+#endif
 
 	CM_InitBoxHull ();
 
 	CM_FloodAreaConnections ();
+#ifndef BSPC
+	Com_LoadStage( "area flood" );
+#endif
+
+	cm.traceContext.numBrushes = cm.numBrushes + BOX_BRUSHES;
+	cm.traceContext.brushChecks = CM_Alloc( cm.traceContext.numBrushes * sizeof( int ) );
+	cm.traceContext.brushCollided = CM_Alloc( cm.traceContext.numBrushes * sizeof( qboolean ) );
+	cm.traceContext.numSurfaces = cm.numSurfaces;
+	cm.traceContext.surfaceChecks = CM_Alloc( cm.numSurfaces * sizeof( int ) );
 
 	// allow this to be cached if it is loaded by the server
 	if ( !clientload ) {
 		Q_strncpyz( cm.name, name, sizeof( cm.name ) );
 	}
+
+#ifndef BSPC
+	Com_Printf( "CM_LoadMap: %s in %i msec, patch collision %s in %i msec%s, %i KB\n", name,
+		Sys_Milliseconds() - startMsec, patchesCached ? "read from cache" : "generated", patchMsec,
+		cm_loadThreads->integer > 0 ? " (with brush edges)" : "", cm_memoryUsed / 1024 );
+#endif
 }
 
 /*
@@ -903,10 +1903,60 @@ CM_ClearMap
 ==================
 */
 void CM_ClearMap( void ) {
+#ifndef BSPC
+	CM_ShutdownTraceBatch();
+	CMod_FreeLoadJobs();
+#endif
 	BSP_Free( cm_bsp );
 	cm_bsp = NULL;
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
+	CM_FreeMemory();
+}
+
+/*
+==================
+CM_AllocTraceContext
+
+Must be freed before the map is cleared
+==================
+*/
+traceContext_t *CM_AllocTraceContext( void ) {
+	traceContext_t	*ctx;
+	byte			*buf;
+	int				numBrushes, numSurfaces;
+
+	numBrushes = cm.traceContext.numBrushes;
+	numSurfaces = cm.traceContext.numSurfaces;
+
+	buf = Z_Malloc( sizeof( *ctx ) + numBrushes * ( sizeof( int ) + sizeof( qboolean ) ) + numSurfaces * sizeof( int ) );
+	Com_Memset( buf, 0, sizeof( *ctx ) );
+
+	ctx = (traceContext_t *)buf;
+	buf += sizeof( *ctx );
+
+	ctx->numBrushes = numBrushes;
+	ctx->brushChecks = (int *)buf;
+	buf += numBrushes * sizeof( int );
+	ctx->surfaceChecks = (int *)buf;
+	buf += numSurfaces * sizeof( int );
+	ctx->brushCollided = (qboolean *)buf;
+	ctx->numSurfaces = numSurfaces;
+
+	Com_Memset( ctx->brushChecks, 0, numBrushes * sizeof( int ) );
+	Com_Memset( ctx->surfaceChecks, 0, numSurfaces * sizeof( int ) );
+	Com_Memset( ctx->brushCollided, 0, numBrushes * sizeof( qboolean ) );
+
+	return ctx;
+}
+
+/*
+==================
+CM_FreeTraceContext
+==================
+*/
+void CM_FreeTraceContext( traceContext_t *ctx ) {
+	Z_Free( ctx );
 }
 
 /*
@@ -1014,8 +2064,7 @@ void CM_InitBoxHull (void)
 	box_brush->numsides = 6;
 	box_brush->sides = cm.brushsides + cm.numBrushSides;
 	box_brush->contents = 0; // Will be set to CONTENTS_SOLID, CONTENTS_BODY, etc
-	box_brush->edges = (cbrushedge_t *)Hunk_Alloc(
-			sizeof( cbrushedge_t ) * 12, h_low );
+	box_brush->edges = (cbrushedge_t *)CM_Alloc( sizeof( cbrushedge_t ) * 12 );
 	box_brush->numEdges = 12;
 
 	box_model.leaf.numLeafBrushes = 1;
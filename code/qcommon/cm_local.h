@@ -37,10 +37,15 @@ Suite 120, Rockville, Maryland 20850 USA.
 #define CAPSULE_MODEL_HANDLE	( cm.numSubModels + 1 )
 
 
+// a node with its plane copied in, so walking the tree only touches one
+// array.  32 bytes, the array is cache line aligned and in depth first
+// order from the root, so a node's front child is usually in the same
+// cache line.
 typedef struct {
-	cplane_t	*plane;
+	cplane_t	plane;
 	int			children[2];		// negative numbers are leafs
-} cNode_t;
+	int			planeNum;
+} cPackedNode_t;
 
 typedef struct {
 	int			cluster;
@@ -73,21 +78,25 @@ typedef struct {
 	winding_t			*winding;
 } cbrushside_t;
 
+// brush side planes four at a time, so they can be tested together
+typedef struct {
+	float		normal[3][4];
+	float		dist[4];
+} cbrushplanes_t;
+
 typedef struct {
 	int			shaderNum;		// the shader that determined the contents
 	int			contents;
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
-	int			checkcount;		// to avoid repeated testings
-	qboolean	collided; // marker for optimisation
+	cbrushplanes_t	*planes;	// [( numsides + 3 ) / 4], NULL for the box brush
 	cbrushedge_t	*edges;
 	int						numEdges;
 } cbrush_t;
 
 
 typedef struct {
-	int			checkcount;				// to avoid repeated testings
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -99,8 +108,20 @@ typedef struct {
 	int			floodvalid;
 } cArea_t;
 
+// brushes and patches already tested by the current trace, so each trace
+// using a different context can run at the same time
+struct traceContext_s {
+	int			checkcount;			// incremented on each trace
+	int			numBrushes;			// including the box brush
+	int			*brushChecks;		// [numBrushes] checkcount when last tested
+	qboolean	*brushCollided;		// [numBrushes] marker for lateral collision tests
+	int			numSurfaces;
+	int			*surfaceChecks;		// [numSurfaces] checkcount when last tested
+};
+
 typedef struct {
 	char		name[MAX_QPATH];
+	int			checksum;
 
 	int			numShaders;
 	dshader_t	*shaders;
@@ -112,7 +133,7 @@ typedef struct {
 	cplane_t	*planes;
 
 	int			numNodes;
-	cNode_t		*nodes;
+	cPackedNode_t	*packedNodes;	// not in the bsp's node order
 
 	int			numLeafs;
 	cLeaf_t		*leafs;
@@ -128,6 +149,7 @@ typedef struct {
 
 	int			numBrushes;
 	cbrush_t	*brushes;
+	float		maxPlaneDist;	// largest brush plane distance from the origin
 
 	int			numClusters;
 	int			clusterBytes;
@@ -145,7 +167,7 @@ typedef struct {
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
+	traceContext_t	traceContext;			// used by functions that don't take a context
 } clipMap_t;
 
 
@@ -159,9 +181,15 @@ extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_traceThreads;
+extern	cvar_t		*cm_brushSIMD;
 
 extern 	int			capsule_contents;
 
+// cm_load.c
+
+void *CM_Alloc( int size );
+
 // cm_test.c
 
 typedef struct
@@ -179,12 +207,14 @@ typedef struct
 } sphere_t;
 
 typedef struct {
+	traceContext_t	*ctx;
 	traceType_t	type;
 	vec3_t		start;
 	vec3_t		end;
 	vec3_t		size[2];	// size of the box being swept through the model
 	vec3_t		offsets[8];	// [signbits][x] = either size[0][x] or size[1][x]
 	float		maxOffset;	// longest corner length from origin
+	float		planeEpsilon;	// more than the rounding error of SIMD plane distances
 	vec3_t		extents;	// greatest of abs(size[0]) and abs(size[1])
 	vec3_t		bounds[2];	// enclosing box of start and end surrounding by size
 	vec3_t		modelOrigin;// origin of the model tracing through
@@ -203,11 +233,12 @@ typedef struct leafList_s {
 	int		*list;
 	vec3_t	bounds[2];
 	int		lastLeaf;		// for overflows where each leaf can't be stored individually
+	traceContext_t	*ctx;	// for storeLeafs that need to skip repeats
 	void	(*storeLeafs)( struct leafList_s *ll, int nodenum );
 } leafList_t;
 
 
-int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize );
+int CM_BoxBrushes( traceContext_t *ctx, const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize );
 
 void CM_StoreLeafs( leafList_t *ll, int nodenum );
 void CM_StoreBrushes( leafList_t *ll, int nodenum );
@@ -225,3 +256,7 @@ struct patchCollide_s	*CM_GenerateTriangleSoupCollide( int numVertexes, vec3_t *
 void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc );
 qboolean CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc );
 void CM_ClearLevelPatches( void );
+
+// cm_trace.c
+
+void CM_ShutdownTraceBatch( void );
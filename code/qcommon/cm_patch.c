@@ -422,15 +422,29 @@ PATCH COLLIDE GENERATION
 ================================================================================
 */
 
-static	int				numPlanes;
-static	patchPlane_t	planes[MAX_PATCH_PLANES];
-
-static	int				numFacets;
-static	facet_t			facets[MAX_FACETS];
+// used by CM_GeneratePatchCollide and CM_GenerateTriangleSoupCollide
+static	patchWork_t		cm_patchWork;
 
 #define	NORMAL_EPSILON	0.0001
 #define	DIST_EPSILON	0.02
 
+/*
+==================
+CM_PatchWorkFailed
+
+Workers can't print or drop, so the patch is generated again on the main
+thread where the message comes out.  Returns qtrue on a worker.
+==================
+*/
+static qboolean CM_PatchWorkFailed( patchWork_t *pw ) {
+	if ( pw->onWorker ) {
+		pw->failed = qtrue;
+		return qtrue;
+	}
+
+	return qfalse;
+}
+
 /*
 ==================
 CM_PlaneEqual
@@ -495,27 +509,31 @@ void CM_SnapVector(vec3_t normal) {
 CM_FindPlane2
 ==================
 */
-int CM_FindPlane2(float plane[4], int *flipped) {
+static int CM_FindPlane2( patchWork_t *pw, float plane[4], int *flipped ) {
 	int i;
 
 	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if (CM_PlaneEqual(&planes[i], plane, flipped)) return i;
+	for ( i = 0 ; i < pw->numPlanes ; i++ ) {
+		if (CM_PlaneEqual(&pw->planes[i], plane, flipped)) return i;
 	}
 
 	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
+	if ( pw->numPlanes == MAX_PATCH_PLANES ) {
+		if ( CM_PatchWorkFailed( pw ) ) {
+			*flipped = qfalse;
+			return 0;
+		}
 		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
 	}
 
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
+	Vector4Copy( plane, pw->planes[pw->numPlanes].plane );
+	pw->planes[pw->numPlanes].signbits = CM_SignbitsForNormal( plane );
 
-	numPlanes++;
+	pw->numPlanes++;
 
 	*flipped = qfalse;
 
-	return numPlanes-1;
+	return pw->numPlanes-1;
 }
 
 /*
@@ -523,7 +541,7 @@ int CM_FindPlane2(float plane[4], int *flipped) {
 CM_FindPlane
 ==================
 */
-static int CM_FindPlane( float *p1, float *p2, float *p3 ) {
+static int CM_FindPlane( patchWork_t *pw, float *p1, float *p2, float *p3 ) {
 	float	plane[4];
 	int		i;
 	float	d;
@@ -533,22 +551,22 @@ static int CM_FindPlane( float *p1, float *p2, float *p3 ) {
 	}
 
 	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if ( DotProduct( plane, planes[i].plane ) < 0 ) {
+	for ( i = 0 ; i < pw->numPlanes ; i++ ) {
+		if ( DotProduct( plane, pw->planes[i].plane ) < 0 ) {
 			continue;	// allow backwards planes?
 		}
 
-		d = DotProduct( p1, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p1, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
 
-		d = DotProduct( p2, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p2, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
 
-		d = DotProduct( p3, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p3, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
@@ -558,16 +576,19 @@ static int CM_FindPlane( float *p1, float *p2, float *p3 ) {
 	}
 
 	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
+	if ( pw->numPlanes == MAX_PATCH_PLANES ) {
+		if ( CM_PatchWorkFailed( pw ) ) {
+			return 0;
+		}
 		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
 	}
 
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
+	Vector4Copy( plane, pw->planes[pw->numPlanes].plane );
+	pw->planes[pw->numPlanes].signbits = CM_SignbitsForNormal( plane );
 
-	numPlanes++;
+	pw->numPlanes++;
 
-	return numPlanes-1;
+	return pw->numPlanes-1;
 }
 
 /*
@@ -575,14 +596,14 @@ static int CM_FindPlane( float *p1, float *p2, float *p3 ) {
 CM_PointOnPlaneSide
 ==================
 */
-static int CM_PointOnPlaneSide( float *p, int planeNum ) {
-	float	*plane;
+static int CM_PointOnPlaneSide( const patchWork_t *pw, float *p, int planeNum ) {
+	const float	*plane;
 	float	d;
 
 	if ( planeNum == -1 ) {
 		return SIDE_ON;
 	}
-	plane = planes[ planeNum ].plane;
+	plane = pw->planes[ planeNum ].plane;
 
 	d = DotProduct( p, plane ) - plane[3];
 
@@ -602,7 +623,7 @@ static int CM_PointOnPlaneSide( float *p, int planeNum ) {
 CM_GridPlane
 ==================
 */
-static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int tri ) {
+static int	CM_GridPlane( patchWork_t *pw, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int tri ) {
 	int		p;
 
 	p = gridPlanes[i][j][tri];
@@ -615,7 +636,9 @@ static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i,
 	}
 
 	// should never happen
-	Com_Printf( "WARNING: CM_GridPlane unresolvable\n" );
+	if ( !CM_PatchWorkFailed( pw ) ) {
+		Com_Printf( "WARNING: CM_GridPlane unresolvable\n" );
+	}
 	return -1;
 }
 
@@ -624,7 +647,7 @@ static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i,
 CM_EdgePlaneNum
 ==================
 */
-static int CM_EdgePlaneNum( cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int k ) {
+static int CM_EdgePlaneNum( patchWork_t *pw, cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int k ) {
 	float	*p1, *p2;
 	vec3_t		up;
 	int			p;
@@ -633,62 +656,62 @@ static int CM_EdgePlaneNum( cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRI
 	case 0:	// top border
 		p1 = grid->points[i][j];
 		p2 = grid->points[i+1][j];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 2:	// bottom border
 		p1 = grid->points[i][j+1];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p2, p1, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p2, p1, up );
 
 	case 3: // left border
 		p1 = grid->points[i][j];
 		p2 = grid->points[i][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p2, p1, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p2, p1, up );
 
 	case 1:	// right border
 		p1 = grid->points[i+1][j];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 4:	// diagonal out of triangle 0
 		p1 = grid->points[i+1][j+1];
 		p2 = grid->points[i][j];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 5:	// diagonal out of triangle 1
 		p1 = grid->points[i][j];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	}
 
@@ -701,7 +724,7 @@ static int CM_EdgePlaneNum( cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRI
 CM_SetBorderInward
 ===================
 */
-static void CM_SetBorderInward( facet_t *facet, cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2],
+static void CM_SetBorderInward( patchWork_t *pw, facet_t *facet, cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2],
 						  int i, int j, int which ) {
 	int		k, l;
 	float	*points[4];
@@ -742,7 +765,7 @@ static void CM_SetBorderInward( facet_t *facet, cGrid_t *grid, int gridPlanes[MA
 		for ( l = 0 ; l < numPoints ; l++ ) {
 			int		side;
 
-			side = CM_PointOnPlaneSide( points[l], facet->borderPlanes[k] );
+			side = CM_PointOnPlaneSide( pw, points[l], facet->borderPlanes[k] );
 			if ( side == SIDE_FRONT ) {
 				front++;
 			} if ( side == SIDE_BACK ) {
@@ -759,8 +782,11 @@ static void CM_SetBorderInward( facet_t *facet, cGrid_t *grid, int gridPlanes[MA
 			facet->borderPlanes[k] = -1;
 		} else {
 			// bisecting side border
-			Com_DPrintf( "WARNING: CM_SetBorderInward: mixed plane sides\n" );
 			facet->borderInward[k] = qfalse;
+			if ( CM_PatchWorkFailed( pw ) ) {
+				continue;
+			}
+			Com_DPrintf( "WARNING: CM_SetBorderInward: mixed plane sides\n" );
 			if ( !debugBlock ) {
 				debugBlock = qtrue;
 				VectorCopy( grid->points[i][j], debugBlockPoints[0] );
@@ -779,7 +805,7 @@ CM_ValidateFacet
 If the facet isn't bounded by its borders, we screwed up.
 ==================
 */
-static qboolean CM_ValidateFacet( facet_t *facet ) {
+static qboolean CM_ValidateFacet( const patchWork_t *pw, facet_t *facet ) {
 	float		plane[4];
 	int			j;
 	winding_t	*w;
@@ -789,14 +815,14 @@ static qboolean CM_ValidateFacet( facet_t *facet ) {
 		return qfalse;
 	}
 
-	Vector4Copy( planes[ facet->surfacePlane ].plane, plane );
+	Vector4Copy( pw->planes[ facet->surfacePlane ].plane, plane );
 	w = BaseWindingForPlane( plane,  plane[3] );
 	for ( j = 0 ; j < facet->numBorders && w ; j++ ) {
 		if ( facet->borderPlanes[j] == -1 ) {
 			FreeWinding( w );
 			return qfalse;
 		}
-		Vector4Copy( planes[ facet->borderPlanes[j] ].plane, plane );
+		Vector4Copy( pw->planes[ facet->borderPlanes[j] ].plane, plane );
 		if ( !facet->borderInward[j] ) {
 			VectorSubtract( vec3_origin, plane, plane );
 			plane[3] = -plane[3];
@@ -831,7 +857,7 @@ static qboolean CM_ValidateFacet( facet_t *facet ) {
 CM_AddFacetBevels
 ==================
 */
-void CM_AddFacetBevels( facet_t *facet ) {
+static void CM_AddFacetBevels( patchWork_t *pw, facet_t *facet ) {
 
 	int i, j, k, l;
 	int axis, dir, flipped;
@@ -839,12 +865,12 @@ void CM_AddFacetBevels( facet_t *facet ) {
 	winding_t *w, *w2;
 	vec3_t mins, maxs, vec, vec2;
 
-	Vector4Copy( planes[ facet->surfacePlane ].plane, plane );
+	Vector4Copy( pw->planes[ facet->surfacePlane ].plane, plane );
 
 	w = BaseWindingForPlane( plane,  plane[3] );
 	for ( j = 0 ; j < facet->numBorders && w ; j++ ) {
 		if (facet->borderPlanes[j] == facet->surfacePlane) continue;
-		Vector4Copy( planes[ facet->borderPlanes[j] ].plane, plane );
+		Vector4Copy( pw->planes[ facet->borderPlanes[j] ].plane, plane );
 
 		if ( !facet->borderInward[j] ) {
 			VectorSubtract( vec3_origin, plane, plane );
@@ -873,21 +899,23 @@ void CM_AddFacetBevels( facet_t *facet ) {
 				plane[3] = -mins[axis];
 			}
 			//if it's the surface plane
-			if (CM_PlaneEqual(&planes[facet->surfacePlane], plane, &flipped)) {
+			if (CM_PlaneEqual(&pw->planes[facet->surfacePlane], plane, &flipped)) {
 				continue;
 			}
 			// see if the plane is already present
 			for ( i = 0 ; i < facet->numBorders ; i++ ) {
-				if (CM_PlaneEqual(&planes[facet->borderPlanes[i]], plane, &flipped))
+				if (CM_PlaneEqual(&pw->planes[facet->borderPlanes[i]], plane, &flipped))
 					break;
 			}
 
 			if ( i == facet->numBorders ) {
 				if ( facet->numBorders >= 4 + 6 + 16 ) {
-					Com_Printf( "ERROR: too many bevels\n" );
+					if ( !CM_PatchWorkFailed( pw ) ) {
+						Com_Printf( "ERROR: too many bevels\n" );
+					}
 					continue;
 				}
-				facet->borderPlanes[facet->numBorders] = CM_FindPlane2(plane, &flipped);
+				facet->borderPlanes[facet->numBorders] = CM_FindPlane2( pw, plane, &flipped );
 				facet->borderNoAdjust[facet->numBorders] = 0;
 				facet->borderInward[facet->numBorders] = flipped;
 				facet->numBorders++;
@@ -946,33 +974,35 @@ void CM_AddFacetBevels( facet_t *facet ) {
 				}
 
 				//if it's the surface plane
-				if (CM_PlaneEqual(&planes[facet->surfacePlane], plane, &flipped)) {
+				if (CM_PlaneEqual(&pw->planes[facet->surfacePlane], plane, &flipped)) {
 					continue;
 				}
 				// see if the plane is already present
 				for ( i = 0 ; i < facet->numBorders ; i++ ) {
-					if (CM_PlaneEqual(&planes[facet->borderPlanes[i]], plane, &flipped)) {
+					if (CM_PlaneEqual(&pw->planes[facet->borderPlanes[i]], plane, &flipped)) {
 							break;
 					}
 				}
 
 				if ( i == facet->numBorders ) {
 					if ( facet->numBorders >= 4 + 6 + 16 ) {
-						Com_Printf( "ERROR: too many bevels\n" );
+						if ( !CM_PatchWorkFailed( pw ) ) {
+							Com_Printf( "ERROR: too many bevels\n" );
+						}
 						continue;
 					}
-					facet->borderPlanes[facet->numBorders] = CM_FindPlane2(plane, &flipped);
+					facet->borderPlanes[facet->numBorders] = CM_FindPlane2( pw, plane, &flipped );
 
 					for ( k = 0 ; k < facet->numBorders ; k++ ) {
 						if (facet->borderPlanes[facet->numBorders] ==
-							facet->borderPlanes[k]) Com_Printf("WARNING: bevel plane already used\n");
+							facet->borderPlanes[k] && !CM_PatchWorkFailed( pw )) Com_Printf("WARNING: bevel plane already used\n");
 					}
 
 					facet->borderNoAdjust[facet->numBorders] = 0;
 					facet->borderInward[facet->numBorders] = flipped;
 					//
 					w2 = CopyWinding(w);
-					Vector4Copy(planes[facet->borderPlanes[facet->numBorders]].plane, newplane);
+					Vector4Copy(pw->planes[facet->borderPlanes[facet->numBorders]].plane, newplane);
 					if (!facet->borderInward[facet->numBorders])
 					{
 						VectorNegate(newplane, newplane);
@@ -980,7 +1010,9 @@ void CM_AddFacetBevels( facet_t *facet ) {
 					} //end if
 					ChopWindingInPlace( &w2, newplane, newplane[3], 0.1f );
 					if (!w2) {
-						Com_DPrintf("WARNING: CM_AddFacetBevels... invalid bevel\n");
+						if ( !CM_PatchWorkFailed( pw ) ) {
+							Com_DPrintf("WARNING: CM_AddFacetBevels... invalid bevel\n");
+						}
 						continue;
 					}
 					else {
@@ -999,7 +1031,9 @@ void CM_AddFacetBevels( facet_t *facet ) {
 #ifndef BSPC
 	//add opposite plane
 	if ( facet->numBorders >= 4 + 6 + 16 ) {
-		Com_Printf( "ERROR: too many bevels\n" );
+		if ( !CM_PatchWorkFailed( pw ) ) {
+			Com_Printf( "ERROR: too many bevels\n" );
+		}
 		return;
 	}
 	facet->borderPlanes[facet->numBorders] = facet->surfacePlane;
@@ -1022,16 +1056,16 @@ typedef enum {
 CM_PatchCollideFromGrid
 ==================
 */
-static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
+static void CM_PatchCollideFromGrid( patchWork_t *pw, cGrid_t *grid ) {
 	int				i, j;
 	float			*p1, *p2, *p3;
-	int				gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2];
+	int				(*gridPlanes)[MAX_GRID_SIZE][2] = pw->gridPlanes;
 	facet_t			*facet;
 	int				borders[4];
 	int				noAdjust[4];
 
-	numPlanes = 0;
-	numFacets = 0;
+	pw->numPlanes = 0;
+	pw->numFacets = 0;
 
 	// find the planes for each triangle of the grid
 	for ( i = 0 ; i < grid->width - 1 ; i++ ) {
@@ -1039,12 +1073,12 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 			p1 = grid->points[i][j];
 			p2 = grid->points[i+1][j];
 			p3 = grid->points[i+1][j+1];
-			gridPlanes[i][j][0] = CM_FindPlane( p1, p2, p3 );
+			gridPlanes[i][j][0] = CM_FindPlane( pw, p1, p2, p3 );
 
 			p1 = grid->points[i+1][j+1];
 			p2 = grid->points[i][j+1];
 			p3 = grid->points[i][j];
-			gridPlanes[i][j][1] = CM_FindPlane( p1, p2, p3 );
+			gridPlanes[i][j][1] = CM_FindPlane( pw, p1, p2, p3 );
 		}
 	}
 
@@ -1060,7 +1094,7 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 			} 
 			noAdjust[EN_TOP] = ( borders[EN_TOP] == gridPlanes[i][j][0] );
 			if ( borders[EN_TOP] == -1 || noAdjust[EN_TOP] ) {
-				borders[EN_TOP] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 0 );
+				borders[EN_TOP] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 0 );
 			}
 
 			borders[EN_BOTTOM] = -1;
@@ -1071,7 +1105,7 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_BOTTOM] = ( borders[EN_BOTTOM] == gridPlanes[i][j][1] );
 			if ( borders[EN_BOTTOM] == -1 || noAdjust[EN_BOTTOM] ) {
-				borders[EN_BOTTOM] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 2 );
+				borders[EN_BOTTOM] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 2 );
 			}
 
 			borders[EN_LEFT] = -1;
@@ -1082,7 +1116,7 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_LEFT] = ( borders[EN_LEFT] == gridPlanes[i][j][1] );
 			if ( borders[EN_LEFT] == -1 || noAdjust[EN_LEFT] ) {
-				borders[EN_LEFT] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 3 );
+				borders[EN_LEFT] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 3 );
 			}
 
 			borders[EN_RIGHT] = -1;
@@ -1093,13 +1127,16 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_RIGHT] = ( borders[EN_RIGHT] == gridPlanes[i][j][0] );
 			if ( borders[EN_RIGHT] == -1 || noAdjust[EN_RIGHT] ) {
-				borders[EN_RIGHT] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 1 );
+				borders[EN_RIGHT] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 1 );
 			}
 
-			if ( numFacets == MAX_FACETS ) {
+			if ( pw->numFacets == MAX_FACETS ) {
+				if ( CM_PatchWorkFailed( pw ) ) {
+					return;
+				}
 				Com_Error( ERR_DROP, "MAX_FACETS" );
 			}
-			facet = &facets[numFacets];
+			facet = &pw->facets[pw->numFacets];
 			Com_Memset( facet, 0, sizeof( *facet ) );
 
 			if ( gridPlanes[i][j][0] == gridPlanes[i][j][1] ) {
@@ -1116,10 +1153,10 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 				facet->borderNoAdjust[2] = noAdjust[EN_BOTTOM];
 				facet->borderPlanes[3] = borders[EN_LEFT];
 				facet->borderNoAdjust[3] = noAdjust[EN_LEFT];
-				CM_SetBorderInward( facet, grid, gridPlanes, i, j, -1 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, -1 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 			} else {
 				// two separate triangles
@@ -1133,19 +1170,22 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 				if ( facet->borderPlanes[2] == -1 ) {
 					facet->borderPlanes[2] = borders[EN_BOTTOM];
 					if ( facet->borderPlanes[2] == -1 ) {
-						facet->borderPlanes[2] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 4 );
+						facet->borderPlanes[2] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 4 );
 					}
 				}
- 				CM_SetBorderInward( facet, grid, gridPlanes, i, j, 0 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+ 				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, 0 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 
-				if ( numFacets == MAX_FACETS ) {
+				if ( pw->numFacets == MAX_FACETS ) {
+					if ( CM_PatchWorkFailed( pw ) ) {
+						return;
+					}
 					Com_Error( ERR_DROP, "MAX_FACETS" );
 				}
-				facet = &facets[numFacets];
+				facet = &pw->facets[pw->numFacets];
 				Com_Memset( facet, 0, sizeof( *facet ) );
 
 				facet->surfacePlane = gridPlanes[i][j][1];
@@ -1158,27 +1198,116 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 				if ( facet->borderPlanes[2] == -1 ) {
 					facet->borderPlanes[2] = borders[EN_TOP];
 					if ( facet->borderPlanes[2] == -1 ) {
-						facet->borderPlanes[2] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 5 );
+						facet->borderPlanes[2] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 5 );
 					}
 				}
-				CM_SetBorderInward( facet, grid, gridPlanes, i, j, 1 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, 1 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 			}
 		}
 	}
+}
+
+
+/*
+===================
+CM_CopyPatchWork
 
-	// copy the results out
-	pf->numPlanes = numPlanes;
-	pf->numFacets = numFacets;
-	pf->facets = Hunk_Alloc( numFacets * sizeof( *pf->facets ), h_high );
-	Com_Memcpy( pf->facets, facets, numFacets * sizeof( *pf->facets ) );
-	pf->planes = Hunk_Alloc( numPlanes * sizeof( *pf->planes ), h_high );
-	Com_Memcpy( pf->planes, planes, numPlanes * sizeof( *pf->planes ) );
+Copies the planes and facets of the last generated patch into data,
+which must have room for PATCH_WORK_SIZE( pw ) bytes
+===================
+*/
+#define PATCH_WORK_SIZE( pw )	( (pw)->numPlanes * sizeof( patchPlane_t ) + (pw)->numFacets * sizeof( facet_t ) )
+
+static void CM_CopyPatchWork( const patchWork_t *pw, patchCollide_t *pf, byte *data ) {
+	pf->numPlanes = pw->numPlanes;
+	pf->planes = (patchPlane_t *)data;
+	Com_Memcpy( pf->planes, pw->planes, pw->numPlanes * sizeof( *pf->planes ) );
+
+	pf->numFacets = pw->numFacets;
+	pf->facets = (facet_t *)( pf->planes + pw->numPlanes );
+	Com_Memcpy( pf->facets, pw->facets, pw->numFacets * sizeof( *pf->facets ) );
 }
 
+/*
+===================
+CM_ValidPatchSize
+===================
+*/
+static qboolean CM_ValidPatchSize( int width, int height, vec3_t *points ) {
+	if ( width <= 2 || height <= 2 || !points ) {
+		return qfalse;
+	}
+
+	// even sizes are invalid for quadratic meshes
+	if ( !(width & 1) || !(height & 1) ) {
+		return qfalse;
+	}
+
+	if ( width > MAX_GRID_SIZE || height > MAX_GRID_SIZE ) {
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+===================
+CM_SetupPatchGrid
+
+Subdivides the control points into a grid of points exactly on the
+curve and returns its bounds, expanded by one unit for epsilon purposes
+===================
+*/
+static void CM_SetupPatchGrid( cGrid_t *grid, int width, int height, vec3_t *points, float subdivisions, vec3_t bounds[2] ) {
+	int				i, j;
+
+	// build a grid
+	grid->width = width;
+	grid->height = height;
+	grid->wrapWidth = qfalse;
+	grid->wrapHeight = qfalse;
+	for ( i = 0 ; i < width ; i++ ) {
+		for ( j = 0 ; j < height ; j++ ) {
+			VectorCopy( points[j*width + i], grid->points[i][j] );
+		}
+	}
+
+	grid->subdivideDistance = subdivisions;
+
+	// subdivide the grid
+	CM_SetGridWrapWidth( grid );
+	CM_SubdivideGridColumns( grid );
+	CM_RemoveDegenerateColumns( grid );
+
+	CM_TransposeGrid( grid );
+
+	CM_SetGridWrapWidth( grid );
+	CM_SubdivideGridColumns( grid );
+	CM_RemoveDegenerateColumns( grid );
+
+	// we now have a grid of points exactly on the curve
+	// the approximate surface defined by these points will be
+	// collided against
+	ClearBounds( bounds[0], bounds[1] );
+	for ( i = 0 ; i < grid->width ; i++ ) {
+		for ( j = 0 ; j < grid->height ; j++ ) {
+			AddPointToBounds( grid->points[i][j], bounds[0], bounds[1] );
+		}
+	}
+
+	// expand by one unit for epsilon purposes
+	bounds[0][0] -= 1;
+	bounds[0][1] -= 1;
+	bounds[0][2] -= 1;
+
+	bounds[1][0] += 1;
+	bounds[1][1] += 1;
+	bounds[1][2] += 1;
+}
 
 /*
 ===================
@@ -1191,9 +1320,8 @@ Points is packed as concatenated rows.
 ===================
 */
 struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *points, float subdivisions ) {
+	patchWork_t		*pw = &cm_patchWork;
 	patchCollide_t	*pf;
-	cGrid_t			grid;
-	int				i, j;
 
 	if ( width <= 2 || height <= 2 || !points ) {
 		Com_Error( ERR_DROP, "CM_GeneratePatchFacets: bad parameters: (%i, %i, %p)",
@@ -1208,54 +1336,76 @@ struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *p
 		Com_Error( ERR_DROP, "CM_GeneratePatchFacets: source is > MAX_GRID_SIZE" );
 	}
 
-	// build a grid
-	grid.width = width;
-	grid.height = height;
-	grid.wrapWidth = qfalse;
-	grid.wrapHeight = qfalse;
-	for ( i = 0 ; i < width ; i++ ) {
-		for ( j = 0 ; j < height ; j++ ) {
-			VectorCopy( points[j*width + i], grid.points[i][j] );
-		}
-	}
+	pf = CM_Alloc( sizeof( *pf ) );
+	CM_SetupPatchGrid( &pw->grid, width, height, points, subdivisions, pf->bounds );
 
-	grid.subdivideDistance = subdivisions;
+	c_totalPatchBlocks += ( pw->grid.width - 1 ) * ( pw->grid.height - 1 );
 
-	// subdivide the grid
-	CM_SetGridWrapWidth( &grid );
-	CM_SubdivideGridColumns( &grid );
-	CM_RemoveDegenerateColumns( &grid );
+	// generate a bsp tree for the surface
+	CM_PatchCollideFromGrid( pw, &pw->grid );
 
-	CM_TransposeGrid( &grid );
+	CM_CopyPatchWork( pw, pf, CM_Alloc( PATCH_WORK_SIZE( pw ) ) );
 
-	CM_SetGridWrapWidth( &grid );
-	CM_SubdivideGridColumns( &grid );
-	CM_RemoveDegenerateColumns( &grid );
+	return pf;
+}
 
-	// we now have a grid of points exactly on the curve
-	// the approximate surface defined by these points will be
-	// collided against
-	pf = Hunk_Alloc( sizeof( *pf ), h_high );
-	ClearBounds( pf->bounds[0], pf->bounds[1] );
-	for ( i = 0 ; i < grid.width ; i++ ) {
-		for ( j = 0 ; j < grid.height ; j++ ) {
-			AddPointToBounds( grid.points[i][j], pf->bounds[0], pf->bounds[1] );
-		}
+/*
+===================
+CM_BuildPatchCollide
+
+Same as CM_GeneratePatchCollide, but safe to run on a job thread with
+a patchWork_t of its own.  The result is a single malloc block that must
+be passed to CM_StorePatchCollide on the main thread.  Returns NULL for
+anything that would print or drop, CM_GeneratePatchCollide should then
+be used to report it.
+===================
+*/
+patchCollide_t *CM_BuildPatchCollide( patchWork_t *pw, int width, int height, vec3_t *points, float subdivisions ) {
+	patchCollide_t	*pf;
+	vec3_t			bounds[2];
+
+	if ( !CM_ValidPatchSize( width, height, points ) ) {
+		return NULL;
 	}
 
-	c_totalPatchBlocks += ( grid.width - 1 ) * ( grid.height - 1 );
+	CM_SetupPatchGrid( &pw->grid, width, height, points, subdivisions, bounds );
 
-	// generate a bsp tree for the surface
-	CM_PatchCollideFromGrid( &grid, pf );
+	pw->onWorker = qtrue;
+	pw->failed = qfalse;
+	CM_PatchCollideFromGrid( pw, &pw->grid );
+	if ( pw->failed ) {
+		return NULL;
+	}
 
-	// expand by one unit for epsilon purposes
-	pf->bounds[0][0] -= 1;
-	pf->bounds[0][1] -= 1;
-	pf->bounds[0][2] -= 1;
+	pf = malloc( sizeof( *pf ) + PATCH_WORK_SIZE( pw ) );
+	if ( !pf ) {
+		return NULL;
+	}
 
-	pf->bounds[1][0] += 1;
-	pf->bounds[1][1] += 1;
-	pf->bounds[1][2] += 1;
+	VectorCopy( bounds[0], pf->bounds[0] );
+	VectorCopy( bounds[1], pf->bounds[1] );
+	CM_CopyPatchWork( pw, pf, (byte *)( pf + 1 ) );
+
+	return pf;
+}
+
+/*
+===================
+CM_StorePatchCollide
+
+Moves a patch from CM_BuildPatchCollide into clip map memory
+===================
+*/
+struct patchCollide_s	*CM_StorePatchCollide( patchCollide_t *built ) {
+	patchCollide_t	*pf;
+	int				size;
+
+	size = sizeof( *pf ) + built->numPlanes * sizeof( patchPlane_t ) + built->numFacets * sizeof( facet_t );
+	pf = CM_Alloc( size );
+	Com_Memcpy( pf, built, size );
+	pf->planes = (patchPlane_t *)( pf + 1 );
+	pf->facets = (facet_t *)( pf->planes + pf->numPlanes );
+	free( built );
 
 	return pf;
 }
@@ -1275,7 +1425,7 @@ Triangle Soup to patchCollide_s
 CM_SetTriangleSoupBorderInward
 ===================
 */
-static void CM_SetTriangleSoupBorderInward( facet_t *facet, float *p1, float *p2, float *p3 )
+static void CM_SetTriangleSoupBorderInward( patchWork_t *pw, facet_t *facet, float *p1, float *p2, float *p3 )
 {
 	int				k, l;
 	int				numPoints;
@@ -1295,7 +1445,7 @@ static void CM_SetTriangleSoupBorderInward( facet_t *facet, float *p1, float *p2
 		for ( l = 0 ; l < numPoints ; l++ ) {
 			int		side;
 
-			side = CM_PointOnPlaneSide( points[l], facet->borderPlanes[k] );
+			side = CM_PointOnPlaneSide( pw, points[l], facet->borderPlanes[k] );
 			if ( side == SIDE_FRONT ) {
 				front++;
 			} if ( side == SIDE_BACK ) {
@@ -1323,13 +1473,13 @@ static void CM_SetTriangleSoupBorderInward( facet_t *facet, float *p1, float *p2
 CM_GenerateBoundaryForPoints
 ==================
 */
-static int CM_GenerateBoundaryForPoints( int surfacePlane, float *p1, float *p2 )
+static int CM_GenerateBoundaryForPoints( patchWork_t *pw, int surfacePlane, float *p1, float *p2 )
 {
 	vec3_t          up;
 
-	VectorMA( p1, 4, planes[surfacePlane].plane, up );
+	VectorMA( p1, 4, pw->planes[surfacePlane].plane, up );
 
-	return CM_FindPlane( p1, p2, up );
+	return CM_FindPlane( pw, p1, p2, up );
 }
 
 /*
@@ -1337,14 +1487,14 @@ static int CM_GenerateBoundaryForPoints( int surfacePlane, float *p1, float *p2
 CM_PatchCollideFromTriangleSoup
 ==================
 */
-static void CM_PatchCollideFromTriangleSoup( cTriangleSoup_t *triSoup, patchCollide_t *pf ) {
+static void CM_PatchCollideFromTriangleSoup( patchWork_t *pw, cTriangleSoup_t *triSoup ) {
 	int				i;
 	float			*p1, *p2, *p3;
 	int				trianglePlanes[SHADER_MAX_TRIANGLES];
 	facet_t			*facet;
 
-	numPlanes = 0;
-	numFacets = 0;
+	pw->numPlanes = 0;
+	pw->numFacets = 0;
 
 	// find the planes for each triangle of the grid
 	for( i = 0; i < triSoup->numTriangles ; i++ ) {
@@ -1352,15 +1502,18 @@ static void CM_PatchCollideFromTriangleSoup( cTriangleSoup_t *triSoup, patchColl
 		p2 = triSoup->points[i][1];
 		p3 = triSoup->points[i][2];
 
-		trianglePlanes[i] = CM_FindPlane(p1, p2, p3);
+		trianglePlanes[i] = CM_FindPlane( pw, p1, p2, p3);
 	}
 
 	// create the borders for each triangle
 	for ( i = 0; i < triSoup->numTriangles ; i++ ) {
-		if ( numFacets == MAX_FACETS ) {
+		if ( pw->numFacets == MAX_FACETS ) {
+			if ( CM_PatchWorkFailed( pw ) ) {
+				return;
+			}
 			Com_Error( ERR_DROP, "MAX_FACETS" );
 		}
-		facet = &facets[numFacets];
+		facet = &pw->facets[pw->numFacets];
 		Com_Memset( facet, 0, sizeof( *facet ) );
 
 		p1 = triSoup->points[i][0];
@@ -1379,25 +1532,17 @@ static void CM_PatchCollideFromTriangleSoup( cTriangleSoup_t *triSoup, patchColl
 		facet->borderNoAdjust[1] = qfalse;
 		facet->borderNoAdjust[2] = qfalse;
 
-		facet->borderPlanes[0] = CM_GenerateBoundaryForPoints( facet->surfacePlane, p1, p2);
-		facet->borderPlanes[1] = CM_GenerateBoundaryForPoints( facet->surfacePlane, p2, p3);
-		facet->borderPlanes[2] = CM_GenerateBoundaryForPoints( facet->surfacePlane, p3, p1);
+		facet->borderPlanes[0] = CM_GenerateBoundaryForPoints( pw, facet->surfacePlane, p1, p2);
+		facet->borderPlanes[1] = CM_GenerateBoundaryForPoints( pw, facet->surfacePlane, p2, p3);
+		facet->borderPlanes[2] = CM_GenerateBoundaryForPoints( pw, facet->surfacePlane, p3, p1);
 
-		CM_SetTriangleSoupBorderInward( facet, p1, p2, p3 );
+		CM_SetTriangleSoupBorderInward( pw, facet, p1, p2, p3 );
 
-		if ( CM_ValidateFacet( facet ) ) {
-			CM_AddFacetBevels( facet );
-			numFacets++;
+		if ( CM_ValidateFacet( pw, facet ) ) {
+			CM_AddFacetBevels( pw, facet );
+			pw->numFacets++;
 		}
 	}
-
-	// copy the results out
-	pf->numPlanes = numPlanes;
-	pf->numFacets = numFacets;
-	pf->facets = Hunk_Alloc( numFacets * sizeof( *pf->facets ), h_high );
-	Com_Memcpy( pf->facets, facets, numFacets * sizeof( *pf->facets ) );
-	pf->planes = Hunk_Alloc( numPlanes * sizeof( *pf->planes ), h_high );
-	Com_Memcpy( pf->planes, planes, numPlanes * sizeof( *pf->planes ) );
 }
 
 /*
@@ -1430,7 +1575,7 @@ struct patchCollide_s	*CM_GenerateTriangleSoupCollide( int numVertexes, vec3_t *
 		}
 	}
 
-	pf = Hunk_Alloc( sizeof( *pf ), h_high );
+	pf = CM_Alloc( sizeof( *pf ) );
 	ClearBounds( pf->bounds[0], pf->bounds[1] );
 	for ( i = 0; i < triSoup.numTriangles ; i++ ) {
 		for ( j = 0; j < 3 ; j++ ) {
@@ -1439,7 +1584,8 @@ struct patchCollide_s	*CM_GenerateTriangleSoupCollide( int numVertexes, vec3_t *
 	}
 
 	// generate a bsp tree for the surface
-	CM_PatchCollideFromTriangleSoup( &triSoup, pf );
+	CM_PatchCollideFromTriangleSoup( &cm_patchWork, &triSoup );
+	CM_CopyPatchWork( &cm_patchWork, pf, CM_Alloc( PATCH_WORK_SIZE( &cm_patchWork ) ) );
 
 	// expand by one unit for epsilon purposes
 	pf->bounds[0][0] -= 1;
@@ -1539,10 +1685,11 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 		if ( j == facet->numBorders ) {
 			// we hit this facet
 #ifndef BSPC
-			if (!cv) {
+			// only for the shared context, other threads may be tracing
+			if (!cv && tw->ctx == &cm.traceContext) {
 				cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
 			}
-			if (cv->integer) {
+			if (cv && cv->integer && tw->ctx == &cm.traceContext) {
 				debugPatchCollide = pc;
 				debugFacet = facet;
 			}
@@ -1726,10 +1873,11 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 					enterFrac = 0;
 				}
 #ifndef BSPC
-				if (!cv) {
+				// only for the shared context, other threads may be tracing
+				if (!cv && tw->ctx == &cm.traceContext) {
 					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
 				}
-				if (cv && cv->integer) {
+				if (cv && cv->integer && tw->ctx == &cm.traceContext) {
 					debugPatchCollide = pc;
 					debugFacet = facet;
 				}
@@ -117,3 +117,18 @@ typedef struct {
 } cTriangleSoup_t;
 
 struct patchCollide_s	*CM_GenerateTriangleSoupCollide( int numVertexes, vec3_t *vertexes, int numIndexes, int *indexes );
+
+// scratch space for generating one patch, each thread needs its own
+typedef struct {
+	int				numPlanes;
+	patchPlane_t	planes[MAX_PATCH_PLANES];
+	int				numFacets;
+	facet_t			facets[MAX_FACETS];
+	cGrid_t			grid;
+	int				gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2];
+	qboolean		onWorker;		// set failed instead of printing or dropping
+	qboolean		failed;
+} patchWork_t;
+
+patchCollide_t			*CM_BuildPatchCollide( patchWork_t *pw, int width, int height, vec3_t *points, float subdivisions );
+struct patchCollide_s	*CM_StorePatchCollide( patchCollide_t *built );
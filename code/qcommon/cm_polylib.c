@@ -34,13 +34,6 @@ Suite 120, Rockville, Maryland 20850 USA.
 #include "cm_local.h"
 
 
-// counters are only bumped when running single threaded,
-// because they are an awful coherence problem
-int	c_active_windings;
-int	c_peak_windings;
-int	c_winding_allocs;
-int	c_winding_points;
-
 void pw(winding_t *w)
 {
 	int		i;
@@ -52,6 +45,9 @@ void pw(winding_t *w)
 /*
 =============
 AllocWinding
+
+Windings come from malloc rather than the zone so that patch
+collision can be generated on job threads
 =============
 */
 winding_t	*AllocWinding (int points)
@@ -59,15 +55,10 @@ winding_t	*AllocWinding (int points)
 	winding_t	*w;
 	int			s;
 
-	c_winding_allocs++;
-	c_winding_points += points;
-	c_active_windings++;
-	if (c_active_windings > c_peak_windings)
-		c_peak_windings = c_active_windings;
-
 	s = sizeof(vec_t)*3*points + sizeof(int);
-	w = Z_Malloc (s);
-	Com_Memset (w, 0, s); 
+	w = calloc (1, s);
+	if (!w)
+		Com_Error (ERR_FATAL, "AllocWinding: failed on allocation of %i bytes", s);
 	return w;
 }
 
@@ -77,8 +68,7 @@ void FreeWinding (winding_t *w)
 		Com_Error (ERR_FATAL, "FreeWinding: freed a freed winding");
 	*(unsigned *)w = 0xdeaddead;
 
-	c_active_windings--;
-	Z_Free (w);
+	free (w);
 }
 
 /*
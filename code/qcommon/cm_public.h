@@ -47,6 +47,32 @@ qboolean	CM_GetEntityToken( int *parseOffset, char *token, int size );
 int			CM_PointContents( const vec3_t p, clipHandle_t model );
 int			CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles );
 
+// each thread tracing at the same time needs its own context, the functions
+// that don't take one use a shared context.  Contexts are only valid for
+// the map that was loaded when they were allocated.  Temp box and capsule
+// models are shared, so only one thread at a time can create and trace them.
+typedef struct traceContext_s traceContext_t;
+
+traceContext_t *CM_AllocTraceContext( void );
+void		CM_FreeTraceContext( traceContext_t *ctx );
+
+void		CM_BoxTraceContext( traceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs,
+						  clipHandle_t model, int brushmask, traceType_t type );
+void		CM_TransformedBoxTraceContext( traceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs,
+						  clipHandle_t model, int brushmask,
+						  const vec3_t origin, const vec3_t angles, traceType_t type );
+
+// traces all requests against one model, grouping them by size and position
+// and splitting them between cm_traceThreads worker threads.  Not re-entrant.
+void		CM_BoxTraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests, clipHandle_t model );
+
+void		CM_TraceStress_f( void );
+void		CM_TraceCapture_f( void );
+void		CM_TraceReplay_f( void );
+void		CM_CollisionBench_f( void );
+
 void		CM_BoxTrace ( trace_t *results, const vec3_t start, const vec3_t end,
 						  const vec3_t mins, const vec3_t maxs,
 						  clipHandle_t model, int brushmask, traceType_t type );
@@ -68,6 +94,7 @@ int			CM_PointLeafnum( const vec3_t p );
 
 // only returns non-solid leafs
 // overflow if return listsize and if *lastLeaf != list[listsize-1]
+// safe to call from multiple threads
 int			CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list,
 		 					int listsize, int *lastLeaf );
 
@@ -76,6 +103,7 @@ int			CM_LeafArea (int leafnum);
 
 void		CM_AdjustAreaPortalState( int area1, int area2, qboolean open );
 qboolean	CM_AreasConnected( int area1, int area2 );
+int			CM_AreaPortalGeneration( void );
 
 int			CM_WriteAreaBits( byte *buffer, int area );
 
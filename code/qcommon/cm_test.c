@@ -38,13 +38,13 @@ CM_PointLeafnum_r
 */
 int CM_PointLeafnum_r( const vec3_t p, int num ) {
 	float		d;
-	cNode_t		*node;
-	cplane_t	*plane;
+	const cPackedNode_t	*node;
+	const cplane_t	*plane;
 
 	while (num >= 0)
 	{
-		node = cm.nodes + num;
-		plane = node->plane;
+		node = cm.packedNodes + num;
+		plane = &node->plane;
 		
 		if (plane->type < 3)
 			d = p[plane->type] - plane->dist;
@@ -109,10 +109,10 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( ll->ctx->brushChecks[brushnum] == ll->ctx->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		ll->ctx->brushChecks[brushnum] = ll->ctx->checkcount;
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -147,7 +147,7 @@ Fills in a list of all the leafs touched
 */
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum ) {
 	cplane_t	*plane;
-	cNode_t		*node;
+	cPackedNode_t	*node;
 	int			s;
 
 	while (1) {
@@ -156,8 +156,8 @@ void CM_BoxLeafnums_r( leafList_t *ll, int nodenum ) {
 			return;
 		}
 	
-		node = &cm.nodes[nodenum];
-		plane = node->plane;
+		node = &cm.packedNodes[nodenum];
+		plane = &node->plane;
 		s = BoxOnPlaneSide( ll->bounds[0], ll->bounds[1], plane );
 		if (s == 1) {
 			nodenum = node->children[0];
@@ -180,8 +180,6 @@ CM_BoxLeafnums
 int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsize, int *lastLeaf) {
 	leafList_t	ll;
 
-	cm.checkcount++;
-
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
 	ll.count = 0;
@@ -190,6 +188,7 @@ int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsiz
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
+	ll.ctx = NULL;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -202,10 +201,10 @@ int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsiz
 CM_BoxBrushes
 ==================
 */
-int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
+int CM_BoxBrushes( traceContext_t *ctx, const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
 	leafList_t	ll;
 
-	cm.checkcount++;
+	ctx->checkcount++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
@@ -215,6 +214,7 @@ int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int li
 	ll.storeLeafs = CM_StoreBrushes;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
+	ll.ctx = ctx;
 	
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -445,6 +445,18 @@ qboolean	CM_AreasConnected( int area1, int area2 ) {
 }
 
 
+/*
+====================
+CM_AreaPortalGeneration
+
+Changes whenever the area connections are reflooded, so callers can
+tell if results based on CM_AreasConnected are still valid
+====================
+*/
+int CM_AreaPortalGeneration( void ) {
+	return cm.floodvalid;
+}
+
 /*
 =================
 CM_WriteAreaBits
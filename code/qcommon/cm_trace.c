@@ -29,6 +29,22 @@ Suite 120, Rockville, Maryland 20850 USA.
 */
 #include "cm_local.h"
 
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define CM_SSE_BRUSHES
+#endif
+
+#ifdef BSPC
+#define CM_UseBrushPlanes( brush )	( (brush)->planes != NULL )
+#else
+#define CM_UseBrushPlanes( brush )	( (brush)->planes != NULL && cm_brushSIMD->integer )
+#endif
+
+#ifndef BSPC
+static fileHandle_t	cm_traceCaptureFile;		// traceCapture output
+static void CM_CaptureTraces( const traceRequest_t *requests, int numRequests );
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -161,6 +177,97 @@ POSITION TESTING
 ===============================================================================
 */
 
+#ifdef CM_SSE_BRUSHES
+/*
+================
+CM_BrushPlaneDistsSSE
+
+Distances of the start and end of an AABB trace from four brush side
+planes.  These can be rounded differently than the scalar code, so they
+are only used to pick out sides that are clearly not crossed or clearly
+in front of the trace, everything closer than tw->planeEpsilon is redone
+with the scalar code so the results don't change.
+================
+*/
+static ID_INLINE void CM_BrushPlaneDistsSSE( const traceWork_t *tw, const cbrushplanes_t *planes, __m128 *d1, __m128 *d2 ) {
+	__m128	zero, nx, ny, nz, ox, oy, oz, lt, dist;
+
+	zero = _mm_setzero_ps();
+	nx = _mm_load_ps( planes->normal[0] );
+	ny = _mm_load_ps( planes->normal[1] );
+	nz = _mm_load_ps( planes->normal[2] );
+
+	// tw->offsets[signbits], maxs for negative normal components
+	lt = _mm_cmplt_ps( nx, zero );
+	ox = _mm_or_ps( _mm_and_ps( lt, _mm_set1_ps( tw->size[1][0] ) ), _mm_andnot_ps( lt, _mm_set1_ps( tw->size[0][0] ) ) );
+	lt = _mm_cmplt_ps( ny, zero );
+	oy = _mm_or_ps( _mm_and_ps( lt, _mm_set1_ps( tw->size[1][1] ) ), _mm_andnot_ps( lt, _mm_set1_ps( tw->size[0][1] ) ) );
+	lt = _mm_cmplt_ps( nz, zero );
+	oz = _mm_or_ps( _mm_and_ps( lt, _mm_set1_ps( tw->size[1][2] ) ), _mm_andnot_ps( lt, _mm_set1_ps( tw->size[0][2] ) ) );
+
+	dist = _mm_sub_ps( _mm_load_ps( planes->dist ),
+		_mm_add_ps( _mm_add_ps( _mm_mul_ps( ox, nx ), _mm_mul_ps( oy, ny ) ), _mm_mul_ps( oz, nz ) ) );
+
+	*d1 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( tw->start[0] ), nx ),
+		_mm_mul_ps( _mm_set1_ps( tw->start[1] ), ny ) ), _mm_mul_ps( _mm_set1_ps( tw->start[2] ), nz ) ), dist );
+
+	if ( d2 ) {
+		*d2 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( tw->end[0] ), nx ),
+			_mm_mul_ps( _mm_set1_ps( tw->end[1] ), ny ) ), _mm_mul_ps( _mm_set1_ps( tw->end[2] ), nz ) ), dist );
+	}
+}
+
+/*
+================
+CM_TestBrushSidesSSE
+
+Sets skipMask to the sides in the group that the start of the box is
+clearly behind, returns qtrue if it's clearly in front of any of them
+from firstSide on
+================
+*/
+static ID_INLINE qboolean CM_TestBrushSidesSSE( const traceWork_t *tw, const cbrush_t *brush, int firstSide, int *skipMask ) {
+	__m128	d1, epsilon;
+	int		group, lanes;
+
+	group = firstSide >> 2;
+	lanes = 0xf & ~( ( 1 << ( firstSide & 3 ) ) - 1 );
+	if ( brush->numsides - group * 4 < 4 ) {
+		lanes &= ( 1 << ( brush->numsides - group * 4 ) ) - 1;
+	}
+
+	CM_BrushPlaneDistsSSE( tw, &brush->planes[group], &d1, NULL );
+	epsilon = _mm_set1_ps( tw->planeEpsilon );
+
+	*skipMask = _mm_movemask_ps( _mm_cmplt_ps( d1, _mm_sub_ps( _mm_setzero_ps(), epsilon ) ) );
+
+	return ( _mm_movemask_ps( _mm_cmpgt_ps( d1, epsilon ) ) & lanes ) != 0;
+}
+
+/*
+================
+CM_ClipBrushSidesSSE
+
+Sets skipMask to the sides in the group that the trace clearly doesn't
+cross and outMask to the sides it is clearly completely in front of
+================
+*/
+static ID_INLINE void CM_ClipBrushSidesSSE( const traceWork_t *tw, const cbrush_t *brush, int group, int *skipMask, int *outMask ) {
+	__m128	d1, d2, epsilon, negEpsilon;
+
+	CM_BrushPlaneDistsSSE( tw, &brush->planes[group], &d1, &d2 );
+	epsilon = _mm_set1_ps( tw->planeEpsilon );
+	negEpsilon = _mm_sub_ps( _mm_setzero_ps(), epsilon );
+
+	*skipMask = _mm_movemask_ps( _mm_and_ps( _mm_cmplt_ps( d1, negEpsilon ), _mm_cmplt_ps( d2, negEpsilon ) ) );
+
+	// d1 > 0 && ( d2 >= SURFACE_CLIP_EPSILON || d2 >= d1 )
+	*outMask = _mm_movemask_ps( _mm_and_ps( _mm_cmpgt_ps( d1, epsilon ),
+		_mm_or_ps( _mm_cmpge_ps( d2, _mm_add_ps( _mm_set1_ps( SURFACE_CLIP_EPSILON ), epsilon ) ),
+			_mm_cmpge_ps( _mm_sub_ps( d2, d1 ), _mm_add_ps( epsilon, epsilon ) ) ) ) );
+}
+#endif
+
 /*
 ================
 CM_TestBoxInBrush
@@ -174,6 +281,10 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 	cbrushside_t	*side;
 	float		t;
 	vec3_t		startp;
+#ifdef CM_SSE_BRUSHES
+	qboolean	useSIMD;
+	int			skipMask;
+#endif
 
 	if (!brush->numsides) {
 		return;
@@ -216,9 +327,25 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 			}
 		}
 	} else {
+#ifdef CM_SSE_BRUSHES
+		useSIMD = CM_UseBrushPlanes( brush );
+		skipMask = 0;
+#endif
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
 		for ( i = 6 ; i < brush->numsides ; i++ ) {
+#ifdef CM_SSE_BRUSHES
+			if ( useSIMD ) {
+				if ( i == 6 || !( i & 3 ) ) {
+					if ( CM_TestBrushSidesSSE( tw, brush, i, &skipMask ) ) {
+						return;
+					}
+				}
+				if ( skipMask & ( 1 << ( i & 3 ) ) ) {
+					continue;
+				}
+			}
+#endif
 			side = brush->sides + i;
 			plane = side->plane;
 
@@ -250,6 +377,7 @@ CM_TestInLeaf
 void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
 	int			brushnum;
+	int			surfnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
@@ -257,10 +385,10 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if ( tw->ctx->brushChecks[brushnum] == tw->ctx->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->ctx->brushChecks[brushnum] = tw->ctx->checkcount;
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -279,14 +407,15 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->ctx->surfaceChecks[surfnum] == tw->ctx->checkcount ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->ctx->surfaceChecks[surfnum] = tw->ctx->checkcount;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -462,13 +591,11 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
-
-	cm.checkcount++;
+	ll.ctx = NULL;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
-
-	cm.checkcount++;
+	tw->ctx->checkcount++;
 
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
@@ -497,7 +624,9 @@ CM_TraceThroughPatch
 void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch, int surfnum ) {
 	float		oldFrac;
 
-	c_patch_traces++;
+	if ( tw->ctx == &cm.traceContext ) {
+		c_patch_traces++;
+	}
 
 	oldFrac = tw->trace.fraction;
 
@@ -527,6 +656,10 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 	float		t;
 	vec3_t		startp;
 	vec3_t		endp;
+#ifdef CM_SSE_BRUSHES
+	qboolean	useSIMD;
+	int			skipMask, outMask;
+#endif
 
 	enterFrac = -1.0;
 	leaveFrac = 1.0;
@@ -536,7 +669,9 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
-	c_brush_traces++;
+	if ( tw->ctx == &cm.traceContext ) {
+		c_brush_traces++;
+	}
 
 	getout = qfalse;
 	startout = qfalse;
@@ -575,7 +710,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			if( d1 <= 0 && d2 <= 0 )
 				continue;
 
-			brush->collided = qtrue;
+			tw->ctx->brushCollided[brush - cm.brushes] = qtrue;
 
 			// crosses face
 			if( d1 > d2 )
@@ -652,7 +787,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 				continue;
 			}
 
-			brush->collided = qtrue;
+			tw->ctx->brushCollided[brush - cm.brushes] = qtrue;
 
 			// crosses face
 			if (d1 > d2) {	// enter
@@ -676,12 +811,36 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			}
 		}
 	} else {
+#ifdef CM_SSE_BRUSHES
+		useSIMD = CM_UseBrushPlanes( brush );
+		skipMask = outMask = 0;
+#endif
 		//
 		// compare the trace against all planes of the brush
 		// find the latest time the trace crosses a plane towards the interior
 		// and the earliest time the trace crosses a plane towards the exterior
 		//
 		for (i = 0; i < brush->numsides; i++) {
+#ifdef CM_SSE_BRUSHES
+			// check four sides at a time and only do the exact test
+			// on sides that are crossed or too close to call
+			if ( useSIMD ) {
+				if ( !( i & 3 ) ) {
+					CM_ClipBrushSidesSSE( tw, brush, i >> 2, &skipMask, &outMask );
+
+					if ( ( skipMask & 0xf ) == 0xf ) {
+						i |= 3;
+						continue;
+					}
+				}
+				if ( skipMask & ( 1 << ( i & 3 ) ) ) {
+					continue;
+				}
+				if ( outMask & ( 1 << ( i & 3 ) ) ) {
+					return;
+				}
+			}
+#endif
 			side = brush->sides + i;
 			plane = side->plane;
 
@@ -708,7 +867,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 				continue;
 			}
 
-			brush->collided = qtrue;
+			tw->ctx->brushCollided[brush - cm.brushes] = qtrue;
 
 			// crosses face
 			if (d1 > d2) {	// enter
@@ -782,6 +941,7 @@ static void CM_ProximityToBrush( traceWork_t *tw, cbrush_t *brush )
 
 	// cheapish purely linear trace to test for intersection
 	Com_Memset( &tw2, 0, sizeof( tw2 ) );
+	tw2.ctx = tw->ctx;
 	tw2.trace.fraction = 1.0f;
 	tw2.type = TT_CAPSULE;
 	tw2.sphere.radius = 0.0f;
@@ -841,6 +1001,7 @@ static void CM_ProximityToPatch( traceWork_t *tw, cPatch_t *patch, int surfnum )
 
 	// cheapish purely linear trace to test for intersection
 	Com_Memset( &tw2, 0, sizeof( tw2 ) );
+	tw2.ctx = tw->ctx;
 	tw2.trace.fraction = 1.0f;
 	tw2.type = TT_CAPSULE;
 	tw2.sphere.radius = 0.0f;
@@ -875,16 +1036,16 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tw->ctx->brushChecks[brushnum] == tw->ctx->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->ctx->brushChecks[brushnum] = tw->ctx->checkcount;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
 		}
 
-		b->collided = qfalse;
+		tw->ctx->brushCollided[brushnum] = qfalse;
 
 		if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
 					b->bounds[0], b->bounds[1] ) ) {
@@ -910,10 +1071,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->ctx->surfaceChecks[surfnum] == tw->ctx->checkcount ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->ctx->surfaceChecks[surfnum] = tw->ctx->checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -937,7 +1098,7 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			b = &cm.brushes[ brushnum ];
 
 			// This brush never collided, so don't bother
-			if( !b->collided )
+			if( !tw->ctx->brushCollided[ brushnum ] )
 				continue;
 
 			if( !( b->contents & tw->contents ) )
@@ -1318,8 +1479,8 @@ a smaller intercept fraction.
 ==================
 */
 void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t p1, vec3_t p2) {
-	cNode_t		*node;
-	cplane_t	*plane;
+	const cPackedNode_t	*node;
+	const cplane_t	*plane;
 	float		t1, t2, offset;
 	float		frac, frac2;
 	float		idist;
@@ -1341,8 +1502,8 @@ void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t
 	// find the point distances to the separating plane
 	// and the offset for the size of the box
 	//
-	node = cm.nodes + num;
-	plane = node->plane;
+	node = cm.packedNodes + num;
+	plane = &node->plane;
 
 	// adjust the plane distance appropriately for mins/maxs
 	if ( plane->type < 3 ) {
@@ -1430,7 +1591,7 @@ void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t
 CM_Trace
 ==================
 */
-void CM_Trace( trace_t *results, const vec3_t start,
+static void CM_Trace( traceContext_t *ctx, trace_t *results, const vec3_t start,
 		const vec3_t end, const vec3_t mins, const vec3_t maxs,
 		clipHandle_t model, const vec3_t origin, int brushmask,
 		traceType_t type, sphere_t *sphere ) {
@@ -1441,12 +1602,15 @@ void CM_Trace( trace_t *results, const vec3_t start,
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
+	ctx->checkcount++;		// for multi-check avoidance
 
-	c_traces++;				// for statistics, may be zeroed
+	if ( ctx == &cm.traceContext ) {
+		c_traces++;			// for statistics, may be zeroed
+	}
 
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof(tw) );
+	tw.ctx = ctx;
 	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
 	tw.type = type;
@@ -1491,6 +1655,15 @@ void CM_Trace( trace_t *results, const vec3_t start,
 
 	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
 
+	// plane distances are sums of terms no larger than this, rounding
+	// differences between two ways of adding them up are well under
+	// 2^-17 of it
+	tw.planeEpsilon = cm.maxPlaneDist + tw.maxOffset;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		tw.planeEpsilon += MAX( fabs( tw.start[i] ), fabs( tw.end[i] ) );
+	}
+	tw.planeEpsilon *= 1.0f / ( 1 << 17 );
+
 	// tw.offsets[signbits] = vector to appropriate corner from origin
 	tw.offsets[0][0] = tw.size[0][0];
 	tw.offsets[0][1] = tw.size[0][1];
@@ -1645,6 +1818,17 @@ void CM_Trace( trace_t *results, const vec3_t start,
 	*results = tw.trace;
 }
 
+/*
+==================
+CM_BoxTraceContext
+==================
+*/
+void CM_BoxTraceContext( traceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs,
+						  clipHandle_t model, int brushmask, traceType_t type ) {
+	CM_Trace( ctx, results, start, end, mins, maxs, model, vec3_origin, brushmask, type, NULL );
+}
+
 /*
 ==================
 CM_BoxTrace
@@ -1653,18 +1837,32 @@ CM_BoxTrace
 void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 						  const vec3_t mins, const vec3_t maxs,
 						  clipHandle_t model, int brushmask, traceType_t type ) {
-	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, type, NULL );
+#ifndef BSPC
+	if ( cm_traceCaptureFile && model == 0 ) {
+		traceRequest_t	req;
+
+		VectorCopy( start, req.start );
+		VectorCopy( end, req.end );
+		VectorCopy( mins ? mins : vec3_origin, req.mins );
+		VectorCopy( maxs ? maxs : vec3_origin, req.maxs );
+		req.passEntityNum = ENTITYNUM_NONE;
+		req.contentmask = brushmask;
+		req.traceType = type;
+		CM_CaptureTraces( &req, 1 );
+	}
+#endif
+	CM_Trace( &cm.traceContext, results, start, end, mins, maxs, model, vec3_origin, brushmask, type, NULL );
 }
 
 /*
 ==================
-CM_TransformedBoxTrace
+CM_TransformedBoxTraceContext
 
 Handles offseting and rotation of the end points for moving and
 rotating entities
 ==================
 */
-void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+void CM_TransformedBoxTraceContext( traceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
 						  const vec3_t mins, const vec3_t maxs,
 						  clipHandle_t model, int brushmask,
 						  const vec3_t origin, const vec3_t angles, traceType_t type ) {
@@ -1738,7 +1936,7 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	}
 
 	// sweep the box through the model
-	CM_Trace( &trace, start_l, end_l, symetricSize[0], symetricSize[1],
+	CM_Trace( ctx, &trace, start_l, end_l, symetricSize[0], symetricSize[1],
 			model, origin, brushmask, type, &sphere );
 
 	// if the bmodel was rotated and there was a collision
@@ -1757,6 +1955,18 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	*results = trace;
 }
 
+/*
+==================
+CM_TransformedBoxTrace
+==================
+*/
+void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs,
+						  clipHandle_t model, int brushmask,
+						  const vec3_t origin, const vec3_t angles, traceType_t type ) {
+	CM_TransformedBoxTraceContext( &cm.traceContext, results, start, end, mins, maxs, model, brushmask, origin, angles, type );
+}
+
 /*
 ==================
 CM_BiSphereTrace
@@ -1773,12 +1983,13 @@ void CM_BiSphereTrace( trace_t *results, const vec3_t start,
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
+	cm.traceContext.checkcount++;	// for multi-check avoidance
 
 	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof( tw ) );
+	tw.ctx = &cm.traceContext;
 	tw.trace.fraction = 1.0f; // assume it goes the entire distance until shown otherwise
 	VectorCopy( vec3_origin, tw.modelOrigin );
 	tw.type = TT_BISPHERE;
@@ -1882,3 +2093,639 @@ void CM_TransformedBiSphereTrace( trace_t *results, const vec3_t start,
 
 	*results = trace;
 }
+
+#ifndef BSPC
+/*
+===============================================================================
+
+BATCHED TRACES
+
+===============================================================================
+*/
+
+#define MAX_TRACE_BATCH			1024	// requests sorted at a time
+#define MIN_TRACE_BATCH_JOB		64		// don't wake a thread for fewer traces
+#define MAX_TRACE_BATCH_JOBS	( MAX_WORKER_THREADS + 1 )
+#define TRACE_BATCH_KEY_BYTES	6		// 1 bit type, 12 bits size, 30 bits position
+
+#define TRACE_CAPTURE_IDENT		( ( 'W' << 24 ) + ( 'C' << 16 ) + ( 'R' << 8 ) + 'T' )
+#define TRACE_CAPTURE_VERSION	1
+#define TRACE_CAPTURE_HEADER	( 3 * 4 )
+#define TRACE_CAPTURE_RECORD	( 15 * 4 )
+
+typedef struct {
+	uint64_t		key;
+	int				index;
+} traceBatchOrder_t;
+
+typedef struct {
+	trace_t					*results;
+	const traceRequest_t	*requests;
+	const traceBatchOrder_t	*order;
+	int						numRequests;
+	int						numJobs;
+	clipHandle_t			model;
+} traceBatch_t;
+
+// job 0 uses cm.traceContext, the others are allocated the first time
+// they are needed and freed with the map
+static traceContext_t		*cm_batchContexts[MAX_TRACE_BATCH_JOBS];
+static traceBatchOrder_t	cm_batchOrder[MAX_TRACE_BATCH];
+static traceBatchOrder_t	cm_batchSortTemp[MAX_TRACE_BATCH];
+
+static int					cm_traceCaptureCount;
+
+/*
+==================
+CM_TraceBatchKey
+
+Sort key that groups traces of the same type and size, so the same box
+offsets and code paths are used back to back, and then orders them along
+a Morton curve through 32 unit cells so neighbouring traces walk the same
+nodes and brushes while they are still in the cache
+==================
+*/
+static uint64_t CM_TraceBatchKey( const traceRequest_t *req ) {
+	uint64_t	morton;
+	int			i, b, size, cell;
+
+	size = 0;
+	for ( i = 0; i < 3; i++ ) {
+		size += (int)( req->maxs[i] - req->mins[i] );
+	}
+	size = Com_Clamp( 0, 4095, size );
+
+	morton = 0;
+	for ( i = 0; i < 3; i++ ) {
+		cell = ( (int)( ( req->start[i] + req->end[i] ) * 0.5f ) >> 5 ) + 512;
+		cell = Com_Clamp( 0, 1023, cell );
+
+		for ( b = 0; b < 10; b++ ) {
+			morton |= (uint64_t)( ( cell >> b ) & 1 ) << ( b * 3 + i );
+		}
+	}
+
+	return ( (uint64_t)( req->traceType == TT_CAPSULE ) << 42 ) | ( (uint64_t)size << 30 ) | morton;
+}
+
+/*
+==================
+CM_SortTraceBatch
+
+Byte-wise radix sort, much cheaper than qsort for a batch of keys that
+only use the low TRACE_BATCH_KEY_BYTES.  Equal keys keep request order.
+==================
+*/
+static void CM_SortTraceBatch( traceBatchOrder_t *order, int count ) {
+	traceBatchOrder_t	*in, *out, *temp;
+	int					counts[256];
+	int					i, shift, total, c;
+
+	in = order;
+	out = cm_batchSortTemp;
+
+	for ( shift = 0; shift < TRACE_BATCH_KEY_BYTES * 8; shift += 8 ) {
+		Com_Memset( counts, 0, sizeof( counts ) );
+		for ( i = 0; i < count; i++ ) {
+			counts[( in[i].key >> shift ) & 255]++;
+		}
+
+		// all keys have the same byte
+		if ( counts[( in[0].key >> shift ) & 255] == count ) {
+			continue;
+		}
+
+		for ( i = 0, total = 0; i < 256; i++ ) {
+			c = counts[i];
+			counts[i] = total;
+			total += c;
+		}
+
+		for ( i = 0; i < count; i++ ) {
+			out[counts[( in[i].key >> shift ) & 255]++] = in[i];
+		}
+
+		temp = in;
+		in = out;
+		out = temp;
+	}
+
+	if ( in != order ) {
+		Com_Memcpy( order, in, count * sizeof( *order ) );
+	}
+}
+
+/*
+==================
+CM_TraceBatchJob
+
+Each job does a contiguous run of the sorted requests
+==================
+*/
+static void CM_TraceBatchJob( void *data, int jobNum ) {
+	traceBatch_t			*batch = data;
+	const traceRequest_t	*req;
+	traceContext_t			*ctx;
+	int						i, first, last;
+
+	ctx = jobNum ? cm_batchContexts[jobNum] : &cm.traceContext;
+
+	first = batch->numRequests * jobNum / batch->numJobs;
+	last = batch->numRequests * ( jobNum + 1 ) / batch->numJobs;
+
+	for ( i = first; i < last; i++ ) {
+		req = &batch->requests[batch->order[i].index];
+
+		// bisphere traces need more than a request holds
+		CM_Trace( ctx, &batch->results[batch->order[i].index], req->start, req->end, req->mins, req->maxs,
+			batch->model, vec3_origin, req->contentmask, req->traceType == TT_CAPSULE ? TT_CAPSULE : TT_AABB, NULL );
+	}
+}
+
+/*
+==================
+CM_CaptureTraces
+==================
+*/
+static void CM_CaptureTraces( const traceRequest_t *requests, int numRequests ) {
+	const traceRequest_t	*req;
+	int						i, j, out[15];
+
+	for ( i = 0, req = requests; i < numRequests; i++, req++ ) {
+		for ( j = 0; j < 3; j++ ) {
+			( (float *)out )[j] = LittleFloat( req->start[j] );
+			( (float *)out )[3+j] = LittleFloat( req->end[j] );
+			( (float *)out )[6+j] = LittleFloat( req->mins[j] );
+			( (float *)out )[9+j] = LittleFloat( req->maxs[j] );
+		}
+		out[12] = LittleLong( req->passEntityNum );
+		out[13] = LittleLong( req->contentmask );
+		out[14] = LittleLong( req->traceType );
+
+		FS_Write( out, sizeof( out ), cm_traceCaptureFile );
+	}
+
+	cm_traceCaptureCount += numRequests;
+}
+
+/*
+==================
+CM_TraceBatch
+==================
+*/
+static void CM_TraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests, clipHandle_t model, int numWorkers ) {
+	traceBatch_t	batch;
+	int				i, count;
+
+	batch.model = model;
+	numWorkers = Com_Clamp( 0, MAX_WORKER_THREADS, numWorkers );
+
+	for ( ; numRequests > 0; numRequests -= count, requests += count, results += count ) {
+		count = MIN( numRequests, MAX_TRACE_BATCH );
+
+		for ( i = 0; i < count; i++ ) {
+			cm_batchOrder[i].key = CM_TraceBatchKey( &requests[i] );
+			cm_batchOrder[i].index = i;
+		}
+		CM_SortTraceBatch( cm_batchOrder, count );
+
+		batch.results = results;
+		batch.requests = requests;
+		batch.order = cm_batchOrder;
+		batch.numRequests = count;
+		batch.numJobs = Com_Clamp( 1, MIN( numWorkers + 1, MAX_TRACE_BATCH_JOBS ), count / MIN_TRACE_BATCH_JOB );
+
+		for ( i = 1; i < batch.numJobs; i++ ) {
+			if ( !cm_batchContexts[i] ) {
+				cm_batchContexts[i] = CM_AllocTraceContext();
+			}
+		}
+
+		Com_RunJobs( CM_TraceBatchJob, &batch, batch.numJobs, batch.numJobs - 1 );
+	}
+}
+
+/*
+==================
+CM_BoxTraceBatch
+==================
+*/
+void CM_BoxTraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests, clipHandle_t model ) {
+	if ( cm_traceCaptureFile && model == 0 ) {
+		CM_CaptureTraces( requests, numRequests );
+	}
+
+	CM_TraceBatch( results, requests, numRequests, model, cm_traceThreads ? cm_traceThreads->integer : 0 );
+}
+
+/*
+==================
+CM_StopTraceCapture
+==================
+*/
+static void CM_StopTraceCapture( void ) {
+	if ( !cm_traceCaptureFile ) {
+		return;
+	}
+
+	FS_FCloseFile( cm_traceCaptureFile );
+	cm_traceCaptureFile = 0;
+
+	Com_Printf( "Captured %d traces.\n", cm_traceCaptureCount );
+}
+
+/*
+==================
+CM_ShutdownTraceBatch
+
+Called when the map is cleared
+==================
+*/
+void CM_ShutdownTraceBatch( void ) {
+	int i;
+
+	CM_StopTraceCapture();
+
+	for ( i = 0; i < MAX_TRACE_BATCH_JOBS; i++ ) {
+		if ( cm_batchContexts[i] ) {
+			CM_FreeTraceContext( cm_batchContexts[i] );
+			cm_batchContexts[i] = NULL;
+		}
+	}
+}
+
+/*
+==================
+CM_TraceCapture_f
+
+Record world traces made through CM_BoxTrace and CM_BoxTraceBatch
+so they can be replayed with traceReplay
+==================
+*/
+void CM_TraceCapture_f( void ) {
+	char	filename[MAX_QPATH];
+	int		header[3];
+
+	if ( Cmd_Argc() != 2 ) {
+		if ( cm_traceCaptureFile ) {
+			CM_StopTraceCapture();
+		} else {
+			Com_Printf( "Usage: traceCapture <filename>, with no filename stops capturing\n" );
+		}
+		return;
+	}
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	CM_StopTraceCapture();
+
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".trc" );
+
+	cm_traceCaptureFile = FS_FOpenFileWrite( filename );
+	if ( !cm_traceCaptureFile ) {
+		Com_Printf( "Couldn't open %s for writing.\n", filename );
+		return;
+	}
+
+	header[0] = LittleLong( TRACE_CAPTURE_IDENT );
+	header[1] = LittleLong( TRACE_CAPTURE_VERSION );
+	header[2] = LittleLong( cm.checksum );
+	FS_Write( header, sizeof( header ), cm_traceCaptureFile );
+
+	cm_traceCaptureCount = 0;
+
+	Com_Printf( "Capturing traces to %s.\n", filename );
+}
+
+/*
+==================
+CM_SameTrace
+==================
+*/
+static qboolean CM_SameTrace( const trace_t *a, const trace_t *b ) {
+	return a->fraction == b->fraction
+		&& a->allsolid == b->allsolid
+		&& a->startsolid == b->startsolid
+		&& a->contents == b->contents
+		&& a->surfaceFlags == b->surfaceFlags
+		&& VectorCompare( a->endpos, b->endpos )
+		&& VectorCompare( a->plane.normal, b->plane.normal );
+}
+
+/*
+==================
+CM_TraceReplay_f
+
+Replay a captured trace workload one trace at a time and then batched,
+and check the results match
+==================
+*/
+void CM_TraceReplay_f( void ) {
+	char			filename[MAX_QPATH];
+	traceRequest_t	*requests, *req;
+	trace_t			*reference, *results;
+	int				*buf, *in;
+	int				numRequests, numWorkers, length, i, j, mismatches;
+	int64_t			start, singleUsec, batchUsec;
+
+	if ( Cmd_Argc() < 2 || Cmd_Argc() > 3 ) {
+		Com_Printf( "Usage: traceReplay <filename> [worker threads]\n" );
+		return;
+	}
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".trc" );
+
+	numWorkers = ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : cm_traceThreads->integer;
+	numWorkers = Com_Clamp( 0, MAX_WORKER_THREADS, numWorkers );
+
+	length = FS_ReadFile( filename, (void **)&buf );
+	if ( !buf ) {
+		Com_Printf( "Couldn't load %s.\n", filename );
+		return;
+	}
+
+	if ( length < TRACE_CAPTURE_HEADER || LittleLong( buf[0] ) != TRACE_CAPTURE_IDENT
+		|| LittleLong( buf[1] ) != TRACE_CAPTURE_VERSION ) {
+		Com_Printf( "%s is not a trace capture.\n", filename );
+		FS_FreeFile( buf );
+		return;
+	}
+
+	if ( LittleLong( buf[2] ) != cm.checksum ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: %s was captured on a different map.\n", filename );
+	}
+
+	numRequests = ( length - TRACE_CAPTURE_HEADER ) / TRACE_CAPTURE_RECORD;
+	if ( !numRequests ) {
+		Com_Printf( "%s has no traces.\n", filename );
+		FS_FreeFile( buf );
+		return;
+	}
+
+	requests = Z_Malloc( numRequests * sizeof( *requests ) );
+	reference = Z_Malloc( numRequests * sizeof( *reference ) );
+	results = Z_Malloc( numRequests * sizeof( *results ) );
+
+	in = buf + TRACE_CAPTURE_HEADER / 4;
+	for ( i = 0, req = requests; i < numRequests; i++, req++, in += TRACE_CAPTURE_RECORD / 4 ) {
+		for ( j = 0; j < 3; j++ ) {
+			req->start[j] = LittleFloat( ( (float *)in )[j] );
+			req->end[j] = LittleFloat( ( (float *)in )[3+j] );
+			req->mins[j] = LittleFloat( ( (float *)in )[6+j] );
+			req->maxs[j] = LittleFloat( ( (float *)in )[9+j] );
+		}
+		req->passEntityNum = LittleLong( in[12] );
+		req->contentmask = LittleLong( in[13] );
+		req->traceType = ( LittleLong( in[14] ) == TT_CAPSULE ) ? TT_CAPSULE : TT_AABB;
+	}
+
+	FS_FreeFile( buf );
+
+	start = Sys_Microseconds();
+	for ( i = 0, req = requests; i < numRequests; i++, req++ ) {
+		CM_BoxTrace( &reference[i], req->start, req->end, req->mins, req->maxs, 0, req->contentmask, req->traceType );
+	}
+	singleUsec = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	CM_TraceBatch( results, requests, numRequests, 0, numWorkers );
+	batchUsec = Sys_Microseconds() - start;
+
+	mismatches = 0;
+	for ( i = 0; i < numRequests; i++ ) {
+		if ( !CM_SameTrace( &reference[i], &results[i] ) ) {
+			mismatches++;
+		}
+	}
+
+	Com_Printf( "%d traces: one at a time %d usec, batched with %d workers %d usec\n",
+		numRequests, (int)singleUsec, numWorkers, (int)batchUsec );
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_RED "%d traces DO NOT MATCH\n", mismatches );
+	} else {
+		Com_Printf( "results match\n" );
+	}
+
+	Z_Free( results );
+	Z_Free( reference );
+	Z_Free( requests );
+}
+
+/*
+===============================================================================
+
+TRACE STRESS TEST
+
+===============================================================================
+*/
+
+#define MAX_STRESS_JOBS		( MAX_WORKER_THREADS + 1 )
+
+typedef struct {
+	int				numTraces;
+	int				numJobs;
+	vec3_t			*points;		// [numTraces*2] start and end of each trace
+	trace_t			*results;		// [numTraces]
+	traceContext_t	*contexts[MAX_STRESS_JOBS];
+} cmTraceStress_t;
+
+static const vec3_t cm_stressMins[3] = { { 0, 0, 0 }, { -15, -15, -24 }, { -8, -8, -8 } };
+static const vec3_t cm_stressMaxs[3] = { { 0, 0, 0 }, { 15, 15, 32 }, { 8, 8, 8 } };
+
+/*
+==================
+CM_TraceStressJob
+
+Each job does every numJobs'th trace against all contents so all jobs
+trace through the same parts of the map at the same time
+==================
+*/
+static void CM_TraceStressJob( void *data, int jobNum ) {
+	cmTraceStress_t	*stress = data;
+	traceContext_t	*ctx;
+	clipHandle_t	model;
+	int				i, box;
+
+	ctx = stress->contexts[jobNum];
+
+	for ( i = jobNum; i < stress->numTraces; i += stress->numJobs ) {
+		box = i % 3;
+
+		if ( i % 7 == 0 && cm.numSubModels > 1 ) {
+			model = 1 + ( i / 7 ) % ( cm.numSubModels - 1 );
+			CM_TransformedBoxTraceContext( ctx, &stress->results[i], stress->points[i*2], stress->points[i*2+1],
+				cm_stressMins[box], cm_stressMaxs[box], model, -1, vec3_origin, vec3_origin, TT_AABB );
+		} else {
+			CM_BoxTraceContext( ctx, &stress->results[i], stress->points[i*2], stress->points[i*2+1],
+				cm_stressMins[box], cm_stressMaxs[box], 0, -1, TT_AABB );
+		}
+	}
+}
+
+/*
+==================
+CM_TraceStress_f
+
+Trace random boxes through the loaded map with one thread and then with
+several threads each using their own context, and check the results match
+==================
+*/
+void CM_TraceStress_f( void ) {
+	cmTraceStress_t	stress;
+	trace_t			*reference;
+	vec3_t			mins, maxs;
+	int				numThreads, start, singleMsec, threadedMsec;
+	int				i, j, r, mismatches;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 3 ) {
+		Com_Printf( "Usage: traceStress [traces] [threads]\n" );
+		return;
+	}
+
+	stress.numTraces = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : 100000;
+	numThreads = ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : 4;
+	stress.numTraces = Com_Clamp( 1, 10000000, stress.numTraces );
+	numThreads = Com_Clamp( 1, MAX_STRESS_JOBS, numThreads );
+
+	stress.points = Z_Malloc( stress.numTraces * 2 * sizeof( vec3_t ) );
+	stress.results = Z_Malloc( stress.numTraces * sizeof( trace_t ) );
+	reference = Z_Malloc( stress.numTraces * sizeof( trace_t ) );
+
+	CM_ModelBounds( 0, mins, maxs );
+
+	// fixed seed so runs can be compared, traces up to 1024 units long
+	r = 0x12345;
+	for ( i = 0; i < stress.numTraces; i++ ) {
+		for ( j = 0; j < 3; j++ ) {
+			r = r * 1103515245 + 12345;
+			stress.points[i*2][j] = mins[j] + ( maxs[j] - mins[j] ) * ( ( r >> 8 ) & 0xffff ) / 65535.0f;
+			r = r * 1103515245 + 12345;
+			stress.points[i*2+1][j] = stress.points[i*2][j] + ( ( ( r >> 8 ) & 0xffff ) / 65535.0f - 0.5f ) * 1024;
+		}
+	}
+
+	// everything on this thread with one context
+	stress.numJobs = 1;
+	stress.contexts[0] = CM_AllocTraceContext();
+
+	start = Sys_Milliseconds();
+	CM_TraceStressJob( &stress, 0 );
+	singleMsec = Sys_Milliseconds() - start;
+
+	Com_Memcpy( reference, stress.results, stress.numTraces * sizeof( trace_t ) );
+	Com_Memset( stress.results, 0, stress.numTraces * sizeof( trace_t ) );
+
+	// again with a context for each thread
+	stress.numJobs = numThreads;
+	for ( i = 1; i < numThreads; i++ ) {
+		stress.contexts[i] = CM_AllocTraceContext();
+	}
+
+	start = Sys_Milliseconds();
+	Com_RunJobs( CM_TraceStressJob, &stress, numThreads, numThreads - 1 );
+	threadedMsec = Sys_Milliseconds() - start;
+
+	mismatches = 0;
+	for ( i = 0; i < stress.numTraces; i++ ) {
+		if ( !CM_SameTrace( &reference[i], &stress.results[i] ) ) {
+			mismatches++;
+		}
+	}
+
+	Com_Printf( "%d traces: 1 thread %d msec, %d threads %d msec\n", stress.numTraces, singleMsec, numThreads, threadedMsec );
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_RED "%d traces DO NOT MATCH\n", mismatches );
+	} else {
+		Com_Printf( "results match\n" );
+	}
+
+	for ( i = 0; i < numThreads; i++ ) {
+		CM_FreeTraceContext( stress.contexts[i] );
+	}
+
+	Z_Free( reference );
+	Z_Free( stress.results );
+	Z_Free( stress.points );
+}
+
+/*
+==================
+CM_CollisionBench_f
+
+Times CM_PointContents, point traces and box traces at random places in
+the loaded map.  The checksums only depend on the results, so they can be
+compared between builds.
+==================
+*/
+void CM_CollisionBench_f( void ) {
+	vec3_t			*points;
+	vec3_t			mins, maxs;
+	trace_t			trace;
+	floatint_t		fi;
+	unsigned		checksum;
+	int				count, start, msec;
+	int				i, j, r, box;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	count = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : 1000000;
+	count = Com_Clamp( 1, 10000000, count );
+
+	points = Z_Malloc( count * 2 * sizeof( vec3_t ) );
+
+	CM_ModelBounds( 0, mins, maxs );
+
+	// same points as traceStress
+	r = 0x12345;
+	for ( i = 0; i < count; i++ ) {
+		for ( j = 0; j < 3; j++ ) {
+			r = r * 1103515245 + 12345;
+			points[i*2][j] = mins[j] + ( maxs[j] - mins[j] ) * ( ( r >> 8 ) & 0xffff ) / 65535.0f;
+			r = r * 1103515245 + 12345;
+			points[i*2+1][j] = points[i*2][j] + ( ( ( r >> 8 ) & 0xffff ) / 65535.0f - 0.5f ) * 1024;
+		}
+	}
+
+	checksum = 0;
+	start = Sys_Milliseconds();
+	for ( i = 0; i < count; i++ ) {
+		checksum = checksum * 31 + CM_PointContents( points[i*2], 0 );
+	}
+	msec = Sys_Milliseconds() - start;
+	Com_Printf( "CM_PointContents: %d in %d msec, %.0f per second, checksum %08x\n",
+		count, msec, count * 1000.0f / MAX( msec, 1 ), checksum );
+
+	for ( box = 0; box < 2; box++ ) {
+		checksum = 0;
+		start = Sys_Milliseconds();
+		for ( i = 0; i < count; i++ ) {
+			CM_BoxTrace( &trace, points[i*2], points[i*2+1], cm_stressMins[box], cm_stressMaxs[box], 0, -1, TT_AABB );
+			fi.f = trace.fraction;
+			checksum = checksum * 31 + fi.ui + trace.contents;
+		}
+		msec = Sys_Milliseconds() - start;
+		Com_Printf( "CM_BoxTrace %s: %d in %d msec, %.0f per second, checksum %08x\n", box ? "box" : "point",
+			count, msec, count * 1000.0f / MAX( msec, 1 ), checksum );
+	}
+
+	Z_Free( points );
+}
+#endif
@@ -109,6 +109,7 @@ cvar_t	*com_legacyprotocol;
 #endif
 cvar_t  *com_homepath;
 cvar_t	*com_busyWait;
+cvar_t	*com_loadTimes;
 #ifndef DEDICATED
 cvar_t  *con_autochat;
 #endif
@@ -2357,23 +2358,15 @@ void Com_QueueEvent( int time, sysEventType_t type, int value, int value2, int p
 
 /*
 ================
-Com_GetSystemEvent
+Com_QueueConsoleInput
 
+Queue console commands
 ================
 */
-sysEvent_t Com_GetSystemEvent( void )
+static void Com_QueueConsoleInput( void )
 {
-	sysEvent_t  ev;
 	char        *s;
 
-	// return if we have data
-	if ( eventHead > eventTail )
-	{
-		eventTail++;
-		return eventQueue[ ( eventTail - 1 ) & MASK_QUEUED_EVENTS ];
-	}
-
-	// check for console commands
 	s = Sys_ConsoleInput();
 	if ( s )
 	{
@@ -2385,6 +2378,27 @@ sysEvent_t Com_GetSystemEvent( void )
 		strcpy( b, s );
 		Com_QueueEvent( 0, SE_CONSOLE, 0, 0, len, b );
 	}
+}
+
+/*
+================
+Com_GetSystemEvent
+
+================
+*/
+sysEvent_t Com_GetSystemEvent( void )
+{
+	sysEvent_t  ev;
+
+	// return if we have data
+	if ( eventHead > eventTail )
+	{
+		eventTail++;
+		return eventQueue[ ( eventTail - 1 ) & MASK_QUEUED_EVENTS ];
+	}
+
+	// check for console commands
+	Com_QueueConsoleInput();
 
 	// return if we have data
 	if ( eventHead > eventTail )
@@ -2967,6 +2981,12 @@ void Com_Init( char *commandLine ) {
 	}
 	Cmd_AddCommand ("quit", Com_Quit_f);
 	Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
+	Cmd_AddCommand ("huffBenchmark", MSG_HuffmanBenchmark_f );
+	Cmd_AddCommand ("deltaBenchmark", MSG_DeltaBenchmark_f );
+	Cmd_AddCommand ("traceStress", CM_TraceStress_f );
+	Cmd_AddCommand ("traceCapture", CM_TraceCapture_f );
+	Cmd_AddCommand ("traceReplay", CM_TraceReplay_f );
+	Cmd_AddCommand ("collisionBench", CM_CollisionBench_f );
 	Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 	Cmd_AddCommand("game_restart", Com_GameRestart_f);
@@ -3023,6 +3043,7 @@ void Com_Init( char *commandLine ) {
 	com_maxfpsMinimized = Cvar_Get( "com_maxfpsMinimized", "0", CVAR_ARCHIVE );
 	com_abnormalExit = Cvar_Get( "com_abnormalExit", "0", CVAR_ROM );
 	com_busyWait = Cvar_Get("com_busyWait", "0", CVAR_ARCHIVE);
+	com_loadTimes = Cvar_Get("com_loadTimes", "0", 0);
 	Cvar_Get("com_errorMessage", "", CVAR_ROM | CVAR_NORESTART);
 
 	com_productName = Cvar_Get( "com_productName", PRODUCT_NAME, CVAR_ROM );
@@ -3490,6 +3511,28 @@ int Com_TimeVal(int minMsec)
 	return timeVal;
 }
 
+/*
+=================
+Com_TimeValUsec
+
+Microseconds until minMsec have passed since the frame started
+=================
+*/
+static int Com_TimeValUsec(int minMsec)
+{
+	int64_t timeVal;
+
+	timeVal = (int64_t)(com_frameTime + minMsec) * 1000 - Sys_Microseconds();
+
+	if(timeVal <= 0)
+		return 0;
+
+	if(timeVal > minMsec * 1000)
+		return minMsec * 1000;
+
+	return timeVal;
+}
+
 /*
 =================
 Com_Frame
@@ -3564,18 +3607,22 @@ void Com_Frame( void ) {
 		{
 			timeValSV = SV_SendQueuedPackets();
 			
-			timeVal = Com_TimeVal(minMsec);
+			timeVal = Com_TimeValUsec(minMsec);
 
 			if(timeValSV < timeVal)
 				timeVal = timeValSV;
 		}
 		else
-			timeVal = Com_TimeVal(minMsec);
+			timeVal = Com_TimeValUsec(minMsec);
 		
-		if(com_busyWait->integer || timeVal < 1)
+		if(com_busyWait->integer)
 			NET_Sleep(0);
-		else
-			NET_Sleep(timeVal - 1);
+		else if(NET_Sleep(timeVal))
+		{
+			// read it now so it doesn't keep waking us up,
+			// it's executed with the rest of the frame's events
+			Com_QueueConsoleInput();
+		}
 	} while(Com_TimeVal(minMsec));
 	
 	IN_Frame();
@@ -3697,6 +3744,279 @@ void Com_Frame( void ) {
 	com_frameNumber++;
 }
 
+/*
+===========================================
+load stage timing
+===========================================
+*/
+
+#define	MAX_LOAD_STAGES		32
+
+typedef struct {
+	const char	*name;
+	int			msec;
+} loadStage_t;
+
+typedef struct {
+	qboolean	active;
+	char		name[MAX_QPATH];
+	int			startMsec;
+	int			lastMsec;
+	int			numStages;
+	loadStage_t	stages[MAX_LOAD_STAGES];
+} loadStages_t;
+
+static loadStages_t	loadStages;
+
+/*
+=================
+Com_BeginLoadStages
+
+Starts timing a level load, each Com_LoadStage marks the end of a stage
+=================
+*/
+void Com_BeginLoadStages( const char *name ) {
+	Q_strncpyz( loadStages.name, name, sizeof( loadStages.name ) );
+	loadStages.active = qtrue;
+	loadStages.numStages = 0;
+	loadStages.startMsec = loadStages.lastMsec = Sys_Milliseconds();
+}
+
+/*
+=================
+Com_LoadStage
+
+Records the time since the previous stage, stage is kept so it must be a
+string literal.  Does nothing outside of a load.
+=================
+*/
+void Com_LoadStage( const char *stage ) {
+	loadStage_t	*ls;
+	int			msec;
+
+	if ( !loadStages.active ) {
+		return;
+	}
+
+	msec = Sys_Milliseconds();
+
+	if ( loadStages.numStages < MAX_LOAD_STAGES ) {
+		ls = &loadStages.stages[ loadStages.numStages++ ];
+		ls->name = stage;
+		ls->msec = msec - loadStages.lastMsec;
+	}
+
+	loadStages.lastMsec = msec;
+}
+
+/*
+=================
+Com_EndLoadStages
+
+Prints the stages if com_loadTimes is set
+=================
+*/
+void Com_EndLoadStages( void ) {
+	int		i;
+
+	if ( !loadStages.active ) {
+		return;
+	}
+
+	Com_LoadStage( "other" );
+	loadStages.active = qfalse;
+
+	if ( !com_loadTimes->integer ) {
+		return;
+	}
+
+	Com_Printf( "%s loaded in %i msec\n", loadStages.name, loadStages.lastMsec - loadStages.startMsec );
+	for ( i = 0; i < loadStages.numStages; i++ ) {
+		Com_Printf( "%6i msec %s\n", loadStages.stages[i].msec, loadStages.stages[i].name );
+	}
+}
+
+/*
+===========================================
+worker threads
+===========================================
+*/
+
+typedef struct {
+	void		*mutex;
+	void		*startSemaphore;	// posted once for each worker needed for a batch
+	void		*doneSemaphore;		// posted when a worker runs out of jobs
+	void		*threads[MAX_WORKER_THREADS];
+	int			numThreads;
+	qboolean	shutdown;
+
+	jobFunc_t	func;
+	void		*data;
+	int			numJobs;
+	int			nextJob;
+} jobPool_t;
+
+static jobPool_t	jobPool;
+
+/*
+=================
+Com_RunJobsLoop
+
+Run jobs until there are none left
+=================
+*/
+static void Com_RunJobsLoop( void ) {
+	int jobNum;
+
+	while ( 1 ) {
+		Sys_LockMutex( jobPool.mutex );
+		if ( jobPool.nextJob < jobPool.numJobs ) {
+			jobNum = jobPool.nextJob++;
+		} else {
+			jobNum = -1;
+		}
+		Sys_UnlockMutex( jobPool.mutex );
+
+		if ( jobNum < 0 ) {
+			return;
+		}
+
+		jobPool.func( jobPool.data, jobNum );
+	}
+}
+
+/*
+=================
+Com_JobWorker
+=================
+*/
+static void Com_JobWorker( void *arg ) {
+	while ( 1 ) {
+		Sys_SemaphoreWait( jobPool.startSemaphore );
+
+		if ( jobPool.shutdown ) {
+			return;
+		}
+
+		Com_RunJobsLoop();
+
+		Sys_SemaphorePost( jobPool.doneSemaphore );
+	}
+}
+
+/*
+=================
+Com_StartJobWorkers
+
+Returns number of worker threads available, up to numWorkers
+=================
+*/
+static int Com_StartJobWorkers( int numWorkers ) {
+	void *thread;
+
+	if ( numWorkers > MAX_WORKER_THREADS ) {
+		numWorkers = MAX_WORKER_THREADS;
+	}
+
+	if ( numWorkers <= jobPool.numThreads ) {
+		return numWorkers;
+	}
+
+	if ( !jobPool.mutex ) {
+		jobPool.mutex = Sys_CreateMutex();
+		jobPool.startSemaphore = Sys_CreateSemaphore();
+		jobPool.doneSemaphore = Sys_CreateSemaphore();
+
+		if ( !jobPool.mutex || !jobPool.startSemaphore || !jobPool.doneSemaphore ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: Failed to create worker thread synchronization objects\n" );
+			return 0;
+		}
+	}
+
+	while ( jobPool.numThreads < numWorkers ) {
+		thread = Sys_CreateThread( Com_JobWorker, NULL );
+
+		if ( !thread ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: Failed to create worker thread %d\n", jobPool.numThreads + 1 );
+			break;
+		}
+
+		jobPool.threads[jobPool.numThreads++] = thread;
+	}
+
+	return jobPool.numThreads;
+}
+
+/*
+=================
+Com_RunJobs
+=================
+*/
+void Com_RunJobs( jobFunc_t func, void *data, int numJobs, int numWorkers ) {
+	int i;
+
+	// the calling thread does one of the jobs
+	if ( numWorkers > numJobs - 1 ) {
+		numWorkers = numJobs - 1;
+	}
+
+	if ( numWorkers > 0 ) {
+		numWorkers = Com_StartJobWorkers( numWorkers );
+	}
+
+	if ( numWorkers <= 0 ) {
+		for ( i = 0; i < numJobs; i++ ) {
+			func( data, i );
+		}
+		return;
+	}
+
+	jobPool.func = func;
+	jobPool.data = data;
+	jobPool.numJobs = numJobs;
+	jobPool.nextJob = 0;
+
+	for ( i = 0; i < numWorkers; i++ ) {
+		Sys_SemaphorePost( jobPool.startSemaphore );
+	}
+
+	Com_RunJobsLoop();
+
+	for ( i = 0; i < numWorkers; i++ ) {
+		Sys_SemaphoreWait( jobPool.doneSemaphore );
+	}
+
+	jobPool.func = NULL;
+	jobPool.data = NULL;
+}
+
+/*
+=================
+Com_ShutdownJobs
+=================
+*/
+static void Com_ShutdownJobs( void ) {
+	int i;
+
+	jobPool.shutdown = qtrue;
+
+	for ( i = 0; i < jobPool.numThreads; i++ ) {
+		Sys_SemaphorePost( jobPool.startSemaphore );
+	}
+
+	for ( i = 0; i < jobPool.numThreads; i++ ) {
+		Sys_JoinThread( jobPool.threads[i] );
+	}
+
+	if ( jobPool.mutex ) {
+		Sys_DestroyMutex( jobPool.mutex );
+		Sys_DestroySemaphore( jobPool.startSemaphore );
+		Sys_DestroySemaphore( jobPool.doneSemaphore );
+	}
+
+	Com_Memset( &jobPool, 0, sizeof( jobPool ) );
+}
+
 /*
 =================
 Com_Shutdown
@@ -3718,6 +4038,9 @@ void Com_Shutdown (void) {
 		FS_HomeRemove( com_pipefile->string );
 	}
 
+	Com_ShutdownJobs();
+
+	CM_ClearMap();
 	BSP_Shutdown();
 }
 
@@ -2194,6 +2194,82 @@ long FS_ReadFile(const char *qpath, void **buffer)
 	return FS_ReadFileDir(qpath, NULL, qfalse, buffer);
 }
 
+/*
+============
+FS_MapFile
+
+Filename are relative to the quake search path.  Only files in directories
+and files stored without compression in pk3s can be mapped.
+============
+*/
+long FS_MapFile( const char *qpath, void **buffer, void **mapping )
+{
+	searchpath_t	*search;
+	unz_file_info	info;
+	fileHandle_t	h;
+	const char		*ospath;
+	long			offset;
+	long			len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( !qpath || !qpath[0] ) {
+		Com_Error( ERR_FATAL, "FS_MapFile with empty name" );
+	}
+
+	*buffer = NULL;
+	*mapping = NULL;
+
+	// find it the same way FS_ReadFile would
+	h = 0;
+	len = -1;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		len = FS_FOpenFileReadDir( qpath, search, &h, qfalse, qfalse );
+		if ( len >= 0 && h ) {
+			break;
+		}
+	}
+
+	if ( !search ) {
+		return -1;
+	}
+
+	if ( fsh[h].zipFile ) {
+		if ( unzGetCurrentFileInfo( fsh[h].handleFiles.file.z, &info, NULL, 0, NULL, 0, NULL, 0 ) != UNZ_OK
+			|| info.compression_method != 0 ) {
+			FS_FCloseFile( h );
+			return -1;
+		}
+		offset = unzGetCurrentFileZStreamPos( fsh[h].handleFiles.file.z );
+		ospath = search->pack->pakFilename;
+	} else {
+		offset = 0;
+		ospath = FS_BuildOSPath( search->dir->fullpath, NULL, qpath );
+	}
+
+	FS_FCloseFile( h );
+
+	*buffer = Sys_MapFile( ospath, offset, len, mapping );
+	if ( !*buffer ) {
+		return -1;
+	}
+
+	fs_loadCount++;
+
+	return len;
+}
+
+/*
+=============
+FS_UnmapFile
+=============
+*/
+void FS_UnmapFile( void *mapping ) {
+	Sys_UnmapFile( mapping );
+}
+
 /*
 =============
 FS_FreeFile
@@ -37,14 +37,15 @@ Suite 120, Rockville, Maryland 20850 USA.
 
 static int			bloc = 0;
 
+// the offset functions don't use bloc so they can be used by multiple threads
+
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int		b = *offset;
+	if ((b&7) == 0) {
+		fout[(b>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(b>>3)] |= bit << (b&7);
+	*offset = b + 1;
 }
 
 int		Huff_getBloc(void)
@@ -59,10 +60,9 @@ void	Huff_setBloc(int _bloc)
 
 int		Huff_getBit( byte *fin, int *offset) {
 	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
+	int b = *offset;
+	t = (fin[(b>>3)] >> (b&7)) & 0x1;
+	*offset = b + 1;
 	return t;
 }
 
@@ -288,18 +288,19 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
-	bloc = *offset;
+	int		b = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (bloc >= maxoffset) {
+		if (b >= maxoffset) {
 			*ch = 0;
 			*offset = maxoffset + 1;
 			return;
 		}
-		if (get_bit(fin)) {
+		if ((fin[(b>>3)] >> (b&7)) & 0x1) {
 			node = node->right;
 		} else {
 			node = node->left;
 		}
+		b++;
 	}
 	if (!node) {
 		*ch = 0;
@@ -307,7 +308,7 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 //		Com_Error(ERR_DROP, "Illegal tree!");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = b;
 }
 
 /* Send the prefix code for this node */
@@ -342,10 +343,153 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout, int maxoffset) {
 	}
 }
 
+/* Send the prefix code for this node at offset */
+static void offsetSend(node_t *node, node_t *child, byte *fout, int *offset, int maxoffset) {
+	if (node->parent) {
+		offsetSend(node->parent, node, fout, offset, maxoffset);
+	}
+	if (child) {
+		if (*offset >= maxoffset) {
+			*offset = maxoffset + 1;
+			return;
+		}
+		Huff_putBit(node->right == child, fout, offset);
+	}
+}
+
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout, maxoffset);
-	*offset = bloc;
+	offsetSend(huff->loc[ch], NULL, fout, offset, maxoffset);
+}
+
+/*
+ * Lookup tables for a fixed tree, such as the one used by MSG_ReadBits and
+ * MSG_WriteBits which is never updated after MSG_initHuffman.  They produce
+ * exactly the same bits as Huff_offsetReceive and Huff_offsetTransmit, which
+ * are still used near the end of the buffer and for codes that don't fit.
+ */
+
+void Huff_BuildTable( huffTable_t *table, huffman_t *huff ) {
+	node_t			*node;
+	huffLookup_t	*entry;
+	unsigned int	code;
+	int				ch, i, length;
+
+	Com_Memset( table, 0, sizeof( *table ) );
+
+	// codes, from the leaf up to the root
+	for ( ch = 0; ch < HMAX+1; ch++ ) {
+		node = huff->compressor.loc[ch];
+		if ( !node ) {
+			continue;
+		}
+
+		code = 0;
+		length = 0;
+		for ( ; node->parent; node = node->parent ) {
+			if ( length == 32 ) {
+				break;
+			}
+			code = ( code << 1 ) | ( node->parent->right == node );
+			length++;
+		}
+
+		if ( node->parent ) {
+			// too long, use Huff_offsetTransmit
+			continue;
+		}
+
+		table->code[ch] = code;
+		table->length[ch] = length;
+	}
+
+	// decode HUFF_LOOKUP_BITS at a time
+	for ( i = 0; i < ( 1 << HUFF_LOOKUP_BITS ); i++ ) {
+		entry = &table->lookup[i];
+		node = huff->decompressor.tree;
+
+		for ( length = 0; node && node->symbol == INTERNAL_NODE && length < HUFF_LOOKUP_BITS; length++ ) {
+			if ( ( i >> length ) & 1 ) {
+				node = node->right;
+			} else {
+				node = node->left;
+			}
+		}
+
+		if ( !node ) {
+			// use Huff_offsetReceive from the root
+			continue;
+		}
+
+		if ( node->symbol == INTERNAL_NODE ) {
+			entry->node = node;
+		} else {
+			entry->symbol = node->symbol;
+			entry->length = length;
+		}
+	}
+}
+
+/* Get a symbol using table built from the tree node */
+void Huff_tableReceive (const huffTable_t *table, node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
+	const huffLookup_t	*entry;
+	unsigned int		bits;
+	int					b = *offset;
+	int					i = b >> 3;
+
+	// need four whole bytes for the lookup
+	if ( i + 4 <= ( maxoffset >> 3 ) ) {
+		bits = fin[i] | ( fin[i+1] << 8 ) | ( fin[i+2] << 16 ) | ( (unsigned int)fin[i+3] << 24 );
+		bits >>= ( b & 7 );
+
+		entry = &table->lookup[bits & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 )];
+
+		if ( entry->length ) {
+			*ch = entry->symbol;
+			*offset = b + entry->length;
+			return;
+		}
+
+		if ( entry->node ) {
+			// finish a long code from where the table left off
+			b += HUFF_LOOKUP_BITS;
+			Huff_offsetReceive( entry->node, ch, fin, &b, maxoffset );
+			*offset = b;
+			return;
+		}
+	}
+
+	Huff_offsetReceive( node, ch, fin, offset, maxoffset );
+}
+
+/* Send a symbol using table built from huff */
+void Huff_tableTransmit (const huffTable_t *table, huff_t *huff, int ch, byte *fout, int *offset, int maxoffset) {
+	uint64_t	bits;
+	byte		*out;
+	int			b = *offset;
+	int			length = table->length[ch];
+	int			i, numBytes;
+
+	if ( !length || b + length > maxoffset ) {
+		Huff_offsetTransmit( huff, ch, fout, offset, maxoffset );
+		return;
+	}
+
+	bits = (uint64_t)table->code[ch] << ( b & 7 );
+	numBytes = ( ( b & 7 ) + length + 7 ) >> 3;
+	out = fout + ( b >> 3 );
+
+	// same as Huff_putBit, which clears each byte when it starts writing to it
+	if ( b & 7 ) {
+		out[0] |= (byte)bits;
+	} else {
+		out[0] = (byte)bits;
+	}
+
+	for ( i = 1; i < numBytes; i++ ) {
+		out[i] = (byte)( bits >> ( i << 3 ) );
+	}
+
+	*offset = b + length;
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -30,7 +30,16 @@ Suite 120, Rockville, Maryland 20850 USA.
 #include "q_shared.h"
 #include "qcommon.h"
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define MSG_SSE2_COMPARE
+#endif
+
 static huffman_t		msgHuff;
+static huffTable_t		msgHuffTable;
+
+// use MSG_WriteHuffBits and MSG_ReadHuffBits, for deltaBenchmark
+static qboolean			msgFastBits = qtrue;
 
 static qboolean			msgInit = qfalse;
 
@@ -105,6 +114,119 @@ bit functions
 =============================================================================
 */
 
+/*
+=================
+MSG_WriteHuffBits
+
+Write the raw low bits and Huffman coded bytes of value at once, using a 64-bit
+accumulator.  The bits are the same as writing them one at a time with
+Huff_putBit and Huff_offsetTransmit.  Returns qfalse if it doesn't fit.
+=================
+*/
+static qboolean MSG_WriteHuffBits( msg_t *msg, int value, int bits ) {
+	uint64_t		acc;
+	unsigned int	v;
+	byte			*out;
+	int				accBits, length, b;
+	int				i, numBytes;
+
+	v = value & (0xffffffff >> (32 - bits));
+
+	accBits = bits & 7;
+	acc = v & ( ( 1 << accBits ) - 1 );
+	v >>= accBits;
+
+	for ( i = accBits; i < bits; i += 8 ) {
+		length = msgHuffTable.length[v & 0xff];
+
+		// leave room to shift acc to the bit offset in the first byte
+		if ( !length || accBits + length > 64 - 7 ) {
+			return qfalse;
+		}
+
+		acc |= (uint64_t)msgHuffTable.code[v & 0xff] << accBits;
+		accBits += length;
+		v >>= 8;
+	}
+
+	b = msg->bit;
+
+	if ( b + accBits > msg->maxsize << 3 ) {
+		return qfalse;
+	}
+
+	acc <<= ( b & 7 );
+	numBytes = ( ( b & 7 ) + accBits + 7 ) >> 3;
+	out = msg->data + ( b >> 3 );
+
+	// Huff_putBit clears each byte when it starts writing to it
+	if ( b & 7 ) {
+		out[0] |= (byte)acc;
+	} else {
+		out[0] = (byte)acc;
+	}
+
+	for ( i = 1; i < numBytes; i++ ) {
+		out[i] = (byte)( acc >> ( i << 3 ) );
+	}
+
+	msg->bit = b + accBits;
+	return qtrue;
+}
+
+/*
+=================
+MSG_ReadHuffBits
+
+Read the raw low bits and Huffman coded bytes of a value from a single 64-bit
+load.  Returns qfalse if too close to the end of the message or a code isn't in
+the lookup table.
+=================
+*/
+static qboolean MSG_ReadHuffBits( msg_t *msg, int bits, int *value ) {
+	const huffLookup_t	*entry;
+	const byte			*in;
+	uint64_t			acc;
+	unsigned int		v;
+	int					used, b, i;
+
+	b = msg->bit;
+
+	if ( ( b >> 3 ) + 8 > msg->cursize ) {
+		return qfalse;
+	}
+
+	in = msg->data + ( b >> 3 );
+	acc = 0;
+	for ( i = 7; i >= 0; i-- ) {
+		acc = ( acc << 8 ) | in[i];
+	}
+	acc >>= ( b & 7 );
+
+	// at least 57 bits are valid
+	used = bits & 7;
+	v = acc & ( ( 1 << used ) - 1 );
+
+	for ( i = used; i < bits; i += 8 ) {
+		if ( used + HUFF_LOOKUP_BITS > 57 ) {
+			return qfalse;
+		}
+
+		entry = &msgHuffTable.lookup[( acc >> used ) & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 )];
+
+		if ( !entry->length ) {
+			return qfalse;
+		}
+
+		v |= (unsigned int)entry->symbol << i;
+		used += entry->length;
+	}
+
+	msg->bit = b + used;
+	*value = v;
+	return qtrue;
+}
+
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	int	i;
@@ -144,6 +266,8 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		} else {
 			Com_Error( ERR_DROP, "can't write %d bits", bits );
 		}
+	} else if ( msgFastBits && MSG_WriteHuffBits( msg, value, bits ) ) {
+		msg->cursize = (msg->bit >> 3) + 1;
 	} else {
 		value &= (0xffffffff >> (32 - bits));
 		if ( bits&7 ) {
@@ -161,7 +285,7 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		}
 		if ( bits ) {
 			for( i = 0; i < bits; i += 8 ) {
-				Huff_offsetTransmit( &msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
+				Huff_tableTransmit( &msgHuffTable, &msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
 				value = (value >> 8);
 
 				if ( msg->bit > msg->maxsize << 3 ) {
@@ -223,6 +347,10 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		}
 		else
 			Com_Error(ERR_DROP, "can't read %d bits", bits);
+	} else if ( msgFastBits && MSG_ReadHuffBits( msg, bits, &value ) ) {
+		// same as below, which only sign extends using the Huffman coded bits
+		bits -= bits & 7;
+		msg->readcount = (msg->bit>>3)+1;
 	} else {
 		nbits = 0;
 		if (bits&7) {
@@ -239,7 +367,7 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		if (bits) {
 //			fp = fopen("c:\\netchan.bin", "a");
 			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
+				Huff_tableReceive (&msgHuffTable, msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
 //				fwrite(&get, 1, 1, fp);
 				value = (unsigned int)value | ((unsigned int)get<<(i+nbits));
 
@@ -269,6 +397,57 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 // writing functions
 //
 
+/*
+============
+MSG_WriteBitSpan
+
+Append numBits already encoded bits starting at bit in data, such as a
+span of another message.  The bits are copied as is, so the span must
+come from a message using the same encoding as msg.
+============
+*/
+void MSG_WriteBitSpan( msg_t *msg, const byte *data, int bit, int numBits ) {
+	int		value, n, shift;
+	byte	*out;
+
+	if ( msg->overflowed || numBits <= 0 ) {
+		return;
+	}
+
+	if ( msg->bit + numBits > msg->maxsize << 3 ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	while ( numBits > 0 ) {
+		shift = msg->bit & 7;
+
+		// fill the rest of the current output byte
+		n = 8 - shift;
+		if ( n > numBits ) {
+			n = numBits;
+		}
+
+		value = data[bit >> 3] >> ( bit & 7 );
+		if ( ( bit & 7 ) + n > 8 ) {
+			value |= data[( bit >> 3 ) + 1] << ( 8 - ( bit & 7 ) );
+		}
+		value &= ( 1 << n ) - 1;
+
+		out = &msg->data[msg->bit >> 3];
+		if ( !shift ) {
+			*out = 0;
+		}
+		*out |= value << shift;
+
+		msg->bit += n;
+		bit += n;
+		numBits -= n;
+	}
+
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 void MSG_WriteChar( msg_t *sb, int c ) {
 #ifdef PARANOID
 	if (c < -128 || c > 127)
@@ -691,16 +870,26 @@ typedef struct {
 	int		pcount;
 } netField_t;
 
+// limits for comparing whole states at once in MSG_ChangedFields
+#define MAX_NETF_COMPARE_WORDS	4096
+#define MAX_NETF_COMPARE_FIELDS	1024
+
 typedef struct {
 	char		*objectName;
 	int			objectSize;
 
 	int			numFields;
 	netField_t	*fields;
+
+	int			numWords;		// 0 if fields have to be compared one at a time
+	int			*wordFields;	// [numWords] field index for each 32 bit word or -1
 } netFields_t;
 
-static netFields_t msg_playerStateFields = { "playerState_t", 0, 0, NULL };
-static netFields_t msg_entityStateFields = { "entityState_t", 0, 0, NULL };
+static netFields_t msg_playerStateFields = { "playerState_t", 0, 0, NULL, 0, NULL };
+static netFields_t msg_entityStateFields = { "entityState_t", 0, 0, NULL, 0, NULL };
+
+// use MSG_ChangedFields, for deltaBenchmark
+static qboolean msgFastCompare = qtrue;
 
 /*
 =================
@@ -744,6 +933,64 @@ static void MSG_FreeNetFields( netFields_t *stateFields ) {
 		Z_Free( stateFields->fields );
 		stateFields->fields = NULL;
 	}
+	if ( stateFields->wordFields ) {
+		Z_Free( stateFields->wordFields );
+		stateFields->wordFields = NULL;
+	}
+	stateFields->numWords = 0;
+}
+
+/*
+==================
+MSG_InitWordFields
+
+Map each 32 bit word of the state to the field it belongs to so
+MSG_ChangedFields can compare whole states at once.  Fields that
+aren't word aligned or share words are compared one at a time.
+==================
+*/
+static void MSG_InitWordFields( netFields_t *stateFields ) {
+	netField_t	*field;
+	int			numWords;
+	int			i, n, word;
+
+	numWords = stateFields->objectSize / 4;
+
+	if ( numWords > MAX_NETF_COMPARE_WORDS || stateFields->numFields > MAX_NETF_COMPARE_FIELDS ) {
+		return;
+	}
+
+	stateFields->wordFields = Z_Malloc( numWords * sizeof( int ) );
+
+	for ( i = 0; i < numWords; i++ ) {
+		stateFields->wordFields[i] = -1;
+	}
+
+	for ( i = 0, field = stateFields->fields; i < stateFields->numFields; i++, field++ ) {
+		if ( field->offset & 3 ) {
+			break;
+		}
+
+		for ( n = 0; n < field->numElements; n++ ) {
+			word = field->offset / 4 + n;
+			if ( stateFields->wordFields[word] != -1 ) {
+				break;
+			}
+			stateFields->wordFields[word] = i;
+		}
+
+		if ( n != field->numElements ) {
+			break;
+		}
+	}
+
+	if ( i != stateFields->numFields ) {
+		Z_Free( stateFields->wordFields );
+		stateFields->wordFields = NULL;
+		return;
+	}
+
+	stateFields->numWords = numWords;
 }
 
 /*
@@ -820,6 +1067,8 @@ static const char *MSG_InitNetFields( netFields_t *stateFields, const vmNetField
 		return "fields send more data than size of state";
 	}
 
+	MSG_InitWordFields( stateFields );
+
 	// For entityState_t:
 	// all fields should be 32 bits to avoid any compiler packing issues
 	// the "number" field is not part of the field list
@@ -909,6 +1158,78 @@ static int MSG_LastChangedField( void *from, void *to, netFields_t *stateFields
 	return lc;
 }
 
+/*
+==================
+MSG_ChangedFields
+
+Sets a bit in changedFields for each field that is different and returns
+index of last changed field + 1, or 0 if no fields are different.  Compares
+the whole states 16 bytes at a time and then only looks at the changed words.
+==================
+*/
+static int MSG_ChangedFields( void *from, void *to, netFields_t *stateFields, unsigned int *changedFields ) {
+	unsigned int	changedWords[MAX_NETF_COMPARE_WORDS / 32];
+	int				*fromW, *toW;
+	int				numWords, w, i, field, lc;
+	unsigned int	bits;
+#ifdef MSG_SSE2_COMPARE
+	__m128i			zero, a, b;
+	int				mask;
+#endif
+
+	numWords = stateFields->numWords;
+	fromW = (int *)from;
+	toW = (int *)to;
+
+	Com_Memset( changedWords, 0, ( ( numWords + 31 ) >> 5 ) * sizeof( changedWords[0] ) );
+
+	w = 0;
+#ifdef MSG_SSE2_COMPARE
+	zero = _mm_setzero_si128();
+	for ( ; w + 4 <= numWords; w += 4 ) {
+		b = _mm_loadu_si128( (const __m128i *)( toW + w ) );
+		a = from ? _mm_loadu_si128( (const __m128i *)( fromW + w ) ) : zero;
+
+		// one bit for each word that is different
+		mask = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( a, b ) ) ) ^ 15;
+
+		if ( mask ) {
+			changedWords[w >> 5] |= mask << ( w & 31 );
+		}
+	}
+#endif
+	for ( ; w < numWords; w++ ) {
+		if ( toW[w] != ( from ? fromW[w] : 0 ) ) {
+			changedWords[w >> 5] |= 1u << ( w & 31 );
+		}
+	}
+
+	Com_Memset( changedFields, 0, ( ( stateFields->numFields + 31 ) >> 5 ) * sizeof( changedFields[0] ) );
+
+	lc = 0;
+	for ( i = 0; i < ( numWords + 31 ) >> 5; i++ ) {
+		for ( bits = changedWords[i]; bits; bits &= bits - 1 ) {
+			// lowest set bit
+			for ( w = 0; !( bits & ( 1u << w ) ); w++ ) {
+			}
+
+			field = stateFields->wordFields[( i << 5 ) + w];
+			if ( field < 0 ) {
+				// not networked
+				continue;
+			}
+
+			changedFields[field >> 5] |= 1u << ( field & 31 );
+
+			if ( field >= lc ) {
+				lc = field + 1;
+			}
+		}
+	}
+
+	return lc;
+}
+
 // if (int)f == f and (int)f + ( 1<<(FLOAT_INT_BITS-1) ) < ( 1 << FLOAT_INT_BITS )
 // the float will be sent with FLOAT_INT_BITS, otherwise all 32 bits will be sent
 #define	FLOAT_INT_BITS	13
@@ -917,10 +1238,13 @@ static int MSG_LastChangedField( void *from, void *to, netFields_t *stateFields
 /*
 ==================
 MSG_WriteDeltaNetFields
+
+If changedFields isn't NULL, fields without a bit set are sent as unchanged
+without comparing them.
 ==================
 */
 static void MSG_WriteDeltaNetFields( msg_t *msg, void *from, void *to,
-						   netFields_t *stateFields, int numSendFields ) {
+						   netFields_t *stateFields, int numSendFields, const unsigned int *changedFields ) {
 	int			i, n;
 	netField_t	*field;
 	int			trunc;
@@ -931,11 +1255,16 @@ static void MSG_WriteDeltaNetFields( msg_t *msg, void *from, void *to,
 	int			bitsArray[MAX_NETF_ELEMENTS / MAX_NETF_ARRAY_BITS];
 
 	for ( i = 0, field = stateFields->fields ; i < numSendFields ; i++, field++ ) {
+		if ( changedFields && !( changedFields[i >> 5] & ( 1u << ( i & 31 ) ) ) ) {
+			MSG_WriteBits( msg, 0, field->numElementArrays );	// no change
+			continue;
+		}
+
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
 
 		arraysChanged = 0;
-		Com_Memset( bitsArray, 0, sizeof (bitsArray) );
+		Com_Memset( bitsArray, 0, field->numElementArrays * sizeof (bitsArray[0]) );
 
 		for (n=0 ; n<field->numElements ; n++) {
 			if ( ( from && toF[n] != fromF[n] ) || ( !from && toF[n] != 0 ) ) {
@@ -1168,6 +1497,8 @@ identical, under the assumption that the in-order delta code will catch it.
 void MSG_WriteDeltaEntity( msg_t *msg, sharedEntityState_t *from, sharedEntityState_t *to,
 						   qboolean force ) {
 	int			lc;
+	unsigned int	changedFields[MAX_NETF_COMPARE_FIELDS / 32];
+	unsigned int	*changed;
 
 	if ( !msg_entityStateFields.fields ) {
 		Com_Error( ERR_DROP, "entityState_t missing netFields" );
@@ -1187,7 +1518,13 @@ void MSG_WriteDeltaEntity( msg_t *msg, sharedEntityState_t *from, sharedEntitySt
 		Com_Error (ERR_FATAL, "MSG_WriteDeltaEntity: Bad entity number: %i", to->number );
 	}
 
-	lc = MSG_LastChangedField( from, to, &msg_entityStateFields );
+	if ( msgFastCompare && msg_entityStateFields.numWords ) {
+		changed = changedFields;
+		lc = MSG_ChangedFields( from, to, &msg_entityStateFields, changed );
+	} else {
+		changed = NULL;
+		lc = MSG_LastChangedField( from, to, &msg_entityStateFields );
+	}
 
 	if ( lc == 0 ) {
 		// nothing at all changed
@@ -1207,7 +1544,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, sharedEntityState_t *from, sharedEntitySt
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	MSG_WriteDeltaNetFields( msg, from, to, &msg_entityStateFields, lc );
+	MSG_WriteDeltaNetFields( msg, from, to, &msg_entityStateFields, lc, changed );
 }
 
 /*
@@ -1300,16 +1637,24 @@ MSG_WriteDeltaPlayerstate
 */
 void MSG_WriteDeltaPlayerstate( msg_t *msg, sharedPlayerState_t *from, sharedPlayerState_t *to ) {
 	int				lc;
+	unsigned int	changedFields[MAX_NETF_COMPARE_FIELDS / 32];
+	unsigned int	*changed;
 
 	if ( !msg_playerStateFields.fields ) {
 		Com_Error( ERR_DROP, "playerState_t missing netFields" );
 	}
 
-	lc = MSG_LastChangedField( from, to, &msg_playerStateFields );
+	if ( msgFastCompare && msg_playerStateFields.numWords ) {
+		changed = changedFields;
+		lc = MSG_ChangedFields( from, to, &msg_playerStateFields, changed );
+	} else {
+		changed = NULL;
+		lc = MSG_LastChangedField( from, to, &msg_playerStateFields );
+	}
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	MSG_WriteDeltaNetFields( msg, from, to, &msg_playerStateFields, lc );
+	MSG_WriteDeltaNetFields( msg, from, to, &msg_playerStateFields, lc, changed );
 }
 
 
@@ -1621,6 +1966,292 @@ void MSG_initHuffman( void ) {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+	Huff_BuildTable(&msgHuffTable, &msgHuff);
+}
+
+/*
+=================
+MSG_HuffmanBenchmark_f
+
+Compare the msgHuff lookup tables against walking the tree.  Symbols are
+read from a file if given, otherwise they're picked using msg_hData which
+was counted from recorded netchan traffic.
+=================
+*/
+#define HUFF_BENCH_SYMBOLS		( 1 << 20 )
+
+void MSG_HuffmanBenchmark_f( void ) {
+	byte	*symbols, *treeOut, *tableOut, *file;
+	int		numSymbols, maxoffset;
+	int		treeBits, tableBits;
+	int		i, j, ch, total, r, iterations;
+	int		start, treeEncode, tableEncode, treeDecode, tableDecode;
+	qboolean	match;
+
+	if ( Cmd_Argc() > 2 ) {
+		Com_Printf( "Usage: huffBenchmark [file]\n" );
+		return;
+	}
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+
+	file = NULL;
+	if ( Cmd_Argc() == 2 ) {
+		numSymbols = FS_ReadFile( Cmd_Argv( 1 ), (void **)&file );
+		if ( numSymbols <= 0 ) {
+			Com_Printf( "Couldn't read %s\n", Cmd_Argv( 1 ) );
+			return;
+		}
+		if ( numSymbols > HUFF_BENCH_SYMBOLS ) {
+			numSymbols = HUFF_BENCH_SYMBOLS;
+		}
+	} else {
+		numSymbols = HUFF_BENCH_SYMBOLS;
+	}
+
+	// worst case is a 32 bit code for every symbol
+	maxoffset = numSymbols * 32;
+	symbols = Z_Malloc( numSymbols );
+	treeOut = Z_Malloc( maxoffset >> 3 );
+	tableOut = Z_Malloc( maxoffset >> 3 );
+
+	if ( file ) {
+		Com_Memcpy( symbols, file, numSymbols );
+		FS_FreeFile( file );
+	} else {
+		for ( total = 0, i = 0; i < 256; i++ ) {
+			total += msg_hData[i];
+		}
+
+		// fixed seed so runs can be compared
+		r = 0x12345;
+		for ( i = 0; i < numSymbols; i++ ) {
+			r = r * 1103515245 + 12345;
+			ch = ( ( r >> 8 ) & 0x7fffff ) % total;
+			for ( j = 0; j < 255 && ch >= msg_hData[j]; j++ ) {
+				ch -= msg_hData[j];
+			}
+			symbols[i] = j;
+		}
+	}
+
+	iterations = 8;
+
+	start = Sys_Milliseconds();
+	for ( j = 0; j < iterations; j++ ) {
+		treeBits = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_offsetTransmit( &msgHuff.compressor, symbols[i], treeOut, &treeBits, maxoffset );
+		}
+	}
+	treeEncode = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( j = 0; j < iterations; j++ ) {
+		tableBits = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_tableTransmit( &msgHuffTable, &msgHuff.compressor, symbols[i], tableOut, &tableBits, maxoffset );
+		}
+	}
+	tableEncode = Sys_Milliseconds() - start;
+
+	match = ( treeBits == tableBits && !memcmp( treeOut, tableOut, ( treeBits + 7 ) >> 3 ) );
+
+	start = Sys_Milliseconds();
+	for ( j = 0; j < iterations; j++ ) {
+		treeBits = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_offsetReceive( msgHuff.decompressor.tree, &ch, treeOut, &treeBits, tableBits );
+			if ( ch != symbols[i] ) {
+				match = qfalse;
+			}
+		}
+	}
+	treeDecode = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( j = 0; j < iterations; j++ ) {
+		tableBits = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_tableReceive( &msgHuffTable, msgHuff.decompressor.tree, &ch, treeOut, &tableBits, treeBits );
+			if ( ch != symbols[i] ) {
+				match = qfalse;
+			}
+		}
+	}
+	tableDecode = Sys_Milliseconds() - start;
+
+	if ( treeBits != tableBits ) {
+		match = qfalse;
+	}
+
+	Com_Printf( "%d symbols x %d, %d bits\n", numSymbols, iterations, treeBits );
+	Com_Printf( "encode: tree %d msec, table %d msec\n", treeEncode, tableEncode );
+	Com_Printf( "decode: tree %d msec, table %d msec\n", treeDecode, tableDecode );
+	Com_Printf( "output %s\n", match ? "matches" : S_COLOR_RED "DOES NOT MATCH" );
+
+	Z_Free( tableOut );
+	Z_Free( treeOut );
+	Z_Free( symbols );
+}
+
+/*
+=================
+MSG_DeltaBenchmark_f
+
+Time delta encoding and decoding entities with MSG_WriteDeltaEntity and
+MSG_ReadDeltaEntity, with and without MSG_WriteHuffBits/MSG_ReadHuffBits
+and MSG_ChangedFields, and check that all produce the same message.  Uses the game's
+entityState_t fields if they are set, otherwise ones like Quake 3's.
+=================
+*/
+static const int msg_benchFieldBits[] = {
+	32, 0, 0, 0, 0, 0, 0, 0, 0, 10, 0, 8, 8, 8, 8, GENTITYNUM_BITS, 8, 19, GENTITYNUM_BITS, 8, 8, 0, 32, 8,
+	0, 0, 0, 24, 16, 8, GENTITYNUM_BITS, 8, 8, 0, 0, 0, 8, 0, 32, 32, 32, 0, 0, 0, 0, 32, 0, 0, 0, 32, 16
+};
+
+void MSG_DeltaBenchmark_f( void ) {
+	vmNetField_t	vmFields[ARRAY_LEN( msg_benchFieldBits )];
+	netField_t		*field;
+	msg_t			msg;
+	byte			*states, *decoded, *buffers[3];
+	sharedEntityState_t	*from, *to;
+	int				numEntities, iterations, objectSize, bufferSize;
+	int				i, j, n, mode, number, r;
+	int				encodeMsec[3], decodeMsec[3], start, cursize[3];
+	qboolean		benchFields, match;
+
+	if ( Cmd_Argc() > 3 ) {
+		Com_Printf( "Usage: deltaBenchmark [entities] [iterations]\n" );
+		return;
+	}
+
+	numEntities = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : 1024;
+	iterations = ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : 200;
+	numEntities = Com_Clamp( 1, MAX_GENTITIES, numEntities );
+	iterations = Com_Clamp( 1, 100000, iterations );
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+
+	benchFields = !msg_entityStateFields.fields;
+
+	if ( benchFields ) {
+		for ( i = 0; i < ARRAY_LEN( msg_benchFieldBits ); i++ ) {
+			vmFields[i].offset = sizeof( sharedEntityState_t ) + i * 4;
+			vmFields[i].numElements = 1;
+			vmFields[i].bits = msg_benchFieldBits[i];
+		}
+		MSG_InitNetFields( &msg_entityStateFields, vmFields, ARRAY_LEN( vmFields ),
+			sizeof( sharedEntityState_t ) + ARRAY_LEN( vmFields ) * 4, 0 );
+	}
+
+	objectSize = msg_entityStateFields.objectSize;
+
+	// from and to state for each entity
+	states = Z_Malloc( numEntities * 2 * objectSize );
+	decoded = Z_Malloc( numEntities * 3 * objectSize );
+
+	// fixed seed so runs can be compared
+	r = 0x12345;
+	for ( i = 0; i < numEntities; i++ ) {
+		from = (sharedEntityState_t *)( states + i * 2 * objectSize );
+		to = (sharedEntityState_t *)( (byte *)from + objectSize );
+
+		for ( j = 0, field = msg_entityStateFields.fields; j < msg_entityStateFields.numFields; j++, field++ ) {
+			for ( n = 0; n < field->numElements; n++ ) {
+				r = r * 1103515245 + 12345;
+				if ( field->bits == 0 ) {
+					// mix of small integers and full floats
+					*(float *)( (byte *)from + field->offset + n * 4 ) = ( r & 1 ) ? ( ( r >> 8 ) & 1023 ) : ( r >> 8 ) * 0.001f;
+				} else {
+					*(int *)( (byte *)from + field->offset + n * 4 ) = ( r >> 8 ) & 0xffff;
+				}
+			}
+		}
+
+		Com_Memcpy( to, from, objectSize );
+
+		// change a few fields, leave some entities unchanged
+		for ( j = 0; j < 6 && ( i & 3 ); j++ ) {
+			r = r * 1103515245 + 12345;
+			field = &msg_entityStateFields.fields[( ( r >> 8 ) & 0xffff ) % msg_entityStateFields.numFields];
+			*(int *)( (byte *)to + field->offset ) += ( r >> 16 ) & 0xff;
+		}
+
+		from->number = to->number = i;
+	}
+
+	bufferSize = numEntities * ( objectSize + 16 );
+	buffers[0] = Z_Malloc( bufferSize );
+	buffers[1] = Z_Malloc( bufferSize );
+	buffers[2] = Z_Malloc( bufferSize );
+
+	match = qtrue;
+
+	for ( mode = 0; mode < 3; mode++ ) {
+		msgFastBits = ( mode >= 1 );
+		msgFastCompare = ( mode >= 2 );
+
+		start = Sys_Milliseconds();
+		for ( j = 0; j < iterations; j++ ) {
+			MSG_Init( &msg, buffers[mode], bufferSize );
+			for ( i = 0; i < numEntities; i++ ) {
+				from = (sharedEntityState_t *)( states + i * 2 * objectSize );
+				to = (sharedEntityState_t *)( (byte *)from + objectSize );
+				MSG_WriteDeltaEntity( &msg, from, to, qtrue );
+			}
+		}
+		encodeMsec[mode] = Sys_Milliseconds() - start;
+		cursize[mode] = msg.cursize;
+
+		start = Sys_Milliseconds();
+		for ( j = 0; j < iterations; j++ ) {
+			msg.readcount = 0;
+			msg.bit = 0;
+			for ( i = 0; i < numEntities; i++ ) {
+				from = (sharedEntityState_t *)( states + i * 2 * objectSize );
+				to = (sharedEntityState_t *)( decoded + ( i * 3 + mode ) * objectSize );
+				number = MSG_ReadBits( &msg, GENTITYNUM_BITS );
+				MSG_ReadDeltaEntity( &msg, from, to, number );
+			}
+		}
+		decodeMsec[mode] = Sys_Milliseconds() - start;
+	}
+
+	msgFastBits = qtrue;
+	msgFastCompare = qtrue;
+
+	for ( mode = 1; mode < 3; mode++ ) {
+		if ( cursize[0] != cursize[mode] || memcmp( buffers[0], buffers[mode], cursize[0] ) ) {
+			match = qfalse;
+		}
+
+		for ( i = 0; i < numEntities; i++ ) {
+			if ( memcmp( decoded + i * 3 * objectSize, decoded + ( i * 3 + mode ) * objectSize, objectSize ) ) {
+				match = qfalse;
+			}
+		}
+	}
+
+	Com_Printf( "%d entities x %d, %d fields, %d bytes per message\n", numEntities, iterations, msg_entityStateFields.numFields, cursize[1] );
+	Com_Printf( "encode: bitwise %d msec, word %d msec, word + %s compare %d msec\n", encodeMsec[0], encodeMsec[1],
+		msg_entityStateFields.numWords ? "state" : "field", encodeMsec[2] );
+	Com_Printf( "decode: bitwise %d msec, word %d msec\n", decodeMsec[0], decodeMsec[1] );
+	Com_Printf( "output %s\n", match ? "matches" : S_COLOR_RED "DOES NOT MATCH" );
+
+	Z_Free( buffers[2] );
+	Z_Free( buffers[1] );
+	Z_Free( buffers[0] );
+	Z_Free( decoded );
+	Z_Free( states );
+
+	if ( benchFields ) {
+		MSG_FreeNetFields( &msg_entityStateFields );
+	}
 }
 
 /*
@@ -28,6 +28,11 @@ Suite 120, Rockville, Maryland 20850 USA.
 ===========================================================================
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	// needed for recvmmsg and sendmmsg
+#	define _GNU_SOURCE
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -97,6 +102,16 @@ typedef int SOCKET;
 typedef int	ioctlarg_t;
 #	define socketError			errno
 
+#	ifdef __linux__
+		// batch socket reads and writes using recvmmsg and sendmmsg
+#		define NET_BATCHED_IO
+
+		// wait for sockets, console and sub-millisecond timeouts using epoll and timerfd
+#		include <sys/epoll.h>
+#		include <sys/timerfd.h>
+#		define NET_EPOLL
+#	endif
+
 #endif
 
 static qboolean usingSocks = qfalse;
@@ -119,6 +134,10 @@ static cvar_t	*net_mcast6iface;
 
 static cvar_t	*net_dropsim;
 
+#ifdef NET_BATCHED_IO
+static cvar_t	*net_batchedIO;
+#endif
+
 static struct sockaddr	socksRelayAddr;
 
 static SOCKET	ip_socket = INVALID_SOCKET;
@@ -153,6 +172,50 @@ typedef struct
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+// number of send and receive socket calls, for net_stress
+static int netSendCalls;
+static int netRecvCalls;
+
+#ifdef NET_BATCHED_IO
+#define	NET_BATCH_PACKETS		32		// max packets per recvmmsg or sendmmsg call
+#define	NET_BATCH_PACKETLEN		1500	// larger packets are sent immediately
+
+// packets read from one socket by a single recvmmsg call
+typedef struct {
+	SOCKET					sock;
+	int						numPackets;
+	int						nextPacket;
+	struct mmsghdr			msgs[NET_BATCH_PACKETS];
+	struct iovec			iovecs[NET_BATCH_PACKETS];
+	struct sockaddr_storage	from[NET_BATCH_PACKETS];
+	byte					data[NET_BATCH_PACKETS][MAX_MSGLEN + 1];
+} netRecvBatch_t;
+
+// packets queued for a single sendmmsg call
+typedef struct {
+	SOCKET					sock;
+	int						numPackets;
+	struct mmsghdr			msgs[NET_BATCH_PACKETS];
+	struct iovec			iovecs[NET_BATCH_PACKETS];
+	struct sockaddr_storage	to[NET_BATCH_PACKETS];
+	netadrtype_t			toType[NET_BATCH_PACKETS];
+	byte					data[NET_BATCH_PACKETS][NET_BATCH_PACKETLEN];
+} netSendBatch_t;
+
+static qboolean			batchedIO;
+static netRecvBatch_t	recvBatch;
+static netSendBatch_t	sendBatch;
+#endif
+
+#ifdef NET_EPOLL
+#define	NET_EPOLL_FDS			4		// ip_socket, ip6_socket, multicast6_socket, console input
+
+static int		epollFD = -1;
+static int		timerFD = -1;
+static int		epollFDs[NET_EPOLL_FDS] = { -1, -1, -1, -1 };	// registered with epollFD
+static int		epollFailedFDs[NET_EPOLL_FDS] = { -1, -1, -1, -1 };	// couldn't be registered, not retried
+#endif
+
 
 //=============================================================================
 
@@ -523,123 +586,304 @@ qboolean	NET_IsLocalAddress( netadr_t adr ) {
 
 /*
 ==================
-NET_GetPacket
+NET_ReceivedPacket
 
-Receive one packet
+Sets net_from and net_message size for a packet read from sock
 ==================
 */
-qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
+static qboolean NET_ReceivedPacket( SOCKET sock, struct sockaddr_storage *from, socklen_t fromlen, int length, netadr_t *net_from, msg_t *net_message )
 {
-	int 	ret;
-	struct sockaddr_storage from;
-	socklen_t	fromlen;
-	int		err;
-	
-	if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
+	if( sock == ip_socket )
 	{
-		fromlen = sizeof(from);
-		ret = recvfrom( ip_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
-
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
-		}
-		else
-		{
+		memset( ((struct sockaddr_in *)from)->sin_zero, 0, 8 );
 
-			memset( ((struct sockaddr_in *)&from)->sin_zero, 0, 8 );
-		
-			if ( usingSocks && memcmp( &from, &socksRelayAddr, fromlen ) == 0 ) {
-				if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
-					return qfalse;
-				}
-				net_from->type = NA_IP;
-				net_from->ip[0] = net_message->data[4];
-				net_from->ip[1] = net_message->data[5];
-				net_from->ip[2] = net_message->data[6];
-				net_from->ip[3] = net_message->data[7];
-				net_from->port = *(short *)&net_message->data[8];
-				net_message->readcount = 10;
-			}
-			else {
-				SockadrToNetadr( (struct sockaddr *) &from, net_from );
-				net_message->readcount = 0;
-			}
-		
-			if( ret >= net_message->maxsize ) {
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+		if ( usingSocks && memcmp( from, &socksRelayAddr, fromlen ) == 0 ) {
+			if ( length < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
 				return qfalse;
 			}
-			
-			net_message->cursize = ret;
-			return qtrue;
+			net_from->type = NA_IP;
+			net_from->ip[0] = net_message->data[4];
+			net_from->ip[1] = net_message->data[5];
+			net_from->ip[2] = net_message->data[6];
+			net_from->ip[3] = net_message->data[7];
+			net_from->port = *(short *)&net_message->data[8];
+			net_message->readcount = 10;
+		}
+		else {
+			SockadrToNetadr( (struct sockaddr *) from, net_from );
+			net_message->readcount = 0;
 		}
 	}
-	
-	if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
+	else
 	{
-		fromlen = sizeof(from);
-		ret = recvfrom(ip6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
+		SockadrToNetadr( (struct sockaddr *) from, net_from );
+		net_message->readcount = 0;
+	}
 
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
-		}
-		else
+	if( length >= net_message->maxsize ) {
+		Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+		return qfalse;
+	}
+
+	net_message->cursize = length;
+	return qtrue;
+}
+
+#ifdef NET_BATCHED_IO
+/*
+==================
+NET_RecvBatch
+
+Read as many packets from sock as will fit in batch.
+Returns number of packets read or SOCKET_ERROR.
+==================
+*/
+static int NET_RecvBatch( netRecvBatch_t *batch, SOCKET sock, int maxsize )
+{
+	struct mmsghdr	*msg;
+	int				i, ret;
+
+	if( maxsize > sizeof( batch->data[0] ) )
+		maxsize = sizeof( batch->data[0] );
+
+	for( i = 0; i < NET_BATCH_PACKETS; i++ )
+	{
+		msg = &batch->msgs[i];
+
+		batch->iovecs[i].iov_base = batch->data[i];
+		batch->iovecs[i].iov_len = maxsize;
+
+		memset( &msg->msg_hdr, 0, sizeof( msg->msg_hdr ) );
+		msg->msg_hdr.msg_name = &batch->from[i];
+		msg->msg_hdr.msg_namelen = sizeof( batch->from[i] );
+		msg->msg_hdr.msg_iov = &batch->iovecs[i];
+		msg->msg_hdr.msg_iovlen = 1;
+		msg->msg_len = 0;
+	}
+
+	batch->sock = sock;
+	batch->nextPacket = 0;
+
+	ret = recvmmsg( sock, batch->msgs, NET_BATCH_PACKETS, MSG_DONTWAIT, NULL );
+	netRecvCalls++;
+
+	batch->numPackets = ( ret > 0 ) ? ret : 0;
+
+	return ret;
+}
+
+/*
+==================
+NET_GetBatchedPacket
+
+Receive one packet, refilling the receive batch from readable sockets when it is empty
+==================
+*/
+static qboolean NET_GetBatchedPacket( netadr_t *net_from, msg_t *net_message, fd_set *fdr )
+{
+	SOCKET			sockets[3];
+	struct mmsghdr	*msg;
+	int				i, length;
+
+	sockets[0] = ip_socket;
+	sockets[1] = ip6_socket;
+	sockets[2] = ( multicast6_socket != ip6_socket ) ? multicast6_socket : INVALID_SOCKET;
+
+	while( 1 )
+	{
+		if( recvBatch.nextPacket >= recvBatch.numPackets )
 		{
-			SockadrToNetadr((struct sockaddr *) &from, net_from);
-			net_message->readcount = 0;
-		
-			if(ret >= net_message->maxsize)
+			for( i = 0; i < ARRAY_LEN( sockets ); i++ )
 			{
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+				if( sockets[i] != INVALID_SOCKET && FD_ISSET( sockets[i], fdr ) )
+					break;
+			}
+
+			if( i == ARRAY_LEN( sockets ) )
 				return qfalse;
+
+			// read until the socket has nothing left
+			if( NET_RecvBatch( &recvBatch, sockets[i], net_message->maxsize ) == SOCKET_ERROR )
+			{
+				if( socketError != EAGAIN && socketError != ECONNRESET )
+					Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+
+				FD_CLR( sockets[i], fdr );
 			}
-			
-			net_message->cursize = ret;
-			return qtrue;
+			else if( recvBatch.numPackets == 0 )
+				FD_CLR( sockets[i], fdr );
+			continue;
 		}
+
+		msg = &recvBatch.msgs[recvBatch.nextPacket];
+		length = msg->msg_len;
+
+		Com_Memcpy( net_message->data, recvBatch.data[recvBatch.nextPacket], MIN( length, net_message->maxsize ) );
+
+		recvBatch.nextPacket++;
+
+		if( NET_ReceivedPacket( recvBatch.sock, msg->msg_hdr.msg_name, msg->msg_hdr.msg_namelen, length, net_from, net_message ) )
+			return qtrue;
 	}
+}
+#endif
+
+/*
+==================
+NET_GetPacket
 
-	if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET(multicast6_socket, fdr))
+Receive one packet
+==================
+*/
+qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
+{
+	int 	ret;
+	struct sockaddr_storage from;
+	socklen_t	fromlen;
+	int		err;
+	SOCKET	sock;
+
+#ifdef NET_BATCHED_IO
+	if( batchedIO )
+		return NET_GetBatchedPacket( net_from, net_message, fdr );
+#endif
+
+	if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
+		sock = ip_socket;
+	else if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
+		sock = ip6_socket;
+	else if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET(multicast6_socket, fdr))
+		sock = multicast6_socket;
+	else
+		return qfalse;
+
+	fromlen = sizeof(from);
+	ret = recvfrom( sock, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
+	netRecvCalls++;
+
+	if (ret == SOCKET_ERROR)
 	{
-		fromlen = sizeof(from);
-		ret = recvfrom(multicast6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
+		err = socketError;
 
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
-		}
-		else
-		{
-			SockadrToNetadr((struct sockaddr *) &from, net_from);
-			net_message->readcount = 0;
-		
-			if(ret >= net_message->maxsize)
-			{
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
-				return qfalse;
+		if( err != EAGAIN && err != ECONNRESET )
+			Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+
+		// try the next socket
+		FD_CLR( sock, fdr );
+		return NET_GetPacket( net_from, net_message, fdr );
+	}
+
+	return NET_ReceivedPacket( sock, &from, fromlen, ret, net_from, net_message );
+}
+
+//=============================================================================
+
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( netadrtype_t type ) {
+	int err = socketError;
+
+	// wouldblock is silent
+	if( err == EAGAIN ) {
+		return;
+	}
+
+	// some PPP links do not allow broadcasts and return an error
+	if( ( err == EADDRNOTAVAIL ) && ( ( type == NA_BROADCAST ) ) ) {
+		return;
+	}
+
+	Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+}
+
+#ifdef NET_BATCHED_IO
+/*
+==================
+NET_FlushSendBatch
+
+Send all queued packets
+==================
+*/
+static void NET_FlushSendBatch( void ) {
+	int sent, ret;
+
+	sent = 0;
+
+	while( sent < sendBatch.numPackets ) {
+		ret = sendmmsg( sendBatch.sock, &sendBatch.msgs[sent], sendBatch.numPackets - sent, 0 );
+		netSendCalls++;
+
+		if( ret == SOCKET_ERROR ) {
+			if( socketError == EAGAIN ) {
+				// socket buffer is full, drop the rest
+				break;
 			}
-			
-			net_message->cursize = ret;
-			return qtrue;
+
+			// skip the packet that failed
+			NET_SendError( sendBatch.toType[sent] );
+			sent++;
+			continue;
 		}
+
+		sent += ret;
 	}
-	
-	
-	return qfalse;
+
+	sendBatch.numPackets = 0;
 }
 
-//=============================================================================
+/*
+==================
+NET_QueueSendBatch
+
+Queue a packet to be sent by NET_FlushSendBatch
+==================
+*/
+static void NET_QueueSendBatch( SOCKET sock, struct sockaddr_storage *addr, socklen_t addrlen, int length, const void *data, netadrtype_t type ) {
+	struct mmsghdr	*msg;
+	int				i;
+
+	if( sendBatch.numPackets > 0 && sendBatch.sock != sock ) {
+		NET_FlushSendBatch();
+	}
+
+	i = sendBatch.numPackets++;
+	msg = &sendBatch.msgs[i];
+
+	sendBatch.sock = sock;
+	sendBatch.to[i] = *addr;
+	sendBatch.toType[i] = type;
+	Com_Memcpy( sendBatch.data[i], data, length );
+
+	sendBatch.iovecs[i].iov_base = sendBatch.data[i];
+	sendBatch.iovecs[i].iov_len = length;
+
+	memset( &msg->msg_hdr, 0, sizeof( msg->msg_hdr ) );
+	msg->msg_hdr.msg_name = &sendBatch.to[i];
+	msg->msg_hdr.msg_namelen = addrlen;
+	msg->msg_hdr.msg_iov = &sendBatch.iovecs[i];
+	msg->msg_hdr.msg_iovlen = 1;
+
+	if( sendBatch.numPackets == NET_BATCH_PACKETS ) {
+		NET_FlushSendBatch();
+	}
+}
+#endif
+
+/*
+==================
+NET_FlushPackets
+
+Send packets queued by Sys_SendPacket, called before sleeping
+==================
+*/
+static void NET_FlushPackets( void ) {
+#ifdef NET_BATCHED_IO
+	NET_FlushSendBatch();
+#endif
+}
 
 static char socksBuf[4096];
 
@@ -651,6 +895,8 @@ Sys_SendPacket
 void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 	int				ret = SOCKET_ERROR;
 	struct sockaddr_storage	addr;
+	SOCKET			sock;
+	socklen_t		addrlen;
 
 	if( to.type != NA_BROADCAST && to.type != NA_IP && to.type != NA_IP6 && to.type != NA_MULTICAST6)
 	{
@@ -679,27 +925,35 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 		*(short *)&socksBuf[8] = ((struct sockaddr_in *)&addr)->sin_port;
 		memcpy( &socksBuf[10], data, length );
 		ret = sendto( ip_socket, socksBuf, length+10, 0, &socksRelayAddr, sizeof(socksRelayAddr) );
+		netSendCalls++;
 	}
 	else {
-		if(addr.ss_family == AF_INET)
-			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
-		else if(addr.ss_family == AF_INET6)
-			ret = sendto( ip6_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in6) );
-	}
-	if( ret == SOCKET_ERROR ) {
-		int err = socketError;
-
-		// wouldblock is silent
-		if( err == EAGAIN ) {
-			return;
+		if(addr.ss_family == AF_INET) {
+			sock = ip_socket;
+			addrlen = sizeof(struct sockaddr_in);
+		}
+		else if(addr.ss_family == AF_INET6) {
+			sock = ip6_socket;
+			addrlen = sizeof(struct sockaddr_in6);
 		}
+		else
+			return;
 
-		// some PPP links do not allow broadcasts and return an error
-		if( ( err == EADDRNOTAVAIL ) && ( ( to.type == NA_BROADCAST ) ) ) {
+#ifdef NET_BATCHED_IO
+		if( batchedIO && length <= NET_BATCH_PACKETLEN ) {
+			NET_QueueSendBatch( sock, &addr, addrlen, length, data, to.type );
 			return;
 		}
 
-		Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+		// keep packets in order
+		NET_FlushSendBatch();
+#endif
+
+		ret = sendto( sock, data, length, 0, (struct sockaddr *) &addr, addrlen );
+		netSendCalls++;
+	}
+	if( ret == SOCKET_ERROR ) {
+		NET_SendError( to.type );
 	}
 }
 
@@ -1059,7 +1313,14 @@ void NET_LeaveMulticast6()
 	if(multicast6_socket != INVALID_SOCKET)
 	{
 		if(multicast6_socket != ip6_socket)
+		{
 			closesocket(multicast6_socket);
+#ifdef NET_EPOLL
+			// closing removed it from epoll, the descriptor may be reused
+			epollFDs[2] = -1;
+			epollFailedFDs[2] = -1;
+#endif
+		}
 		else
 			setsockopt(multicast6_socket, IPPROTO_IPV6, IPV6_LEAVE_GROUP, (char *) &curgroup, sizeof(curgroup));
 
@@ -1488,10 +1749,43 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get("net_dropsim", "", CVAR_TEMP);
 
+#ifdef NET_BATCHED_IO
+#ifdef DEDICATED
+	net_batchedIO = Cvar_Get( "net_batchedIO", "1", CVAR_LATCH | CVAR_ARCHIVE );
+#else
+	net_batchedIO = Cvar_Get( "net_batchedIO", "0", CVAR_LATCH | CVAR_ARCHIVE );
+#endif
+	modified += net_batchedIO->modified;
+	net_batchedIO->modified = qfalse;
+	batchedIO = net_batchedIO->integer ? qtrue : qfalse;
+#endif
+
 	return modified ? qtrue : qfalse;
 }
 
 
+#ifdef NET_EPOLL
+/*
+====================
+NET_ResetEpoll
+
+Forget registered sockets, closing a socket removes it from epoll.
+Console input is the last fd and stays registered
+====================
+*/
+static void NET_ResetEpoll( void )
+{
+	int i;
+
+	for( i = 0; i < NET_EPOLL_FDS - 1; i++ )
+	{
+		epollFDs[i] = -1;
+		epollFailedFDs[i] = -1;
+	}
+}
+
+#endif
+
 /*
 ====================
 NET_Config
@@ -1537,6 +1831,17 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+		NET_FlushPackets();
+
+#ifdef NET_BATCHED_IO
+		recvBatch.numPackets = 0;
+		recvBatch.nextPacket = 0;
+#endif
+
+#ifdef NET_EPOLL
+		NET_ResetEpoll();
+#endif
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1595,6 +1900,7 @@ void NET_Init( void ) {
 	NET_Config( qtrue );
 	
 	Cmd_AddCommand ("net_restart", NET_Restart_f);
+	Cmd_AddCommand ("net_stress", NET_Stress_f);
 }
 
 
@@ -1610,6 +1916,15 @@ void NET_Shutdown( void ) {
 
 	NET_Config( qfalse );
 
+#ifdef NET_EPOLL
+	if( epollFD != -1 ) {
+		close( timerFD );
+		close( epollFD );
+		timerFD = -1;
+		epollFD = -1;
+	}
+#endif
+
 #ifdef _WIN32
 	WSACleanup();
 	winsockInitialized = qfalse;
@@ -1651,22 +1966,192 @@ void NET_Event(fd_set *fdr)
 		else
 			break;
 	}
+
+	// send replies now instead of after the next sleep
+	NET_FlushPackets();
+}
+
+#ifdef NET_EPOLL
+/*
+====================
+NET_UpdateEpoll
+
+Make sure epollFD is waiting on the current sockets and console input
+====================
+*/
+static qboolean NET_UpdateEpoll( void )
+{
+	struct epoll_event event;
+	int fds[NET_EPOLL_FDS];
+	int i;
+
+	if( epollFD == -1 )
+	{
+		epollFD = epoll_create1( EPOLL_CLOEXEC );
+		if( epollFD == -1 )
+		{
+			Com_Printf( "WARNING: epoll_create1: %s\n", NET_ErrorString() );
+			return qfalse;
+		}
+
+		timerFD = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+		if( timerFD == -1 )
+		{
+			Com_Printf( "WARNING: timerfd_create: %s\n", NET_ErrorString() );
+			close( epollFD );
+			epollFD = -1;
+			return qfalse;
+		}
+
+		memset( &event, 0, sizeof( event ) );
+		event.events = EPOLLIN;
+		event.data.fd = timerFD;
+		epoll_ctl( epollFD, EPOLL_CTL_ADD, timerFD, &event );
+
+		// nothing is registered with the new epollFD
+		for( i = 0; i < NET_EPOLL_FDS; i++ )
+		{
+			epollFDs[i] = -1;
+			epollFailedFDs[i] = -1;
+		}
+	}
+
+	fds[0] = ip_socket;
+	fds[1] = ip6_socket;
+	fds[2] = ( multicast6_socket != ip6_socket ) ? multicast6_socket : -1;
+	fds[3] = Sys_ConsoleInputFD();
+
+	for( i = 0; i < NET_EPOLL_FDS; i++ )
+	{
+		if( fds[i] == epollFDs[i] )
+			continue;
+
+		if( epollFDs[i] != -1 )
+			epoll_ctl( epollFD, EPOLL_CTL_DEL, epollFDs[i], NULL );
+
+		epollFDs[i] = -1;
+
+		if( fds[i] == -1 || fds[i] == epollFailedFDs[i] )
+			continue;
+
+		memset( &event, 0, sizeof( event ) );
+		event.events = EPOLLIN;
+		event.data.fd = fds[i];
+
+		if( epoll_ctl( epollFD, EPOLL_CTL_ADD, fds[i], &event ) == -1 )
+		{
+			// console input redirected from a regular file can't be waited on
+			if( errno != EPERM )
+				Com_Printf( "WARNING: epoll_ctl: %s\n", NET_ErrorString() );
+
+			epollFailedFDs[i] = fds[i];
+		}
+		else
+		{
+			epollFDs[i] = fds[i];
+			epollFailedFDs[i] = -1;
+		}
+	}
+
+	return qtrue;
 }
 
+/*
+====================
+NET_EpollSleep
+
+Returns qtrue if woken up by console input
+====================
+*/
+static qboolean NET_EpollSleep( int usec )
+{
+	struct epoll_event events[NET_EPOLL_FDS + 1];
+	struct itimerspec timer;
+	fd_set fdr;
+	int i, numEvents, timeout;
+	qboolean network = qfalse;
+	qboolean console = qfalse;
+	uint64_t expirations;
+
+	memset( &timer, 0, sizeof( timer ) );
+
+	if( usec > 0 )
+	{
+		// epoll_wait only has millisecond timeouts
+		timer.it_value.tv_sec = usec / 1000000;
+		timer.it_value.tv_nsec = ( usec % 1000000 ) * 1000;
+		timerfd_settime( timerFD, 0, &timer, NULL );
+		timeout = -1;
+	}
+	else
+		timeout = 0;
+
+	numEvents = epoll_wait( epollFD, events, ARRAY_LEN( events ), timeout );
+
+	if( numEvents == -1 && errno != EINTR )
+		Com_Printf( "Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString() );
+
+	FD_ZERO( &fdr );
+
+	for( i = 0; i < numEvents; i++ )
+	{
+		if( events[i].data.fd == timerFD )
+		{
+			if( read( timerFD, &expirations, sizeof( expirations ) ) ) { }
+		}
+		else if( events[i].data.fd == ip_socket || events[i].data.fd == ip6_socket ||
+			events[i].data.fd == multicast6_socket )
+		{
+			FD_SET( events[i].data.fd, &fdr );
+			network = qtrue;
+		}
+		else
+			console = qtrue;
+	}
+
+	if( usec > 0 )
+	{
+		// disarm
+		memset( &timer, 0, sizeof( timer ) );
+		timerfd_settime( timerFD, 0, &timer, NULL );
+	}
+
+	if( network )
+		NET_Event( &fdr );
+
+	return console;
+}
+#endif
+
 /*
 ====================
 NET_Sleep
 
-Sleeps msec or until something happens on the network
+Sleeps usec or until something happens on the network.
+Returns qtrue if it woke up early for console input.
 ====================
 */
-void NET_Sleep(int msec)
+qboolean NET_Sleep(int usec)
 {
 	struct timeval timeout;
 	fd_set fdr;
 	int retval;
+	int msec;
 	SOCKET highestfd = INVALID_SOCKET;
 
+	if(usec < 0)
+		usec = 0;
+
+	NET_FlushPackets();
+
+#ifdef NET_EPOLL
+	if(NET_UpdateEpoll())
+		return NET_EpollSleep(usec);
+#endif
+
+	// select may oversleep, so wake up a millisecond early
+	// and poll for the rest like the frame loop always has
+	msec = usec / 1000 - 1;
 	if(msec < 0)
 		msec = 0;
 
@@ -1691,7 +2176,7 @@ void NET_Sleep(int msec)
 	{
 		// windows ain't happy when select is called without valid FDs
 		SleepEx(msec, 0);
-		return;
+		return qfalse;
 	}
 #endif
 
@@ -1704,6 +2189,8 @@ void NET_Sleep(int msec)
 		Com_Printf("Warning: select() syscall failed: %s\n", NET_ErrorString());
 	else if(retval > 0)
 		NET_Event(&fdr);
+
+	return qfalse;
 }
 
 /*
@@ -1715,3 +2202,189 @@ void NET_Restart_f(void)
 {
 	NET_Config(qtrue);
 }
+
+/*
+====================
+NET_StressDrain
+
+Process everything waiting on sock with chan.
+Returns number of complete messages received.
+====================
+*/
+static int NET_StressDrain( SOCKET sock, netchan_t *chan, void *batch )
+{
+	byte	bufData[MAX_MSGLEN + 1];
+	msg_t	netmsg;
+	struct sockaddr_storage from;
+	socklen_t	fromlen;
+	int		ret, numMessages;
+#ifdef NET_BATCHED_IO
+	netRecvBatch_t	*recv = batch;
+	int		i;
+#endif
+
+	numMessages = 0;
+
+	while(1)
+	{
+#ifdef NET_BATCHED_IO
+		if(recv)
+		{
+			ret = NET_RecvBatch( recv, sock, sizeof(bufData) );
+
+			if(ret <= 0)
+				break;
+
+			for(i = 0; i < ret; i++)
+			{
+				MSG_Init(&netmsg, bufData, sizeof(bufData));
+				netmsg.cursize = recv->msgs[i].msg_len;
+				Com_Memcpy(bufData, recv->data[i], netmsg.cursize);
+
+				if(Netchan_Process(chan, &netmsg))
+					numMessages++;
+			}
+			continue;
+		}
+#endif
+
+		MSG_Init(&netmsg, bufData, sizeof(bufData));
+
+		fromlen = sizeof(from);
+		ret = recvfrom(sock, (void *)netmsg.data, netmsg.maxsize, 0, (struct sockaddr *) &from, &fromlen);
+		netRecvCalls++;
+
+		if(ret == SOCKET_ERROR)
+			break;
+
+		netmsg.cursize = ret;
+
+		if(Netchan_Process(chan, &netmsg))
+			numMessages++;
+	}
+
+	return numMessages;
+}
+
+/*
+====================
+NET_Stress_f
+
+Send netchan messages to a loopback socket the way a server frame sends
+snapshots to MAX_CLIENTS clients, with and without batched socket calls.
+====================
+*/
+void NET_Stress_f(void)
+{
+	SOCKET		sock;
+	struct sockaddr_in	address;
+	socklen_t	addrlen;
+	netadr_t	adr;
+	netchan_t	sendChan, recvChan;
+	byte		*data;
+	void		*batch;
+	int			numMessages, size;
+	int			mode, numModes;
+	int			sent, received, i, err;
+	int			sendCalls, recvCalls, start, msec;
+#ifdef NET_BATCHED_IO
+	qboolean	oldBatchedIO = batchedIO;
+#endif
+
+	if(Cmd_Argc() > 3)
+	{
+		Com_Printf("Usage: net_stress [messages] [size]\n");
+		return;
+	}
+
+	numMessages = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 20000;
+	size = (Cmd_Argc() > 2) ? atoi(Cmd_Argv(2)) : 1200;
+
+	if(numMessages < 1)
+		numMessages = 1;
+
+	if(size < 1)
+		size = 1;
+	else if(size > MAX_MSGLEN)
+		size = MAX_MSGLEN;
+
+	if(ip_socket == INVALID_SOCKET)
+	{
+		Com_Printf("net_stress: IPv4 networking is not enabled\n");
+		return;
+	}
+
+	sock = NET_IPSocket("127.0.0.1", PORT_ANY, &err);
+
+	if(sock == INVALID_SOCKET)
+		return;
+
+	addrlen = sizeof(address);
+	if(getsockname(sock, (struct sockaddr *) &address, &addrlen) == SOCKET_ERROR)
+	{
+		Com_Printf("net_stress: getsockname: %s\n", NET_ErrorString());
+		closesocket(sock);
+		return;
+	}
+
+	Sys_StringToAdr("127.0.0.1", &adr, NA_IP);
+	adr.port = address.sin_port;
+
+	data = Z_Malloc(size);
+	for(i = 0; i < size; i++)
+		data[i] = i & 0xff;
+
+#ifdef NET_BATCHED_IO
+	batch = Z_Malloc(sizeof(netRecvBatch_t));
+	numModes = 2;
+#else
+	batch = NULL;
+	numModes = 1;
+#endif
+
+	for(mode = 0; mode < numModes; mode++)
+	{
+#ifdef NET_BATCHED_IO
+		batchedIO = mode ? qtrue : qfalse;
+#endif
+
+		Netchan_Setup(NS_SERVER, &sendChan, adr, 0, 0, qfalse);
+		Netchan_Setup(NS_CLIENT, &recvChan, adr, 0, 0, qfalse);
+
+		sendCalls = netSendCalls;
+		recvCalls = netRecvCalls;
+		received = 0;
+
+		start = Sys_Milliseconds();
+
+		for(sent = 0; sent < numMessages; )
+		{
+			// one server frame worth of snapshots
+			for(i = 0; i < MAX_CLIENTS && sent < numMessages; i++, sent++)
+			{
+				Netchan_Transmit(&sendChan, size, data);
+
+				while(sendChan.unsentFragments)
+					Netchan_TransmitNextFragment(&sendChan);
+			}
+
+			NET_FlushPackets();
+
+			received += NET_StressDrain(sock, &recvChan, mode ? batch : NULL);
+		}
+
+		msec = Sys_Milliseconds() - start;
+
+		Com_Printf("%s: %d messages of %d bytes, %d received, %d send calls, %d receive calls, %d msec\n",
+			mode ? "batched" : "unbatched", numMessages, size, received,
+			netSendCalls - sendCalls, netRecvCalls - recvCalls, msec);
+	}
+
+#ifdef NET_BATCHED_IO
+	batchedIO = oldBatchedIO;
+	Z_Free(batch);
+#endif
+
+	Z_Free(data);
+	closesocket(sock);
+}
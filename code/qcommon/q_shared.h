@@ -1139,6 +1139,17 @@ typedef struct {
 // trace->entityNum can also be 0 to (MAX_GENTITIES-1)
 // or ENTITYNUM_NONE, ENTITYNUM_WORLD
 
+// a single request for the batched trace system calls
+typedef struct {
+	vec3_t		start;
+	vec3_t		end;
+	vec3_t		mins;
+	vec3_t		maxs;
+	int			passEntityNum;	// ignored by cgame
+	int			contentmask;
+	int			traceType;		// TT_AABB or TT_CAPSULE
+} traceRequest_t;
+
 
 // markfragments are returned by R_MarkFragments()
 typedef struct {
@@ -136,6 +136,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitSpan( msg_t *msg, const byte *data, int bit, int numBits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -181,6 +182,8 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, sharedPlayerState_t *from, sharedPlay
 
 
 void MSG_ReportChangeVectors_f( void );
+void MSG_HuffmanBenchmark_f( void );
+void MSG_DeltaBenchmark_f( void );
 
 //============================================================================
 
@@ -242,6 +245,7 @@ typedef struct {
 void		NET_Init( void );
 void		NET_Shutdown( void );
 void		NET_Restart_f( void );
+void		NET_Stress_f( void );
 void		NET_Config( qboolean enableNetworking );
 void		NET_FlushPacketQueue(void);
 void		NET_SendPacket (netsrc_t sock, int length, const void *data, netadr_t to);
@@ -258,7 +262,7 @@ int		NET_StringToAdr ( const char *s, netadr_t *a, netadrtype_t family);
 qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_message);
 void		NET_JoinMulticast6(void);
 void		NET_LeaveMulticast6(void);
-void		NET_Sleep(int msec);
+qboolean	NET_Sleep(int usec);
 
 
 #define	MAX_MSGLEN				32768		// max length of a message, which may
@@ -781,6 +785,13 @@ void	FS_ForceFlush( fileHandle_t f );
 void	FS_FreeFile( void *buffer );
 // frees the memory returned by FS_ReadFile
 
+long	FS_MapFile( const char *qpath, void **buffer, void **mapping );
+// maps a file from a directory, or stored uncompressed in a pk3, instead of
+// reading it.  Changes to the buffer are private and there is no trailing 0.
+// -1 length and a NULL buffer if it can't be mapped, use FS_ReadFile instead.
+
+void	FS_UnmapFile( void *mapping );
+
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
 
@@ -973,6 +984,20 @@ qboolean	Com_IsVoipTarget(uint8_t *voipTargets, int voipTargetsSize, int playerN
 
 qboolean	Com_GameIsSinglePlayer(void);
 
+// runs func( data, jobNum ) for each jobNum in 0 to numJobs-1 using up to
+// numWorkers extra threads, returns when all jobs are finished.  Only call
+// from the main thread.  Jobs must not use Com_Printf, Com_Error, the zone
+// or hunk allocators, or a VM.
+#define	MAX_WORKER_THREADS	16
+typedef void (*jobFunc_t)( void *data, int jobNum );
+void		Com_RunJobs( jobFunc_t func, void *data, int numJobs, int numWorkers );
+
+// times the stages of a level load, printed by Com_EndLoadStages
+// when com_loadTimes is set.  stage must be a string literal.
+void		Com_BeginLoadStages( const char *name );
+void		Com_LoadStage( const char *stage );
+void		Com_EndLoadStages( void );
+
 void		Com_StartupVariable( const char *match );
 // checks for and removes command line "+set var arg" constructs
 // if match is NULL, all set commands will be executed, otherwise
@@ -1266,6 +1291,8 @@ void	Sys_Print( const char *msg );
 // Sys_Milliseconds should only be used for profiling purposes,
 // any game related timing information should come from event timestamps
 int		Sys_Milliseconds (void);
+// same origin as Sys_Milliseconds, for sleeping until a deadline
+int64_t	Sys_Microseconds (void);
 
 qboolean Sys_RandomBytes( byte *string, int len );
 
@@ -1289,6 +1316,9 @@ qboolean Sys_Mkdir( const char *path );
 qboolean Sys_Rmdir( const char *path );
 FILE	*Sys_Mkfifo( const char *ospath );
 int		Sys_StatFile( char *ospath );
+// copy on write mapping of part of a file, returns NULL on failure
+void	*Sys_MapFile( const char *ospath, long offset, long length, void **mapping );
+void	Sys_UnmapFile( void *mapping );
 char	*Sys_Cwd( void );
 void	Sys_SetDefaultInstallPath(const char *path);
 char	*Sys_DefaultInstallPath(void);
@@ -1302,6 +1332,7 @@ char	*Sys_DefaultHomePath(void);
 const char *Sys_Dirname( char *path );
 const char *Sys_Basename( char *path );
 char *Sys_ConsoleInput(void);
+int Sys_ConsoleInputFD(void);
 
 char **Sys_ListFiles( const char *directory, const char *extension, char *filter, int *numfiles, qboolean wantsubs );
 void	Sys_FreeFileList( char **list );
@@ -1309,6 +1340,20 @@ void	Sys_Sleep(int msec);
 
 qboolean Sys_LowPhysicalMemory( void );
 
+// threads, mutexes, and counting semaphores for Com_RunJobs
+// returns NULL on failure
+void	*Sys_CreateThread( void (*function)( void *arg ), void *arg );
+void	Sys_JoinThread( void *thread );
+void	*Sys_CreateMutex( void );
+void	Sys_DestroyMutex( void *mutex );
+void	Sys_LockMutex( void *mutex );
+void	Sys_UnlockMutex( void *mutex );
+void	*Sys_CreateSemaphore( void );
+void	Sys_DestroySemaphore( void *semaphore );
+void	Sys_SemaphoreWait( void *semaphore );
+void	Sys_SemaphorePost( void *semaphore );
+int		Sys_NumProcessors( void );
+
 void Sys_SetEnv(const char *name, const char *value);
 
 typedef enum
@@ -1382,6 +1427,21 @@ typedef struct {
 	huff_t		decompressor;
 } huffman_t;
 
+#define HUFF_LOOKUP_BITS	10	// bits decoded per lookup
+
+typedef struct {
+	short		symbol;
+	byte		length;		// 0 if the code is longer than HUFF_LOOKUP_BITS
+	node_t		*node;		// where to continue decoding longer codes
+} huffLookup_t;
+
+// lookup tables for a tree that isn't updated anymore
+typedef struct {
+	unsigned int	code[HMAX+1];	// first bit sent is bit 0
+	byte			length[HMAX+1];	// 0 if not in the tree or too long
+	huffLookup_t	lookup[1 << HUFF_LOOKUP_BITS];
+} huffTable_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1392,6 +1452,9 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+void	Huff_BuildTable( huffTable_t *table, huffman_t *huff );
+void	Huff_tableReceive (const huffTable_t *table, node_t *node, int *ch, byte *fin, int *offset, int maxoffset);
+void	Huff_tableTransmit (const huffTable_t *table, huff_t *huff, int ch, byte *fout, int *offset, int maxoffset);
 
 // don't use if you don't know what you're doing.
 int		Huff_getBloc(void);
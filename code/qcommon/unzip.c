@@ -1587,6 +1587,20 @@ extern uLong ZEXPORT unzGetOffset (file)
     return s->pos_in_central_dir;
 }
 
+extern uLong ZEXPORT unzGetCurrentFileZStreamPos (file)
+    unzFile file;
+{
+    unz_s* s;
+
+    if (file==NULL)
+        return 0;
+    s=(unz_s*)file;
+    if (s->pfile_in_zip_read==NULL)
+        return 0;
+    return s->pfile_in_zip_read->pos_in_zipfile +
+           s->pfile_in_zip_read->byte_before_the_zipfile;
+}
+
 extern int ZEXPORT unzSetOffset (file, pos)
         unzFile file;
         uLong pos;
@@ -346,6 +346,9 @@ extern uLong ZEXPORT unzGetOffset (unzFile file);
 /* Set the current file offset */
 extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
+/* Get the position of the opened current file's data in the zip file, 0 if none is open */
+extern uLong ZEXPORT unzGetCurrentFileZStreamPos (unzFile file);
+
 
 
 #ifdef __cplusplus
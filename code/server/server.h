@@ -52,17 +52,58 @@ typedef struct voipServerPacket_s
 } voipServerPacket_t;
 #endif
 
+typedef struct svClusterLink_s {
+	struct svEntity_s		*ent;
+	int						cluster;
+	struct svClusterLink_s	*prev, *next;
+} svClusterLink_t;
+
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	int			worldTreeLeaf;		// leaf in the world tree + 1, 0 if not in it
 	
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
 	int			snapshotCounter;	// used to prevent double adding from portal views
+
+	int				numClusterLinks;	// unique clusternums linked into sv.clusterEntities
+	svClusterLink_t	clusterLinks[MAX_ENT_CLUSTERS];
 } svEntity_t;
 
+// visible entities shared by all viewers in the same cluster and area
+#define	MAX_SNAPSHOT_VIS_CACHE		64
+#define	MAX_SNAPSHOT_VIS_ENTITIES	(MAX_GENTITIES*4)
+
+typedef struct {
+	int			cluster;
+	int			area;
+	int			portalGeneration;	// CM_AreaPortalGeneration()
+	int			listGeneration;		// sv.snapshotListGeneration
+
+	int			areabytes;
+	byte		areabits[MAX_MAP_AREA_BYTES];
+
+	int			*entities;			// sorted, into sv.snapshotVisEntities
+	int			numEntities;
+} snapshotVisCache_t;
+
+// entity deltas shared by clients with the same delta base
+#define	MAX_DELTA_CACHE_ENTRIES		4096	// must be a power of two
+#define	MAX_DELTA_CACHE_PROBES		8
+#define	MAX_DELTA_CACHE_BYTES		0x40000
+#define	DELTA_CACHE_BASELINE		-2		// fromFrame for deltas from sv.svEntitiesBaseline
+
+typedef struct {
+	int			frame;				// svs.snapshotFrame when added
+	int			number;				// entity number
+	int			fromFrame;			// snapshotFrame of the from state
+	int			bit;				// start of the encoded delta in sv.deltaCacheBits
+	int			numBits;
+} deltaCacheEntry_t;
+
 typedef enum {
 	SS_DEAD,			// no map loaded
 	SS_LOADING,			// spawning level entities
@@ -103,6 +144,39 @@ typedef struct {
 
 	int				restartTime;
 	int				time;
+
+	// per-cluster entity index, updated by SV_LinkEntity / SV_UnlinkEntity
+	int				numClusters;
+	svClusterLink_t	**clusterEntities;	// [numClusters] entities touching each PVS cluster
+
+	// entities that can't be found through clusterEntities, rebuilt
+	// by the first snapshot built in each SV_SendClientMessages
+	qboolean		snapshotListsValid;
+	int				numBroadcastEntities;
+	int				broadcastEntities[MAX_GENTITIES];	// SVF_BROADCAST
+	int				numPlayerMaskEntities;
+	int				playerMaskEntities[MAX_GENTITIES];	// SVF_PLAYERMASK
+	int				numOverflowEntities;
+	int				overflowEntities[MAX_GENTITIES];	// too many clusters for clusternums
+	int				snapshotListGeneration;
+
+	// cleared at the end of each SV_SendClientMessages
+	int				numSnapshotVisCache;
+	snapshotVisCache_t	snapshotVisCache[MAX_SNAPSHOT_VIS_CACHE];
+	int				numSnapshotVisEntities;
+	int				snapshotVisEntities[MAX_SNAPSHOT_VIS_ENTITIES];
+
+	int				snapshotVisCacheHits;
+	int				snapshotVisCacheMisses;
+
+	// entity deltas encoded this frame, entries from previous frames are unused
+	qboolean		deltaCacheActive;
+	deltaCacheEntry_t	deltaCache[MAX_DELTA_CACHE_ENTRIES];
+	int				deltaCacheBytes;
+	byte			deltaCacheBits[MAX_DELTA_CACHE_BYTES];
+
+	int				deltaCacheHits;
+	int				deltaCacheMisses;
 } server_t;
 
 
@@ -123,6 +197,7 @@ typedef struct {
 	int				messageSent;		// time the message was transmitted
 	int				messageAcked;		// time the message was acked
 	int				messageSize;		// used to rate drop packets
+	int				snapshotFrame;		// svs.snapshotFrame it was built in, -1 if it can't use sv.deltaCache
 } clientSnapshot_t;
 
 typedef enum {
@@ -137,6 +212,7 @@ typedef enum {
 typedef struct netchan_buffer_s {
 	msg_t           msg;
 	byte            msgBuffer[MAX_MSGLEN];
+	qboolean        download;		// download messages are paced by sv_dlRate, not the client's rate
 	struct netchan_buffer_s *next;
 } netchan_buffer_t;
 
@@ -194,6 +270,8 @@ typedef struct client_s {
 	qboolean		needBaseline;
 	int				ping;
 	int				rate;				// bytes / second
+	int64_t			rateTime;			// Sys_Microseconds() when rateCredit was last filled
+	int64_t			rateCredit;			// bytes * 1000000 that can be sent, negative while over rate
 	int				snapshotMsec;		// requests a snapshot every snapshotMsec unless rate choked
 	netchan_t		netchan;
 	// TTimo
@@ -202,6 +280,7 @@ typedef struct client_s {
 	// buffer them into this queue, and hand them out to netchan as needed
 	netchan_buffer_t *netchan_start_queue;
 	netchan_buffer_t **netchan_end_queue;
+	qboolean		downloadFragments;	// the unsent fragments are from a download message
 
 #ifdef USE_VOIP
 	qboolean hasVoip;
@@ -221,6 +300,26 @@ typedef struct client_s {
 
 } client_t;
 
+// clients waiting to send fragments or queued messages, see SV_Netchan_ScheduleSend
+#define SEND_WHEEL_SLOTS	256		// msec, must be a power of two
+
+typedef struct {
+	qboolean		scheduled;
+	int64_t			time;				// Sys_Microseconds() when the next packet can be sent
+	int				slot;				// in svs.sendWheel
+	int				next, prev;			// client number + 1 in the same slot, 0 for none
+} sendSchedule_t;
+
+// a snapshot message being written by SV_SendClientMessages
+typedef struct {
+	client_t			*client;
+	msg_t				msg;
+	qboolean			sendSnapshot;
+	clientSnapshot_t	*deltaFrame;		// NULL for full snapshot
+	int					lastframe;			// number of frames since deltaFrame
+	byte				msgBuffer[MAX_MSGLEN];
+} snapshotMessage_t;
+
 //=============================================================================
 
 
@@ -260,6 +359,16 @@ typedef struct {
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
 	netadr_t	redirectAddress;			// for rcon return messages
 	int			masterResolveTime[MAX_MASTER_SERVERS]; // next svs.time that server should do dns lookup for master server
+
+	snapshotMessage_t	*snapshotMessages;	// [numSnapshotMessages] for sv_snapshotThreads
+	int			numSnapshotMessages;
+
+	int			snapshotFrame;				// incremented every SV_SendClientMessages
+
+	sendSchedule_t	*sendSchedule;			// [sv_maxclients->integer]
+	int			sendWheel[SEND_WHEEL_SLOTS];	// first client number + 1 in each slot, 0 for none
+	int64_t		sendWheelTime;				// msec of the last slot that was run
+	int			numSendScheduled;
 } serverStatic_t;
 
 #define SERVER_MAXBANS	1024
@@ -309,6 +418,10 @@ extern	cvar_t	*sv_pure;
 extern	cvar_t	*sv_floodProtect;
 extern	cvar_t	*sv_lanForceRate;
 extern	cvar_t	*sv_banFile;
+extern	cvar_t	*sv_snapshotThreads;
+extern	cvar_t	*sv_deltaCache;
+extern	cvar_t	*sv_deltaCacheHitRate;
+extern	cvar_t	*sv_worldTree;
 
 extern	cvar_t	*sv_public;
 
@@ -357,7 +470,8 @@ void SV_RemoveOperatorCommands (void);
 
 
 void SV_MasterShutdown (void);
-int SV_RateMsec(client_t *client);
+int SV_RateUsec(client_t *client);
+void SV_RateSent(client_t *client, int messageSize);
 
 
 
@@ -422,6 +536,7 @@ void SV_WriteFrameToClient (client_t *client, msg_t *msg);
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
 void SV_SendClientSnapshot( client_t *client );
+void SV_SnapshotStats_f( void );
 
 //
 // sv_game.c
@@ -436,6 +551,8 @@ void		SV_InitGameProgs ( void );
 void		SV_ShutdownGameProgs ( void );
 void		SV_RestartGameProgs( void );
 qboolean	SV_inPVS (const vec3_t p1, const vec3_t p2);
+int			SV_inPVSList( const vec3_t p, const vec3_t *points, int numPoints, qboolean ignorePortals, byte *visible );
+void		SV_ClearPVSCache( void );
 
 //
 // sv_bot.c
@@ -482,6 +599,7 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_WorldBenchmark_f( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -508,6 +626,9 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests );
+// SV_Trace for each request, results and requests must not overlap
+
 void SV_ClipToEntities( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, traceType_t type );
 // clip to entities, but not world
 
@@ -518,6 +639,8 @@ void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, con
 // sv_net_chan.c
 //
 void SV_Netchan_Transmit( client_t *client, msg_t *msg);
-int SV_Netchan_TransmitNextFragment(client_t *client);
+void SV_Netchan_TransmitDownload( client_t *client, msg_t *msg );
+void SV_Netchan_ScheduleSend( client_t *client );
+void SV_Netchan_ResetSendSchedule( void );
 qboolean SV_Netchan_Process( client_t *client, msg_t *msg );
 void SV_Netchan_FreeQueue(client_t *client);
@@ -1227,6 +1227,8 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("worldBenchmark", SV_WorldBenchmark_f);
+	Cmd_AddCommand ("snapshotstats", SV_SnapshotStats_f);
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 	Cmd_AddCommand ("devmap", SV_Map_f);
@@ -1261,6 +1263,8 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("worldBenchmark");
+	Cmd_RemoveCommand ("snapshotstats");
 	Cmd_RemoveCommand ("say");
 #endif
 }
@@ -1232,40 +1232,6 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 	return 1;
 }
 
-/*
-==================
-SV_SendQueuedMessages
-
-Send one round of fragments, or queued messages to all clients that have data pending.
-Return the shortest time interval for sending next packet to client
-==================
-*/
-
-int SV_SendQueuedMessages(void)
-{
-	int i, retval = -1, nextFragT;
-	client_t *cl;
-	
-	for(i=0; i < sv_maxclients->integer; i++)
-	{
-		cl = &svs.clients[i];
-		
-		if(cl->state)
-		{
-			nextFragT = SV_RateMsec(cl);
-
-			if(!nextFragT)
-				nextFragT = SV_Netchan_TransmitNextFragment(cl);
-
-			if(nextFragT >= 0 && (retval == -1 || retval > nextFragT))
-				retval = nextFragT;
-		}
-	}
-
-	return retval;
-}
-
-
 /*
 ==================
 SV_SendDownloadMessages
@@ -1295,7 +1261,7 @@ int SV_SendDownloadMessages(void)
 			if(retval)
 			{
 				MSG_WriteByte(&msg, svc_EOF);
-				SV_Netchan_Transmit(cl, &msg);
+				SV_Netchan_TransmitDownload(cl, &msg);
 				numDLs += retval;
 			}
 		}
@@ -141,6 +141,73 @@ void SV_GetBrushBounds( int modelindex, vec3_t mins, vec3_t maxs ) {
 
 
 
+/*
+===============================================================================
+
+PVS POINT CACHE
+
+The game tests the same origins against the PVS many times a frame, so
+the cluster and area of recently looked up points are remembered until
+the next game frame.
+
+===============================================================================
+*/
+
+#define	PVS_CACHE_SIZE	256		// must be a power of two
+
+typedef struct {
+	vec3_t		point;
+	int			cluster;
+	int			area;
+	int			frame;
+} pvsCachePoint_t;
+
+static pvsCachePoint_t	sv_pvsCache[PVS_CACHE_SIZE];
+static int				sv_pvsCacheFrame = 1;
+
+/*
+=================
+SV_ClearPVSCache
+
+Called each game frame and when a map is loaded
+=================
+*/
+void SV_ClearPVSCache( void ) {
+	sv_pvsCacheFrame++;
+}
+
+/*
+=================
+SV_PointCluster
+=================
+*/
+static void SV_PointCluster( const vec3_t p, int *cluster, int *area ) {
+	pvsCachePoint_t	*cp;
+	floatint_t		fi[3];
+	unsigned		hash;
+	int				leafnum;
+
+	fi[0].f = p[0];
+	fi[1].f = p[1];
+	fi[2].f = p[2];
+	hash = ( fi[0].ui * 73856093u ) ^ ( fi[1].ui * 19349663u ) ^ ( fi[2].ui * 83492791u );
+	cp = &sv_pvsCache[ ( hash ^ ( hash >> 16 ) ) & ( PVS_CACHE_SIZE - 1 ) ];
+
+	if ( cp->frame != sv_pvsCacheFrame || !VectorCompare( cp->point, p ) ) {
+		leafnum = CM_PointLeafnum( p );
+
+		VectorCopy( p, cp->point );
+		cp->cluster = CM_LeafCluster( leafnum );
+		cp->area = CM_LeafArea( leafnum );
+		cp->frame = sv_pvsCacheFrame;
+	}
+
+	*cluster = cp->cluster;
+	if ( area ) {
+		*area = cp->area;
+	}
+}
+
 /*
 =================
 SV_inPVS
@@ -150,19 +217,14 @@ Also checks portalareas so that doors block sight
 */
 qboolean SV_inPVS (const vec3_t p1, const vec3_t p2)
 {
-	int		leafnum;
 	int		cluster;
 	int		area1, area2;
 	byte	*mask;
 
-	leafnum = CM_PointLeafnum (p1);
-	cluster = CM_LeafCluster (leafnum);
-	area1 = CM_LeafArea (leafnum);
+	SV_PointCluster (p1, &cluster, &area1);
 	mask = CM_ClusterPVS (cluster);
 
-	leafnum = CM_PointLeafnum (p2);
-	cluster = CM_LeafCluster (leafnum);
-	area2 = CM_LeafArea (leafnum);
+	SV_PointCluster (p2, &cluster, &area2);
 	if ( mask && (!(mask[cluster>>3] & (1<<(cluster&7)) ) ) )
 		return qfalse;
 	if (!CM_AreasConnected (area1, area2))
@@ -180,16 +242,13 @@ Does NOT check portalareas
 */
 qboolean SV_inPVSIgnorePortals( const vec3_t p1, const vec3_t p2)
 {
-	int		leafnum;
 	int		cluster;
 	byte	*mask;
 
-	leafnum = CM_PointLeafnum (p1);
-	cluster = CM_LeafCluster (leafnum);
+	SV_PointCluster (p1, &cluster, NULL);
 	mask = CM_ClusterPVS (cluster);
 
-	leafnum = CM_PointLeafnum (p2);
-	cluster = CM_LeafCluster (leafnum);
+	SV_PointCluster (p2, &cluster, NULL);
 
 	if ( mask && (!(mask[cluster>>3] & (1<<(cluster&7)) ) ) )
 		return qfalse;
@@ -198,6 +257,44 @@ qboolean SV_inPVSIgnorePortals( const vec3_t p1, const vec3_t p2)
 }
 
 
+/*
+=================
+SV_inPVSList
+
+Tests one point against many, sets visible[i] for each of points that
+SV_inPVS (or SV_inPVSIgnorePortals) would return qtrue for.  Returns the
+number of visible points.
+=================
+*/
+int SV_inPVSList( const vec3_t p, const vec3_t *points, int numPoints, qboolean ignorePortals, byte *visible )
+{
+	int		i;
+	int		cluster;
+	int		area1, area2;
+	byte	*mask;
+	int		numVisible;
+
+	SV_PointCluster (p, &cluster, &area1);
+	mask = CM_ClusterPVS (cluster);
+
+	numVisible = 0;
+	for ( i = 0; i < numPoints; i++ ) {
+		SV_PointCluster (points[i], &cluster, &area2);
+
+		visible[i] = qfalse;
+		if ( mask && (!(mask[cluster>>3] & (1<<(cluster&7)) ) ) )
+			continue;
+		if ( !ignorePortals && !CM_AreasConnected (area1, area2) )
+			continue;
+
+		visible[i] = qtrue;
+		numVisible++;
+	}
+
+	return numVisible;
+}
+
+
 /*
 ========================
 SV_AdjustAreaPortalState
@@ -473,6 +570,9 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_CLIPTOENTITIESCAPSULE:
 		SV_ClipToEntities( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], TT_CAPSULE );
 		return 0;
+	case G_TRACEBATCH:
+		SV_TraceBatch( VMA(1), VMA(2), args[3] );
+		return 0;
 	case G_POINT_CONTENTS:
 		return SV_PointContents( VMA(1), args[2] );
 	case G_GET_BRUSH_BOUNDS:
@@ -482,6 +582,8 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return SV_inPVS( VMA(1), VMA(2) );
 	case G_IN_PVS_IGNORE_PORTALS:
 		return SV_inPVSIgnorePortals( VMA(1), VMA(2) );
+	case G_IN_PVS_LIST:
+		return SV_inPVSList( VMA(1), VMA(2), args[3], args[4], VMA(5) );
 
 	case G_SET_CONFIGSTRING:
 		SV_SetConfigstring( args[1], VMA(2) );
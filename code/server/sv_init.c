@@ -302,6 +302,7 @@ static void SV_Startup( void ) {
 
 	svs.clients = Z_Malloc (sizeof(client_t) * sv_maxclients->integer );
 	svs.players = Z_Malloc (sizeof(player_t) * sv_maxclients->integer );
+	SV_Netchan_ResetSendSchedule();
 	if ( !Com_GameIsSinglePlayer() ) {
 		svs.numSnapshotEntities = sv_maxclients->integer * PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
 	} else {
@@ -408,6 +409,8 @@ void SV_ChangeMaxClients( void ) {
 	// free the old playes and clients on the hunk
 	Hunk_FreeTempMemory( oldPlayers );
 	Hunk_FreeTempMemory( oldClients );
+
+	SV_Netchan_ResetSendSchedule();
 	
 	// allocate new snapshot entities
 	if ( !Com_GameIsSinglePlayer() ) {
@@ -488,8 +491,11 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	char		systemInfo[16384];
 	const char	*p;
 
+	Com_BeginLoadStages( server );
+
 	// shut down the existing game if it is running
 	SV_ShutdownGameProgs();
+	Com_LoadStage( "game shutdown" );
 
 	Com_Printf ("Loading level %s...\n", server);
 	Com_DPrintf ("------ Server Initialization ------\n");
@@ -504,6 +510,7 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 
 	// clear the whole hunk because we're (re)loading the server
 	Hunk_Clear();
+	Com_LoadStage( "client shutdown" );
 
 #ifdef DEDICATED
 	// Restart renderer
@@ -514,9 +521,10 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	// Restart renderer
 	CL_StartHunkUsers( qtrue );
 #endif
+	Com_LoadStage( "renderer" );
 
-	// clear collision map data
-	CM_ClearMap();
+	// collision map data isn't on the hunk, CM_LoadMap keeps it if the
+	// same map is loaded again
 
 	// init client structures and svs.numSnapshotEntities 
 	if ( !Cvar_VariableValue("sv_running") ) {
@@ -555,8 +563,11 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	// make sure we are not paused
 	Cvar_Set("cl_paused", "0");
 
+	Com_LoadStage( "server init" );
+
 	// restart the file system
 	FS_Restart(qfalse);
+	Com_LoadStage( "filesystem" );
 
 	CM_LoadMap( va("maps/%s.bsp", server), qfalse, &checksum );
 
@@ -572,6 +583,7 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 
 	// clear physics interaction links
 	SV_ClearWorld ();
+	SV_ClearPVSCache();
 	
 	// media configstring setting should be done during
 	// the loading stage, so connected clients don't have
@@ -582,8 +594,11 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	SV_BotInitCvars();
 	SV_BotInitBotLib();
 
+	Com_LoadStage( "world" );
+
 	// load and spawn all other entities
 	SV_InitGameProgs();
+	Com_LoadStage( "game init" );
 
 	// allocate the snapshot entities on the hunk
 	DA_Init( &svs.snapshotEntities, svs.numSnapshotEntities, sv.gameEntityStateSize, qfalse );
@@ -597,6 +612,7 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 		sv.time += 100;
 		svs.time += 100;
 	}
+	Com_LoadStage( "settle frames" );
 
 	// create a baseline for more efficient communications
 	SV_CreateBaseline ();
@@ -734,6 +750,8 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	}
 #endif
 
+	Com_EndLoadStages();
+
 	Com_DPrintf ("-----------------------------------\n");
 }
 
@@ -810,6 +828,11 @@ void SV_Init (void)
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
 	sv_banFile = Cvar_Get("sv_banFile", "serverbans.dat", CVAR_ARCHIVE);
+	sv_snapshotThreads = Cvar_Get("sv_snapshotThreads", "0", CVAR_ARCHIVE);
+	Cvar_CheckRange(sv_snapshotThreads, 0, MAX_WORKER_THREADS, qtrue);
+	sv_deltaCache = Cvar_Get("sv_deltaCache", "1", CVAR_ARCHIVE);
+	sv_deltaCacheHitRate = Cvar_Get("sv_deltaCacheHitRate", "0", CVAR_ROM);
+	sv_worldTree = Cvar_Get("sv_worldTree", "0", CVAR_ARCHIVE);
 
 	sv_public = Cvar_Get("sv_public", "0", 0);
 	Cvar_CheckRange(sv_public, -2, 1, qtrue);
@@ -905,6 +928,12 @@ void SV_Shutdown( char *finalmsg ) {
 		
 		Z_Free(svs.clients);
 	}
+	if ( svs.snapshotMessages ) {
+		Z_Free( svs.snapshotMessages );
+	}
+	if ( svs.sendSchedule ) {
+		Z_Free( svs.sendSchedule );
+	}
 	Com_Memset( &svs, 0, sizeof( svs ) );
 
 	Cvar_Set( "sv_running", "0" );
@@ -69,6 +69,10 @@ cvar_t	*sv_pure;
 cvar_t	*sv_floodProtect;
 cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
 cvar_t	*sv_banFile;
+cvar_t	*sv_snapshotThreads;	// worker threads for delta encoding snapshots
+cvar_t	*sv_deltaCache;			// share encoded entity deltas between clients
+cvar_t	*sv_deltaCacheHitRate;	// percent of entity deltas found in the cache
+cvar_t	*sv_worldTree;			// link entities in a dynamic box tree instead of world sectors
 
 cvar_t  *sv_public;
 
@@ -1229,6 +1233,8 @@ void SV_Frame( int msec ) {
 		svs.time += frameMsec;
 		sv.time += frameMsec;
 
+		SV_ClearPVSCache();
+
 		// let everything in the world think and move
 		VM_Call (gvm, GAME_RUN_FRAME, sv.time);
 	}
@@ -1255,22 +1261,20 @@ void SV_Frame( int msec ) {
 
 /*
 ====================
-SV_RateMsec
+SV_ClientRate
 
-Return the number of msec until another message can be sent to
-a client based on its rate settings
+Return the client's rate in bytes per second after applying
+sv_minRate, sv_maxRate and timescale
 ====================
 */
 
 #define UDPIP_HEADER_SIZE 28
 #define UDPIP6_HEADER_SIZE 48
 
-int SV_RateMsec(client_t *client)
+static int SV_ClientRate(client_t *client)
 {
-	int rate, rateMsec;
-	int messageSize;
-	
-	messageSize = client->netchan.lastSentSize;
+	int rate;
+
 	rate = client->rate;
 
 	if(sv_maxRate->integer)
@@ -1289,18 +1293,104 @@ int SV_RateMsec(client_t *client)
 			rate = sv_minRate->integer;
 	}
 
+	rate = (int) (rate * com_timescale->value);
+
+	if(rate < 1)
+		rate = 1;
+
+	return rate;
+}
+
+/*
+====================
+SV_RateExempt
+
+Loopback clients and LAN clients with sv_lanForceRate aren't rate limited
+====================
+*/
+
+static qboolean SV_RateExempt(client_t *client)
+{
+	return client->netchan.remoteAddress.type == NA_LOOPBACK ||
+		(sv_lanForceRate->integer && Sys_IsLANAddress(client->netchan.remoteAddress));
+}
+
+/*
+====================
+SV_RateUsec
+
+Return the number of usec until another message can be sent to
+a client based on its rate settings.
+
+Each client has a token bucket that is filled at the client's rate
+and emptied by SV_RateSent. The bucket has no room for bursts, so a
+message can be sent once the time to send the previous ones at the
+client's rate has passed.
+====================
+*/
+
+int SV_RateUsec(client_t *client)
+{
+	int rate;
+	int64_t now, elapsed;
+
+	if(SV_RateExempt(client))
+	{
+		client->rateCredit = 0;
+		return 0;
+	}
+
+	rate = SV_ClientRate(client);
+	now = Sys_Microseconds();
+
+	elapsed = now - client->rateTime;
+	client->rateTime = now;
+
+	// the bucket can't go from empty to full in more than a second
+	if(elapsed > 1000000 || elapsed < 0)
+		elapsed = 1000000;
+
+	client->rateCredit += elapsed * rate;
+
+	if(client->rateCredit >= 0)
+	{
+		client->rateCredit = 0;
+		return 0;
+	}
+
+	return (int) ((-client->rateCredit + rate - 1) / rate);
+}
+
+/*
+====================
+SV_RateSent
+
+Take a sent message out of the client's token bucket. The debt is
+limited to a second at the client's rate, or the message if it is
+larger, so the client can't fall behind by more than that
+====================
+*/
+
+void SV_RateSent(client_t *client, int messageSize)
+{
+	int64_t maxDebt;
+
+	if(SV_RateExempt(client))
+		return;
+
+	// bring the bucket up to date before taking from it
+	SV_RateUsec(client);
+
 	if(client->netchan.remoteAddress.type == NA_IP6)
 		messageSize += UDPIP6_HEADER_SIZE;
 	else
 		messageSize += UDPIP_HEADER_SIZE;
-		
-	rateMsec = messageSize * 1000 / ((int) (rate * com_timescale->value));
-	rate = Sys_Milliseconds() - client->netchan.lastSentTime;
-	
-	if(rate > rateMsec)
-		return 0;
-	else
-		return rateMsec - rate;
+
+	client->rateCredit -= (int64_t) messageSize * 1000000;
+
+	maxDebt = (int64_t) MAX(SV_ClientRate(client), messageSize) * 1000000;
+	if(client->rateCredit < -maxDebt)
+		client->rateCredit = -maxDebt;
 }
 
 /*
@@ -1309,33 +1399,32 @@ SV_SendQueuedPackets
 
 Send download messages and queued packets in the time that we're idle, i.e.
 not computing a server frame or sending client snapshots.
-Return the time in msec until we expect to be called next
+Return the time in usec until we expect to be called next
 ====================
 */
 
 int SV_SendQueuedPackets()
 {
 	int numBlocks;
-	int dlStart, deltaT, delayT;
-	static int dlNextRound = 0;
+	int64_t dlStart, deltaT, delayT;
+	static int64_t dlNextRound = 0;
 	int timeVal = INT_MAX;
 
-	// Send out fragmented packets now that we're idle
+	// Send out fragmented packets that are due
 	delayT = SV_SendQueuedMessages();
 	if(delayT >= 0)
 		timeVal = delayT;
 
 	if(sv_dlRate->integer)
 	{
-		// Rate limiting. This is very imprecise for high
-		// download rates due to millisecond timedelta resolution
-		dlStart = Sys_Milliseconds();
+		// Rate limiting
+		dlStart = Sys_Microseconds();
 		deltaT = dlNextRound - dlStart;
 
 		if(deltaT > 0)
 		{
 			if(deltaT < timeVal)
-				timeVal = deltaT + 1;
+				timeVal = deltaT;
 		}
 		else
 		{
@@ -1344,12 +1433,12 @@ int SV_SendQueuedPackets()
 			if(numBlocks)
 			{
 				// There are active downloads
-				deltaT = Sys_Milliseconds() - dlStart;
+				deltaT = Sys_Microseconds() - dlStart;
 
-				delayT = 1000 * numBlocks * MAX_DOWNLOAD_BLKSIZE;
+				delayT = (int64_t) 1000000 * numBlocks * MAX_DOWNLOAD_BLKSIZE;
 				delayT /= sv_dlRate->integer * 1024;
 
-				if(delayT <= deltaT + 1)
+				if(delayT <= deltaT + 1000)
 				{
 					// Sending the last round of download messages
 					// took too long for given rate, don't wait for
@@ -1358,10 +1447,10 @@ int SV_SendQueuedPackets()
 					// all of the bandwidth. This will result in an
 					// effective maximum rate of 1MB/s per user, but the
 					// low download window size limits this anyways.
-					if(timeVal > 2)
-						timeVal = 2;
+					if(timeVal > 1000)
+						timeVal = 1000;
 
-					dlNextRound = dlStart + deltaT + 1;
+					dlNextRound = dlStart + deltaT + 1000;
 				}
 				else
 				{
@@ -64,6 +64,7 @@ void SV_Netchan_TransmitNextInQueue(client_t *client)
 	netbuf = client->netchan_start_queue;
 
 	Netchan_Transmit(&client->netchan, netbuf->msg.cursize, netbuf->msg.data);
+	client->downloadFragments = netbuf->download;
 
 	// pop from queue
 	client->netchan_start_queue = netbuf->next;
@@ -81,32 +82,27 @@ void SV_Netchan_TransmitNextInQueue(client_t *client)
 /*
 =================
 SV_Netchan_TransmitNextFragment
-Transmit the next fragment and the next queued packet
-Return number of ms until next message can be sent based on throughput given by client rate,
--1 if no packet was sent.
+Transmit the next fragment or the next queued packet
 =================
 */
 
-int SV_Netchan_TransmitNextFragment(client_t *client)
+static void SV_Netchan_TransmitNextFragment(client_t *client)
 {
 	if(client->netchan.unsentFragments)
-	{
 		Netchan_TransmitNextFragment(&client->netchan);
-		return SV_RateMsec(client);
-	}
 	else if(client->netchan_start_queue)
-	{
 		SV_Netchan_TransmitNextInQueue(client);
-		return SV_RateMsec(client);
-	}
-	
-	return -1;
+	else
+		return;
+
+	if(!client->downloadFragments)
+		SV_RateSent(client, client->netchan.lastSentSize);
 }
 
 
 /*
 ===============
-SV_Netchan_Transmit
+SV_Netchan_TransmitMessage
 TTimo
 https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=462
 if there are some unsent fragments (which may happen if the snapshots
@@ -115,7 +111,7 @@ then buffer them and make sure they get sent in correct order
 ================
 */
 
-void SV_Netchan_Transmit( client_t *client, msg_t *msg)
+static void SV_Netchan_TransmitMessage( client_t *client, msg_t *msg, qboolean download )
 {
 	MSG_WriteByte( msg, svc_EOF );
 
@@ -126,6 +122,7 @@ void SV_Netchan_Transmit( client_t *client, msg_t *msg)
 		netbuf = (netchan_buffer_t *) Z_Malloc(sizeof(netchan_buffer_t));
 		// store the msg, we can't store it encoded, as the encoding depends on stuff we still have to finish sending
 		MSG_Copy(&netbuf->msg, netbuf->msgBuffer, sizeof( netbuf->msgBuffer ), msg);
+		netbuf->download = download;
 		netbuf->next = NULL;
 		// insert it in the queue, the message will be encoded and sent later
 		*client->netchan_end_queue = netbuf;
@@ -134,7 +131,220 @@ void SV_Netchan_Transmit( client_t *client, msg_t *msg)
 	else
 	{
 		Netchan_Transmit( &client->netchan, msg->cursize, msg->data );
+		client->downloadFragments = download;
+		if( !download )
+			SV_RateSent( client, client->netchan.lastSentSize );
+	}
+
+	SV_Netchan_ScheduleSend( client );
+}
+
+/*
+===============
+SV_Netchan_Transmit
+===============
+*/
+void SV_Netchan_Transmit( client_t *client, msg_t *msg )
+{
+	SV_Netchan_TransmitMessage( client, msg, qfalse );
+}
+
+/*
+===============
+SV_Netchan_TransmitDownload
+
+Download messages are paced by sv_dlRate and aren't charged to the client's rate
+===============
+*/
+void SV_Netchan_TransmitDownload( client_t *client, msg_t *msg )
+{
+	SV_Netchan_TransmitMessage( client, msg, qtrue );
+}
+
+/*
+=============================================================================
+
+SEND SCHEDULE
+
+Clients with unsent fragments or queued messages are kept in a timer wheel
+with one slot per millisecond, in the slot for the time their rate allows
+the next packet to be sent.  Times further away than the wheel wrap around
+and are skipped until they are due.
+
+=============================================================================
+*/
+
+/*
+=================
+SV_Netchan_UnlinkSend
+=================
+*/
+static void SV_Netchan_UnlinkSend( int clientNum )
+{
+	sendSchedule_t *send;
+
+	send = &svs.sendSchedule[clientNum];
+
+	if(!send->scheduled)
+		return;
+
+	if(send->prev)
+		svs.sendSchedule[send->prev - 1].next = send->next;
+	else
+		svs.sendWheel[send->slot] = send->next;
+
+	if(send->next)
+		svs.sendSchedule[send->next - 1].prev = send->prev;
+
+	send->next = send->prev = 0;
+	send->scheduled = qfalse;
+	svs.numSendScheduled--;
+}
+
+/*
+=================
+SV_Netchan_ScheduleSend
+
+Add the client to the send schedule if it has packets waiting to be sent,
+or remove it if it doesn't
+=================
+*/
+void SV_Netchan_ScheduleSend( client_t *client )
+{
+	sendSchedule_t *send;
+	int clientNum;
+	int64_t msec;
+
+	if(!svs.sendSchedule)
+		return;
+
+	clientNum = client - svs.clients;
+	send = &svs.sendSchedule[clientNum];
+
+	if(!client->state || !(client->netchan.unsentFragments || client->netchan_start_queue))
+	{
+		SV_Netchan_UnlinkSend(clientNum);
+		return;
+	}
+
+	if(send->scheduled)
+		return;
+
+	send->time = Sys_Microseconds() + SV_RateUsec(client);
+
+	// slots before svs.sendWheelTime have already been run
+	msec = send->time / 1000;
+	if(msec < svs.sendWheelTime)
+		msec = svs.sendWheelTime;
+
+	send->slot = msec & (SEND_WHEEL_SLOTS - 1);
+	send->prev = 0;
+	send->next = svs.sendWheel[send->slot];
+	if(send->next)
+		svs.sendSchedule[send->next - 1].prev = clientNum + 1;
+	svs.sendWheel[send->slot] = clientNum + 1;
+
+	send->scheduled = qtrue;
+	svs.numSendScheduled++;
+}
+
+/*
+=================
+SV_Netchan_ResetSendSchedule
+
+Called after svs.clients is allocated
+=================
+*/
+void SV_Netchan_ResetSendSchedule( void )
+{
+	int i;
+
+	if(svs.sendSchedule)
+		Z_Free(svs.sendSchedule);
+
+	svs.sendSchedule = Z_Malloc(sv_maxclients->integer * sizeof(sendSchedule_t));
+	Com_Memset(svs.sendWheel, 0, sizeof(svs.sendWheel));
+	svs.sendWheelTime = Sys_Microseconds() / 1000;
+	svs.numSendScheduled = 0;
+
+	for(i = 0; i < sv_maxclients->integer; i++)
+		SV_Netchan_ScheduleSend(&svs.clients[i]);
+}
+
+/*
+==================
+SV_SendQueuedMessages
+
+Send the next fragment or queued message to clients that are due.
+Return the time in usec until the next client is due, or -1 if no
+client has data pending
+==================
+*/
+
+int SV_SendQueuedMessages(void)
+{
+	sendSchedule_t *send;
+	client_t *cl;
+	int64_t now, nowMsec, msec, slotMsec;
+	int clientNum, next, slot, i;
+
+	if(!svs.numSendScheduled)
+		return -1;
+
+	now = Sys_Microseconds();
+	nowMsec = now / 1000;
+
+	// only need to go around the wheel once
+	msec = svs.sendWheelTime;
+	if(nowMsec - msec >= SEND_WHEEL_SLOTS)
+		msec = nowMsec - SEND_WHEEL_SLOTS + 1;
+
+	for(; msec <= nowMsec; msec++)
+	{
+		slot = msec & (SEND_WHEEL_SLOTS - 1);
+
+		for(next = svs.sendWheel[slot]; next; )
+		{
+			clientNum = next - 1;
+			send = &svs.sendSchedule[clientNum];
+			next = send->next;
+
+			if(send->time > now)
+				continue;
+
+			cl = &svs.clients[clientNum];
+
+			SV_Netchan_UnlinkSend(clientNum);
+
+			if(cl->state)
+				SV_Netchan_TransmitNextFragment(cl);
+
+			// reschedule if there is more to send, it's always in a later
+			// slot or at the start of this one so it won't be seen again
+			SV_Netchan_ScheduleSend(cl);
+		}
+	}
+
+	svs.sendWheelTime = nowMsec;
+
+	if(!svs.numSendScheduled)
+		return -1;
+
+	// find the first slot with a client that is due this time around the wheel
+	for(i = 0; i < SEND_WHEEL_SLOTS; i++)
+	{
+		slotMsec = nowMsec + i;
+
+		for(next = svs.sendWheel[slotMsec & (SEND_WHEEL_SLOTS - 1)]; next; next = send->next)
+		{
+			send = &svs.sendSchedule[next - 1];
+
+			if(send->time / 1000 <= slotMsec)
+				return send->time > now ? (int) (send->time - now) : 0;
+		}
 	}
+
+	return SEND_WHEEL_SLOTS * 1000;
 }
 
 /*
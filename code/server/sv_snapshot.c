@@ -76,6 +76,70 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============
+SV_WriteCachedDeltaEntity
+
+Entities in snapshots built in the same frame are copies of the same game
+entity state, so clients delta compressing from snapshots built in the same
+frame get the same bits for the entity.  Copy the bits if another client
+already had the delta encoded this frame.
+=============
+*/
+static void SV_WriteCachedDeltaEntity( msg_t *msg, sharedEntityState_t *from, sharedEntityState_t *to,
+									qboolean force, int fromFrame ) {
+	deltaCacheEntry_t	*entry;
+	msg_t				cache;
+	int					hash, i, startBit;
+
+	if ( !sv.deltaCacheActive || fromFrame == -1 ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	hash = to->number * 7919 + fromFrame;
+	entry = NULL;
+
+	for ( i = 0; i < MAX_DELTA_CACHE_PROBES; i++ ) {
+		entry = &sv.deltaCache[ ( hash + i ) & ( MAX_DELTA_CACHE_ENTRIES - 1 ) ];
+
+		if ( entry->frame != svs.snapshotFrame ) {
+			// unused this frame
+			break;
+		}
+
+		if ( entry->number == to->number && entry->fromFrame == fromFrame ) {
+			sv.deltaCacheHits++;
+			MSG_WriteBitSpan( msg, sv.deltaCacheBits, entry->bit, entry->numBits );
+			return;
+		}
+	}
+
+	sv.deltaCacheMisses++;
+
+	startBit = msg->bit;
+	MSG_WriteDeltaEntity( msg, from, to, force );
+
+	if ( i == MAX_DELTA_CACHE_PROBES || msg->overflowed
+		|| sv.deltaCacheBytes + ( ( msg->bit - startBit ) >> 3 ) + 1 > MAX_DELTA_CACHE_BYTES ) {
+		return;
+	}
+
+	entry->frame = svs.snapshotFrame;
+	entry->number = to->number;
+	entry->fromFrame = fromFrame;
+	entry->bit = sv.deltaCacheBytes << 3;
+	entry->numBits = msg->bit - startBit;
+
+	Com_Memset( &cache, 0, sizeof( cache ) );
+	cache.data = sv.deltaCacheBits;
+	cache.maxsize = MAX_DELTA_CACHE_BYTES;
+	cache.bit = entry->bit;
+
+	MSG_WriteBitSpan( &cache, msg->data, startBit, entry->numBits );
+	sv.deltaCacheBytes = ( cache.bit + 7 ) >> 3;
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -88,12 +152,20 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 	int		oldindex, newindex;
 	int		oldnum, newnum;
 	int		from_num_entities;
+	int		fromFrame;
 
 	// generate the delta update
 	if ( !from ) {
 		from_num_entities = 0;
+		fromFrame = -1;
 	} else {
 		from_num_entities = from->num_entities;
+		fromFrame = from->snapshotFrame;
+	}
+
+	// only entities in snapshots built this frame can be shared
+	if ( to->snapshotFrame != svs.snapshotFrame ) {
+		fromFrame = -1;
 	}
 
 	newent = NULL;
@@ -119,7 +191,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteCachedDeltaEntity( msg, oldent, newent, qfalse, fromFrame );
 			oldindex++;
 			newindex++;
 			continue;
@@ -127,7 +199,8 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, DA_ElementPointer( sv.svEntitiesBaseline, newnum ), newent, qtrue );
+			SV_WriteCachedDeltaEntity( msg, DA_ElementPointer( sv.svEntitiesBaseline, newnum ), newent, qtrue,
+				( to->snapshotFrame == svs.snapshotFrame ) ? DELTA_CACHE_BASELINE : -1 );
 			newindex++;
 			continue;
 		}
@@ -147,47 +220,63 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SnapshotDeltaFrame
+
+Returns the previous frame to delta compress the snapshot from and sets
+lastframe to how many frames ago it was, or NULL for a full snapshot.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
-	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
-
-	// snapshot wasn't ever built
-	if ( !frame->playerStates.pointer ) {
-		return;
-	}
+static clientSnapshot_t *SV_SnapshotDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t	*oldframe;
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->netchan.outgoingSequence - client->deltaMessage 
 		>= (PACKET_BACKUP - 3) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf ("%s: Delta request from out of date packet.\n", SV_ClientName( client ));
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else {
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
 		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
 			Com_DPrintf ("%s: Delta request from out of date entities.\n", SV_ClientName( client ));
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+
+oldframe and lastframe are from SV_SnapshotDeltaFrame.  This only reads
+the server state so it can be run on a worker thread.
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	// snapshot wasn't ever built
+	if ( !frame->playerStates.pointer ) {
+		return;
+	}
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -221,12 +310,6 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 
 	MSG_WriteByte (msg, snapFlags);
 
-	// send playerstates
-	if (frame->numPSs > MAX_SPLITVIEW) {
-		Com_DPrintf(S_COLOR_YELLOW "Warning: Almost sent numPSs as %d (max=%d)\n", frame->numPSs, MAX_SPLITVIEW);
-		frame->numPSs = MAX_SPLITVIEW;
-	}
-
 	// send number of playerstates and local player indexes
 	MSG_WriteByte (msg, frame->numPSs);
 	for (i = 0; i < MAX_SPLITVIEW; i++) {
@@ -382,37 +465,135 @@ static void SV_AddEntToSnapshot( clientSnapshot_t *frame, svEntity_t *svEnt, sha
 
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_UpdateSnapshotEntityLists
+
+Collect the entities that can't be found through the per-cluster entity
+lists, broadcast entities and entities touching too many clusters, as well
+as player masked entities which are usually only sent to a few players.
+This is done once per SV_SendClientMessages instead of for every client.
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint( int psIndex, int playerNum, vec3_t origin, clientSnapshot_t *frame, 
-									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+static void SV_UpdateSnapshotEntityLists( void ) {
+	sharedEntity_t	*ent;
+	svEntity_t		*svEnt;
+	int				e;
+
+	sv.numBroadcastEntities = 0;
+	sv.numPlayerMaskEntities = 0;
+	sv.numOverflowEntities = 0;
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum( e );
+
+		if ( !ent->r.linked ) {
+			continue;
+		}
+
+		if ( ent->r.svFlags & SVF_BROADCAST ) {
+			sv.broadcastEntities[ sv.numBroadcastEntities++ ] = e;
+		} else if ( ent->r.svFlags & SVF_PLAYERMASK ) {
+			sv.playerMaskEntities[ sv.numPlayerMaskEntities++ ] = e;
+		}
+
+		svEnt = &sv.svEntities[ e ];
+		if ( svEnt->lastCluster ) {
+			sv.overflowEntities[ sv.numOverflowEntities++ ] = e;
+		}
+	}
+
+	sv.snapshotListsValid = qtrue;
+
+	// cached visible entities are no longer valid
+	sv.snapshotListGeneration++;
+}
+
+/*
+===============
+SV_AddSnapshotCandidates
+
+Mark all entities that may be visible from clientpvs, so only those need to
+be fully checked.  Entities are found through the per-cluster entity lists
+of each cluster in the PVS and the lists from SV_UpdateSnapshotEntityLists.
+===============
+*/
+static void SV_AddSnapshotCandidates( const byte *clientpvs, unsigned *candidates ) {
+	svClusterLink_t	*link;
+	int				cluster;
+	int				e, i;
+
+	for ( cluster = 0 ; cluster < sv.numClusters ; cluster++ ) {
+		if ( !clientpvs[cluster >> 3] ) {
+			cluster |= 7;
+			continue;
+		}
+
+		if ( !( clientpvs[cluster >> 3] & ( 1 << ( cluster & 7 ) ) ) ) {
+			continue;
+		}
+
+		for ( link = sv.clusterEntities[cluster] ; link ; link = link->next ) {
+			e = link->ent - sv.svEntities;
+
+			// player masked entities are added from their own list
+			if ( SV_GentityNum( e )->r.svFlags & SVF_PLAYERMASK ) {
+				continue;
+			}
+
+			candidates[e >> 5] |= 1u << ( e & 31 );
+		}
+	}
+
+	for ( i = 0 ; i < sv.numBroadcastEntities ; i++ ) {
+		e = sv.broadcastEntities[i];
+		candidates[e >> 5] |= 1u << ( e & 31 );
+	}
+
+	for ( i = 0 ; i < sv.numPlayerMaskEntities ; i++ ) {
+		e = sv.playerMaskEntities[i];
+		candidates[e >> 5] |= 1u << ( e & 31 );
+	}
+
+	for ( i = 0 ; i < sv.numOverflowEntities ; i++ ) {
+		e = sv.overflowEntities[i];
+		candidates[e >> 5] |= 1u << ( e & 31 );
+	}
+}
+
+/*
+===============
+SV_FindVisibleEntities
+
+Fills in a sorted list of the entities that are visible from the cluster
+and area, without any of the checks that depend on the viewing player.
+Returns the number of entities added to the list.
+===============
+*/
+static int SV_FindVisibleEntities( int clientcluster, int clientarea, int *list ) {
 	int		e, i;
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
 	int		l;
-	int		clientarea, clientcluster;
-	int		leafnum;
+	int		count;
 	byte	*clientpvs;
 	byte	*bitvector;
+	unsigned	candidates[MAX_GENTITIES / 32];
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specfically check for it
-	if ( !sv.state ) {
-		return;
-	}
-
-	leafnum = CM_PointLeafnum (origin);
-	clientarea = CM_LeafArea (leafnum);
-	clientcluster = CM_LeafCluster (leafnum);
+	clientpvs = CM_ClusterPVS (clientcluster);
 
-	// calculate the visible areas
-	frame->areabytes[psIndex] = CM_WriteAreaBits( frame->areabits[psIndex], clientarea );
+	Com_Memset( candidates, 0, sizeof( candidates ) );
+	SV_AddSnapshotCandidates( clientpvs, candidates );
 
-	clientpvs = CM_ClusterPVS (clientcluster);
+	count = 0;
 
 	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		// skip entities that can't be visible
+		if ( !( candidates[e >> 5] & ( 1u << ( e & 31 ) ) ) ) {
+			if ( !candidates[e >> 5] ) {
+				e |= 31;
+			}
+			continue;
+		}
+
 		ent = SV_GentityNum(e);
 
 		// never send entities that aren't linked in
@@ -425,39 +606,14 @@ static void SV_AddEntitiesVisibleFromPoint( int psIndex, int playerNum, vec3_t o
 			ent->s.number = e;
 		}
 
-		// entities can be flagged to explicitly not be sent to the client
-		if ( ent->r.svFlags & SVF_NOCLIENT ) {
-			continue;
-		}
-
-		// entities can be flagged to be sent to a given mask of clients
-		if ( ent->r.svFlags & SVF_PLAYERMASK ) {
-			if ( !Com_ClientListContains( &ent->r.sendPlayers, playerNum ) )
-				continue;
-		}
-
-		svEnt = SV_SvEntityForGentity( ent );
-
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
-			continue;
-		}
-
-		// limit based on distance
-		if ( ent->r.cullDistance ) {
-			vec3_t dir;
-			VectorSubtract(ent->s.origin, origin, dir);
-			if ( VectorLengthSquared(dir) > (float) ent->r.cullDistance * ent->r.cullDistance ) {
-				continue;
-			}
-		}
-
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( frame, svEnt, ent, eNums );
+			list[count++] = e;
 			continue;
 		}
 
+		svEnt = SV_SvEntityForGentity( ent );
+
 		// ignore if not touching a PV leaf
 		// check area
 		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
@@ -499,6 +655,162 @@ static void SV_AddEntitiesVisibleFromPoint( int psIndex, int playerNum, vec3_t o
 			}
 		}
 
+		list[count++] = e;
+	}
+
+	return count;
+}
+
+/*
+===============
+SV_SnapshotVisCache
+
+Returns the cached visible entities for the cluster and area, finding them
+if this is the first viewer there since the cache was cleared.  Splitscreen
+players and players standing near each other share the same entry.
+Returns NULL if the cache is full.
+===============
+*/
+static snapshotVisCache_t *SV_SnapshotVisCache( int clientcluster, int clientarea ) {
+	snapshotVisCache_t	*entry;
+	int					portalGeneration;
+	int					i;
+
+	portalGeneration = CM_AreaPortalGeneration();
+
+	for ( i = 0 ; i < sv.numSnapshotVisCache ; i++ ) {
+		entry = &sv.snapshotVisCache[i];
+
+		if ( entry->cluster == clientcluster && entry->area == clientarea
+			&& entry->portalGeneration == portalGeneration
+			&& entry->listGeneration == sv.snapshotListGeneration ) {
+			sv.snapshotVisCacheHits++;
+			return entry;
+		}
+	}
+
+	sv.snapshotVisCacheMisses++;
+
+	// the whole entity list must fit, entries aren't freed until the
+	// end of SV_SendClientMessages as they may still be in use
+	if ( sv.numSnapshotVisCache == MAX_SNAPSHOT_VIS_CACHE
+		|| sv.numSnapshotVisEntities + sv.num_entities > MAX_SNAPSHOT_VIS_ENTITIES ) {
+		return NULL;
+	}
+
+	entry = &sv.snapshotVisCache[ sv.numSnapshotVisCache++ ];
+	entry->cluster = clientcluster;
+	entry->area = clientarea;
+	entry->portalGeneration = portalGeneration;
+	entry->listGeneration = sv.snapshotListGeneration;
+
+	Com_Memset( entry->areabits, 0, sizeof( entry->areabits ) );
+	entry->areabytes = CM_WriteAreaBits( entry->areabits, clientarea );
+
+	entry->entities = &sv.snapshotVisEntities[ sv.numSnapshotVisEntities ];
+	entry->numEntities = SV_FindVisibleEntities( clientcluster, clientarea, entry->entities );
+	sv.numSnapshotVisEntities += entry->numEntities;
+
+	return entry;
+}
+
+/*
+===============
+SV_ClearSnapshotVisCache
+===============
+*/
+static void SV_ClearSnapshotVisCache( void ) {
+	sv.numSnapshotVisCache = 0;
+	sv.numSnapshotVisEntities = 0;
+}
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( int psIndex, int playerNum, vec3_t origin, clientSnapshot_t *frame, 
+									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+	int		e, i;
+	sharedEntity_t *ent;
+	svEntity_t	*svEnt;
+	int		clientarea, clientcluster;
+	int		leafnum;
+	snapshotVisCache_t	*cache;
+	int		*visEntities;
+	int		numVisEntities;
+
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specfically check for it
+	if ( !sv.state ) {
+		return;
+	}
+
+	if ( !sv.snapshotListsValid ) {
+		SV_UpdateSnapshotEntityLists();
+	}
+
+	leafnum = CM_PointLeafnum (origin);
+	clientarea = CM_LeafArea (leafnum);
+	clientcluster = CM_LeafCluster (leafnum);
+
+	cache = SV_SnapshotVisCache( clientcluster, clientarea );
+
+	if ( cache ) {
+		// calculate the visible areas
+		for ( i = 0 ; i < cache->areabytes ; i++ ) {
+			frame->areabits[psIndex][i] |= cache->areabits[i];
+		}
+		frame->areabytes[psIndex] = cache->areabytes;
+
+		visEntities = cache->entities;
+		numVisEntities = cache->numEntities;
+	} else {
+		// calculate the visible areas
+		frame->areabytes[psIndex] = CM_WriteAreaBits( frame->areabits[psIndex], clientarea );
+
+		visEntities = Hunk_AllocateTempMemory( MAX_GENTITIES * sizeof( int ) );
+		numVisEntities = SV_FindVisibleEntities( clientcluster, clientarea, visEntities );
+	}
+
+	for ( i = 0 ; i < numVisEntities ; i++ ) {
+		e = visEntities[i];
+		ent = SV_GentityNum(e);
+
+		// entities can be flagged to explicitly not be sent to the client
+		if ( ent->r.svFlags & SVF_NOCLIENT ) {
+			continue;
+		}
+
+		// entities can be flagged to be sent to a given mask of clients
+		if ( ent->r.svFlags & SVF_PLAYERMASK ) {
+			if ( !Com_ClientListContains( &ent->r.sendPlayers, playerNum ) )
+				continue;
+		}
+
+		svEnt = SV_SvEntityForGentity( ent );
+
+		// don't double add an entity through portals
+		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+			continue;
+		}
+
+		// limit based on distance
+		if ( ent->r.cullDistance ) {
+			vec3_t dir;
+			VectorSubtract(ent->s.origin, origin, dir);
+			if ( VectorLengthSquared(dir) > (float) ent->r.cullDistance * ent->r.cullDistance ) {
+				continue;
+			}
+		}
+
+		// broadcast entities are always sent
+		if ( ent->r.svFlags & SVF_BROADCAST ) {
+			SV_AddEntToSnapshot( frame, svEnt, ent, eNums );
+			continue;
+		}
+
 		// visibility dummies
 		if ( ent->r.svFlags & SVF_VISDUMMY ) {
 			sharedEntity_t *ment = NULL;
@@ -579,6 +891,10 @@ static void SV_AddEntitiesVisibleFromPoint( int psIndex, int playerNum, vec3_t o
 		}
 
 	}
+
+	if ( !cache ) {
+		Hunk_FreeTempMemory( visEntities );
+	}
 }
 
 /*
@@ -615,6 +931,9 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
 	frame->num_entities = 0;
+
+	// game entity states may change before the next SV_SendClientMessages
+	frame->snapshotFrame = sv.deltaCacheActive ? svs.snapshotFrame : -1;
 	
 	if ( client->state == CS_ZOMBIE ) {
 		return;
@@ -769,60 +1088,128 @@ void SV_SendMessageToClient(msg_t *msg, client_t *client)
 
 /*
 =======================
-SV_SendClientSnapshot
-
-Also called by SV_FinalMessage
+SV_BeginSnapshotMessage
 
+Writes everything that comes before the snapshot and decides which frame
+to delta compress the snapshot from.  All snapshots for this frame must be
+built first as they may overwrite the delta frame's entities.
 =======================
 */
-void SV_SendClientSnapshot( client_t *client ) {
-	byte		msg_buf[MAX_MSGLEN];
-	msg_t		msg;
+static void SV_BeginSnapshotMessage( snapshotMessage_t *sm, client_t *client ) {
+	clientSnapshot_t	*frame;
 
-	// build the snapshot
-	SV_BuildClientSnapshot( client );
+	sm->client = client;
+	sm->sendSnapshot = qfalse;
+	sm->deltaFrame = NULL;
+	sm->lastframe = 0;
 
-	// bots need to have their snapshots build, but
-	// the query them directly without needing to be sent
-	if ( client->netchan.remoteAddress.type == NA_BOT ) {
-		return;
-	}
-
-	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = qtrue;
+	MSG_Init (&sm->msg, sm->msgBuffer, sizeof(sm->msgBuffer));
+	sm->msg.allowoverflow = qtrue;
 
 	// NOTE, MRE: all server->client messages now acknowledge
 	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
+	MSG_WriteLong( &sm->msg, client->lastClientCommand );
 
 	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
+	SV_UpdateServerCommandsToClient( client, &sm->msg );
 
 	// if client is awaiting gamestate (or downloading a pk3), hold off sending snapshot as it
 	// can't be loaded until after cgame is loaded.
 	// must send snapshot to kicked (zombie) clients for them to process disconnect.
 	if ( client->state != CS_ACTIVE && client->state != CS_ZOMBIE ) {
 		client->needBaseline = qtrue;
-	} else {
-		// entities delta baseline
-		SV_WriteBaselineToClient( client, &msg );
+		return;
+	}
 
-		// send over all the relevant entityState_t
-		// and playerState_t
-		SV_WriteSnapshotToClient( client, &msg );
+	sm->sendSnapshot = qtrue;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	// snapshot wasn't ever built
+	if ( !frame->playerStates.pointer ) {
+		return;
 	}
 
+	if (frame->numPSs > MAX_SPLITVIEW) {
+		Com_DPrintf(S_COLOR_YELLOW "Warning: Almost sent numPSs as %d (max=%d)\n", frame->numPSs, MAX_SPLITVIEW);
+		frame->numPSs = MAX_SPLITVIEW;
+	}
+
+	sm->deltaFrame = SV_SnapshotDeltaFrame( client, &sm->lastframe );
+}
+
+/*
+=======================
+SV_WriteSnapshotMessage
+
+Delta encodes the baselines and snapshot.  This is most of the work of
+sending a snapshot and may be run on a worker thread.
+=======================
+*/
+static void SV_WriteSnapshotMessage( snapshotMessage_t *sm ) {
+	if ( !sm->sendSnapshot ) {
+		return;
+	}
+
+	// entities delta baseline
+	SV_WriteBaselineToClient( sm->client, &sm->msg );
+
+	// send over all the relevant entityState_t
+	// and playerState_t
+	SV_WriteSnapshotToClient( sm->client, sm->deltaFrame, sm->lastframe, &sm->msg );
+}
+
+/*
+=======================
+SV_WriteSnapshotMessageJob
+=======================
+*/
+static void SV_WriteSnapshotMessageJob( void *data, int jobNum ) {
+	SV_WriteSnapshotMessage( &((snapshotMessage_t *)data)[jobNum] );
+}
+
+/*
+=======================
+SV_FinishSnapshotMessage
+=======================
+*/
+static void SV_FinishSnapshotMessage( snapshotMessage_t *sm ) {
 #ifdef USE_VOIP
-	SV_WriteVoipToClient( client, &msg );
+	SV_WriteVoipToClient( sm->client, &sm->msg );
 #endif
 
 	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf ("WARNING: msg overflowed for %s\n", SV_ClientName( client ));
-		MSG_Clear (&msg);
+	if ( sm->msg.overflowed ) {
+		Com_Printf ("WARNING: msg overflowed for %s\n", SV_ClientName( sm->client ));
+		MSG_Clear (&sm->msg);
+	}
+
+	SV_SendMessageToClient( &sm->msg, sm->client );
+}
+
+/*
+=======================
+SV_SendClientSnapshot
+
+Also called by SV_FinalMessage
+
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client ) {
+	snapshotMessage_t	sm;
+
+	// build the snapshot
+	SV_BuildClientSnapshot( client );
+
+	// bots need to have their snapshots build, but
+	// the query them directly without needing to be sent
+	if ( client->netchan.remoteAddress.type == NA_BOT ) {
+		return;
 	}
 
-	SV_SendMessageToClient( &msg, client );
+	SV_BeginSnapshotMessage( &sm, client );
+	SV_WriteSnapshotMessage( &sm );
+	SV_FinishSnapshotMessage( &sm );
 }
 
 
@@ -835,6 +1222,26 @@ void SV_SendClientMessages(void)
 {
 	int		i;
 	client_t	*c;
+	int		numMessages;
+	qboolean	threaded;
+	int		lookups;
+
+	threaded = ( sv_snapshotThreads->integer > 0 );
+	numMessages = 0;
+
+	// the delta cache isn't thread safe
+	svs.snapshotFrame++;
+	sv.deltaCacheActive = ( sv_deltaCache->integer && !threaded );
+	sv.deltaCacheBytes = 0;
+	lookups = sv.deltaCacheHits + sv.deltaCacheMisses;
+
+	if ( threaded && svs.numSnapshotMessages < sv_maxclients->integer ) {
+		if ( svs.snapshotMessages ) {
+			Z_Free( svs.snapshotMessages );
+		}
+		svs.numSnapshotMessages = sv_maxclients->integer;
+		svs.snapshotMessages = Z_Malloc( svs.numSnapshotMessages * sizeof( snapshotMessage_t ) );
+	}
 
 	// send a message to each connected client
 	for(i=0; i < sv_maxclients->integer; i++)
@@ -856,21 +1263,90 @@ void SV_SendClientMessages(void)
 			continue;		// Drop this snapshot if the packet queue is still full or delta compression will break
 		}
 
-		if(!(c->netchan.remoteAddress.type == NA_LOOPBACK ||
-		     (sv_lanForceRate->integer && Sys_IsLANAddress(c->netchan.remoteAddress))))
+		// rate control for clients not on LAN, SV_RateUsec is 0 for the others
+		// allow being under a msec early, the next chance is the next server frame
+		if(SV_RateUsec(c) >= 1000)
 		{
-			// rate control for clients not on LAN 
-			if(SV_RateMsec(c) > 0)
-			{
-				// Not enough time since last packet passed through the line
-				c->rateDelayed = qtrue;
-				continue;
-			}
+			// Not enough time since last packet passed through the line
+			c->rateDelayed = qtrue;
+			continue;
 		}
 
 		// generate and send a new message
-		SV_SendClientSnapshot(c);
+		if ( threaded ) {
+			// build now, encode and send after all snapshots are built
+			SV_BuildClientSnapshot( c );
+
+			if ( c->netchan.remoteAddress.type != NA_BOT ) {
+				svs.snapshotMessages[numMessages++].client = c;
+			}
+		} else {
+			SV_SendClientSnapshot(c);
+		}
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+
+	if ( numMessages ) {
+		for ( i = 0; i < numMessages; i++ ) {
+			SV_BeginSnapshotMessage( &svs.snapshotMessages[i], svs.snapshotMessages[i].client );
+		}
+
+		// delta encode the snapshots in parallel
+		Com_RunJobs( SV_WriteSnapshotMessageJob, svs.snapshotMessages, numMessages, sv_snapshotThreads->integer );
+
+		// netchan isn't thread safe
+		for ( i = 0; i < numMessages; i++ ) {
+			SV_FinishSnapshotMessage( &svs.snapshotMessages[i] );
+		}
+	}
+
+	// entity flags may change before the next snapshots are built
+	sv.snapshotListsValid = qfalse;
+	SV_ClearSnapshotVisCache();
+
+	sv.deltaCacheActive = qfalse;
+
+	if ( sv.deltaCacheHits + sv.deltaCacheMisses != lookups ) {
+		Cvar_Set( "sv_deltaCacheHitRate", va( "%.1f", 100.0f * sv.deltaCacheHits / ( sv.deltaCacheHits + sv.deltaCacheMisses ) ) );
+	}
+}
+
+/*
+=======================
+SV_SnapshotStats_f
+
+Print how often the visible entities for a viewer were shared
+=======================
+*/
+void SV_SnapshotStats_f( void ) {
+	int		total;
+
+	// make sure server is running
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	total = sv.snapshotVisCacheHits + sv.snapshotVisCacheMisses;
+
+	Com_Printf( "snapshot visibility cache:\n" );
+	Com_Printf( "%9i lookups\n", total );
+	Com_Printf( "%9i hits (%.1f%%)\n", sv.snapshotVisCacheHits, total ? 100.0f * sv.snapshotVisCacheHits / total : 0.0f );
+	Com_Printf( "%9i misses\n", sv.snapshotVisCacheMisses );
+
+	total = sv.deltaCacheHits + sv.deltaCacheMisses;
+
+	Com_Printf( "entity delta cache:\n" );
+	Com_Printf( "%9i lookups\n", total );
+	Com_Printf( "%9i hits (%.1f%%)\n", sv.deltaCacheHits, total ? 100.0f * sv.deltaCacheHits / total : 0.0f );
+	Com_Printf( "%9i misses\n", sv.deltaCacheMisses );
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		sv.snapshotVisCacheHits = 0;
+		sv.snapshotVisCacheMisses = 0;
+		sv.deltaCacheHits = 0;
+		sv.deltaCacheMisses = 0;
+		Cvar_Set( "sv_deltaCacheHitRate", "0" );
+	}
 }
@@ -78,6 +78,455 @@ typedef struct worldSector_s {
 worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
+/*
+Alternatively (sv_worldTree 1) entities are kept in the leafs of a dynamic
+bounding box tree.  Leaf boxes are fattened by WORLD_TREE_MARGIN so entities
+that move a little don't change the tree, and the tree is kept balanced with
+rotations as entities are inserted and removed, so it doesn't degrade on large
+or vertical maps the way the fixed sectors do.
+*/
+
+#define	WORLD_TREE_NULL			-1
+#define	WORLD_TREE_MARGIN		32
+#define	MAX_WORLD_TREE_NODES	(MAX_GENTITIES*2)
+
+typedef struct {
+	vec3_t	mins, maxs;		// fattened for leafs
+	int		parent;			// next free node for unused nodes
+	int		children[2];	// WORLD_TREE_NULL for leafs
+	int		height;			// 0 for leafs, -1 for unused nodes
+	int		entityNum;		// leafs only
+} worldTreeNode_t;
+
+typedef struct {
+	worldTreeNode_t	nodes[MAX_WORLD_TREE_NODES];
+	int			root;
+	int			freeList;
+	int			numNodes;
+	int			numLeafs;
+
+	int			numKept;		// links that stayed inside the fat box
+	int			numReinserted;
+} worldTree_t;
+
+static worldTree_t	sv_entityTree;
+static qboolean		sv_worldTreeActive;
+
+
+/*
+===============
+SV_WorldTreeAllocNode
+===============
+*/
+static int SV_WorldTreeAllocNode( void ) {
+	worldTreeNode_t	*node;
+	int				index;
+
+	index = sv_entityTree.freeList;
+	if ( index == WORLD_TREE_NULL ) {
+		Com_Error( ERR_DROP, "SV_WorldTreeAllocNode: MAX_WORLD_TREE_NODES" );
+	}
+
+	node = &sv_entityTree.nodes[index];
+	sv_entityTree.freeList = node->parent;
+	sv_entityTree.numNodes++;
+
+	node->parent = WORLD_TREE_NULL;
+	node->children[0] = node->children[1] = WORLD_TREE_NULL;
+	node->height = 0;
+	node->entityNum = -1;
+
+	return index;
+}
+
+/*
+===============
+SV_WorldTreeFreeNode
+===============
+*/
+static void SV_WorldTreeFreeNode( int index ) {
+	worldTreeNode_t	*node;
+
+	node = &sv_entityTree.nodes[index];
+	node->parent = sv_entityTree.freeList;
+	node->height = -1;
+	sv_entityTree.freeList = index;
+	sv_entityTree.numNodes--;
+}
+
+/*
+===============
+SV_WorldTreeArea
+
+Half the surface area of a box, the cost of visiting a node is
+proportional to it for randomly placed queries
+===============
+*/
+static float SV_WorldTreeArea( const vec3_t mins, const vec3_t maxs ) {
+	vec3_t	size;
+
+	VectorSubtract( maxs, mins, size );
+	return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+/*
+===============
+SV_WorldTreeUnion
+===============
+*/
+static void SV_WorldTreeUnion( const worldTreeNode_t *a, const worldTreeNode_t *b, vec3_t mins, vec3_t maxs ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		mins[i] = MIN( a->mins[i], b->mins[i] );
+		maxs[i] = MAX( a->maxs[i], b->maxs[i] );
+	}
+}
+
+/*
+===============
+SV_WorldTreeUpdateNode
+
+Recalculate the box and height of an inner node from its children
+===============
+*/
+static void SV_WorldTreeUpdateNode( int index ) {
+	worldTreeNode_t	*node, *child0, *child1;
+
+	node = &sv_entityTree.nodes[index];
+	child0 = &sv_entityTree.nodes[node->children[0]];
+	child1 = &sv_entityTree.nodes[node->children[1]];
+
+	SV_WorldTreeUnion( child0, child1, node->mins, node->maxs );
+	node->height = 1 + MAX( child0->height, child1->height );
+}
+
+/*
+===============
+SV_WorldTreeReplaceChild
+
+Point the parent of oldChild at newChild instead
+===============
+*/
+static void SV_WorldTreeReplaceChild( int parent, int oldChild, int newChild ) {
+	worldTreeNode_t	*node;
+
+	sv_entityTree.nodes[newChild].parent = parent;
+
+	if ( parent == WORLD_TREE_NULL ) {
+		sv_entityTree.root = newChild;
+		return;
+	}
+
+	node = &sv_entityTree.nodes[parent];
+	if ( node->children[0] == oldChild ) {
+		node->children[0] = newChild;
+	} else {
+		node->children[1] = newChild;
+	}
+}
+
+/*
+===============
+SV_WorldTreeBalance
+
+If one child of the node is more than one level taller than the other,
+rotate the taller child up to take the node's place.  Returns the index
+of the node now at this position in the tree.
+===============
+*/
+static int SV_WorldTreeBalance( int index ) {
+	worldTreeNode_t	*node, *up, *grand[2];
+	int				side, upIndex, taller, shorter;
+	int				balance;
+
+	node = &sv_entityTree.nodes[index];
+	if ( node->height < 2 ) {
+		return index;
+	}
+
+	balance = sv_entityTree.nodes[node->children[1]].height - sv_entityTree.nodes[node->children[0]].height;
+	if ( balance > 1 ) {
+		side = 1;
+	} else if ( balance < -1 ) {
+		side = 0;
+	} else {
+		return index;
+	}
+
+	upIndex = node->children[side];
+	up = &sv_entityTree.nodes[upIndex];
+	grand[0] = &sv_entityTree.nodes[up->children[0]];
+	grand[1] = &sv_entityTree.nodes[up->children[1]];
+
+	// the taller grandchild stays under the rotated node,
+	// the shorter one takes its place under the old node
+	if ( grand[0]->height > grand[1]->height ) {
+		taller = up->children[0];
+		shorter = up->children[1];
+	} else {
+		taller = up->children[1];
+		shorter = up->children[0];
+	}
+
+	SV_WorldTreeReplaceChild( node->parent, index, upIndex );
+
+	up->children[0] = index;
+	up->children[1] = taller;
+	node->parent = upIndex;
+
+	node->children[side] = shorter;
+	sv_entityTree.nodes[shorter].parent = index;
+
+	SV_WorldTreeUpdateNode( index );
+	SV_WorldTreeUpdateNode( upIndex );
+
+	return upIndex;
+}
+
+/*
+===============
+SV_WorldTreeRefit
+
+Walk from a node up to the root fixing boxes and heights
+===============
+*/
+static void SV_WorldTreeRefit( int index ) {
+	while ( index != WORLD_TREE_NULL ) {
+		index = SV_WorldTreeBalance( index );
+		SV_WorldTreeUpdateNode( index );
+		index = sv_entityTree.nodes[index].parent;
+	}
+}
+
+/*
+===============
+SV_WorldTreeInsertLeaf
+===============
+*/
+static void SV_WorldTreeInsertLeaf( int leaf ) {
+	worldTreeNode_t	*nodes, *node, *child;
+	vec3_t			mins, maxs;
+	float			area, combinedArea;
+	float			cost, inheritance, childCost[2];
+	int				index, sibling, parent;
+	int				i;
+
+	nodes = sv_entityTree.nodes;
+
+	if ( sv_entityTree.root == WORLD_TREE_NULL ) {
+		sv_entityTree.root = leaf;
+		nodes[leaf].parent = WORLD_TREE_NULL;
+		return;
+	}
+
+	// find the sibling that grows the total area of the tree the least
+	index = sv_entityTree.root;
+	while ( nodes[index].height > 0 ) {
+		node = &nodes[index];
+
+		area = SV_WorldTreeArea( node->mins, node->maxs );
+		SV_WorldTreeUnion( node, &nodes[leaf], mins, maxs );
+		combinedArea = SV_WorldTreeArea( mins, maxs );
+
+		// cost of pairing the leaf with this node
+		cost = 2 * combinedArea;
+
+		// every node above the sibling grows by at least this much
+		inheritance = 2 * ( combinedArea - area );
+
+		for ( i = 0 ; i < 2 ; i++ ) {
+			child = &nodes[node->children[i]];
+			SV_WorldTreeUnion( child, &nodes[leaf], mins, maxs );
+			childCost[i] = SV_WorldTreeArea( mins, maxs ) + inheritance;
+			if ( child->height > 0 ) {
+				childCost[i] -= SV_WorldTreeArea( child->mins, child->maxs );
+			}
+		}
+
+		if ( cost < childCost[0] && cost < childCost[1] ) {
+			break;
+		}
+
+		index = ( childCost[0] < childCost[1] ) ? node->children[0] : node->children[1];
+	}
+	sibling = index;
+
+	// create a new parent for the sibling and the leaf
+	parent = SV_WorldTreeAllocNode();
+	SV_WorldTreeReplaceChild( nodes[sibling].parent, sibling, parent );
+
+	nodes[parent].children[0] = sibling;
+	nodes[parent].children[1] = leaf;
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+
+	SV_WorldTreeRefit( parent );
+}
+
+/*
+===============
+SV_WorldTreeRemoveLeaf
+
+The leaf node itself is left allocated
+===============
+*/
+static void SV_WorldTreeRemoveLeaf( int leaf ) {
+	worldTreeNode_t	*nodes;
+	int				parent, grandParent, sibling;
+
+	nodes = sv_entityTree.nodes;
+
+	if ( leaf == sv_entityTree.root ) {
+		sv_entityTree.root = WORLD_TREE_NULL;
+		return;
+	}
+
+	parent = nodes[leaf].parent;
+	grandParent = nodes[parent].parent;
+	if ( nodes[parent].children[0] == leaf ) {
+		sibling = nodes[parent].children[1];
+	} else {
+		sibling = nodes[parent].children[0];
+	}
+
+	// the sibling takes the parent's place
+	SV_WorldTreeReplaceChild( grandParent, parent, sibling );
+	SV_WorldTreeFreeNode( parent );
+
+	SV_WorldTreeRefit( grandParent );
+}
+
+/*
+===============
+SV_WorldTreeLinkEntity
+
+Returns the entity's leaf.  An existing leaf is only moved in the tree
+if the new box sticks out of its fat box, or is much smaller than it.
+===============
+*/
+static int SV_WorldTreeLinkEntity( int leaf, int entityNum, const vec3_t absmin, const vec3_t absmax ) {
+	worldTreeNode_t	*node;
+	int				i;
+
+	if ( leaf != WORLD_TREE_NULL ) {
+		node = &sv_entityTree.nodes[leaf];
+		for ( i = 0 ; i < 3 ; i++ ) {
+			if ( absmin[i] < node->mins[i] || absmax[i] > node->maxs[i] ) {
+				break;
+			}
+			if ( absmin[i] - node->mins[i] > 4 * WORLD_TREE_MARGIN
+				|| node->maxs[i] - absmax[i] > 4 * WORLD_TREE_MARGIN ) {
+				break;
+			}
+		}
+		if ( i == 3 ) {
+			sv_entityTree.numKept++;
+			return leaf;
+		}
+
+		SV_WorldTreeRemoveLeaf( leaf );
+		sv_entityTree.numReinserted++;
+	} else {
+		leaf = SV_WorldTreeAllocNode();
+		sv_entityTree.numLeafs++;
+	}
+
+	node = &sv_entityTree.nodes[leaf];
+	node->entityNum = entityNum;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		node->mins[i] = absmin[i] - WORLD_TREE_MARGIN;
+		node->maxs[i] = absmax[i] + WORLD_TREE_MARGIN;
+	}
+
+	SV_WorldTreeInsertLeaf( leaf );
+
+	return leaf;
+}
+
+/*
+===============
+SV_WorldTreeUnlinkEntity
+===============
+*/
+static void SV_WorldTreeUnlinkEntity( int leaf ) {
+	SV_WorldTreeRemoveLeaf( leaf );
+	SV_WorldTreeFreeNode( leaf );
+	sv_entityTree.numLeafs--;
+}
+
+/*
+===============
+SV_ClearWorldTree
+===============
+*/
+static void SV_ClearWorldTree( void ) {
+	int		i;
+
+	sv_entityTree.root = WORLD_TREE_NULL;
+	sv_entityTree.numNodes = 0;
+	sv_entityTree.numLeafs = 0;
+	sv_entityTree.numKept = 0;
+	sv_entityTree.numReinserted = 0;
+
+	sv_entityTree.freeList = WORLD_TREE_NULL;
+	for ( i = MAX_WORLD_TREE_NODES - 1 ; i >= 0 ; i-- ) {
+		sv_entityTree.nodes[i].parent = sv_entityTree.freeList;
+		sv_entityTree.nodes[i].height = -1;
+		sv_entityTree.freeList = i;
+	}
+}
+
+/*
+===============
+SV_WorldTreeStats_r
+===============
+*/
+static void SV_WorldTreeStats_r( int index, int depth, int *leafsAtDepth, float *innerArea ) {
+	worldTreeNode_t	*node;
+
+	node = &sv_entityTree.nodes[index];
+	if ( node->height == 0 ) {
+		leafsAtDepth[depth]++;
+		return;
+	}
+
+	*innerArea += SV_WorldTreeArea( node->mins, node->maxs );
+	SV_WorldTreeStats_r( node->children[0], depth + 1, leafsAtDepth, innerArea );
+	SV_WorldTreeStats_r( node->children[1], depth + 1, leafsAtDepth, innerArea );
+}
+
+/*
+===============
+SV_WorldTreeList
+===============
+*/
+static void SV_WorldTreeList( void ) {
+	int		leafsAtDepth[MAX_WORLD_TREE_NODES / 2];
+	float	innerArea, rootArea;
+	int		height;
+	int		i;
+
+	if ( sv_entityTree.root == WORLD_TREE_NULL ) {
+		Com_Printf( "world tree: empty\n" );
+		return;
+	}
+
+	height = sv_entityTree.nodes[sv_entityTree.root].height;
+	Com_Memset( leafsAtDepth, 0, ( height + 1 ) * sizeof( leafsAtDepth[0] ) );
+	innerArea = 0;
+	SV_WorldTreeStats_r( sv_entityTree.root, 0, leafsAtDepth, &innerArea );
+
+	for ( i = 0 ; i <= height ; i++ ) {
+		Com_Printf( "depth %i: %i entities\n", i, leafsAtDepth[i] );
+	}
+
+	rootArea = SV_WorldTreeArea( sv_entityTree.nodes[sv_entityTree.root].mins, sv_entityTree.nodes[sv_entityTree.root].maxs );
+	Com_Printf( "world tree: %i entities, %i nodes, height %i, area ratio %.2f\n",
+		sv_entityTree.numLeafs, sv_entityTree.numNodes, height, rootArea > 0 ? innerArea / rootArea : 0 );
+	Com_Printf( "%i links kept their leaf, %i moved it\n", sv_entityTree.numKept, sv_entityTree.numReinserted );
+}
+
 
 /*
 ===============
@@ -89,6 +538,11 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( sv_worldTreeActive ) {
+		SV_WorldTreeList();
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -144,11 +598,12 @@ static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs
 
 /*
 ===============
-SV_ClearWorld
+SV_ClearWorldEntities
 
+Resets the entity broadphase for the current clip map
 ===============
 */
-void SV_ClearWorld( void ) {
+static void SV_ClearWorldEntities( qboolean useTree ) {
 	clipHandle_t	h;
 	vec3_t			mins, maxs;
 
@@ -159,20 +614,121 @@ void SV_ClearWorld( void ) {
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	SV_ClearWorldTree();
+	sv_worldTreeActive = useTree;
+}
+
+/*
+===============
+SV_ClearWorld
+
+===============
+*/
+void SV_ClearWorld( void ) {
+	SV_ClearWorldEntities( sv_worldTree->integer != 0 );
+
+	// allocate the per-cluster entity lists
+	sv.numClusters = CM_NumClusters();
+	if ( sv.numClusters > 0 ) {
+		sv.clusterEntities = Hunk_Alloc( sv.numClusters * sizeof( *sv.clusterEntities ), h_high );
+	} else {
+		sv.clusterEntities = NULL;
+	}
 }
 
 
 /*
 ===============
-SV_UnlinkEntity
+SV_UnlinkEntityClusters
 
+Remove the entity from all of the per-cluster entity lists
 ===============
 */
-void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
+static void SV_UnlinkEntityClusters( svEntity_t *ent ) {
+	svClusterLink_t	*link;
+	int				i;
+
+	for ( i = 0 ; i < ent->numClusterLinks ; i++ ) {
+		link = &ent->clusterLinks[i];
+
+		if ( link->prev ) {
+			link->prev->next = link->next;
+		} else {
+			sv.clusterEntities[ link->cluster ] = link->next;
+		}
+		if ( link->next ) {
+			link->next->prev = link->prev;
+		}
+		link->prev = link->next = NULL;
+	}
+
+	ent->numClusterLinks = 0;
+}
+
+/*
+===============
+SV_LinkEntityClusters
+
+Add the entity to the per-cluster entity list of each of its clusternums.
+Entities with overflowed clusters are only linked to the explicit ones,
+the snapshot code checks them separately.
+===============
+*/
+static void SV_LinkEntityClusters( svEntity_t *ent ) {
+	svClusterLink_t	*link;
+	int				cluster;
+	int				i, j;
+
+	ent->numClusterLinks = 0;
+
+	if ( !sv.clusterEntities ) {
+		return;
+	}
+
+	for ( i = 0 ; i < ent->numClusters ; i++ ) {
+		cluster = ent->clusternums[i];
+		if ( cluster < 0 || cluster >= sv.numClusters ) {
+			break;
+		}
+
+		// multiple leafs are often in the same cluster
+		for ( j = 0 ; j < i ; j++ ) {
+			if ( ent->clusternums[j] == cluster ) {
+				break;
+			}
+		}
+		if ( j != i ) {
+			continue;
+		}
+
+		link = &ent->clusterLinks[ent->numClusterLinks++];
+		link->ent = ent;
+		link->cluster = cluster;
+		link->prev = NULL;
+		link->next = sv.clusterEntities[cluster];
+		if ( link->next ) {
+			link->next->prev = link;
+		}
+		sv.clusterEntities[cluster] = link;
+	}
+}
+
+
+/*
+===============
+SV_UnlinkSvEntity
+
+If keepTreeLeaf is set the entity's world tree leaf is returned
+instead of being removed, so SV_LinkEntity can reuse it.
+===============
+*/
+static int SV_UnlinkSvEntity( sharedEntity_t *gEnt, qboolean keepTreeLeaf ) {
 	svEntity_t		*ent;
 	svEntity_t		*scan;
 	worldSector_t	*ws;
 	sharedPlayerState_t	*ps;
+	int				leaf;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
@@ -182,25 +738,53 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 		ps->linked = qfalse;
 	}
 
+	if ( ent->worldTreeLeaf ) {
+		leaf = ent->worldTreeLeaf - 1;
+		ent->worldTreeLeaf = 0;
+
+		SV_UnlinkEntityClusters( ent );
+		sv.snapshotListsValid = qfalse;
+
+		if ( keepTreeLeaf ) {
+			return leaf;
+		}
+		SV_WorldTreeUnlinkEntity( leaf );
+		return WORLD_TREE_NULL;
+	}
+
 	ws = ent->worldSector;
 	if ( !ws ) {
-		return;		// not linked in anywhere
+		return WORLD_TREE_NULL;		// not linked in anywhere
 	}
 	ent->worldSector = NULL;
 
+	SV_UnlinkEntityClusters( ent );
+	sv.snapshotListsValid = qfalse;
+
 	if ( ws->entities == ent ) {
 		ws->entities = ent->nextEntityInWorldSector;
-		return;
+		return WORLD_TREE_NULL;
 	}
 
 	for ( scan = ws->entities ; scan ; scan = scan->nextEntityInWorldSector ) {
 		if ( scan->nextEntityInWorldSector == ent ) {
 			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
+			return WORLD_TREE_NULL;
 		}
 	}
 
 	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	return WORLD_TREE_NULL;
+}
+
+/*
+===============
+SV_UnlinkEntity
+
+===============
+*/
+void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
+	SV_UnlinkSvEntity( gEnt, qfalse );
 }
 
 
@@ -219,14 +803,18 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	int			i;
 	int			area;
 	int			lastLeaf;
+	int			treeLeaf;
 	float		*origin, *angles;
 	svEntity_t	*ent;
 	sharedPlayerState_t	*ps;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
-		SV_UnlinkEntity( gEnt );	// unlink from old position
+	// unlink from old position, keeping the tree leaf so
+	// small moves don't have to touch the tree
+	treeLeaf = WORLD_TREE_NULL;
+	if ( ent->worldSector || ent->worldTreeLeaf ) {
+		treeLeaf = SV_UnlinkSvEntity( gEnt, qtrue );
 	}
 
 	// get the position
@@ -271,6 +859,9 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	// if none of the leafs were inside the map, the
 	// entity is outside the world and can be considered unlinked
 	if ( !num_leafs ) {
+		if ( treeLeaf != WORLD_TREE_NULL ) {
+			SV_WorldTreeUnlinkEntity( treeLeaf );
+		}
 		return;
 	}
 
@@ -312,24 +903,32 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+	if ( sv_worldTreeActive ) {
+		treeLeaf = SV_WorldTreeLinkEntity( treeLeaf, ent - sv.svEntities, gEnt->r.absmin, gEnt->r.absmax );
+		ent->worldTreeLeaf = treeLeaf + 1;
+	} else {
+		// find the first world sector node that the ent's box crosses
+		node = sv_worldSectors;
+		while (1)
+		{
+			if (node->axis == -1)
+				break;
+			if ( gEnt->r.absmin[node->axis] > node->dist)
+				node = node->children[0];
+			else if ( gEnt->r.absmax[node->axis] < node->dist)
+				node = node->children[1];
+			else
+				break;		// crosses the node
+		}
+
+		// link it in
+		ent->worldSector = node;
+		ent->nextEntityInWorldSector = node->entities;
+		node->entities = ent;
 	}
-	
-	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
+
+	SV_LinkEntityClusters( ent );
+	sv.snapshotListsValid = qfalse;
 
 	gEnt->r.linked = qtrue;
 	if (gEnt->s.number < MAX_CLIENTS) {
@@ -406,6 +1005,58 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesTree_r
+
+====================
+*/
+static void SV_AreaEntitiesTree_r( int index, areaParms_t *ap ) {
+	worldTreeNode_t	*node;
+	sharedEntity_t	*gcheck;
+
+	node = &sv_entityTree.nodes[index];
+
+	if ( node->mins[0] > ap->maxs[0]
+	|| node->mins[1] > ap->maxs[1]
+	|| node->mins[2] > ap->maxs[2]
+	|| node->maxs[0] < ap->mins[0]
+	|| node->maxs[1] < ap->mins[1]
+	|| node->maxs[2] < ap->mins[2]) {
+		return;
+	}
+
+	if ( node->height > 0 ) {
+		SV_AreaEntitiesTree_r( node->children[0], ap );
+		SV_AreaEntitiesTree_r( node->children[1], ap );
+		return;
+	}
+
+	// leaf boxes are fattened, check the real one
+	gcheck = SV_GentityNum( node->entityNum );
+
+	if ( !gcheck->r.linked ) {
+		return;
+	}
+
+	if ( gcheck->r.absmin[0] > ap->maxs[0]
+	|| gcheck->r.absmin[1] > ap->maxs[1]
+	|| gcheck->r.absmin[2] > ap->maxs[2]
+	|| gcheck->r.absmax[0] < ap->mins[0]
+	|| gcheck->r.absmax[1] < ap->mins[1]
+	|| gcheck->r.absmax[2] < ap->mins[2]) {
+		return;
+	}
+
+	if ( ap->count == ap->maxcount ) {
+		Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
+		return;
+	}
+
+	ap->list[ap->count] = node->entityNum;
+	ap->count++;
+}
+
 /*
 ================
 SV_AreaEntities
@@ -420,12 +1071,229 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( sv_worldTreeActive ) {
+		if ( sv_entityTree.root != WORLD_TREE_NULL ) {
+			SV_AreaEntitiesTree_r( sv_entityTree.root, &ap );
+		}
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
 
 	return ap.count;
 }
 
 
+/*
+============================================================================
+
+WORLD BENCHMARK
+
+Moves a few hundred boxes around the current map and compares linking and
+area queries between the world sectors and the world tree.
+============================================================================
+*/
+
+typedef struct {
+	int64_t		linkUsec, queryUsec;
+	int			found;
+	unsigned	hash;		// order independent, so both broadphases should match
+} worldBenchmark_t;
+
+/*
+====================
+SV_WorldBenchmarkRandom
+====================
+*/
+static float SV_WorldBenchmarkRandom( unsigned *seed ) {
+	*seed = *seed * 1664525 + 1013904223;
+	return ( *seed >> 8 ) / (float)( 1 << 24 );
+}
+
+/*
+====================
+SV_WorldBenchmarkRun
+====================
+*/
+static void SV_WorldBenchmarkRun( qboolean useTree, int numFrames, vec3_t *velocities, int *list, worldBenchmark_t *bench ) {
+	static const vec3_t	sizes[3][2] = {
+		{ { -15, -15, -24 }, { 15, 15, 32 } },	// players
+		{ { -8, -8, -8 }, { 8, 8, 8 } },		// items and missiles
+		{ { -64, -64, -32 }, { 64, 64, 96 } }	// movers
+	};
+	sharedEntity_t	*gEnt;
+	vec3_t			worldMins, worldMaxs, mins, maxs;
+	float			*vel;
+	unsigned		seed;
+	int64_t			start;
+	int				frame, size, count;
+	int				i, j;
+
+	Com_Memset( bench, 0, sizeof( *bench ) );
+	Com_Memset( sv.svEntities, 0, sizeof( sv.svEntities ) );
+	Com_Memset( sv.gentities, 0, sv.gentitySize * sv.num_entities );
+	SV_ClearWorldEntities( useTree );
+
+	CM_ModelBounds( CM_InlineModel( 0 ), worldMins, worldMaxs );
+
+	// the same start positions and velocities for both runs
+	seed = 1;
+	for ( i = MAX_CLIENTS ; i < sv.num_entities ; i++ ) {
+		gEnt = SV_GentityNum( i );
+		gEnt->s.number = i;
+
+		size = ( i % 8 == 0 ) ? 2 : ( i % 8 < 3 ) ? 1 : 0;
+		VectorCopy( sizes[size][0], gEnt->s.mins );
+		VectorCopy( sizes[size][1], gEnt->s.maxs );
+
+		for ( j = 0 ; j < 3 ; j++ ) {
+			gEnt->r.currentOrigin[j] = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * SV_WorldBenchmarkRandom( &seed );
+			velocities[i][j] = ( SV_WorldBenchmarkRandom( &seed ) * 2 - 1 ) * ( j == 2 ? 8 : 24 );
+		}
+	}
+
+	for ( frame = 0 ; frame < numFrames ; frame++ ) {
+		start = Sys_Microseconds();
+		for ( i = MAX_CLIENTS ; i < sv.num_entities ; i++ ) {
+			gEnt = SV_GentityNum( i );
+			vel = velocities[i];
+
+			VectorAdd( gEnt->r.currentOrigin, vel, gEnt->r.currentOrigin );
+			for ( j = 0 ; j < 3 ; j++ ) {
+				if ( gEnt->r.currentOrigin[j] < worldMins[j] || gEnt->r.currentOrigin[j] > worldMaxs[j] ) {
+					vel[j] = -vel[j];
+				}
+			}
+
+			SV_LinkEntity( gEnt );
+		}
+		bench->linkUsec += Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		for ( i = MAX_CLIENTS ; i < sv.num_entities ; i++ ) {
+			gEnt = SV_GentityNum( i );
+			vel = velocities[i];
+
+			// what a move of this entity through the next frame would check
+			for ( j = 0 ; j < 3 ; j++ ) {
+				mins[j] = gEnt->r.absmin[j] + MIN( vel[j], 0 );
+				maxs[j] = gEnt->r.absmax[j] + MAX( vel[j], 0 );
+			}
+
+			count = SV_AreaEntities( mins, maxs, list, MAX_GENTITIES );
+			bench->found += count;
+			for ( j = 0 ; j < count ; j++ ) {
+				bench->hash += ( i * MAX_GENTITIES + list[j] ) * 2654435761u;
+			}
+		}
+		bench->queryUsec += Sys_Microseconds() - start;
+	}
+}
+
+/*
+====================
+SV_WorldBenchmark_f
+
+Runs on its own entities, the server's world is saved and restored around it
+====================
+*/
+void SV_WorldBenchmark_f( void ) {
+	worldBenchmark_t	sectors, tree;
+	svEntity_t			*savedSvEntities;
+	worldSector_t		*savedSectors;
+	worldTree_t			*savedTree;
+	int					savedNumSectors;
+	qboolean			savedTreeActive;
+	sharedEntity_t		*savedGentities;
+	int					savedGentitySize, savedNumEntities;
+	svClusterLink_t		**savedClusterEntities;
+	vec3_t				*velocities;
+	int					*list;
+	int					numEntities, numFrames;
+	int					i, c, maxSector, height;
+	svEntity_t			*ent;
+
+	if ( !CM_NumInlineModels() ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 3 ) {
+		Com_Printf( "Usage: worldBenchmark [entities] [frames]\n" );
+		return;
+	}
+
+	numEntities = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : 512;
+	numEntities = Com_Clamp( 1, ENTITYNUM_MAX_NORMAL - MAX_CLIENTS, numEntities );
+	numFrames = ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : 100;
+	numFrames = MAX( numFrames, 1 );
+
+	savedSvEntities = Z_Malloc( sizeof( sv.svEntities ) );
+	Com_Memcpy( savedSvEntities, sv.svEntities, sizeof( sv.svEntities ) );
+	savedSectors = Z_Malloc( sizeof( sv_worldSectors ) );
+	Com_Memcpy( savedSectors, sv_worldSectors, sizeof( sv_worldSectors ) );
+	savedTree = Z_Malloc( sizeof( sv_entityTree ) );
+	Com_Memcpy( savedTree, &sv_entityTree, sizeof( sv_entityTree ) );
+	savedNumSectors = sv_numworldSectors;
+	savedTreeActive = sv_worldTreeActive;
+	savedGentities = sv.gentities;
+	savedGentitySize = sv.gentitySize;
+	savedNumEntities = sv.num_entities;
+	savedClusterEntities = sv.clusterEntities;
+
+	sv.num_entities = MAX_CLIENTS + numEntities;
+	sv.gentitySize = sizeof( sharedEntity_t );
+	sv.gentities = Z_Malloc( sv.num_entities * sv.gentitySize );
+	sv.clusterEntities = NULL;
+
+	velocities = Z_Malloc( sv.num_entities * sizeof( *velocities ) );
+	list = Z_Malloc( MAX_GENTITIES * sizeof( *list ) );
+
+	SV_WorldBenchmarkRun( qfalse, numFrames, velocities, list, &sectors );
+
+	maxSector = 0;
+	for ( i = 0 ; i < sv_numworldSectors ; i++ ) {
+		c = 0;
+		for ( ent = sv_worldSectors[i].entities ; ent ; ent = ent->nextEntityInWorldSector ) {
+			c++;
+		}
+		maxSector = MAX( maxSector, c );
+	}
+
+	SV_WorldBenchmarkRun( qtrue, numFrames, velocities, list, &tree );
+
+	height = ( sv_entityTree.root != WORLD_TREE_NULL ) ? sv_entityTree.nodes[sv_entityTree.root].height : 0;
+
+	Com_Printf( "%i entities, %i frames\n", numEntities, numFrames );
+	Com_Printf( "sectors: link %.2f msec, query %.2f msec per frame, %i found, up to %i entities in one sector\n",
+		sectors.linkUsec / 1000.0 / numFrames, sectors.queryUsec / 1000.0 / numFrames, sectors.found, maxSector );
+	Com_Printf( "tree:    link %.2f msec, query %.2f msec per frame, %i found, height %i, %i links kept their leaf, %i moved it\n",
+		tree.linkUsec / 1000.0 / numFrames, tree.queryUsec / 1000.0 / numFrames, tree.found, height,
+		sv_entityTree.numKept, sv_entityTree.numReinserted );
+	if ( sectors.found != tree.found || sectors.hash != tree.hash ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: world sectors and world tree found different entities\n" );
+	}
+
+	Z_Free( list );
+	Z_Free( velocities );
+	Z_Free( sv.gentities );
+
+	Com_Memcpy( sv.svEntities, savedSvEntities, sizeof( sv.svEntities ) );
+	Com_Memcpy( sv_worldSectors, savedSectors, sizeof( sv_worldSectors ) );
+	Com_Memcpy( &sv_entityTree, savedTree, sizeof( sv_entityTree ) );
+	sv_numworldSectors = savedNumSectors;
+	sv_worldTreeActive = savedTreeActive;
+	sv.gentities = savedGentities;
+	sv.gentitySize = savedGentitySize;
+	sv.num_entities = savedNumEntities;
+	sv.clusterEntities = savedClusterEntities;
+	sv.snapshotListsValid = qfalse;
+
+	Z_Free( savedTree );
+	Z_Free( savedSectors );
+	Z_Free( savedSvEntities );
+}
+
+
 
 //===========================================================================
 
@@ -580,33 +1448,23 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
+SV_ClipWorldTraceToEntities
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+Finish a trace that has already been clipped to the world
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, traceType_t type ) {
+static void SV_ClipWorldTraceToEntities( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, traceType_t type ) {
 	moveclip_t	clip;
 	int			i;
 
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
+	results->entityNum = results->fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+	if ( results->fraction == 0 ) {
+		return;		// blocked immediately by the world
 	}
 
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, type );
-	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
-	if ( clip.trace.fraction == 0 ) {
-		*results = clip.trace;
-		return;		// blocked immediately by the world
-	}
-
+	clip.trace = *results;
 	clip.contentmask = contentmask;
 	clip.start = start;
 //	VectorCopy( clip.trace.endpos, clip.end );
@@ -637,6 +1495,59 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 }
 
 
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, traceType_t type ) {
+	trace_t		trace;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	// clip to world
+	CM_BoxTrace( &trace, start, end, mins, maxs, 0, contentmask, type );
+
+	SV_ClipWorldTraceToEntities( &trace, start, mins, maxs, end, passEntityNum, contentmask, type );
+
+	*results = trace;
+}
+
+
+/*
+==================
+SV_TraceBatch
+
+SV_Trace for an array of requests.  The world traces are done together
+so they can be sorted and spread over worker threads, entities are
+clipped afterwards on this thread.
+==================
+*/
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests ) {
+	const traceRequest_t	*req;
+	int						i;
+
+	if ( numRequests <= 0 ) {
+		return;
+	}
+
+	CM_BoxTraceBatch( results, requests, numRequests, 0 );
+
+	for ( i = 0, req = requests; i < numRequests; i++, req++ ) {
+		SV_ClipWorldTraceToEntities( &results[i], req->start, req->mins, req->maxs, req->end,
+			req->passEntityNum, req->contentmask, req->traceType == TT_CAPSULE ? TT_CAPSULE : TT_AABB );
+	}
+}
+
+
 /*
 =============
 SV_ClipToEntities
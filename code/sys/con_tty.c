@@ -504,6 +504,19 @@ char *CON_Input( void )
 	return NULL;
 }
 
+/*
+==================
+CON_InputFD
+==================
+*/
+int CON_InputFD( void )
+{
+	if( !stdin_active && !ttycon_on )
+		return -1;
+
+	return STDIN_FILENO;
+}
+
 /*
 ==================
 CON_Print
@@ -550,6 +550,16 @@ void CON_WindowsColorPrint( const char *msg )
 	}
 }
 
+/*
+==================
+CON_InputFD
+==================
+*/
+int CON_InputFD( void )
+{
+	return -1;
+}
+
 /*
 ==================
 CON_Print
@@ -54,6 +54,7 @@ Suite 120, Rockville, Maryland 20850 USA.
 void CON_Shutdown( void );
 void CON_Init( void );
 char *CON_Input( void );
+int CON_InputFD( void );
 void CON_Print( const char *message );
 
 unsigned int CON_LogSize( void );
@@ -146,6 +146,18 @@ char *Sys_ConsoleInput(void)
 	return CON_Input( );
 }
 
+/*
+=================
+Sys_ConsoleInputFD
+
+File descriptor to wait on for console input, or -1
+=================
+*/
+int Sys_ConsoleInputFD(void)
+{
+	return CON_InputFD( );
+}
+
 /*
 ==================
 Sys_GetClipboardData
@@ -47,6 +47,7 @@ Suite 120, Rockville, Maryland 20850 USA.
 #include <fenv.h>
 #include <sys/wait.h>
 #include <time.h>
+#include <pthread.h>
 
 qboolean stdinIsATTY;
 
@@ -142,6 +143,23 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	struct timeval tp;
+
+	gettimeofday(&tp, NULL);
+
+	if (!sys_timeBase)
+		sys_timeBase = tp.tv_sec;
+
+	return (int64_t)(tp.tv_sec - sys_timeBase)*1000000 + tp.tv_usec;
+}
+
 /*
 ==================
 Sys_RandomBytes
@@ -231,6 +249,69 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+typedef struct {
+	void	*base;
+	size_t	size;
+} sysMapping_t;
+
+/*
+==================
+Sys_MapFile
+
+Map length bytes at offset in the file, changes to the memory are private
+==================
+*/
+void *Sys_MapFile( const char *ospath, long offset, long length, void **mapping ) {
+	sysMapping_t	*map;
+	void			*base;
+	long			pageOffset;
+	int				fd;
+
+	*mapping = NULL;
+
+	if ( length <= 0 || offset < 0 ) {
+		return NULL;
+	}
+
+	fd = open( ospath, O_RDONLY );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+
+	// mappings have to start on a page
+	pageOffset = offset % sysconf( _SC_PAGESIZE );
+	base = mmap( NULL, length + pageOffset, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - pageOffset );
+	close( fd );
+
+	if ( base == MAP_FAILED ) {
+		return NULL;
+	}
+
+	map = malloc( sizeof( *map ) );
+	if ( !map ) {
+		munmap( base, length + pageOffset );
+		return NULL;
+	}
+
+	map->base = base;
+	map->size = length + pageOffset;
+	*mapping = map;
+
+	return (byte *)base + pageOffset;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *mapping ) {
+	sysMapping_t	*map = mapping;
+
+	munmap( map->base, map->size );
+	free( map );
+}
+
 /*
 ==================
 Sys_Mkdir
@@ -1015,3 +1096,212 @@ qboolean Sys_PathIsAbsolute( const char *path ) {
 
 	return ( path[0] == '/' );
 }
+
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct {
+	pthread_t	thread;
+	void		(*function)( void *arg );
+	void		*arg;
+} sysThread_t;
+
+typedef struct {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int				count;
+} sysSemaphore_t;
+
+/*
+=================
+Sys_ThreadMain
+=================
+*/
+static void *Sys_ThreadMain( void *arg ) {
+	sysThread_t *thread = arg;
+
+	thread->function( thread->arg );
+
+	return NULL;
+}
+
+/*
+=================
+Sys_CreateThread
+=================
+*/
+void *Sys_CreateThread( void (*function)( void *arg ), void *arg ) {
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if ( !thread ) {
+		return NULL;
+	}
+
+	thread->function = function;
+	thread->arg = arg;
+
+	if ( pthread_create( &thread->thread, NULL, Sys_ThreadMain, thread ) != 0 ) {
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+=================
+Sys_JoinThread
+
+Wait for the thread to exit and free it
+=================
+*/
+void Sys_JoinThread( void *thread ) {
+	pthread_join( ((sysThread_t *)thread)->thread, NULL );
+	free( thread );
+}
+
+/*
+=================
+Sys_CreateMutex
+=================
+*/
+void *Sys_CreateMutex( void ) {
+	pthread_mutex_t *mutex;
+
+	mutex = malloc( sizeof( *mutex ) );
+	if ( !mutex ) {
+		return NULL;
+	}
+
+	if ( pthread_mutex_init( mutex, NULL ) != 0 ) {
+		free( mutex );
+		return NULL;
+	}
+
+	return mutex;
+}
+
+/*
+=================
+Sys_DestroyMutex
+=================
+*/
+void Sys_DestroyMutex( void *mutex ) {
+	pthread_mutex_destroy( mutex );
+	free( mutex );
+}
+
+/*
+=================
+Sys_LockMutex
+=================
+*/
+void Sys_LockMutex( void *mutex ) {
+	pthread_mutex_lock( mutex );
+}
+
+/*
+=================
+Sys_UnlockMutex
+=================
+*/
+void Sys_UnlockMutex( void *mutex ) {
+	pthread_mutex_unlock( mutex );
+}
+
+/*
+=================
+Sys_CreateSemaphore
+
+Unnamed POSIX semaphores are not supported on all platforms (OS X),
+so use a condition variable.
+=================
+*/
+void *Sys_CreateSemaphore( void ) {
+	sysSemaphore_t *semaphore;
+
+	semaphore = malloc( sizeof( *semaphore ) );
+	if ( !semaphore ) {
+		return NULL;
+	}
+
+	if ( pthread_mutex_init( &semaphore->mutex, NULL ) != 0 ) {
+		free( semaphore );
+		return NULL;
+	}
+
+	if ( pthread_cond_init( &semaphore->cond, NULL ) != 0 ) {
+		pthread_mutex_destroy( &semaphore->mutex );
+		free( semaphore );
+		return NULL;
+	}
+
+	semaphore->count = 0;
+
+	return semaphore;
+}
+
+/*
+=================
+Sys_DestroySemaphore
+=================
+*/
+void Sys_DestroySemaphore( void *semaphore ) {
+	sysSemaphore_t *sem = semaphore;
+
+	pthread_cond_destroy( &sem->cond );
+	pthread_mutex_destroy( &sem->mutex );
+	free( sem );
+}
+
+/*
+=================
+Sys_SemaphoreWait
+=================
+*/
+void Sys_SemaphoreWait( void *semaphore ) {
+	sysSemaphore_t *sem = semaphore;
+
+	pthread_mutex_lock( &sem->mutex );
+	while ( sem->count == 0 ) {
+		pthread_cond_wait( &sem->cond, &sem->mutex );
+	}
+	sem->count--;
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+=================
+Sys_SemaphorePost
+=================
+*/
+void Sys_SemaphorePost( void *semaphore ) {
+	sysSemaphore_t *sem = semaphore;
+
+	pthread_mutex_lock( &sem->mutex );
+	sem->count++;
+	pthread_cond_signal( &sem->cond );
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+=================
+Sys_NumProcessors
+=================
+*/
+int Sys_NumProcessors( void ) {
+	long count;
+
+	count = sysconf( _SC_NPROCESSORS_ONLN );
+	if ( count < 1 ) {
+		return 1;
+	}
+
+	return count;
+}
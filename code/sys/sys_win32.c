@@ -159,6 +159,18 @@ int Sys_Milliseconds (void)
 	return sys_curtime;
 }
 
+/*
+================
+Sys_Microseconds
+
+Only millisecond precision, like Sys_Milliseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	return (int64_t)Sys_Milliseconds() * 1000;
+}
+
 /*
 ================
 Sys_RandomBytes
@@ -285,6 +297,62 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+/*
+==============
+Sys_MapFile
+
+Map length bytes at offset in the file, changes to the memory are private
+==============
+*/
+void *Sys_MapFile( const char *ospath, long offset, long length, void **mapping ) {
+	SYSTEM_INFO	info;
+	HANDLE		file, fileMapping;
+	void		*base;
+	long		pageOffset;
+
+	*mapping = NULL;
+
+	if ( length <= 0 || offset < 0 ) {
+		return NULL;
+	}
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+
+	fileMapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( !fileMapping ) {
+		return NULL;
+	}
+
+	// views have to start on the allocation granularity
+	GetSystemInfo( &info );
+	pageOffset = offset % info.dwAllocationGranularity;
+	base = MapViewOfFile( fileMapping, FILE_MAP_COPY, 0, offset - pageOffset, length + pageOffset );
+
+	// the view keeps the mapping open
+	CloseHandle( fileMapping );
+
+	if ( !base ) {
+		return NULL;
+	}
+
+	*mapping = base;
+
+	return (byte *)base + pageOffset;
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *mapping ) {
+	UnmapViewOfFile( mapping );
+}
+
 /*
 ==============
 Sys_Mkdir
@@ -840,3 +908,169 @@ qboolean Sys_PathIsAbsolute( const char *path ) {
 
 	return ( PathIsRelative( filename ) == FALSE );
 }
+
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct {
+	HANDLE		handle;
+	void		(*function)( void *arg );
+	void		*arg;
+} sysThread_t;
+
+/*
+=================
+Sys_ThreadMain
+=================
+*/
+static DWORD WINAPI Sys_ThreadMain( LPVOID arg ) {
+	sysThread_t *thread = arg;
+
+	thread->function( thread->arg );
+
+	return 0;
+}
+
+/*
+=================
+Sys_CreateThread
+=================
+*/
+void *Sys_CreateThread( void (*function)( void *arg ), void *arg ) {
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if ( !thread ) {
+		return NULL;
+	}
+
+	thread->function = function;
+	thread->arg = arg;
+	thread->handle = CreateThread( NULL, 0, Sys_ThreadMain, thread, 0, NULL );
+
+	if ( !thread->handle ) {
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+=================
+Sys_JoinThread
+
+Wait for the thread to exit and free it
+=================
+*/
+void Sys_JoinThread( void *thread ) {
+	sysThread_t *t = thread;
+
+	WaitForSingleObject( t->handle, INFINITE );
+	CloseHandle( t->handle );
+	free( t );
+}
+
+/*
+=================
+Sys_CreateMutex
+=================
+*/
+void *Sys_CreateMutex( void ) {
+	CRITICAL_SECTION *mutex;
+
+	mutex = malloc( sizeof( *mutex ) );
+	if ( !mutex ) {
+		return NULL;
+	}
+
+	InitializeCriticalSection( mutex );
+
+	return mutex;
+}
+
+/*
+=================
+Sys_DestroyMutex
+=================
+*/
+void Sys_DestroyMutex( void *mutex ) {
+	DeleteCriticalSection( mutex );
+	free( mutex );
+}
+
+/*
+=================
+Sys_LockMutex
+=================
+*/
+void Sys_LockMutex( void *mutex ) {
+	EnterCriticalSection( mutex );
+}
+
+/*
+=================
+Sys_UnlockMutex
+=================
+*/
+void Sys_UnlockMutex( void *mutex ) {
+	LeaveCriticalSection( mutex );
+}
+
+/*
+=================
+Sys_CreateSemaphore
+=================
+*/
+void *Sys_CreateSemaphore( void ) {
+	return CreateSemaphore( NULL, 0, 0x7FFFFFFF, NULL );
+}
+
+/*
+=================
+Sys_DestroySemaphore
+=================
+*/
+void Sys_DestroySemaphore( void *semaphore ) {
+	CloseHandle( semaphore );
+}
+
+/*
+=================
+Sys_SemaphoreWait
+=================
+*/
+void Sys_SemaphoreWait( void *semaphore ) {
+	WaitForSingleObject( semaphore, INFINITE );
+}
+
+/*
+=================
+Sys_SemaphorePost
+=================
+*/
+void Sys_SemaphorePost( void *semaphore ) {
+	ReleaseSemaphore( semaphore, 1, NULL );
+}
+
+/*
+=================
+Sys_NumProcessors
+=================
+*/
+int Sys_NumProcessors( void ) {
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+
+	if ( info.dwNumberOfProcessors < 1 ) {
+		return 1;
+	}
+
+	return info.dwNumberOfProcessors;
+}